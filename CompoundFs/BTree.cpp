@@ -6,15 +6,29 @@
 #include "SmallBufferStack.h"
 
 #include <algorithm>
+#include <numeric>
+#include <stdexcept>
+#include <atomic>
 #include <assert.h>
 
 using namespace TxFs;
 
+namespace
+{
+/// Versions are unique across trees, so that a cursor never mistakes a new tree for its own.
+uint64_t newVersion() noexcept
+{
+    static std::atomic<uint64_t> lastVersion { 0 };
+    return ++lastVersion;
+}
+}
+
 //////////////////////////////////////////////////////////////////////////
 
 BTree::BTree(const std::shared_ptr<CacheManager>& cacheManager, PageIndex rootIndex)
     : m_cacheManager(cacheManager)
     , m_rootIndex(rootIndex)
+    , m_version(newVersion())
 {
     if (m_rootIndex == PageIdx::INVALID)
         m_rootIndex = m_cacheManager.newPage<Leaf>(PageIdx::INVALID, PageIdx::INVALID).m_index;
@@ -27,6 +41,9 @@ struct BTree::KeyInserter
     BTree* m_btree;
     InnerNodeStack m_stack;
     ConstPageDef<Leaf> m_constLeafDef;
+    std::optional<PageDef<Leaf>> m_leafDef; // m_constLeafDef once it was made writable
+    bool m_split = false;                   // the leaf was split: m_constLeafDef and m_stack are stale
+    uint64_t m_added = 0;                   // keys added to the leaf but not yet to the counts in m_stack
 
     const uint16_t* findExact()
     {
@@ -36,6 +53,30 @@ struct BTree::KeyInserter
         return it == m_constLeafDef.m_page->endTable() ? nullptr : it;
     }
 
+    PageDef<Leaf> writableLeaf()
+    {
+        if (!m_leafDef)
+            m_leafDef = m_btree->m_cacheManager.makePageWritable(m_constLeafDef);
+        return *m_leafDef;
+    }
+
+    InsertResult upsert(ReplacePolicy replacePolicy)
+    {
+        auto it = m_constLeafDef.m_page->find(m_key);
+        if (it != m_constLeafDef.m_page->endTable())
+            return insertExistingKey(replacePolicy, it);
+
+        insertNewKey();
+        return Inserted {};
+    }
+
+    /// Adds the keys inserted into the leaf to the counts of its ancestors.
+    void updateCounts()
+    {
+        m_btree->addToCounts(m_stack, m_key, m_added);
+        m_added = 0;
+    }
+
     InsertResult insertExistingKey(ReplacePolicy replacePolicy, const uint16_t* it)
     {
         ByteStringView ventry = m_constLeafDef.m_page->getValue(it);
@@ -46,7 +87,7 @@ struct BTree::KeyInserter
         if (ventry == m_value)
             return res;
 
-        auto leafDef = m_btree->m_cacheManager.makePageWritable(m_constLeafDef);
+        auto leafDef = writableLeaf();
         if (ventry.size() == m_value.size())
         {
             // replace at the same position
@@ -56,38 +97,56 @@ struct BTree::KeyInserter
         }
 
         leafDef.m_page->remove(m_key);
-        insertNewKey(leafDef);
+        insertNewKey(leafDef, 0);
         return res;
     }
 
-    void insertNewKey(PageDef<Leaf> leafDef)
+    void insertNewKey(PageDef<Leaf> leafDef, uint64_t added)
     {
+        if (!leafDef.m_page->hasSpace(m_key, m_value))
+            leafDef.m_page->compact();
+
         if (leafDef.m_page->hasSpace(m_key, m_value))
         {
             leafDef.m_page->insert(m_key, m_value);
+            m_added += added;
             return;
         }
 
         // link rightLeaf to the right hand-side of leafDef
         auto rightLeaf = m_btree->m_cacheManager.newPage<Leaf>(leafDef.m_index, leafDef.m_page->getNext());
+        if (leafDef.m_page->getNext() != PageIdx::INVALID)
+        {
+            auto next = m_btree->m_cacheManager.loadPage<Leaf>(leafDef.m_page->getNext());
+            m_btree->m_cacheManager.makePageWritable(next).m_page->setPrev(rightLeaf.m_index);
+        }
         leafDef.m_page->setNext(rightLeaf.m_index);
 
         // split and move up
+        m_split = true;
         leafDef.m_page->split(rightLeaf.m_page.get(), m_key, m_value);
-        m_btree->propagate(m_stack, rightLeaf.m_page->getLowestKey(), leafDef.m_index, rightLeaf.m_index);
+        m_btree->propagate(m_stack, rightLeaf.m_page->getLowestKey(), leafDef.m_index, rightLeaf.m_index,
+                           leafDef.m_page->nofItems(), rightLeaf.m_page->nofItems(), m_added + added);
+        m_added = 0;
     }
 
-    void insertNewKey() { insertNewKey(m_btree->m_cacheManager.makePageWritable(m_constLeafDef)); }
+    void insertNewKey() { insertNewKey(writableLeaf(), 1); }
 };
 
 BTree::InsertResult BTree::insert(ByteStringView key, ByteStringView value, ReplacePolicy replacePolicy)
 {
+    m_version = newVersion();
     KeyInserter keyInserter { key, value, this };
     auto it = keyInserter.findExact();
     if (it)
-        return keyInserter.insertExistingKey(replacePolicy, it);
+    {
+        auto res = keyInserter.insertExistingKey(replacePolicy, it);
+        keyInserter.updateCounts();
+        return res;
+    }
 
     keyInserter.insertNewKey();
+    keyInserter.updateCounts();
     return Inserted {};
 }
 
@@ -100,18 +159,243 @@ std::optional<ByteString> BTree::insert(ByteStringView key, ByteStringView value
     return std::nullopt;
 }
 
+void BTree::insertBatch(const std::vector<KeyValue>& keyValues)
+{
+    insertBatch(keyValues, [](ByteStringView) { return true; }, {});
+}
+
+/// Inserts the pairs in ascending key order: the keys that fall into the same leaf share one descent
+/// and one makePageWritable() until the leaf has to be split. Equal keys are inserted in the order
+/// they appear in keyValues. The handler gets the index into keyValues and the result of each pair; it
+/// must not modify the tree.
+void BTree::insertBatch(const std::vector<KeyValue>& keyValues, ReplacePolicy replacePolicy,
+                        const InsertResultHandler& handler)
+{
+    m_version = newVersion();
+    std::vector<size_t> order(keyValues.size());
+    std::iota(order.begin(), order.end(), size_t(0));
+    std::stable_sort(order.begin(), order.end(),
+                     [&](size_t lhs, size_t rhs) { return keyValues[lhs].first < keyValues[rhs].first; });
+
+    auto it = order.begin();
+    while (it != order.end())
+    {
+        KeyInserter keyInserter { keyValues[*it].first, keyValues[*it].second, this };
+        keyInserter.m_constLeafDef = findLeaf(keyInserter.m_key, keyInserter.m_stack);
+        auto upperBound = leafUpperBound(keyInserter.m_stack, keyInserter.m_key);
+        do
+        {
+            std::tie(keyInserter.m_key, keyInserter.m_value) = keyValues[*it];
+            auto res = keyInserter.upsert(replacePolicy);
+            if (handler)
+                handler(*it, res);
+            ++it;
+        } while (!keyInserter.m_split && it != order.end()
+                 && (!upperBound || keyValues[*it].first < ByteStringView(*upperBound)));
+        keyInserter.updateCounts();
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////
 
-void BTree::unlinkLeaveNode(const std::shared_ptr<Leaf>& leaf)
+struct BTree::BulkLoader
 {
-    if (leaf->getPrev() != PageIdx::INVALID)
+    using Level = std::vector<InnerNode::Entry>; // lowest key, page and number of keys of each node
+
+    BTree* m_btree;
+    size_t m_leafLimit;
+    size_t m_innerLimit;
+
+    BulkLoader(BTree* btree, double fillFactor)
+        : m_btree(btree)
+        , m_leafLimit(limit(Leaf::capacity(), fillFactor))
+        , m_innerLimit(limit(InnerNode::capacity(), fillFactor))
+    {}
+
+    static size_t limit(size_t capacity, double fillFactor)
+    {
+        if (!(fillFactor > 0. && fillFactor <= 1.))
+            throw std::runtime_error("BTree::bulkLoad(): fill factor out of range");
+        return static_cast<size_t>(capacity * fillFactor);
+    }
+
+    bool fits(const Leaf& leaf, ByteStringView key, ByteStringView value) const
+    {
+        return Leaf::capacity() - leaf.bytesLeft() + leaf.requiredSpace(key, value) <= m_leafLimit;
+    }
+
+    /// Fills leaves from left to right and links them. A full leaf is compacted before moving on to
+    /// the next one. If the source turns out to be unordered the leaves loaded so far are freed.
+    Level loadLeaves(const KeyValueSource& source)
     {
-        auto left = m_cacheManager.loadPage<Leaf>(leaf->getPrev());
-        m_cacheManager.makePageWritable(left).m_page->setNext(leaf->getNext());
+        Level leaves;
+        try
+        {
+            fillLeaves(source, leaves);
+        }
+        catch (...)
+        {
+            for (const auto& leaf: leaves)
+                m_btree->m_freePages.push_back(leaf.m_page);
+            throw;
+        }
+        return leaves;
     }
-    if (leaf->getNext() != PageIdx::INVALID)
+
+    void fillLeaves(const KeyValueSource& source, Level& leaves)
     {
-        auto right = m_cacheManager.loadPage<Leaf>(leaf->getNext());
-        m_cacheManager.makePageWritable(right).m_page->setPrev(leaf->getPrev());
+        std::optional<PageDef<Leaf>> leafDef;
+        ByteString lastKey;
+
+        while (auto keyValue = source())
+        {
+            auto [key, value] = *keyValue;
+            if (leafDef && !(ByteStringView(lastKey) < key))
+                throw std::runtime_error("BTree::bulkLoad(): keys are not strictly ascending");
+
+            if (leafDef && !fits(*leafDef->m_page, key, value))
+                leafDef->m_page->compact();
+
+            if (!leafDef || !fits(*leafDef->m_page, key, value))
+            {
+                auto prev = leafDef ? leafDef->m_index : PageIdx::INVALID;
+                auto nextLeaf = m_btree->m_cacheManager.newPage<Leaf>(prev, PageIdx::INVALID);
+                if (leafDef)
+                    leafDef->m_page->setNext(nextLeaf.m_index);
+                leafDef = nextLeaf;
+                leaves.push_back({ key, nextLeaf.m_index });
+            }
+
+            leafDef->m_page->insert(key, value);
+            leaves.back().m_count++;
+            lastKey = key;
+        }
+    }
+
+    /// Groups the children into inner nodes, accounting for the prefix the keys of a node share.
+    /// Every node gets at least two children, so the last group either joins its predecessor or
+    /// takes over the predecessor's last child.
+    Level loadInnerNodes(const Level& children)
+    {
+        assert(children.size() > 1);
+        std::vector<std::pair<size_t, size_t>> groups; // [begin, end) into children
+        size_t keyBytes = 0;
+        size_t prefixSize = 0;
+        for (size_t i = 0; i < children.size(); i++)
+        {
+            ByteStringView key = children[i].m_key;
+            if (groups.empty())
+            {
+                groups.emplace_back(i, i + 1);
+                continue;
+            }
+
+            auto& [begin, end] = groups.back();
+            auto nofItems = end - begin - 1;
+            if (nofItems == 0)
+            {
+                end++;
+                keyBytes = key.size();
+                prefixSize = key.size();
+                continue;
+            }
+
+            auto newPrefixSize = std::min(prefixSize, commonPrefixSize(children[begin + 1].m_key, key));
+            if (InnerNode::packedSize(nofItems + 1, keyBytes + key.size(), newPrefixSize) > m_innerLimit)
+            {
+                groups.emplace_back(i, i + 1);
+                continue;
+            }
+
+            end++;
+            keyBytes += key.size();
+            prefixSize = newPrefixSize;
+        }
+
+        if (groups.size() > 1 && groups.back().second - groups.back().first == 1)
+        {
+            auto& prev = *(groups.end() - 2);
+            auto data = children.data();
+            if (InnerNode::packedSize(data + prev.first + 1, data + prev.second + 1) <= InnerNode::capacity())
+            {
+                prev.second++;
+                groups.pop_back();
+            }
+            else
+            {
+                assert(prev.second - prev.first > 2);
+                prev.second--;
+                groups.back().first--;
+            }
+        }
+
+        Level parents;
+        for (auto [begin, end]: groups)
+        {
+            auto innerDef = m_btree->m_cacheManager.newPage<InnerNode>();
+            auto data = children.data();
+            innerDef.m_page->assign(children[begin], data + begin + 1, data + end);
+            parents.push_back({ children[begin].m_key, innerDef.m_index, innerDef.m_page->totalCount() });
+        }
+        return parents;
+    }
+
+    /// Moves the single top-level node into the root page, which keeps its index.
+    void replaceRoot(PageIndex top)
+    {
+        auto root = m_btree->m_cacheManager.makePageWritable(m_btree->m_cacheManager.loadPage<Leaf>(m_btree->m_rootIndex));
+        auto topDef = m_btree->m_cacheManager.loadPage<Node>(top);
+        if (topDef.m_page->m_type == NodeType::Leaf)
+            *root.m_page = *staticPageDefCast<Leaf>(std::move(topDef)).m_page;
+        else
+            new (root.m_page.get()) InnerNode(*staticPageDefCast<InnerNode>(std::move(topDef)).m_page);
+        m_btree->m_freePages.push_back(top);
+    }
+
+    void load(const KeyValueSource& source)
+    {
+        auto level = loadLeaves(source);
+        if (level.empty())
+            return;
+
+        while (level.size() > 1)
+            level = loadInnerNodes(level);
+        replaceRoot(level.front().m_page);
+    }
+};
+
+/// Builds the tree bottom-up from key/value pairs in strictly ascending key order. Leaves and inner
+/// nodes are packed up to fillFactor of their capacity. If the tree is not empty the pairs are 
+/// inserted one by one.
+void BTree::bulkLoad(const KeyValueSource& source, double fillFactor)
+{
+    m_version = newVersion();
+    auto rootDef = m_cacheManager.loadPage<Node>(m_rootIndex);
+    if (rootDef.m_page->m_type != NodeType::Leaf || !staticPageDefCast<Leaf>(std::move(rootDef)).m_page->empty())
+    {
+        while (auto keyValue = source())
+            insert(keyValue->first, keyValue->second);
+        return;
+    }
+
+    BulkLoader bulkLoader(this, fillFactor);
+    bulkLoader.load(source);
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+/// Links prev and next, dropping the leaves in between from the chain.
+void BTree::unlinkLeaves(PageIndex prev, PageIndex next)
+{
+    if (prev != PageIdx::INVALID)
+    {
+        auto left = m_cacheManager.loadPage<Leaf>(prev);
+        m_cacheManager.makePageWritable(left).m_page->setNext(next);
+    }
+    if (next != PageIdx::INVALID)
+    {
+        auto right = m_cacheManager.loadPage<Leaf>(next);
+        m_cacheManager.makePageWritable(right).m_page->setPrev(prev);
     }
 }
 
@@ -134,17 +418,20 @@ std::shared_ptr<const InnerNode> BTree::handleUnderflow([[maybe_unused]] PageDef
         auto rightPage = m_cacheManager.makePageWritable(right).m_page;
         auto newParentKey = InnerNode::redistribute(*left.m_page, *rightPage, parentKey);
         parent.m_page->remove(parentKey);
-        parent.m_page->insert(newParentKey, right.m_index);
+        parent.m_page->insert(newParentKey, right.m_index, rightPage->totalCount());
+        parent.m_page->setCount(left.m_index, left.m_page->totalCount());
         return nullptr;
     }
 
     left.m_page->mergeWith(*right.m_page, parentKey);
+    parent.m_page->setCount(left.m_index, left.m_page->totalCount());
     m_freePages.push_back(right.m_index);
     return right.m_page;
 }
 
 std::optional<ByteString> BTree::remove(ByteStringView key)
 {
+    m_version = newVersion();
     InnerNodeStack stack;
 
     auto leafDef = findLeaf(key, stack);
@@ -156,10 +443,22 @@ std::optional<ByteString> BTree::remove(ByteStringView key)
     auto leaf = m_cacheManager.makePageWritable(leafDef).m_page;
     leaf->remove(key);
     if (leaf->nofItems() > 0)
+    {
+        addToCounts(stack, key, -1);
         return beforeValue;
+    }
 
-    unlinkLeaveNode(leaf);
+    unlinkLeaves(leaf->getPrev(), leaf->getNext());
     m_freePages.push_back(leafDef.m_index);
+    removeFromParents(stack, key, 1);
+    return beforeValue;
+}
+
+/// Removes the child key leads to from the inner node on top of the stack, after the child and the
+/// removed keys below it were freed. Underflowing nodes are merged or redistributed up to the root.
+void BTree::removeFromParents(InnerNodeStack& stack, ByteStringView key, uint64_t removed)
+{
+    ByteString freedKey;
     while (!stack.empty())
     {
         auto inner = m_cacheManager.makePageWritable(stack.top());
@@ -167,7 +466,7 @@ std::optional<ByteString> BTree::remove(ByteStringView key)
         innerPage->remove(key);
 
         if (innerPage->nofItems() > 1)
-            return beforeValue;
+            break;
         else if (innerPage->nofItems() == 0)
         {
             // must be the root page
@@ -176,20 +475,37 @@ std::optional<ByteString> BTree::remove(ByteStringView key)
             auto xleaf = m_cacheManager.loadPage<Leaf>(innerPage->getLeft(innerPage->beginTable()));
             [[maybe_unused]] auto root = new (innerPage.get()) Leaf(*xleaf.m_page);
             m_freePages.push_back(xleaf.m_index);
-            return beforeValue;
+            return;
         }
         else if (stack.size() == 1)
-            return beforeValue;
+            return;
 
         auto freePage = handleUnderflow(inner, key, stack);
         if (!freePage)
-            return beforeValue;
+        {
+            // the counts of the parent are up to date as well
+            stack.pop();
+            break;
+        }
 
-        key = freePage->getKey(freePage->beginTable());
+        freedKey = freePage->getKey(freePage->beginTable());
+        key = freedKey;
         stack.pop();
     }
 
-    return beforeValue;
+    if (!stack.empty())
+        stack.pop();
+    addToCounts(stack, key, -static_cast<int64_t>(removed));
+}
+
+/// Adds delta to the counts on the path to key, from the inner node on top of the stack up to the
+/// root. The stack is emptied.
+void BTree::addToCounts(InnerNodeStack& stack, ByteStringView key, int64_t delta)
+{
+    if (delta == 0)
+        return;
+    for (; !stack.empty(); stack.pop())
+        m_cacheManager.makePageWritable(stack.top()).m_page->addCount(key, delta);
 }
 
 ConstPageDef<Leaf> BTree::findLeaf(ByteStringView key, InnerNodeStack& stack) const
@@ -205,30 +521,58 @@ ConstPageDef<Leaf> BTree::findLeaf(ByteStringView key, InnerNodeStack& stack) co
     }
 }
 
-void BTree::propagate(InnerNodeStack& stack, ByteStringView keyToInsert, PageIndex left, PageIndex right)
+/// The lowest separator key above key on the path to its leaf: all keys below it go to the same leaf.
+/// The rightmost leaf has no upper bound.
+std::optional<ByteString> BTree::leafUpperBound(const InnerNodeStack& stack, ByteStringView key) const
+{
+    for (auto it = stack.end(); it != stack.end() - stack.size();)
+    {
+        const auto& inner = *(--it)->m_page;
+        auto pos = inner.lowerBound(key);
+        if (pos != inner.endTable() && ByteStringView(inner.getKey(pos)) == key)
+            ++pos;
+        if (pos != inner.endTable())
+            return inner.getKey(pos);
+    }
+    return std::nullopt;
+}
+
+/// Inserts right after left, which was split. The ancestors above the inner node that takes right
+/// count the keys added to left and right.
+void BTree::propagate(InnerNodeStack& stack, ByteStringView keyToInsert, PageIndex left, PageIndex right,
+                      uint64_t leftCount, uint64_t rightCount, uint64_t added)
 {
     ByteString key = keyToInsert;
     bool leftRightIsLeaf = stack.empty();
     while (!stack.empty())
     {
         auto inner = m_cacheManager.makePageWritable(stack.top());
+        inner.m_page->setCount(left, leftCount);
+        if (!inner.m_page->hasSpace(key))
+            inner.m_page->compact();
+
         if (inner.m_page->hasSpace(key))
         {
-            inner.m_page->insert(key, right);
+            inner.m_page->insert(key, right, rightCount);
+            stack.pop();
+            addToCounts(stack, key, added);
             return;
         }
 
         auto rightInner = m_cacheManager.newPage<InnerNode>();
-        key = inner.m_page->split(rightInner.m_page.get(), key, right);
+        key = inner.m_page->split(rightInner.m_page.get(), key, right, rightCount);
         left = inner.m_index;
         right = rightInner.m_index;
+        leftCount = inner.m_page->totalCount();
+        rightCount = rightInner.m_page->totalCount();
         stack.pop();
     }
 
-    growTree(key, leftRightIsLeaf, left, right);
+    growTree(key, leftRightIsLeaf, left, right, leftCount, rightCount);
 }
 
-void TxFs::BTree::growTree(ByteStringView key, bool leftRightIsLeaf, PageIndex left, PageIndex right)
+void TxFs::BTree::growTree(ByteStringView key, bool leftRightIsLeaf, PageIndex left, PageIndex right,
+                           uint64_t leftCount, uint64_t rightCount)
 {
     assert(m_rootIndex == left);
     if (leftRightIsLeaf)
@@ -238,14 +582,16 @@ void TxFs::BTree::growTree(ByteStringView key, bool leftRightIsLeaf, PageIndex l
         auto rightDef = m_cacheManager.makePageWritable(m_cacheManager.loadPage<Leaf>(right));
         *pageDef.m_page = *leftDef.m_page; 
         rightDef.m_page->setPrev(pageDef.m_index);
-        [[maybe_unused]] auto root = new (leftDef.m_page.get()) InnerNode(key, pageDef.m_index, right);
+        [[maybe_unused]] auto root =
+            new (leftDef.m_page.get()) InnerNode(key, pageDef.m_index, right, leftCount, rightCount);
         return;
     }
 
     auto pageDef = m_cacheManager.newPage<InnerNode>();
     auto leftDef = m_cacheManager.makePageWritable(m_cacheManager.loadPage<InnerNode>(left));
     *pageDef.m_page = *leftDef.m_page;
-    [[maybe_unused]] auto root = new (leftDef.m_page.get()) InnerNode(key, pageDef.m_index, right);
+    [[maybe_unused]] auto root =
+        new (leftDef.m_page.get()) InnerNode(key, pageDef.m_index, right, leftCount, rightCount);
 }
 
 BTree::RenameResult BTree::rename(ByteStringView oldKey, ByteStringView newKey)
@@ -265,6 +611,12 @@ BTree::RenameResult BTree::rename(ByteStringView oldKey, ByteStringView newKey)
     return std::get<Unchanged>(res);
 }
 
+struct BTree::KeyRange
+{
+    ByteString m_lowKey;
+    ByteString m_highKey; // empty: unbounded
+};
+
 BTree::Cursor BTree::find(ByteStringView key) const
 {
     InnerNodeStack stack;
@@ -273,35 +625,208 @@ BTree::Cursor BTree::find(ByteStringView key) const
     auto it = leafDef.m_page->find(key);
     if (it == leafDef.m_page->endTable())
         return Cursor();
-    return Cursor(leafDef.m_page, it);
+    return makeCursor(leafDef.m_page, it, nullptr);
 }
 
-BTree::Cursor BTree::begin(ByteStringView key) const
+/// The first entry with a key not less than key. If the leaf key leads to has none, it is the first
+/// entry of the next leaf.
+std::pair<std::shared_ptr<const Leaf>, const uint16_t*> BTree::locate(ByteStringView key) const
 {
     InnerNodeStack stack;
 
-    auto leafDef = findLeaf(key, stack);
-    auto it = leafDef.m_page->lowerBound(key);
-    if (it == leafDef.m_page->endTable())
-        return Cursor();
+    auto leaf = findLeaf(key, stack).m_page;
+    const uint16_t* it = leaf->lowerBound(key);
+    if (it == leaf->endTable() && leaf->getNext() != PageIdx::INVALID)
+    {
+        leaf = m_cacheManager.loadPage<Leaf>(leaf->getNext()).m_page;
+        it = leaf->beginTable();
+    }
+    return { leaf, it };
+}
+
+BTree::Cursor BTree::begin(ByteStringView key) const
+{
+    auto [leaf, it] = locate(key);
+    return makeCursor(leaf, it, nullptr);
+}
+
+/// Cursor over the keys in [lowKey, highKey); an empty highKey leaves the range unbounded.
+BTree::Cursor BTree::begin(ByteStringView lowKey, ByteStringView highKey) const
+{
+    auto range = std::make_shared<const KeyRange>(KeyRange { lowKey, highKey });
+    auto [leaf, it] = locate(lowKey);
+    return makeCursor(leaf, it, range);
+}
+
+/// Cursor at the key with the given index within [lowKey, highKey). The subtree counts lead to its
+/// leaf in a single descent.
+BTree::Cursor BTree::begin(ByteStringView lowKey, ByteStringView highKey, size_t index) const
+{
+    auto range = std::make_shared<const KeyRange>(KeyRange { lowKey, highKey });
+    uint64_t position = rank(lowKey) + index;
+    PageIndex id = m_rootIndex;
+    while (true)
+    {
+        auto nodeDef = m_cacheManager.loadPage<Node>(id);
+        if (nodeDef.m_page->m_type == NodeType::Leaf)
+        {
+            auto leaf = staticPageDefCast<Leaf>(std::move(nodeDef)).m_page;
+            auto it = leaf->beginTable() + std::min<uint64_t>(position, leaf->nofItems());
+            return makeCursor(leaf, it, range);
+        }
+        id = staticPageDefCast<InnerNode>(std::move(nodeDef)).m_page->findPosition(position);
+    }
+}
+
+/// Number of keys in [lowKey, highKey); an empty highKey counts all keys from lowKey on.
+size_t BTree::count(ByteStringView lowKey, ByteStringView highKey) const
+{
+    auto low = rank(lowKey);
+    if (highKey.size() > 0)
+        return rank(highKey) - low;
+
+    auto nodeDef = m_cacheManager.loadPage<Node>(m_rootIndex);
+    if (nodeDef.m_page->m_type == NodeType::Leaf)
+        return staticPageDefCast<Leaf>(std::move(nodeDef)).m_page->nofItems() - low;
+    return staticPageDefCast<InnerNode>(std::move(nodeDef)).m_page->totalCount() - low;
+}
 
-    return Cursor(leafDef.m_page, it);
+/// Number of keys less than key: the counts of the subtrees left of the path to key's leaf and the
+/// keys before key within the leaf.
+uint64_t BTree::rank(ByteStringView key) const
+{
+    uint64_t rank = 0;
+    PageIndex id = m_rootIndex;
+    while (true)
+    {
+        auto nodeDef = m_cacheManager.loadPage<Node>(id);
+        if (nodeDef.m_page->m_type == NodeType::Leaf)
+        {
+            auto leaf = staticPageDefCast<Leaf>(std::move(nodeDef)).m_page;
+            return rank + (leaf->lowerBound(key) - leaf->beginTable());
+        }
+        auto inner = staticPageDefCast<InnerNode>(std::move(nodeDef)).m_page;
+        rank += inner->countBefore(key);
+        id = inner->findPage(key);
+    }
 }
 
+/// Stepping within a leaf is cheap while the tree is unchanged. Otherwise the cursor first finds its
+/// key again, or the key that took its place.
 BTree::Cursor BTree::next(Cursor cursor) const
 {
     if (!cursor)
         return cursor;
 
-    const auto& [leaf, index] = *cursor.m_position;
-    if (leaf->beginTable() + index + 1 < leaf->endTable())
-        return Cursor(leaf, leaf->beginTable() + index + 1);
+    if (cursor.m_version != m_version)
+    {
+        ByteStringView key = cursor.m_position->m_key;
+        auto [leaf, it] = locate(key);
+        bool found = it != leaf->endTable() && ByteStringView(leaf->getKey(it)) == key;
+        auto relocated = makeCursor(leaf, it, cursor.m_range);
+        if (!found || !relocated)
+            return relocated;
+        cursor = relocated;
+    }
 
-    if (leaf->getNext() == PageIdx::INVALID)
-        return Cursor();
+    auto& pos = *cursor.m_position;
+    if (pos.m_index + 1 < pos.m_end)
+    {
+        pos.m_index++;
+        pos.m_key = pos.m_leaf->getKey(pos.m_leaf->beginTable() + pos.m_index);
+        return cursor;
+    }
 
-    auto nextLeaf = m_cacheManager.loadPage<Leaf>(leaf->getNext()).m_page;
-    return Cursor(nextLeaf, nextLeaf->beginTable());
+    if (pos.m_end < pos.m_leaf->nofItems() || pos.m_leaf->getNext() == PageIdx::INVALID)
+        return makeCursor(pos.m_leaf, pos.m_leaf->endTable(), cursor.m_range);
+
+    auto nextLeaf = m_cacheManager.loadPage<Leaf>(pos.m_leaf->getNext()).m_page;
+    return makeCursor(nextLeaf, nextLeaf->beginTable(), cursor.m_range);
+}
+
+BTree::Cursor BTree::prev(Cursor cursor) const
+{
+    if (!cursor)
+        return cursor;
+
+    if (cursor.m_version != m_version)
+    {
+        auto [leaf, it] = locate(cursor.m_position->m_key);
+        return stepBack(leaf, it, cursor.m_range);
+    }
+
+    auto& pos = *cursor.m_position;
+    if (pos.m_index > pos.m_begin)
+    {
+        pos.m_index--;
+        pos.m_key = pos.m_leaf->getKey(pos.m_leaf->beginTable() + pos.m_index);
+        return cursor;
+    }
+    return stepBack(pos.m_leaf, pos.m_leaf->beginTable() + pos.m_index, cursor.m_range);
+}
+
+/// Moves the cursor to the first key not less than key, staying within the cursor's range. Keys in
+/// the cursor's leaf or the leaf after it are found without descending the tree.
+BTree::Cursor BTree::seek(Cursor cursor, ByteStringView key) const
+{
+    if (cursor.m_range && key < cursor.m_range->m_lowKey)
+        key = cursor.m_range->m_lowKey;
+
+    if (cursor && cursor.m_version == m_version)
+    {
+        auto leaf = cursor.m_position->m_leaf;
+        bool aboveLeaf = ByteStringView(leaf->getKey(leaf->endTable() - 1)) < key;
+        if (aboveLeaf && leaf->getNext() != PageIdx::INVALID)
+        {
+            auto nextLeaf = m_cacheManager.loadPage<Leaf>(leaf->getNext()).m_page;
+            if (!(ByteStringView(nextLeaf->getKey(nextLeaf->endTable() - 1)) < key))
+                return makeCursor(nextLeaf, nextLeaf->lowerBound(key), cursor.m_range);
+        }
+        else if (!aboveLeaf && (leaf->getPrev() == PageIdx::INVALID || !(key < ByteStringView(leaf->getLowestKey()))))
+            return makeCursor(leaf, leaf->lowerBound(key), cursor.m_range);
+    }
+
+    auto [leaf, it] = locate(key);
+    return makeCursor(leaf, it, cursor.m_range);
+}
+
+/// The cursor at the entry before it.
+BTree::Cursor BTree::stepBack(const std::shared_ptr<const Leaf>& leaf, const uint16_t* it,
+                              const std::shared_ptr<const KeyRange>& range) const
+{
+    if (it != leaf->beginTable())
+        return makeCursor(leaf, it - 1, range);
+    if (leaf->getPrev() == PageIdx::INVALID)
+        return makeCursor(leaf, leaf->endTable(), range);
+
+    auto prevLeaf = m_cacheManager.loadPage<Leaf>(leaf->getPrev()).m_page;
+    assert(!prevLeaf->empty());
+    return makeCursor(prevLeaf, prevLeaf->endTable() - 1, range);
+}
+
+/// The cursor at it. The cursor is empty, but keeps its range, if it is outside of the range.
+BTree::Cursor BTree::makeCursor(const std::shared_ptr<const Leaf>& leaf, const uint16_t* it,
+                                const std::shared_ptr<const KeyRange>& range) const
+{
+    const uint16_t* begin = leaf->beginTable();
+    const uint16_t* end = leaf->endTable();
+    if (range)
+    {
+        begin = leaf->lowerBound(range->m_lowKey);
+        if (range->m_highKey.size() > 0)
+            end = leaf->lowerBound(range->m_highKey);
+    }
+
+    Cursor cursor;
+    if (it >= begin && it < end)
+    {
+        cursor = Cursor(leaf, it);
+        cursor.m_position->m_begin = static_cast<uint16_t>(begin - leaf->beginTable());
+        cursor.m_position->m_end = static_cast<uint16_t>(end - leaf->beginTable());
+    }
+    cursor.m_range = range;
+    cursor.m_version = m_version;
+    return cursor;
 }
 
 struct BTree::NodeVisitor
@@ -361,14 +886,151 @@ bool BTree::visitAllNodes(const TreeNodeVisitor& visitor)
 
 //////////////////////////////////////////////////////////////////////////
 
+struct BTree::RangeRemover
+{
+    BTree* m_btree;
+    ByteString m_low;
+    ByteStringView m_high; // empty: unbounded
+    const KeyValueHandler& m_handler;
+    size_t m_removed = 0;
+
+    bool belowHigh(ByteStringView key) const { return m_high.size() == 0 || key < m_high; }
+
+    bool covers(ByteStringView lower, const std::optional<ByteString>& upper) const
+    {
+        if (lower < m_low)
+            return false;
+        return m_high.size() == 0 || (upper && !(m_high < *upper));
+    }
+
+    void report(const Leaf& leaf, const uint16_t* begin, const uint16_t* end)
+    {
+        m_removed += end - begin;
+        if (m_handler)
+            for (auto it = begin; it != end; ++it)
+                m_handler(leaf.getKey(it), leaf.getValue(it));
+    }
+
+    /// Descends towards m_low. The first subtree on the way that lies completely within the range is
+    /// dropped, otherwise the range is removed from the leaf m_low belongs to. Returns false if there
+    /// is nothing left to remove.
+    bool removeNext()
+    {
+        InnerNodeStack stack;
+        ByteString lower; // the keys of the node are in [lower, upper)
+        std::optional<ByteString> upper;
+        PageIndex id = m_btree->m_rootIndex;
+        while (true)
+        {
+            auto nodeDef = m_btree->m_cacheManager.loadPage<Node>(id);
+            if (nodeDef.m_page->m_type == NodeType::Leaf)
+                return removeFromLeaf(staticPageDefCast<Leaf>(std::move(nodeDef)), stack, upper);
+
+            stack.emplace(staticPageDefCast<InnerNode>(std::move(nodeDef)));
+            const auto& inner = *stack.top().m_page;
+            auto it = inner.lowerBound(m_low);
+            if (it != inner.endTable() && ByteStringView(inner.getKey(it)) == ByteStringView(m_low))
+                id = inner.getRight(it++);
+            else
+                id = inner.getLeft(it);
+            if (it != inner.beginTable())
+                lower = inner.getKey(it - 1);
+            if (it != inner.endTable())
+                upper = inner.getKey(it);
+
+            if (covers(lower, upper))
+            {
+                dropSubtree(id, stack, lower);
+                return true;
+            }
+        }
+    }
+
+    /// Hands all pages of the subtree to the free pages without making them writable.
+    void dropSubtree(PageIndex id, InnerNodeStack& stack, ByteStringView key)
+    {
+        auto removedBefore = m_removed;
+        PageIndex prev = PageIdx::INVALID;
+        PageIndex next = PageIdx::INVALID;
+        bool first = true;
+        TreeNodeVisitor visitor = [&](const TreeNode& node) {
+            if (auto leafDef = std::get_if<ConstPageDef<Leaf>>(&node))
+            {
+                const auto& leaf = *leafDef->m_page;
+                report(leaf, leaf.beginTable(), leaf.endTable());
+                prev = first ? leaf.getPrev() : prev;
+                next = leaf.getNext();
+                first = false;
+                m_btree->m_freePages.push_back(leafDef->m_index);
+            }
+            else
+                m_btree->m_freePages.push_back(std::get<ConstPageDef<InnerNode>>(node).m_index);
+            return true;
+        };
+        NodeVisitor(m_btree->m_cacheManager, visitor).visit(id);
+
+        m_btree->unlinkLeaves(prev, next);
+        m_btree->removeFromParents(stack, key, m_removed - removedBefore);
+    }
+
+    bool removeFromLeaf(const ConstPageDef<Leaf>& leafDef, InnerNodeStack& stack, const std::optional<ByteString>& upper)
+    {
+        const auto& leaf = *leafDef.m_page;
+        auto begin = leaf.lowerBound(m_low);
+        auto end = begin;
+        while (end != leaf.endTable() && belowHigh(leaf.getKey(end)))
+            ++end;
+
+        if (begin != end)
+        {
+            report(leaf, begin, end);
+            std::vector<ByteString> keys;
+            for (auto it = begin; it != end; ++it)
+                keys.push_back(leaf.getKey(it));
+
+            auto page = m_btree->m_cacheManager.makePageWritable(leafDef).m_page;
+            for (const auto& key: keys)
+                page->remove(key);
+
+            if (page->empty() && !stack.empty())
+            {
+                m_btree->unlinkLeaves(page->getPrev(), page->getNext());
+                m_btree->m_freePages.push_back(leafDef.m_index);
+                m_btree->removeFromParents(stack, m_low, keys.size());
+            }
+            else
+                m_btree->addToCounts(stack, m_low, -static_cast<int64_t>(keys.size()));
+        }
+
+        if (!upper || !belowHigh(*upper))
+            return false;
+        m_low = *upper;
+        return true;
+    }
+};
+
+/// Removes all keys in [lowKey, highKey); an empty highKey removes all keys from lowKey on. Subtrees
+/// within the range are dropped as a whole, so the tree is descended once per dropped subtree
+/// instead of once per key. The handler sees each removed pair; it must not modify the tree.
+size_t BTree::removeRange(ByteStringView lowKey, ByteStringView highKey, const KeyValueHandler& handler)
+{
+    m_version = newVersion();
+    RangeRemover rangeRemover { this, lowKey, highKey, handler };
+    while (rangeRemover.removeNext())
+        ;
+    return rangeRemover.m_removed;
+}
+
+//////////////////////////////////////////////////////////////////////////
+
 BTree::Cursor::Cursor(const std::shared_ptr<const Leaf>& leaf, const uint16_t* it) noexcept
-    : m_position({ leaf, uint16_t(it - leaf->beginTable()) })
+    : m_position({ leaf, uint16_t(it - leaf->beginTable()), leaf->getKey(it), 0, uint16_t(leaf->nofItems()) })
 {}
 
 std::pair<ByteStringView, ByteStringView> BTree::Cursor::current() const
 {
-    const auto& [leaf, index] = *m_position;
-    auto it = leaf->beginTable() + index;
-    return std::make_pair(leaf->getKey(it), leaf->getValue(it));
+    const auto& pos = *m_position;
+    auto it = pos.m_leaf->beginTable() + pos.m_index;
+    return { pos.m_key, pos.m_leaf->getValue(it) };
 }
 
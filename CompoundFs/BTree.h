@@ -27,6 +27,9 @@ class BTree final
     using InnerNodeStack = SmallBufferStack<ConstPageDef<InnerNode>, 5>;
     struct KeyInserter;
     struct NodeVisitor;
+    struct BulkLoader;
+    struct RangeRemover;
+    struct KeyRange;
 
 public:
     class Cursor;
@@ -39,34 +42,62 @@ public:
     using ReplacePolicy = bool (*)(ByteStringView beforValue);
     using TreeNode = std::variant<ConstPageDef<Leaf>, ConstPageDef<InnerNode>>;
     using TreeNodeVisitor = std::function<bool (const TreeNode&)>;
+    using KeyValue = std::pair<ByteStringView, ByteStringView>;
+    using KeyValueSource = std::function<std::optional<KeyValue>()>;
+    using InsertResultHandler = std::function<void(size_t index, const InsertResult&)>;
+    using KeyValueHandler = std::function<void(ByteStringView key, ByteStringView value)>;
 
 public:
     BTree(const std::shared_ptr<CacheManager>& cacheManager, PageIndex rootIndex = PageIdx::INVALID);
 
     std::optional<ByteString> insert(ByteStringView key, ByteStringView value);
     InsertResult insert(ByteStringView key, ByteStringView value, ReplacePolicy replacePolicy);
+    void insertBatch(const std::vector<KeyValue>& keyValues);
+    void insertBatch(const std::vector<KeyValue>& keyValues, ReplacePolicy replacePolicy,
+                     const InsertResultHandler& handler);
     RenameResult rename(ByteStringView oldKey, ByteStringView newKey);
     std::optional<ByteString> remove(ByteStringView key);
+    size_t removeRange(ByteStringView lowKey, ByteStringView highKey, const KeyValueHandler& handler = {});
+    void bulkLoad(const KeyValueSource& source, double fillFactor = 1.0);
+    template <typename TIter>
+    void bulkLoad(TIter begin, TIter end, double fillFactor = 1.0);
 
     Cursor find(ByteStringView key) const;
     Cursor begin(ByteStringView key) const;
+    Cursor begin(ByteStringView lowKey, ByteStringView highKey) const;
     Cursor next(Cursor cursor) const;
+    Cursor prev(Cursor cursor) const;
+    Cursor seek(Cursor cursor, ByteStringView key) const;
+    Cursor begin(ByteStringView lowKey, ByteStringView highKey, size_t index) const;
+    size_t count(ByteStringView lowKey, ByteStringView highKey) const;
 
     bool visitAllNodes(const TreeNodeVisitor&);
     const std::vector<PageIndex>& getFreePages() const noexcept { return m_freePages; }
 
 private:
-    void propagate(InnerNodeStack& stack, ByteStringView keyToInsert, PageIndex left, PageIndex right);
+    void propagate(InnerNodeStack& stack, ByteStringView keyToInsert, PageIndex left, PageIndex right,
+                   uint64_t leftCount, uint64_t rightCount, uint64_t added);
+    void addToCounts(InnerNodeStack& stack, ByteStringView key, int64_t delta);
+    uint64_t rank(ByteStringView key) const;
     ConstPageDef<Leaf> findLeaf(ByteStringView key, InnerNodeStack& stack) const;
+    std::optional<ByteString> leafUpperBound(const InnerNodeStack& stack, ByteStringView key) const;
+    std::pair<std::shared_ptr<const Leaf>, const uint16_t*> locate(ByteStringView key) const;
+    Cursor makeCursor(const std::shared_ptr<const Leaf>& leaf, const uint16_t* it,
+                      const std::shared_ptr<const KeyRange>& range) const;
+    Cursor stepBack(const std::shared_ptr<const Leaf>& leaf, const uint16_t* it,
+                    const std::shared_ptr<const KeyRange>& range) const;
     std::shared_ptr<const InnerNode> handleUnderflow(PageDef<InnerNode>& inner, ByteStringView key,
                                                      const InnerNodeStack& stack);
-    void unlinkLeaveNode(const std::shared_ptr<Leaf>& leaf);
-    void growTree(ByteStringView keyToInsert, bool leftRightIsLeaf, PageIndex left, PageIndex right);
+    void unlinkLeaves(PageIndex prev, PageIndex next);
+    void removeFromParents(InnerNodeStack& stack, ByteStringView key, uint64_t removed);
+    void growTree(ByteStringView keyToInsert, bool leftRightIsLeaf, PageIndex left, PageIndex right,
+                  uint64_t leftCount, uint64_t rightCount);
 
 private:
     mutable TypedCacheManager m_cacheManager;
     PageIndex m_rootIndex;
-    std::vector<uint32_t> m_freePages;
+    std::vector<PageIndex> m_freePages;
+    uint64_t m_version; // changes with every modification, cursors of other versions revalidate
 };
 
 //////////////////////////////////////////////////////////////////////////
@@ -76,7 +107,7 @@ class BTree::Cursor final
     friend class BTree;
 
 public:
-    constexpr Cursor() noexcept = default;
+    Cursor() noexcept = default;
     Cursor(const std::shared_ptr<const Leaf>& leaf, const uint16_t* it) noexcept;
 
     constexpr bool operator==(const Cursor& rhs) const noexcept { return m_position == rhs.m_position; }
@@ -91,6 +122,9 @@ private:
     {
         std::shared_ptr<const Leaf> m_leaf;
         uint16_t m_index;
+        ByteString m_key; // keys are stored prefix-compressed in the leaf
+        uint16_t m_begin; // [m_begin, m_end) of m_leaf lies within m_range
+        uint16_t m_end;
 
         constexpr bool operator==(const Position& rhs) const noexcept
         {
@@ -99,10 +133,29 @@ private:
     };
 
     std::optional<Position> m_position;
+    std::shared_ptr<const KeyRange> m_range; // unbounded if empty
+    uint64_t m_version = 0;                  // of the tree m_position was taken from
 };
 
 //////////////////////////////////////////////////////////////////////////
 
+/// Bulk-loads key/value pairs in ascending key order. The iterators must refer to elements that stay 
+/// alive while loading.
+template <typename TIter>
+inline void BTree::bulkLoad(TIter begin, TIter end, double fillFactor)
+{
+    bulkLoad(
+        [&]() -> std::optional<KeyValue> {
+            if (begin == end)
+                return std::nullopt;
+            const auto& [key, value] = *begin++;
+            return KeyValue(key, value);
+        },
+        fillFactor);
+}
+
+//////////////////////////////////////////////////////////////////////////
+
 struct BTree::Inserted
 {};
 
@@ -34,6 +34,7 @@ public:
     constexpr size_t size() const noexcept;
     constexpr const uint8_t* data() const noexcept;
     constexpr const uint8_t* end() const noexcept; 
+    constexpr ByteStringView substr(size_t pos, size_t count = std::numeric_limits<uint8_t>::max()) const noexcept;
     static constexpr ByteStringView fromStream(const uint8_t* stream) noexcept;
 
 private:
@@ -48,6 +49,7 @@ class ByteString final
 public:
     ByteString() noexcept = default;
     ByteString(ByteStringView bsv) noexcept;
+    ByteString(ByteStringView head, ByteStringView tail) noexcept;
     template <typename TStr, typename = EnableWithString<TStr>>
     ByteString(TStr&& str);
 
@@ -72,6 +74,8 @@ class ByteStringStream final
 {
 public:
     ByteStringStream() noexcept;
+    ByteStringStream(const ByteStringStream& other) noexcept;
+    ByteStringStream& operator=(const ByteStringStream& other) noexcept;
 
     operator ByteStringView() const noexcept;
 
@@ -132,6 +136,12 @@ constexpr const uint8_t* ByteStringView::end() const noexcept
     return m_data + m_length;
 }
 
+constexpr ByteStringView ByteStringView::substr(size_t pos, size_t count) const noexcept
+{
+    assert(pos <= m_length);
+    return ByteStringView(m_data + pos, static_cast<uint8_t>(std::min(count, m_length - pos)));
+}
+
 constexpr ByteStringView ByteStringView::fromStream(const uint8_t* stream) noexcept
 {
     return ByteStringView(stream + 1, *stream);
@@ -164,6 +174,14 @@ inline ByteString::ByteString(ByteStringView bsv) noexcept
     : m_buffer(bsv.data(), bsv.data() + bsv.size())
 {}
 
+inline ByteString::ByteString(ByteStringView head, ByteStringView tail) noexcept
+{
+    assert(head.size() + tail.size() <= maxSize());
+    m_buffer.reserve(head.size() + tail.size());
+    m_buffer.insert(m_buffer.end(), head.data(), head.end());
+    m_buffer.insert(m_buffer.end(), tail.data(), tail.end());
+}
+
 inline ByteString& ByteString::operator=(ByteStringView bsv) noexcept
 {
     ByteString bs(bsv);
@@ -199,6 +217,17 @@ inline ByteStringStream::ByteStringStream() noexcept
     : m_pos(m_buffer)
 {}
 
+/// m_pos points into the own buffer: copies must not share it.
+inline ByteStringStream::ByteStringStream(const ByteStringStream& other) noexcept
+    : m_pos(std::copy(other.m_buffer, const_cast<const uint8_t*>(other.m_pos), m_buffer))
+{}
+
+inline ByteStringStream& ByteStringStream::operator=(const ByteStringStream& other) noexcept
+{
+    m_pos = std::copy(other.m_buffer, const_cast<const uint8_t*>(other.m_pos), m_buffer);
+    return *this;
+}
+
 inline ByteStringStream::operator ByteStringView() const noexcept
 {
     return ByteStringView(m_buffer, static_cast<uint8_t>(m_pos - m_buffer));
@@ -9,6 +9,7 @@
 #include <unordered_map>
 #include <unordered_set>
 #include <memory>
+#include <vector>
 
 namespace TxFs
 {
@@ -29,6 +30,8 @@ public:
     PageCache m_pageCache;
     DivertedPageIds m_divertedPageIds;
     NewPageIds m_newPageIds;
+    NewPageIds m_freedPageIds; // New pages still visible to readers of the last commit
+    std::vector<Interval> m_unreclaimedCopies; // copies of earlier commits snapshot readers may still work on
     Lock m_lock;
 };
 
@@ -19,10 +19,25 @@ CacheManager::CacheManager(std::unique_ptr<FileInterface> fi, uint32_t maxPages)
     : m_pageMemoryAllocator(maxPages) 
     , m_cache { std::move(fi) }
     , m_maxCachedPages(maxPages)
+    , m_mutex(std::make_unique<std::recursive_mutex>())
 {
     m_cache.m_lock = m_cache.file()->defaultAccess();
 }
 
+/// Removes the copies of earlier commits if the snapshot readers have left by now.
+CacheManager::~CacheManager()
+{
+    if (!m_cache.m_fileInterface || m_cache.m_unreclaimedCopies.empty())
+        return;
+
+    try
+    {
+        getCommitHandler().reclaimCopies();
+    }
+    catch (...)
+    {
+    }
+}
 
 /// Delivers a new page. The page is either allocated form the FreeStore or it comes from extending the file. The
 /// PageDef<> is writable as it is expected that a new page was requested because you want to write to it.
@@ -36,6 +51,7 @@ PageDef<uint8_t> CacheManager::newPage()
 PageDef<uint8_t> CacheManager::asNewPage(PageIndex pageIndex)
 {
     // assert(m_cache.m_pageCache.find(pageIndex) == m_cache.m_pageCache.end());
+    std::lock_guard lock(*m_mutex);
     auto page = m_pageMemoryAllocator.allocate();
     m_cache.m_pageCache.emplace(pageIndex, CachedPage(page, PageClass::New));
     m_cache.m_newPageIds.insert(pageIndex);
@@ -43,17 +59,33 @@ PageDef<uint8_t> CacheManager::asNewPage(PageIndex pageIndex)
     return PageDef<uint8_t>(page, pageIndex);
 }
 
+/// Like asNewPage() for a page that was freed by the current transaction. Readers of the last commit may still see
+/// the page, so it is neither evicted nor written before the exclusive commit phase.
+PageDef<uint8_t> CacheManager::asFreedPage(PageIndex pageIndex)
+{
+    std::lock_guard lock(*m_mutex);
+    m_cache.m_freedPageIds.insert(pageIndex);
+    return asNewPage(pageIndex);
+}
+
 /// Loads the specified page. The page was written by a previous transactions. The return value can be transformed into
 /// something writable (makePageWritable()) which in turn makes this page subject to the dirty-page protocol.
+/// Concurrent readers don't block each other while reading from the file.
 ConstPageDef<uint8_t> CacheManager::loadPage(PageIndex origId)
 {
+    std::unique_lock lock(*m_mutex);
     auto id = TxFs::divertPage(m_cache, origId);
     auto it = m_cache.m_pageCache.find(id);
     if (it == m_cache.m_pageCache.end())
     {
         auto page = m_pageMemoryAllocator.allocate();
+        lock.unlock();
         TxFs::readSignedPage(m_cache.file(), id, page.get());
-        m_cache.m_pageCache.emplace(id, CachedPage(page, PageClass::Read));
+        lock.lock();
+
+        auto [cached, inserted] = m_cache.m_pageCache.emplace(id, CachedPage(page, PageClass::Read));
+        if (!inserted) // another reader was faster
+            return ConstPageDef<uint8_t>(cached->second.m_page, origId);
         trimCheck();
         return ConstPageDef<uint8_t>(page, origId);
     }
@@ -68,6 +100,7 @@ ConstPageDef<uint8_t> CacheManager::loadPage(PageIndex origId)
 /// MetaData pages) as they unnecessarily end up following the dirty-page protocol.
 PageDef<uint8_t> CacheManager::repurpose(PageIndex origId)
 {
+    std::lock_guard lock(*m_mutex);
     auto id = TxFs::divertPage(m_cache, origId);
     PageClass pageClass = m_cache.m_newPageIds.count(id) ? PageClass::New : PageClass::Dirty;
     auto it = m_cache.m_pageCache.find(id);
@@ -88,6 +121,7 @@ PageDef<uint8_t> CacheManager::repurpose(PageIndex origId)
 /// dirty-page protocoll). All other pages are treated as PageClass::New.
 void CacheManager::setPageDirty(PageIndex id) noexcept
 {
+    std::lock_guard lock(*m_mutex);
     id = TxFs::divertPage(m_cache, id);
     PageClass pageClass = m_cache.m_newPageIds.count(id) ? PageClass::New : PageClass::Dirty;
 
@@ -100,12 +134,18 @@ void CacheManager::setPageDirty(PageIndex id) noexcept
 void CacheManager::trimCheck()
 {
     if (m_cache.m_pageCache.size() > m_maxCachedPages)
-        trim(m_maxCachedPages / 4 * 3);
+        trimPages(m_maxCachedPages / 4 * 3);
 }
 
 // Trims down memory usage by maxPages. If users have a lot of pinned pages this is triggered too often. Make sure that
 // there is sufficient space to deal with real-world scenarios.
 size_t CacheManager::trim(uint32_t maxPages)
+{
+    std::lock_guard lock(*m_mutex);
+    return trimPages(maxPages);
+}
+
+size_t CacheManager::trimPages(uint32_t maxPages)
 {
     auto prioritizedPages = getUnpinnedPages();
     maxPages = std::min(maxPages, (uint32_t) prioritizedPages.size());
@@ -142,7 +182,8 @@ std::vector<PrioritizedPage> CacheManager::getUnpinnedPages() const
     std::vector<PrioritizedPage> pageSortItems;
     pageSortItems.reserve(m_cache.m_pageCache.size());
     for (const auto& cp: m_cache.m_pageCache)
-        if (cp.second.m_page.use_count() == 1) // we don't use weak_ptr => this is save
+        if (cp.second.m_page.use_count() == 1 // we don't use weak_ptr => this is save
+            && !m_cache.m_freedPageIds.count(cp.first))
             pageSortItems.emplace_back(cp.second, cp.first);
     return pageSortItems;
 }
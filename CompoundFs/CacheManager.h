@@ -14,6 +14,7 @@
 #include <unordered_map>
 #include <unordered_set>
 #include <functional>
+#include <mutex>
 
 namespace TxFs
 {
@@ -28,17 +29,21 @@ class RollbackHandler;
 /// persists enough information to allow rollback from *any* incomplete update
 /// operation. As a result a write operation either completes or does not
 /// affect the previous state of the file therefore the file is never corrupted.
+/// Loading pages is thread-safe so several readers can share the cache. Writing
+/// (and committing) still needs exclusive access.
 class CacheManager final
 {
 public:
     CacheManager(std::unique_ptr<FileInterface> fi, uint32_t maxPages = 256);
     CacheManager(CacheManager&&) = default;
+    ~CacheManager();
 
     template <typename TCallable>
     void setPageIntervalAllocator(TCallable&&);
 
     PageDef<uint8_t> newPage();
     PageDef<uint8_t> asNewPage(PageIndex pageIndex);
+    PageDef<uint8_t> asFreedPage(PageIndex pageIndex);
 
     ConstPageDef<uint8_t> loadPage(PageIndex id);
     PageDef<uint8_t> repurpose(PageIndex index);
@@ -57,6 +62,7 @@ private:
     std::vector<PrioritizedPage> getUnpinnedPages() const;
 
     void trimCheck();
+    size_t trimPages(uint32_t maxPages);
     void evictDirtyPages(std::vector<PrioritizedPage>::iterator begin, std::vector<PrioritizedPage>::iterator end);
     void evictNewPages(std::vector<PrioritizedPage>::iterator begin, std::vector<PrioritizedPage>::iterator end);
     void removeFromCache(std::vector<PrioritizedPage>::iterator begin, std::vector<PrioritizedPage>::iterator end);
@@ -66,6 +72,7 @@ private:
     Cache m_cache;
     std::function<Interval(size_t)> m_pageIntervalAllocator;
     uint32_t m_maxCachedPages;
+    std::unique_ptr<std::recursive_mutex> m_mutex; // eviction of Dirty pages re-enters via the FreeStore
 };
 
 ///////////////////////////////////////////////////////////////////////////////
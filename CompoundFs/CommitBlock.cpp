@@ -8,13 +8,16 @@ using namespace TxFs;
 std::string CommitBlock::toString() const
 {
     ByteStringStream bss;
-    uint8_t version = 0; // make it versionable
+    uint8_t version = 3; // make it versionable
     bss.push(version);
+    bss.push(m_pageIndexSize);
     bss.push(m_freeStoreDescriptor.m_fileSize);
     bss.push(m_freeStoreDescriptor.m_first);
     bss.push(m_freeStoreDescriptor.m_last);
     bss.push(m_compositSize);
     bss.push(m_maxFolderId);
+    bss.push(m_pageSize);
+    bss.push(m_directoryFormat);
     ByteStringView bsv = bss;
     return std::string(bsv.data(), bsv.end());
 }
@@ -25,10 +28,21 @@ CommitBlock CommitBlock::fromString(std::string_view sv)
     CommitBlock cb;
     uint8_t version = 0;
     bsv = ByteStringStream::pop(version, bsv);
+    cb.m_pageIndexSize = sizeof(uint32_t);
+    if (version > 1)
+        bsv = ByteStringStream::pop(cb.m_pageIndexSize, bsv);
+    if (cb.m_pageIndexSize != sizeof(PageIndex))
+        return cb; // the rest cannot be decoded with this build's page indices
     bsv = ByteStringStream::pop(cb.m_freeStoreDescriptor.m_fileSize, bsv);
     bsv = ByteStringStream::pop(cb.m_freeStoreDescriptor.m_first, bsv);
     bsv = ByteStringStream::pop(cb.m_freeStoreDescriptor.m_last, bsv);
     bsv = ByteStringStream::pop(cb.m_compositSize, bsv);
     bsv = ByteStringStream::pop(cb.m_maxFolderId, bsv);
+    cb.m_pageSize = 4096;
+    if (version > 0)
+        bsv = ByteStringStream::pop(cb.m_pageSize, bsv);
+    cb.m_directoryFormat = 0;
+    if (version > 2)
+        bsv = ByteStringStream::pop(cb.m_directoryFormat, bsv);
     return cb;
 }
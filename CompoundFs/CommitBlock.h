@@ -1,5 +1,6 @@
 
 #include "FileDescriptor.h"
+#include "Node.h"
 #include <string>
 
 namespace TxFs
@@ -9,6 +10,9 @@ namespace TxFs
         FileDescriptor m_freeStoreDescriptor;
         uint64_t m_compositSize = 0;
         uint32_t m_maxFolderId = 2;
+        uint32_t m_pageSize = PageSize; // files of version 0 have 4096 byte pages
+        uint8_t m_pageIndexSize = sizeof(PageIndex); // files before version 2 have 32 bit page indices
+        uint8_t m_directoryFormat = DirectoryFormat; // files before version 3 have format 0
         
         std::string toString() const;
         static CommitBlock fromString(std::string_view);
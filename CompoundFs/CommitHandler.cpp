@@ -5,6 +5,13 @@
 
 using namespace TxFs;
 
+namespace
+{
+constexpr size_t StagingBudget = 8 * 1024 * 1024; // bytes
+constexpr size_t MaxStagedPages = StagingBudget / PageSize;
+using Clock = std::chrono::steady_clock;
+}
+
 CommitHandler::CommitHandler(Cache& cache) noexcept
     : m_cache(cache)
 {}
@@ -20,41 +27,94 @@ std::vector<PageIndex> CommitHandler::getDivertedPageIds() const
     return pages;
 }
 
-void CommitHandler::commit()
+/// Runs the commit-phase. Everything readers cannot see (New pages, copies of the original Dirty pages, the logs and
+/// the contents of diverted pages) is prepared up-front so that the [X] lock only covers the in-place update of the
+/// original Dirty pages.
+CommitStats CommitHandler::commit()
 {
+    CommitStats stats;
+    auto start = Clock::now();
     auto dirtyPageIds = getDirtyPageIds();
+    stats.m_dirtyPages = dirtyPageIds.size();
+    stats.m_divertedPages = m_cache.m_divertedPageIds.size();
     if (dirtyPageIds.empty()) 
     {
-        lockedWriteCachedPages();
-        return;
+        lockedWriteCachedPages(stats);
+        stats.m_totalDuration = Clock::now() - start;
+        return stats;
     }
 
     auto fileSize = m_cache.m_fileInterface->fileSizeInPages();
     {
         // order the file writes: make sure the copies are visible before the Logs
+        stats.m_newPages = writeNewPages();
         auto origToCopyPages = copyDirtyPages(dirtyPageIds);
-        m_cache.m_fileInterface->flushFile();
+        stats.m_copiedPages = origToCopyPages.size();
+        stats.m_copyFlushDuration = timedFlush();
 
         // make sure the Logs are visible before we overwrite original contents
-        writeLogs(origToCopyPages);
-        m_cache.m_fileInterface->flushFile();
+        stats.m_logPages = writeLogs(origToCopyPages);
+        stats.m_logFlushDuration = timedFlush();
     }
 
-    auto commitLock = exclusiveLockedCommit(dirtyPageIds);
-    m_cache.m_fileInterface->flushFile();
-    m_cache.m_fileInterface->truncate(fileSize);
-    m_cache.m_lock = commitLock.release();
+    auto stagedPages = stageDivertedPages(dirtyPageIds);
+    stats.m_stagedPages = stagedPages.m_offsets.size();
+    exclusiveLockedCommit(dirtyPageIds, stagedPages, fileSize, stats);
+    stats.m_totalDuration = Clock::now() - start;
+    return stats;
 }
 
-CommitLock CommitHandler::exclusiveLockedCommit(const std::vector<PageIndex>& dirtyPageIds)
+/// Overwrites the original Dirty pages under the [X] lock. The flush and the truncation of the file (removing the
+/// logs) must also happen before readers are let back in.
+void CommitHandler::exclusiveLockedCommit(const std::vector<PageIndex>& dirtyPageIds, const StagedPages& stagedPages,
+                                          size_t fileSize, CommitStats& stats)
 {
-    auto commitLock = m_cache.m_fileInterface->commitAccess(std::move(m_cache.m_lock));
-    updateDirtyPages(dirtyPageIds);
+    auto start = Clock::now();
+    auto commitLock = m_cache.commitAccess();
+    auto locked = Clock::now();
+    stats.m_lockWaitDuration = locked - start;
+
+    updateDirtyPages(dirtyPageIds, stagedPages);
     writeCachedPages();
-    return commitLock;
+    stats.m_commitFlushDuration = timedFlush();
+    m_cache.m_fileInterface->truncate(fileSize + stats.m_copiedPages); // the logs are not needed anymore
+
+    m_cache.m_lock = commitLock.release();
+    stats.m_exclusiveLockDuration = Clock::now() - locked;
+
+    // snapshot readers may still work on the copies: don't wait for them, a later commit removes the copies
+    if (auto reclaimLock = m_cache.file()->tryReclaimAccess())
+        m_cache.m_fileInterface->truncate(fileSize);
+    else
+    {
+        m_cache.m_unreclaimedCopies.emplace_back(PageIndex(fileSize), PageIndex(fileSize + stats.m_copiedPages));
+        stats.m_unreclaimedPages = stats.m_copiedPages;
+    }
 }
 
-void CommitHandler::lockedWriteCachedPages()
+/// Removes the copies of earlier commits if no snapshot reader works on them anymore. Never waits for the readers.
+/// Copies at the end of the file are truncated. The file may have grown beyond the other copies: these are returned
+/// so that the caller can free them.
+std::vector<Interval> CommitHandler::reclaimCopies()
+{
+    if (m_cache.m_unreclaimedCopies.empty())
+        return {};
+
+    auto reclaimLock = m_cache.file()->tryReclaimAccess();
+    if (!reclaimLock)
+        return {};
+
+    std::vector<Interval> copies;
+    std::swap(copies, m_cache.m_unreclaimedCopies);
+    if (copies.back().end() == m_cache.m_fileInterface->fileSizeInPages())
+    {
+        m_cache.m_fileInterface->truncate(copies.back().begin());
+        copies.pop_back();
+    }
+    return copies;
+}
+
+void CommitHandler::lockedWriteCachedPages(CommitStats& stats)
 {
     if (m_cache.m_newPageIds.empty())
     {
@@ -62,10 +122,23 @@ void CommitHandler::lockedWriteCachedPages()
         return;
     }
 
-    auto commitLock = m_cache.m_fileInterface->commitAccess(std::move(m_cache.m_lock));
+    stats.m_newPages = m_cache.m_newPageIds.size();
+    auto start = Clock::now();
+    auto commitLock = m_cache.commitAccess();
+    auto locked = Clock::now();
+    stats.m_lockWaitDuration = locked - start;
+
     writeCachedPages();
     m_cache.m_lock = commitLock.release();
     m_cache.m_newPageIds.clear();
+    stats.m_exclusiveLockDuration = Clock::now() - locked;
+}
+
+std::chrono::nanoseconds CommitHandler::timedFlush()
+{
+    auto start = Clock::now();
+    m_cache.m_fileInterface->flushFile();
+    return Clock::now() - start;
 }
 
 /// Get the original ids of the PageClass::Dirty pages. Some of them may
@@ -106,9 +179,63 @@ std::vector<std::pair<PageIndex, PageIndex>> CommitHandler::copyDirtyPages(const
     return origToCopyPages;
 }
 
-/// Update the original PageClass::DirtyPage pages either from the cache or from the diverted
+/// New pages were never visible to readers so they can be written before the exclusive commit phase. Pages freed by
+/// this transaction are the exception: they wait for the exclusive phase. Written pages (and unchanged Read pages)
+/// leave the cache. Cached contents of diverted pages stay as they are needed to update the
+/// original pages. Returns the number of pages written.
+size_t CommitHandler::writeNewPages()
+{
+    std::unordered_set<PageIndex> divertedPageIds;
+    for (const auto& [originalPageIdx, divertedPageIdx]: m_cache.m_divertedPageIds)
+        divertedPageIds.insert(divertedPageIdx);
+
+    size_t pagesWritten = 0;
+    for (auto it = m_cache.m_pageCache.begin(); it != m_cache.m_pageCache.end();)
+    {
+        assert(it->second.m_pageClass != PageClass::Undefined);
+        if (it->second.m_pageClass == PageClass::Dirty || divertedPageIds.count(it->first) ||
+            m_cache.m_freedPageIds.count(it->first))
+        {
+            ++it;
+            continue;
+        }
+
+        if (it->second.m_pageClass == PageClass::New)
+        {
+            TxFs::writeSignedPage(m_cache.file(), it->first, it->second.m_page.get());
+            pagesWritten++;
+        }
+        it = m_cache.m_pageCache.erase(it);
+    }
+    m_cache.m_newPageIds.clear();
+    return pagesWritten;
+}
+
+/// Reads the contents of diverted pages that are not in the cache into memory so that the exclusive commit phase only
+/// needs to write. At most MaxStagedPages are staged, the remaining pages are copied under the [X] lock.
+CommitHandler::StagedPages CommitHandler::stageDivertedPages(const std::vector<PageIndex>& dirtyPageIds) const
+{
+    StagedPages stagedPages;
+    for (auto origIdx: dirtyPageIds)
+    {
+        if (stagedPages.m_offsets.size() == MaxStagedPages)
+            break;
+
+        auto id = TxFs::divertPage(m_cache, origIdx);
+        if (id == origIdx || m_cache.m_pageCache.count(id))
+            continue;
+
+        auto offset = stagedPages.m_buffer.size();
+        stagedPages.m_buffer.resize(offset + PageSize);
+        TxFs::readSignedPage(m_cache.file(), id, stagedPages.m_buffer.data() + offset);
+        stagedPages.m_offsets.emplace(origIdx, offset);
+    }
+    return stagedPages;
+}
+
+/// Update the original PageClass::DirtyPage pages either from the cache, the staged pages or from the diverted
 /// pages and erase them from the cache.
-void CommitHandler::updateDirtyPages(const std::vector<PageIndex>& dirtyPageIds)
+void CommitHandler::updateDirtyPages(const std::vector<PageIndex>& dirtyPageIds, const StagedPages& stagedPages)
 {
     for (auto origIdx: dirtyPageIds)
     {
@@ -119,7 +246,14 @@ void CommitHandler::updateDirtyPages(const std::vector<PageIndex>& dirtyPageIds)
             // if the page is not in the cache just physically copy the page from
             // its diverted place. (PageClass::Dirty pages are either in the cache or diverted)
             assert(id != origIdx);
-            TxFs::copyPage(m_cache.file(), id, origIdx);
+            auto staged = stagedPages.m_offsets.find(origIdx);
+            if (staged == stagedPages.m_offsets.end())
+                TxFs::copyPage(m_cache.file(), id, origIdx);
+            else
+            {
+                auto page = stagedPages.m_buffer.data() + staged->second;
+                m_cache.file()->writePage(origIdx, 0, page, page + PageSize); // still signed
+            }
         }
         else
         {
@@ -142,11 +276,13 @@ void CommitHandler::writeCachedPages()
     }
     m_cache.m_pageCache.clear();
     m_cache.m_newPageIds.clear();
+    m_cache.m_freedPageIds.clear();
 }
 
-/// Fill the log pages with data and write them to the file.
-void CommitHandler::writeLogs(const std::vector<std::pair<PageIndex, PageIndex>>& origToCopyPages)
+/// Fill the log pages with data and write them to the file. Returns the number of log pages.
+size_t CommitHandler::writeLogs(const std::vector<std::pair<PageIndex, PageIndex>>& origToCopyPages)
 {
+    size_t logPages = 0;
     auto begin = origToCopyPages.begin();
     while (begin != origToCopyPages.end())
     {
@@ -154,7 +290,9 @@ void CommitHandler::writeLogs(const std::vector<std::pair<PageIndex, PageIndex>>
         LogPage logPage(pageIndex);
         begin = logPage.pushBack(begin, origToCopyPages.end());
         TxFs::writeSignedPage(m_cache.file(), pageIndex, &logPage);
+        logPages++;
     }
+    return logPages;
 }
 
 bool CommitHandler::empty() const
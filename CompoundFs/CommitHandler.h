@@ -8,32 +8,70 @@
 #include <vector>
 #include <unordered_map>
 #include <unordered_set>
+#include <chrono>
 
 namespace TxFs
 {
 class CommitLock;
 
+///////////////////////////////////////////////////////////////////////////////
+/// Metrics of one commit-phase: what was written and where the time went.
+struct CommitStats
+{
+    size_t m_dirtyPages = 0;    // original pages overwritten under the [X] lock
+    size_t m_divertedPages = 0; // Dirty pages evicted from the cache before commit
+    size_t m_stagedPages = 0;   // diverted pages read back before taking the [X] lock
+    size_t m_copiedPages = 0;   // copies of the original Dirty pages (for rollback)
+    size_t m_newPages = 0;      // New pages written during the commit
+    size_t m_logPages = 0;
+    size_t m_unreclaimedPages = 0; // copies left in place for snapshot readers
+
+    std::chrono::nanoseconds m_copyFlushDuration {};     // flush after writing the copies
+    std::chrono::nanoseconds m_logFlushDuration {};      // flush after writing the logs
+    std::chrono::nanoseconds m_commitFlushDuration {};   // flush under the [X] lock
+    std::chrono::nanoseconds m_lockWaitDuration {};      // waiting for commitAccess()
+    std::chrono::nanoseconds m_exclusiveLockDuration {}; // time the [X] lock was held
+    std::chrono::nanoseconds m_totalDuration {};
+};
+
+///////////////////////////////////////////////////////////////////////////////
+
 class CommitHandler final
 {
+public:
+    /// Contents of diverted Dirty pages read back before the exclusive commit phase.
+    struct StagedPages
+    {
+        std::unordered_map<PageIndex, size_t> m_offsets; // original page -> offset into m_buffer
+        std::vector<uint8_t> m_buffer;
+    };
+
 public:
     CommitHandler(Cache& cache) noexcept;
 
-    void commit();
+    CommitStats commit();
+    size_t writeNewPages();
     std::vector<std::pair<PageIndex, PageIndex>> copyDirtyPages(const std::vector<PageIndex>& dirtyPageIds);
-    void writeLogs(const std::vector<std::pair<PageIndex, PageIndex>>& origToCopyPages);
-    void updateDirtyPages(const std::vector<PageIndex>& dirtyPageIds);
+    size_t writeLogs(const std::vector<std::pair<PageIndex, PageIndex>>& origToCopyPages);
+    StagedPages stageDivertedPages(const std::vector<PageIndex>& dirtyPageIds) const;
+    void updateDirtyPages(const std::vector<PageIndex>& dirtyPageIds, const StagedPages& stagedPages = {});
     void writeCachedPages();
-    CommitLock exclusiveLockedCommit(const std::vector<PageIndex>& dirtyPageIds);
-    void lockedWriteCachedPages();
+    void exclusiveLockedCommit(const std::vector<PageIndex>& dirtyPageIds, const StagedPages& stagedPages,
+                               size_t fileSize, CommitStats& stats);
+    void lockedWriteCachedPages(CommitStats& stats);
+    std::vector<Interval> reclaimCopies();
 
     std::vector<PageIndex> getDivertedPageIds() const;
     std::vector<PageIndex> getDirtyPageIds() const;
     bool empty() const;
     size_t getCompositeSize() const;
 
+private:
+    std::chrono::nanoseconds timedFlush();
+
 private:
     Cache& m_cache;
- 
+
 };
 
 }
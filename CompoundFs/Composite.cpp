@@ -1,11 +1,23 @@
 
 #include "Composite.h"
 #include "RollbackHandler.h"
+#include "FileIo.h"
+#include <string>
 
 using namespace TxFs;
 
-
-
+namespace
+{
+/// The page size is part of the file format, see PageSize. It is checked before anything else is read
+/// because any other page size makes every page fail its checksum.
+void checkPageSize(const FileInterface* file)
+{
+    auto pageSize = probePageSize(file);
+    if (pageSize && *pageSize != PageSize)
+        throw std::runtime_error("Composite: file was created with a page size of " + std::to_string(*pageSize)
+                                 + " bytes, this build uses " + std::to_string(PageSize));
+}
+}
 
 FileSystem Composite::initializeNew(std::unique_ptr<FileInterface> file)
 {
@@ -19,6 +31,7 @@ FileSystem Composite::initializeNew(std::unique_ptr<FileInterface> file)
 
 FileSystem Composite::initializeExisting(std::unique_ptr<FileInterface> fileInterface)
 {
+    checkPageSize(fileInterface.get());
     auto cacheManager = std::make_shared<CacheManager>(std::move(fileInterface));
     auto rollbackHandler = cacheManager->getRollbackHandler();
     rollbackHandler.revertPartialCommit();
@@ -31,6 +44,7 @@ FileSystem Composite::initializeExisting(std::unique_ptr<FileInterface> fileInte
 
 FileSystem Composite::initializeReadOnly(std::unique_ptr<FileInterface> fileInterface)
 {
+    checkPageSize(fileInterface.get());
     auto cacheManager = std::make_shared<CacheManager>(std::move(fileInterface));
     auto rollbackHandler = cacheManager->getRollbackHandler();
     rollbackHandler.virtualRevertPartialCommit();
@@ -41,3 +55,15 @@ FileSystem Composite::initializeReadOnly(std::unique_ptr<FileInterface> fileInte
     return fileSystem;
 }
 
+FileSystem Composite::initializeSnapshot(std::unique_ptr<FileInterface> fileInterface)
+{
+    checkPageSize(fileInterface.get());
+    auto cacheManager = std::make_shared<CacheManager>(std::move(fileInterface));
+    auto rollbackHandler = cacheManager->getRollbackHandler();
+    rollbackHandler.acquireSnapshot();
+
+    FileSystem::Startup startup { cacheManager, 1, 0 };
+    auto fileSystem = FileSystem(startup);
+    fileSystem.init();
+    return fileSystem;
+}
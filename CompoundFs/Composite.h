@@ -30,10 +30,20 @@ public:
         return initializeReadOnly(std::move(file));
     }
 
+    /// Like openReadOnly() but never waits for a commit in progress: readers arriving during a
+    /// commit see the state before it.
+    template <typename TFile, typename... TArgs>
+    static FileSystem openSnapshot(TArgs&&... args)
+    {
+        std::unique_ptr<FileInterface> file = std::make_unique<SnapshotFile<TFile>>(std::forward<TArgs>(args)...);
+        return initializeSnapshot(std::move(file));
+    }
+
 private:
     static FileSystem initializeNew(std::unique_ptr<FileInterface> file);
     static FileSystem initializeExisting(std::unique_ptr<FileInterface> file);
     static FileSystem initializeReadOnly(std::unique_ptr<FileInterface> file);
+    static FileSystem initializeSnapshot(std::unique_ptr<FileInterface> file);
 };
 
 }
\ No newline at end of file
@@ -0,0 +1,150 @@
+
+#include "Compression.h"
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <stdexcept>
+
+using namespace TxFs;
+
+namespace
+{
+constexpr size_t MinMatch = 4;
+constexpr size_t LastLiterals = 5; // a block ends with at least that many literals
+constexpr size_t MatchLimit = 12;  // no match starts in the last bytes of a block
+constexpr size_t MaxOffset = 65535;
+constexpr size_t HashLog = 12;
+
+uint32_t read32(const uint8_t* p)
+{
+    uint32_t value;
+    std::memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+size_t hash(uint32_t sequence)
+{
+    return (sequence * 2654435761U) >> (32 - HashLog);
+}
+
+uint8_t* writeLength(size_t length, uint8_t* dest)
+{
+    for (; length >= 255; length -= 255)
+        *dest++ = 255;
+    *dest++ = uint8_t(length);
+    return dest;
+}
+
+size_t readLength(const uint8_t*& begin, const uint8_t* end)
+{
+    size_t length = 0;
+    uint8_t byte = 255;
+    while (byte == 255)
+    {
+        if (begin == end)
+            throw std::runtime_error("Compressed data is corrupt");
+        byte = *begin++;
+        length += byte;
+    }
+    return length;
+}
+
+/// A sequence is a token, the literals and - unless it is the last one - the offset and length of a match.
+uint8_t* writeSequence(const uint8_t* literals, const uint8_t* literalsEnd, size_t offset, size_t matchLength,
+                       uint8_t* dest)
+{
+    size_t literalLength = literalsEnd - literals;
+    size_t matchCode = matchLength ? matchLength - MinMatch : 0;
+    *dest++ = uint8_t((std::min<size_t>(literalLength, 15) << 4) | std::min<size_t>(matchCode, 15));
+    if (literalLength >= 15)
+        dest = writeLength(literalLength - 15, dest);
+    dest = std::copy(literals, literalsEnd, dest);
+    if (matchLength == 0)
+        return dest;
+
+    *dest++ = uint8_t(offset);
+    *dest++ = uint8_t(offset >> 8);
+    if (matchCode >= 15)
+        dest = writeLength(matchCode - 15, dest);
+    return dest;
+}
+
+}
+
+size_t TxFs::maxCompressedSize(size_t size)
+{
+    return size + size / 255 + 16;
+}
+
+size_t TxFs::compress(const uint8_t* begin, const uint8_t* end, uint8_t* dest)
+{
+    uint8_t* out = dest;
+    const uint8_t* anchor = begin;
+    if (size_t(end - begin) > MatchLimit)
+    {
+        std::array<uint32_t, size_t(1) << HashLog> positions {};
+        const uint8_t* matchLimit = end - MatchLimit;
+        for (const uint8_t* pos = begin; pos < matchLimit;)
+        {
+            uint32_t sequence = read32(pos);
+            size_t h = hash(sequence);
+            const uint8_t* ref = begin + positions[h];
+            positions[h] = uint32_t(pos - begin);
+            if (ref >= pos || size_t(pos - ref) > MaxOffset || read32(ref) != sequence)
+            {
+                pos++;
+                continue;
+            }
+
+            while (pos > anchor && ref > begin && pos[-1] == ref[-1])
+            {
+                pos--;
+                ref--;
+            }
+
+            const uint8_t* matchEnd = pos + MinMatch;
+            for (const uint8_t* r = ref + MinMatch; matchEnd < end - LastLiterals && *matchEnd == *r; r++)
+                matchEnd++;
+
+            out = writeSequence(anchor, pos, pos - ref, matchEnd - pos, out);
+            pos = anchor = matchEnd;
+        }
+    }
+    out = writeSequence(anchor, end, 0, 0, out);
+    return out - dest;
+}
+
+uint8_t* TxFs::decompress(const uint8_t* begin, const uint8_t* end, uint8_t* dest, uint8_t* destEnd)
+{
+    uint8_t* out = dest;
+    while (begin < end)
+    {
+        uint8_t token = *begin++;
+        size_t literalLength = token >> 4;
+        if (literalLength == 15)
+            literalLength += readLength(begin, end);
+        if (literalLength > size_t(end - begin) || literalLength > size_t(destEnd - out))
+            throw std::runtime_error("Compressed data is corrupt");
+        out = std::copy(begin, begin + literalLength, out);
+        begin += literalLength;
+        if (begin == end)
+            break;
+
+        if (end - begin < 2)
+            throw std::runtime_error("Compressed data is corrupt");
+        size_t offset = begin[0] | (size_t(begin[1]) << 8);
+        begin += 2;
+        size_t matchLength = token & 15;
+        if (matchLength == 15)
+            matchLength += readLength(begin, end);
+        matchLength += MinMatch;
+        if (offset == 0 || offset > size_t(out - dest) || matchLength > size_t(destEnd - out))
+            throw std::runtime_error("Compressed data is corrupt");
+
+        // the match may overlap the bytes it produces
+        const uint8_t* ref = out - offset;
+        for (size_t i = 0; i < matchLength; i++)
+            *out++ = ref[i];
+    }
+    return out;
+}
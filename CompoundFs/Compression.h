@@ -0,0 +1,41 @@
+
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+namespace TxFs
+{
+
+enum class Compression : uint8_t { None, Lz4 };
+
+/// Compressed files consist of chunks of up to ChunkSize bytes. Each chunk is compressed on its own and
+/// preceded by a ChunkHeader; a chunk that does not get smaller is stored as it is. Closing the file adds the
+/// chunk index: a ChunkHeader of size 0 followed by a ChunkIndexEntry per chunk. Sequential reads skip it.
+constexpr size_t ChunkSize = 64 * 1024;
+
+struct ChunkHeader
+{
+    uint32_t m_storedSize;
+    uint32_t m_size;
+
+    constexpr bool isCompressed() const noexcept { return m_storedSize != m_size; }
+    constexpr bool isChunkIndex() const noexcept { return m_size == 0; }
+};
+
+/// Where a chunk starts in the file before compression and in the stored bytes.
+struct ChunkIndexEntry
+{
+    uint64_t m_offset;
+    uint64_t m_storedOffset;
+};
+
+/// LZ77 block compression in the format of LZ4 blocks, compatible with the reference implementation.
+/// compress() needs maxCompressedSize() bytes at dest and returns the compressed size; decompress() returns
+/// the end of the output and throws on corrupt input.
+size_t maxCompressedSize(size_t size);
+size_t compress(const uint8_t* begin, const uint8_t* end, uint8_t* dest);
+uint8_t* decompress(const uint8_t* begin, const uint8_t* end, uint8_t* dest, uint8_t* destEnd);
+
+}
@@ -5,26 +5,304 @@
 #include "TreeValue.h"
 #include "CommitBlock.h"
 #include "CommitHandler.h"
+#include "FileReader.h"
 #include "RollbackHandler.h"
+#include "OverflowPage.h"
+#include "Hasher.h"
 #include <assert.h>
+#include <stdexcept>
+#include <string>
 
 using namespace TxFs;
 
 namespace
 {
+/// String attributes too large for a leaf are stored in a chain of OverflowPages. Instead of the
+/// TreeValue the tree keeps a marker, the first page of the chain and the size of the string.
+constexpr uint8_t OverflowString = 0x80 | uint8_t(TreeValue::Type::String);
+
+struct Overflow
+{
+    PageIndex m_first;
+    uint64_t m_size;
+};
+
+std::optional<Overflow> getOverflow(ByteStringView bsv)
+{
+    uint8_t marker = 0;
+    bsv = ByteStringStream::pop(marker, bsv);
+    if (marker != OverflowString)
+        return std::nullopt;
+
+    Overflow overflow;
+    bsv = ByteStringStream::pop(overflow.m_first, bsv);
+    ByteStringStream::pop(overflow.m_size, bsv);
+    return overflow;
+}
+
+Overflow writeOverflow(const std::shared_ptr<CacheManager>& cacheManager, std::string_view str)
+{
+    TypedCacheManager tcm(cacheManager);
+    auto begin = reinterpret_cast<const uint8_t*>(str.data());
+    auto end = begin + str.size();
+
+    auto page = tcm.newPage<OverflowPage>();
+    Overflow overflow { page.m_index, str.size() };
+    begin = page.m_page->fill(begin, end);
+    while (begin != end)
+    {
+        auto next = tcm.newPage<OverflowPage>();
+        page.m_page->setNext(next.m_index);
+        page = next;
+        begin = page.m_page->fill(begin, end);
+    }
+    return overflow;
+}
+
+std::string readOverflow(const std::shared_ptr<CacheManager>& cacheManager, Overflow overflow)
+{
+    TypedCacheManager tcm(cacheManager);
+    std::string str;
+    str.reserve(static_cast<size_t>(overflow.m_size));
+    for (auto index = overflow.m_first; index != PageIdx::INVALID;)
+    {
+        auto page = tcm.loadPage<OverflowPage>(index);
+        str.append(page.m_page->begin(), page.m_page->end());
+        index = page.m_page->getNext();
+    }
+    assert(str.size() == overflow.m_size);
+    return str;
+}
+
+/// Small files are stored in the tree as a marker followed by their content.
+constexpr uint8_t InlineFile = 0x80 | uint8_t(TreeValue::Type::File);
+
+std::optional<ByteStringView> getInlineFile(ByteStringView bsv)
+{
+    uint8_t marker = 0;
+    bsv = ByteStringStream::pop(marker, bsv);
+    if (marker != InlineFile)
+        return std::nullopt;
+    return bsv;
+}
+
+/// Compressed, deduplicated and hashed files are stored as a marker with these flags, the descriptor of their
+/// pages and the size of the file before compression. Compressed files add the position of their chunk index,
+/// hashed files the hash of their content and, for more than one block, the overflow pages of the block hashes.
+constexpr uint8_t CompressedFlag = 0x40;
+constexpr uint8_t DeduplicatedFlag = 0x20;
+constexpr uint8_t HashedFlag = 0x10;
+
+struct StoredFile
+{
+    FileDescriptor m_descriptor;
+    uint64_t m_size;
+    uint8_t m_flags;
+    uint64_t m_chunkIndex = 0;
+    uint64_t m_contentHash = 0;
+    PageIndex m_blockHashes = PageIdx::INVALID;
+
+    size_t nofBlocks() const { return size_t((m_size + HashBlockSize - 1) / HashBlockSize); }
+};
+
+std::optional<StoredFile> getStoredFile(ByteStringView bsv)
+{
+    uint8_t marker = 0;
+    bsv = ByteStringStream::pop(marker, bsv);
+    uint8_t flags = marker & (CompressedFlag | DeduplicatedFlag | HashedFlag);
+    if (flags == 0 || (marker & ~flags) != uint8_t(TreeValue::Type::File))
+        return std::nullopt;
+
+    StoredFile storedFile;
+    storedFile.m_flags = flags;
+    bsv = ByteStringStream::pop(storedFile.m_descriptor.m_first, bsv);
+    bsv = ByteStringStream::pop(storedFile.m_descriptor.m_last, bsv);
+    bsv = ByteStringStream::pop(storedFile.m_descriptor.m_fileSize, bsv);
+    bsv = ByteStringStream::pop(storedFile.m_size, bsv);
+    if (flags & CompressedFlag)
+        bsv = ByteStringStream::pop(storedFile.m_chunkIndex, bsv);
+    if (flags & HashedFlag)
+    {
+        bsv = ByteStringStream::pop(storedFile.m_contentHash, bsv);
+        if (storedFile.nofBlocks() > 1)
+            ByteStringStream::pop(storedFile.m_blockHashes, bsv);
+    }
+    return storedFile;
+}
+
+/// Inline files show up as files of the content's size without pages, compressed files with the pages and
+/// size of their chunks.
+TreeValue fromStoredValue(ByteStringView bsv)
+{
+    if (auto content = getInlineFile(bsv))
+        return FileDescriptor(PageIdx::INVALID, PageIdx::INVALID, content->size());
+    if (auto storedFile = getStoredFile(bsv))
+        return storedFile->m_descriptor;
+    return TreeValue::fromStream(bsv);
+}
+
+void copyFileContent(ByteStringView bsv, DirectoryStructure::FileContent* content)
+{
+    if (!content)
+        return;
+
+    *content = DirectoryStructure::FileContent();
+    if (auto inlineFile = getInlineFile(bsv))
+        content->m_inlineContent.assign(inlineFile->data(), inlineFile->end());
+    else if (auto storedFile = getStoredFile(bsv))
+    {
+        if (storedFile->m_flags & CompressedFlag)
+        {
+            content->m_uncompressedSize = storedFile->m_size;
+            content->m_chunkIndex = storedFile->m_chunkIndex;
+        }
+        content->m_deduplicated = (storedFile->m_flags & DeduplicatedFlag) != 0;
+    }
+}
+
+// ------------------------------------------------------------------------
+
 struct ValueStream
 {
     ValueStream(const TreeValue& value) { value.toStream(m_byteStringStream); }
+    ValueStream(Overflow overflow)
+    {
+        m_byteStringStream.push(OverflowString);
+        m_byteStringStream.push(overflow.m_first);
+        m_byteStringStream.push(overflow.m_size);
+    }
+    ValueStream(ByteStringView inlineFile)
+    {
+        m_byteStringStream.push(InlineFile);
+        m_byteStringStream.push(inlineFile);
+    }
+    ValueStream(StoredFile storedFile)
+    {
+        m_byteStringStream.push(uint8_t(storedFile.m_flags | uint8_t(TreeValue::Type::File)));
+        m_byteStringStream.push(storedFile.m_descriptor.m_first);
+        m_byteStringStream.push(storedFile.m_descriptor.m_last);
+        m_byteStringStream.push(storedFile.m_descriptor.m_fileSize);
+        m_byteStringStream.push(storedFile.m_size);
+        if (storedFile.m_flags & CompressedFlag)
+            m_byteStringStream.push(storedFile.m_chunkIndex);
+        if (storedFile.m_flags & HashedFlag)
+        {
+            m_byteStringStream.push(storedFile.m_contentHash);
+            if (storedFile.nofBlocks() > 1)
+                m_byteStringStream.push(storedFile.m_blockHashes);
+        }
+    }
 
     operator ByteStringView() const { return m_byteStringStream; }
 
     ByteStringStream m_byteStringStream;
 };
 
+ValueStream makeAttributeStream(const std::shared_ptr<CacheManager>& cacheManager, const TreeValue& attribute)
+{
+    if (attribute.getType() == TreeValue::Type::String)
+    {
+        const auto& str = attribute.get<std::string>();
+        if (str.size() > TreeValue::maxVariableSize())
+            return ValueStream(writeOverflow(cacheManager, str));
+    }
+    return ValueStream(attribute);
+}
+
+// ------------------------------------------------------------------------
+
+bool isAttribute(ByteStringView bsv)
+{
+    auto type = fromStoredValue(bsv).getType();
+    return type != TreeValue::Type::Folder && type != TreeValue::Type::File;
+}
+
+bool isFile(ByteStringView bsv)
+{
+    return fromStoredValue(bsv).getType() == TreeValue::Type::File;
+}
+
+/// The lowest key above all keys starting with prefix; empty if there is none.
+ByteString prefixEnd(ByteStringView prefix)
+{
+    std::vector<uint8_t> end(prefix.data(), prefix.end());
+    while (!end.empty() && end.back() == std::numeric_limits<uint8_t>::max())
+        end.pop_back();
+    if (!end.empty())
+        end.back()++;
+    return ByteStringView(end.data(), static_cast<uint8_t>(end.size()));
+}
+
 // ------------------------------------------------------------------------
 
 constexpr Folder SystemFolder { 1 };
 constexpr std::string_view CommitBlockAttributeName { "CommitBlock" };
+
+/// Pages shared by deduplicated or cloned files form extents. An entry per extent counts the files referring
+/// to it; its key holds the first page in big-endian order, so that the extents within an interval of pages
+/// are a range of keys. Deduplicated pages are single page extents that are also found by the hash of their
+/// content.
+constexpr uint8_t PageHashName = 'H';
+constexpr uint8_t ExtentName = 'E';
+
+DirectoryKey pageHashKey(uint64_t hash)
+{
+    ByteStringStream name;
+    name.push(PageHashName);
+    name.push(hash);
+    return DirectoryKey(SystemFolder, name);
+}
+
+DirectoryKey extentKey(PageIndex first)
+{
+    ByteStringStream name;
+    name.push(ExtentName);
+    for (size_t i = sizeof(PageIndex); i-- > 0;)
+        name.push(uint8_t(first >> (8 * i)));
+    return DirectoryKey(SystemFolder, name);
+}
+
+struct ExtentRefs
+{
+    PageIndex m_end;
+    uint64_t m_count;
+    uint64_t m_hash; // of the content of deduplicated pages
+
+    static ExtentRefs fromStream(ByteStringView bsv)
+    {
+        ExtentRefs refs;
+        bsv = ByteStringStream::pop(refs.m_end, bsv);
+        bsv = ByteStringStream::pop(refs.m_count, bsv);
+        ByteStringStream::pop(refs.m_hash, bsv);
+        return refs;
+    }
+
+    ByteStringStream toStream() const
+    {
+        ByteStringStream bss;
+        bss.push(m_end);
+        bss.push(m_count);
+        bss.push(m_hash);
+        return bss;
+    }
+};
+
+/// The extents within iv, by their first page. Files refer to whole extents only.
+std::vector<std::pair<PageIndex, ExtentRefs>> findExtents(const BTree& btree, Interval iv)
+{
+    std::vector<std::pair<PageIndex, ExtentRefs>> extents;
+    for (auto cursor = btree.begin(extentKey(iv.begin()), extentKey(iv.end())); cursor; cursor = btree.next(cursor))
+    {
+        auto key = cursor.key();
+        PageIndex first = 0;
+        for (auto byte = key.end() - sizeof(PageIndex); byte != key.end(); byte++)
+            first = (first << 8) | *byte;
+        auto refs = ExtentRefs::fromStream(cursor.value());
+        assert(refs.m_end <= iv.end());
+        extents.emplace_back(first, refs);
+    }
+    return extents;
+}
 }
 
 DirectoryStructure::DirectoryStructure(DirectoryStructure&& ds) noexcept
@@ -33,6 +311,7 @@ DirectoryStructure::DirectoryStructure(DirectoryStructure&& ds) noexcept
     , m_maxFolderId(std::move(ds.m_maxFolderId))
     , m_freeStore(std::move(ds.m_freeStore))
     , m_rootIndex(std::move(ds.m_rootIndex))
+    , m_folderCache(std::move(ds.m_folderCache))
 {
     connectFreeStore();
 }
@@ -55,6 +334,7 @@ DirectoryStructure& DirectoryStructure::operator=(DirectoryStructure&& ds) noexc
     m_maxFolderId = std::move(ds.m_maxFolderId);
     m_freeStore = std::move(ds.m_freeStore);
     m_rootIndex = ds.m_rootIndex;
+    m_folderCache = std::move(ds.m_folderCache);
     connectFreeStore();
     return *this;
 }
@@ -77,19 +357,25 @@ std::optional<Folder> DirectoryStructure::makeSubFolder(const DirectoryKey& dkey
 {
     if (dkey == DirectoryKey(""))
         return Folder::Root;
+    if (auto folder = m_folderCache.find(dkey))
+        return folder;
 
     ValueStream value(Folder { m_maxFolderId });
     auto res = m_btree.insert(dkey, value, [](ByteStringView) { return false; });
 
     auto inserted = std::get_if<BTree::Inserted>(&res);
     if (inserted)
+    {
+        m_folderCache.insert(dkey, Folder { m_maxFolderId });
         return Folder { m_maxFolderId++ };
+    }
 
     auto unchanged = std::get<BTree::Unchanged>(res);
-    auto origValue = TreeValue::fromStream(unchanged.m_currentValue.value());
+    auto origValue = fromStoredValue(unchanged.m_currentValue.value());
     if (origValue.getType() != TreeValue::Type::Folder)
         return std::nullopt;
 
+    m_folderCache.insert(dkey, origValue.get<Folder>());
     return origValue.get<Folder>();
 }
 
@@ -97,26 +383,61 @@ std::optional<Folder> DirectoryStructure::subFolder(const DirectoryKey& dkey) co
 {
     if (dkey == DirectoryKey(""))
         return Folder::Root;
+    if (auto folder = m_folderCache.find(dkey))
+        return folder;
 
     auto cursor = m_btree.find(dkey);
     if (!cursor)
         return std::nullopt;
 
-    auto treeValue = TreeValue::fromStream(cursor.value());
+    auto treeValue = fromStoredValue(cursor.value());
     if (treeValue.getType() != TreeValue::Type::Folder)
         return std::nullopt;
 
+    m_folderCache.insert(dkey, treeValue.get<Folder>());
     return treeValue.get<Folder>();
 }
 
 bool DirectoryStructure::addAttribute(const DirectoryKey& dkey, const TreeValue& attribute)
 {
-    ValueStream value(attribute);
-    auto res = m_btree.insert(dkey, value, [](ByteStringView bsv) {
-        auto type = TreeValue::fromStream(bsv).getType();
-        return type != TreeValue::Type::Folder && type != TreeValue::Type::File;
+    auto value = makeAttributeStream(m_cacheManager, attribute);
+    auto res = m_btree.insert(dkey, value, isAttribute);
+    if (std::holds_alternative<BTree::Unchanged>(res))
+    {
+        deleteOverflow(value);
+        return false;
+    }
+
+    if (auto replaced = std::get_if<BTree::Replaced>(&res))
+        deleteOverflow(replaced->m_beforeValue);
+    return true;
+}
+
+/// Batched addAttribute(): returns the number of attributes added.
+size_t DirectoryStructure::addAttributes(const std::vector<std::pair<DirectoryKey, TreeValue>>& attributes)
+{
+    std::vector<ValueStream> values;
+    std::vector<BTree::KeyValue> keyValues;
+    values.reserve(attributes.size());
+    keyValues.reserve(attributes.size());
+    for (const auto& [dkey, attribute]: attributes)
+    {
+        values.push_back(makeAttributeStream(m_cacheManager, attribute));
+        keyValues.emplace_back(dkey, values.back());
+    }
+
+    size_t added = 0;
+    std::vector<ByteString> released;
+    m_btree.insertBatch(keyValues, isAttribute, [&](size_t index, const BTree::InsertResult& res) {
+        added += std::holds_alternative<BTree::Unchanged>(res) ? 0 : 1;
+        if (std::holds_alternative<BTree::Unchanged>(res))
+            released.emplace_back(keyValues[index].second);
+        else if (auto replaced = std::get_if<BTree::Replaced>(&res))
+            released.push_back(replaced->m_beforeValue);
     });
-    return !std::holds_alternative<BTree::Unchanged>(res);
+    for (const auto& value: released)
+        deleteOverflow(value);
+    return added;
 }
 
 std::optional<TreeValue> DirectoryStructure::getAttribute(const DirectoryKey& dkey) const
@@ -125,27 +446,80 @@ std::optional<TreeValue> DirectoryStructure::getAttribute(const DirectoryKey& dk
     if (!cursor)
         return std::nullopt;
 
-    auto attribute = TreeValue::fromStream(cursor.value());
+    auto attribute = readValue(cursor.value());
     if (attribute.getType() == TreeValue::Type::Folder || attribute.getType() == TreeValue::Type::File)
         return std::nullopt;
     return attribute;
 }
 
+/// Resolves overflowing strings: their pages are only read when the value is asked for.
+TreeValue DirectoryStructure::readValue(ByteStringView value) const
+{
+    auto overflow = getOverflow(value);
+    if (overflow)
+        return readOverflow(m_cacheManager, *overflow);
+    return fromStoredValue(value);
+}
+
+/// Frees the overflow pages of a value that was replaced, removed or not inserted at all.
+void DirectoryStructure::deleteOverflow(ByteStringView value)
+{
+    if (auto overflow = getOverflow(value))
+        deleteOverflowPages(overflow->m_first);
+}
+
+/// Frees the overflow pages of the block hashes of a file that was replaced or removed.
+void DirectoryStructure::deleteContentHashes(ByteStringView value)
+{
+    auto storedFile = getStoredFile(value);
+    if (storedFile && storedFile->m_blockHashes != PageIdx::INVALID)
+        deleteOverflowPages(storedFile->m_blockHashes);
+}
+
+void DirectoryStructure::deleteOverflowPages(PageIndex first)
+{
+    TypedCacheManager tcm(m_cacheManager);
+    for (auto index = first; index != PageIdx::INVALID;)
+    {
+        auto page = tcm.loadPage<OverflowPage>(index);
+        m_freeStore.deallocate(index);
+        index = page.m_page->getNext();
+    }
+}
+
 bool DirectoryStructure::rename(const DirectoryKey& oldKey, const DirectoryKey& newKey)
 {
     auto res = m_btree.rename(oldKey, newKey);
-    return std::get_if<BTree::Inserted>(&res);
+    if (!std::holds_alternative<BTree::Inserted>(res))
+        return false;
+
+    m_folderCache.erase(oldKey);
+    return true;
 }
 
 size_t DirectoryStructure::remove(Folder folder)
 {
-    std::vector<ByteString> keysToDelete;
-    for (auto cursor = begin(folder); cursor; cursor = next(cursor))
-        keysToDelete.emplace_back(cursor.m_cursor.key());
+    m_folderCache.clear(); // entries of the folder's descendants are dropped as well
+    std::vector<Folder> subFolders;
+    std::vector<ByteString> files;
+    std::vector<ByteString> overflows;
+    DirectoryKey dkey(folder);
+    size_t numOfRemovedItems = m_btree.removeRange(dkey, prefixEnd(dkey), [&](ByteStringView, ByteStringView value) {
+        auto deletedValue = fromStoredValue(value);
+        if (deletedValue.getType() == TreeValue::Type::Folder)
+            subFolders.push_back(deletedValue.get<Folder>());
+        else if (deletedValue.getType() == TreeValue::Type::File)
+            files.emplace_back(value);
+        else if (getOverflow(value))
+            overflows.emplace_back(value);
+    });
 
-    size_t numOfRemovedItems = 0;
-    for (const auto& k: keysToDelete)
-        numOfRemovedItems += remove(k);
+    for (const auto& file: files)
+        deleteFile(file);
+    for (const auto& overflow: overflows)
+        deleteOverflow(overflow);
+    for (auto subFolder: subFolders)
+        numOfRemovedItems += remove(subFolder);
 
     return numOfRemovedItems;
 }
@@ -156,39 +530,41 @@ size_t DirectoryStructure::remove(ByteStringView key)
     if (!res)
         return 0;
 
-    auto deletedValue = TreeValue::fromStream(*res);
+    auto deletedValue = fromStoredValue(*res);
     switch (deletedValue.getType())
     {
     case TreeValue::Type::Folder:
         return remove(deletedValue.get<Folder>()) + 1;
 
     case TreeValue::Type::File:
-        m_freeStore.deleteFile(deletedValue.get<FileDescriptor>());
+        deleteFile(*res);
         return 1;
 
     default:
+        deleteOverflow(*res);
         return 1;
     }
 }
 
-std::optional<FileDescriptor> DirectoryStructure::openFile(const DirectoryKey& dkey) const
+/// How the file is stored is copied to content if given.
+std::optional<FileDescriptor> DirectoryStructure::openFile(const DirectoryKey& dkey, FileContent* content) const
 {
     auto cursor = m_btree.find(dkey);
     if (!cursor)
         return std::nullopt;
 
-    auto treeValue = TreeValue::fromStream(cursor.value());
+    auto treeValue = fromStoredValue(cursor.value());
     if (treeValue.getType() != TreeValue::Type::File)
         return std::nullopt;
 
+    copyFileContent(cursor.value(), content);
     return treeValue.get<FileDescriptor>();
 }
 
 bool DirectoryStructure::createFile(const DirectoryKey& dkey)
 {
     ValueStream value(FileDescriptor {});
-    auto res = m_btree.insert(
-        dkey, value, [](ByteStringView bsv) { return TreeValue::fromStream(bsv).getType() == TreeValue::Type::File; });
+    auto res = m_btree.insert(dkey, value, isFile);
 
     if (std::holds_alternative<BTree::Unchanged>(res))
         return false;
@@ -197,46 +573,341 @@ bool DirectoryStructure::createFile(const DirectoryKey& dkey)
     if (!replaced)
         return true;
 
-    auto beforeFile = TreeValue::fromStream(replaced->m_beforeValue);
-    m_freeStore.deleteFile(beforeFile.get<FileDescriptor>());
+    deleteFile(replaced->m_beforeValue);
     return true;
 }
 
-std::optional<FileDescriptor> DirectoryStructure::appendFile(const DirectoryKey& dkey)
+/// Batched createFile(): the result tells for each key whether the file was created.
+std::vector<bool> DirectoryStructure::createFiles(const std::vector<DirectoryKey>& dkeys)
+{
+    ValueStream value(FileDescriptor {});
+    std::vector<BTree::KeyValue> keyValues;
+    keyValues.reserve(dkeys.size());
+    for (const auto& dkey: dkeys)
+        keyValues.emplace_back(dkey, value);
+
+    std::vector<bool> created(dkeys.size());
+    std::vector<ByteString> replacedFiles;
+    m_btree.insertBatch(keyValues, isFile, [&](size_t index, const BTree::InsertResult& res) {
+        if (std::holds_alternative<BTree::Unchanged>(res))
+            return;
+
+        created[index] = true;
+        auto replaced = std::get_if<BTree::Replaced>(&res);
+        if (replaced)
+            replacedFiles.push_back(replaced->m_beforeValue);
+    });
+    for (const auto& file: replacedFiles)
+        deleteFile(file);
+    return created;
+}
+
+/// How the file is stored is copied to content if given.
+std::optional<FileDescriptor> DirectoryStructure::appendFile(const DirectoryKey& dkey, FileContent* content)
 {
     ValueStream value(FileDescriptor {});
     auto res = m_btree.insert(dkey, value, [](ByteStringView) { return false; });
 
     if (std::holds_alternative<BTree::Inserted>(res))
+    {
+        copyFileContent(value, content);
         return FileDescriptor {};
+    }
 
     auto cursor = std::get<BTree::Unchanged>(res).m_currentValue;
-    auto currentValue = TreeValue::fromStream(cursor.value());
+    auto currentValue = fromStoredValue(cursor.value());
     if (currentValue.getType() != TreeValue::Type::File)
         return std::nullopt;
 
+    copyFileContent(cursor.value(), content);
     return currentValue.get<FileDescriptor>();
 }
 
 bool DirectoryStructure::updateFile(const DirectoryKey& dkey, FileDescriptor desc)
 {
     ValueStream value = TreeValue { desc };
-    auto res = m_btree.insert(
-        dkey, value, [](ByteStringView bsv) { return TreeValue::fromStream(bsv).getType() == TreeValue::Type::File; });
+    auto res = m_btree.insert(dkey, value, isFile);
 
     if (std::holds_alternative<BTree::Unchanged>(res))
         return false;
 
     auto replaced = std::get_if<BTree::Replaced>(&res);
     if (replaced)
+    {
+        deleteContentHashes(replaced->m_beforeValue);
         return true;
+    }
 
     // res is a <Inserted> - so it did not exist before
     remove(dkey);
     return false;
 }
 
-void DirectoryStructure::commit()
+/// Stores the descriptor of a file written compressed, deduplicated or with content hashes as told by content;
+/// like updateFile() the file must exist.
+bool DirectoryStructure::updateFile(const DirectoryKey& dkey, FileDescriptor desc, const FileContent& content)
+{
+    assert(content.m_inlineContent.empty());
+    uint8_t flags = (content.m_uncompressedSize ? CompressedFlag : 0) | (content.m_deduplicated ? DeduplicatedFlag : 0)
+                    | (content.m_hashes ? HashedFlag : 0);
+    if (flags == 0)
+        return updateFile(dkey, desc);
+
+    StoredFile storedFile { desc, content.m_uncompressedSize.value_or(desc.m_fileSize), flags, content.m_chunkIndex };
+    if (content.m_hashes)
+    {
+        const auto& blocks = content.m_hashes->m_blocks;
+        assert(content.m_hashes->m_size == storedFile.m_size && blocks.size() == storedFile.nofBlocks());
+        storedFile.m_contentHash = content.m_hashes->m_hash;
+        if (blocks.size() > 1)
+            storedFile.m_blockHashes =
+                writeOverflow(m_cacheManager, std::string_view(reinterpret_cast<const char*>(blocks.data()),
+                                                               blocks.size() * sizeof(uint64_t)))
+                    .m_first;
+    }
+
+    ValueStream value(storedFile);
+    auto res = m_btree.insert(dkey, value, isFile);
+
+    if (std::holds_alternative<BTree::Unchanged>(res))
+    {
+        deleteContentHashes(value);
+        return false;
+    }
+
+    if (auto replaced = std::get_if<BTree::Replaced>(&res))
+    {
+        deleteContentHashes(replaced->m_beforeValue);
+        return true;
+    }
+
+    remove(dkey);
+    return false;
+}
+
+/// The hashes stored with a file by updateFile(). Writing the file again drops them.
+std::optional<ContentHashes> DirectoryStructure::contentHashes(const DirectoryKey& dkey) const
+{
+    auto cursor = m_btree.find(dkey);
+    if (!cursor)
+        return std::nullopt;
+
+    auto storedFile = getStoredFile(cursor.value());
+    if (!storedFile || !(storedFile->m_flags & HashedFlag))
+        return std::nullopt;
+
+    ContentHashes hashes { storedFile->m_size, storedFile->m_contentHash, {} };
+    if (storedFile->m_blockHashes == PageIdx::INVALID)
+    {
+        if (storedFile->m_size > 0)
+            hashes.m_blocks.push_back(storedFile->m_contentHash);
+        return hashes;
+    }
+
+    hashes.m_blocks.resize(storedFile->nofBlocks());
+    auto blocks = readOverflow(m_cacheManager, { storedFile->m_blockHashes, hashes.m_blocks.size() * sizeof(uint64_t) });
+    std::copy(blocks.begin(), blocks.end(), reinterpret_cast<char*>(hashes.m_blocks.data()));
+    return hashes;
+}
+
+/// Stores the content of a small file in the tree; like updateFile() the file must exist.
+bool DirectoryStructure::updateFile(const DirectoryKey& dkey, ByteStringView content)
+{
+    assert(content.size() <= maxInlineFileSize());
+    ValueStream value(content);
+    auto res = m_btree.insert(dkey, value, isFile);
+
+    if (std::holds_alternative<BTree::Unchanged>(res))
+        return false;
+
+    auto replaced = std::get_if<BTree::Replaced>(&res);
+    if (replaced)
+    {
+        deleteFile(replaced->m_beforeValue);
+        return true;
+    }
+
+    remove(dkey);
+    return false;
+}
+
+/// Makes dstKey a file with the content of srcKey without copying its pages: both files refer to them until
+/// they are deleted. Only a partially filled last page is copied, so that appending to one of the files does
+/// not change the other. Both files are deduplicated files from then on.
+bool DirectoryStructure::cloneFile(const DirectoryKey& srcKey, const DirectoryKey& dstKey)
+{
+    if (ByteStringView(srcKey) == ByteStringView(dstKey))
+        return false;
+
+    auto cursor = m_btree.find(srcKey);
+    if (!cursor || fromStoredValue(cursor.value()).getType() != TreeValue::Type::File)
+        return false;
+
+    FileContent content;
+    ByteString srcValue = cursor.value();
+    auto desc = fromStoredValue(srcValue).get<FileDescriptor>();
+    copyFileContent(srcValue, &content);
+    if (!createFile(dstKey))
+        return false;
+
+    if (desc.isInline())
+        return updateFile(dstKey, ByteStringView(content.m_inlineContent.data(),
+                                                 static_cast<uint8_t>(content.m_inlineContent.size())));
+
+    std::vector<Interval> intervals;
+    TypedCacheManager tcm(m_cacheManager);
+    for (auto index = desc.m_first; index != PageIdx::INVALID;)
+    {
+        auto fileTable = tcm.loadPage<FileTable>(index);
+        IntervalSequence is;
+        fileTable.m_page->insertInto(is);
+        intervals.insert(intervals.end(), is.begin(), is.end());
+        index = fileTable.m_page->getNext();
+    }
+
+    std::vector<uint8_t> lastPage(size_t(desc.m_fileSize % PageSize));
+    if (!lastPage.empty())
+    {
+        FileReader fileReader(m_cacheManager);
+        fileReader.open(desc);
+        fileReader.seek(desc.m_fileSize - lastPage.size());
+        fileReader.read(lastPage.data(), lastPage.data() + lastPage.size());
+
+        auto& last = intervals.back();
+        last = Interval(last.begin(), last.end() - 1);
+        if (last.empty())
+            intervals.pop_back();
+    }
+
+    FileWriter fileWriter(m_cacheManager);
+    for (auto iv: intervals)
+    {
+        sharePages(iv);
+        fileWriter.appendPages(iv, uint64_t(iv.length()) * PageSize);
+    }
+    if (!lastPage.empty())
+        fileWriter.write(lastPage.data(), lastPage.data() + lastPage.size());
+
+    content.m_deduplicated = true;
+    content.m_hashes = contentHashes(srcKey);
+    updateFile(srcKey, desc, content);
+    return updateFile(dstKey, fileWriter.close(), content);
+}
+
+/// FileWriters share pages through the tree: see findDuplicatePage() and addDuplicatePage().
+PageDeduplicator DirectoryStructure::makePageDeduplicator()
+{
+    return PageDeduplicator { [this](const uint8_t* page) { return findDuplicatePage(page); },
+                              [this](const uint8_t* page, PageIndex index) { addDuplicatePage(page, index); } };
+}
+
+/// Returns a page with the same content as page and counts the new reference to it.
+std::optional<PageIndex> DirectoryStructure::findDuplicatePage(const uint8_t* page)
+{
+    auto cursor = m_btree.find(pageHashKey(hash64(page, PageSize)));
+    if (!cursor)
+        return std::nullopt;
+
+    PageIndex index;
+    ByteStringStream::pop(index, cursor.value());
+    FileReader fileReader(m_cacheManager);
+    fileReader.openPages(Interval(index));
+    auto content = fileReader.readView(PageSize);
+    if (!std::equal(content.begin(), content.end(), page))
+        return std::nullopt; // same hash, different content
+
+    auto key = extentKey(index);
+    auto refs = ExtentRefs::fromStream(m_btree.find(key).value());
+    refs.m_count++;
+    m_btree.insert(key, refs.toStream());
+    return index;
+}
+
+/// Makes the newly written page available to findDuplicatePage(), unless another page has the same hash.
+void DirectoryStructure::addDuplicatePage(const uint8_t* page, PageIndex index)
+{
+    auto hash = hash64(page, PageSize);
+    ByteStringStream value;
+    value.push(index);
+    auto res = m_btree.insert(pageHashKey(hash), value, [](ByteStringView) { return false; });
+    if (std::holds_alternative<BTree::Unchanged>(res))
+        return;
+
+    m_btree.insert(extentKey(index), ExtentRefs { index + 1, 1, hash }.toStream());
+}
+
+/// Frees the pages of a removed or replaced file. Pages of deduplicated and cloned files are only freed when
+/// the last file referring to them is gone.
+void DirectoryStructure::deleteFile(ByteStringView value)
+{
+    deleteContentHashes(value);
+    auto storedFile = getStoredFile(value);
+    if (!storedFile || !(storedFile->m_flags & DeduplicatedFlag))
+    {
+        m_freeStore.deleteFile(fromStoredValue(value).get<FileDescriptor>());
+        return;
+    }
+
+    TypedCacheManager tcm(m_cacheManager);
+    for (auto index = storedFile->m_descriptor.m_first; index != PageIdx::INVALID;)
+    {
+        auto fileTable = tcm.loadPage<FileTable>(index);
+        IntervalSequence intervals;
+        fileTable.m_page->insertInto(intervals);
+        for (auto iv: intervals)
+            releasePages(iv);
+        m_freeStore.deallocate(index);
+        index = fileTable.m_page->getNext();
+    }
+}
+
+/// Drops one reference to the pages of iv. Pages not shared and extents without references are freed.
+void DirectoryStructure::releasePages(Interval iv)
+{
+    auto pos = iv.begin();
+    for (auto [first, refs]: findExtents(m_btree, iv))
+    {
+        if (pos < first)
+            m_freeStore.deletePages(Interval(pos, first));
+        pos = refs.m_end;
+
+        if (--refs.m_count > 0)
+        {
+            m_btree.insert(extentKey(first), refs.toStream());
+            continue;
+        }
+
+        m_btree.remove(extentKey(first));
+        auto hashCursor = m_btree.find(pageHashKey(refs.m_hash));
+        PageIndex hashedPage = PageIdx::INVALID;
+        if (hashCursor)
+            ByteStringStream::pop(hashedPage, hashCursor.value());
+        if (hashedPage == first)
+            m_btree.remove(pageHashKey(refs.m_hash));
+        m_freeStore.deletePages(Interval(first, refs.m_end));
+    }
+    if (pos < iv.end())
+        m_freeStore.deletePages(Interval(pos, iv.end()));
+}
+
+/// Adds one reference to the pages of iv: extents within iv count it, the pages between them become new
+/// extents referred to by two files.
+void DirectoryStructure::sharePages(Interval iv)
+{
+    auto pos = iv.begin();
+    for (auto [first, refs]: findExtents(m_btree, iv))
+    {
+        if (pos < first)
+            m_btree.insert(extentKey(pos), ExtentRefs { first, 2, 0 }.toStream());
+        pos = refs.m_end;
+        refs.m_count++;
+        m_btree.insert(extentKey(first), refs.toStream());
+    }
+    if (pos < iv.end())
+        m_btree.insert(extentKey(pos), ExtentRefs { iv.end(), 2, 0 }.toStream());
+}
+
+CommitStats DirectoryStructure::commit()
 {
     const auto& freePages = m_btree.getFreePages();
     for (auto page: freePages)
@@ -244,6 +915,8 @@ void DirectoryStructure::commit()
     m_btree = BTree(m_cacheManager, m_rootIndex);
 
     auto commitHandler = m_cacheManager->getCommitHandler();
+    for (auto copies: commitHandler.reclaimCopies())
+        m_freeStore.deletePages(copies);
 
     auto divertedPageIds = commitHandler.getDivertedPageIds();
     for (auto page: divertedPageIds)
@@ -255,13 +928,14 @@ void DirectoryStructure::commit()
     cb.m_compositSize = commitHandler.getCompositeSize();
     cb.m_maxFolderId = m_maxFolderId;
     storeCommitBlock(cb);
-    commitHandler.commit();
+    auto stats = commitHandler.commit();
     assert(commitHandler.empty());
 
     m_freeStore = FreeStore(m_cacheManager, cb.m_freeStoreDescriptor);
     connectFreeStore();
-    assert(cb.m_compositSize == commitHandler.getCompositeSize());
+    assert(cb.m_compositSize <= commitHandler.getCompositeSize()); // maybe followed by unreclaimed copies
     assert(m_btree.getFreePages().empty());
+    return stats;
 }
 
 void DirectoryStructure::rollback()
@@ -281,6 +955,15 @@ void DirectoryStructure::init()
 
 void DirectoryStructure::init(const CommitBlock& commitBlock)
 {
+    if (commitBlock.m_pageSize != PageSize)
+        throw std::runtime_error("DirectoryStructure: file was created with a different page size");
+    if (commitBlock.m_pageIndexSize != sizeof(PageIndex))
+        throw std::runtime_error("DirectoryStructure: file was created with a different page index size");
+    if (commitBlock.m_directoryFormat != DirectoryFormat)
+        throw std::runtime_error("DirectoryStructure: file has directory format "
+                                 + std::to_string(commitBlock.m_directoryFormat) + ", this build reads format "
+                                 + std::to_string(DirectoryFormat));
+    m_folderCache.clear();
     m_maxFolderId = commitBlock.m_maxFolderId;
     m_btree = BTree(m_cacheManager, m_rootIndex);
     m_freeStore = FreeStore(m_cacheManager, commitBlock.m_freeStoreDescriptor);
@@ -295,6 +978,12 @@ void DirectoryStructure::storeCommitBlock(const CommitBlock& cb)
 
 CommitBlock DirectoryStructure::retrieveCommitBlock() const
 {
+    // format 0 trees cannot be searched for the commit block, but their root node gives them away
+    auto rootType = TypedCacheManager(m_cacheManager).loadPage<Node>(m_rootIndex).m_page->m_type;
+    if (rootType == NodeType::LeafFormat0 || rootType == NodeType::InnerFormat0)
+        throw std::runtime_error("DirectoryStructure: file has directory format 0, this build reads format "
+                                 + std::to_string(DirectoryFormat));
+
     auto str = getAttribute(DirectoryKey(SystemFolder, CommitBlockAttributeName))->get<std::string>();
     return CommitBlock::fromString(str);
 }
@@ -310,20 +999,39 @@ std::pair<Folder, std::string_view> DirectoryStructure::Cursor::key() const
     return std::pair(folder, nameView);
 }
 
+TreeValue DirectoryStructure::Cursor::value() const
+{
+    return m_directoryStructure->readValue(m_cursor.value());
+}
+
+DirectoryStructure::Cursor DirectoryStructure::find(const DirectoryKey& dkey) const
+{
+    auto cursor = m_btree.begin(dkey, prefixEnd(DirectoryKey(dkey.getFolder())));
+    if (!cursor || cursor.key() != dkey)
+        return Cursor();
+    return Cursor(cursor, this);
+}
+
+/// The cursor is bounded by the end of the folder.
 DirectoryStructure::Cursor DirectoryStructure::next(Cursor cursor) const
 {
-    auto folder = cursor.key().first;
-    cursor = m_btree.next(cursor.m_cursor);
-    if (cursor && cursor.key().first != folder)
-        cursor = Cursor();
-    return cursor;
+    return Cursor(m_btree.next(cursor.m_cursor), this);
 }
 
 DirectoryStructure::Cursor DirectoryStructure::begin(const DirectoryKey& dkey) const
 {
-    auto folder = dkey.getFolder();
-    DirectoryStructure::Cursor cursor = m_btree.begin(dkey);
-    if (cursor && cursor.key().first != folder)
-        cursor = Cursor();
-    return cursor;
+    return Cursor(m_btree.begin(dkey, prefixEnd(DirectoryKey(dkey.getFolder()))), this);
+}
+
+/// The entry index positions after the first one not less than dkey, found without walking the
+/// entries in between.
+DirectoryStructure::Cursor DirectoryStructure::begin(const DirectoryKey& dkey, size_t index) const
+{
+    return Cursor(m_btree.begin(dkey, prefixEnd(DirectoryKey(dkey.getFolder())), index), this);
+}
+
+/// Number of entries of dkey's folder that are not less than dkey.
+size_t DirectoryStructure::count(const DirectoryKey& dkey) const
+{
+    return m_btree.count(dkey, prefixEnd(DirectoryKey(dkey.getFolder())));
 }
@@ -2,9 +2,13 @@
 #pragma once
 
 #include "CacheManager.h"
+#include "CommitHandler.h"
 #include "FreeStore.h"
 #include "BTree.h"
 #include "TreeValue.h"
+#include "FolderCache.h"
+#include "FileWriter.h"
+#include "Hasher.h"
 #include <memory>
 #include <cstdint>
 
@@ -60,6 +64,16 @@ public:
         PageIndex m_rootIndex;
     };
 
+    /// What openFile() and appendFile() tell about files that are not simply stored in pages.
+    struct FileContent
+    {
+        std::vector<uint8_t> m_inlineContent;
+        std::optional<uint64_t> m_uncompressedSize; // only set for compressed files
+        uint64_t m_chunkIndex = 0;                  // position of the chunk index of compressed files
+        bool m_deduplicated = false;
+        std::optional<ContentHashes> m_hashes;      // only passed to updateFile(), see contentHashes()
+    };
+
 public:
     DirectoryStructure(const Startup& startup);
     DirectoryStructure(DirectoryStructure&&) noexcept;
@@ -72,22 +86,32 @@ public:
     std::optional<Folder> subFolder(const DirectoryKey& dkey) const;
 
     bool addAttribute(const DirectoryKey& dkey, const TreeValue& attribute);
+    size_t addAttributes(const std::vector<std::pair<DirectoryKey, TreeValue>>& attributes);
     std::optional<TreeValue> getAttribute(const DirectoryKey& dkey) const;
 
     bool rename(const DirectoryKey& oldKey, const DirectoryKey& newKey);
     size_t remove(ByteStringView key);
     size_t remove(Folder folder);
 
-    std::optional<FileDescriptor> openFile(const DirectoryKey& dkey) const;
+    std::optional<FileDescriptor> openFile(const DirectoryKey& dkey, FileContent* content = nullptr) const;
     bool createFile(const DirectoryKey& dkey);
-    std::optional<FileDescriptor> appendFile(const DirectoryKey& dkey);
+    std::vector<bool> createFiles(const std::vector<DirectoryKey>& dkeys);
+    std::optional<FileDescriptor> appendFile(const DirectoryKey& dkey, FileContent* content = nullptr);
     bool updateFile(const DirectoryKey& dkey, FileDescriptor desc);
+    bool updateFile(const DirectoryKey& dkey, FileDescriptor desc, const FileContent& content);
+    bool updateFile(const DirectoryKey& dkey, ByteStringView content);
+    std::optional<ContentHashes> contentHashes(const DirectoryKey& dkey) const;
+    static constexpr size_t maxInlineFileSize() noexcept { return ByteString::maxSize() - sizeof(uint8_t); }
+    PageDeduplicator makePageDeduplicator();
+    bool cloneFile(const DirectoryKey& srcKey, const DirectoryKey& dstKey);
 
     Cursor find(const DirectoryKey& dkey) const;
     Cursor begin(const DirectoryKey& dkey) const;
+    Cursor begin(const DirectoryKey& dkey, size_t index) const;
     Cursor next(Cursor cursor) const;
+    size_t count(const DirectoryKey& dkey) const;
 
-    void commit();
+    CommitStats commit();
     void rollback();
 
     void storeCommitBlock(const CommitBlock&);
@@ -96,6 +120,15 @@ public:
 private:
     void connectFreeStore();
     void init(const CommitBlock& cb);
+    TreeValue readValue(ByteStringView value) const;
+    void deleteOverflow(ByteStringView value);
+    void deleteOverflowPages(PageIndex first);
+    void deleteContentHashes(ByteStringView value);
+    void deleteFile(ByteStringView value);
+    void releasePages(Interval iv);
+    void sharePages(Interval iv);
+    std::optional<PageIndex> findDuplicatePage(const uint8_t* page);
+    void addDuplicatePage(const uint8_t* page, PageIndex index);
 
 
 private:
@@ -104,6 +137,7 @@ private:
     uint32_t m_maxFolderId;
     FreeStore m_freeStore;
     PageIndex m_rootIndex;
+    mutable FolderCache m_folderCache;
 };
 
 //////////////////////////////////////////////////////////////////////////
@@ -114,30 +148,21 @@ class DirectoryStructure::Cursor final
 
 public:
     constexpr Cursor() noexcept = default;
-    Cursor(const BTree::Cursor& cursor) noexcept
+    Cursor(const BTree::Cursor& cursor, const DirectoryStructure* directoryStructure) noexcept
         : m_cursor(cursor)
+        , m_directoryStructure(directoryStructure)
     {}
 
     constexpr bool operator==(const Cursor& rhs) const noexcept { return m_cursor == rhs.m_cursor; }
     constexpr bool operator!=(const Cursor& rhs) const noexcept { return !(m_cursor == rhs.m_cursor); }
 
     std::pair<Folder,std::string_view> key() const;
-    TreeValue value() const { return TreeValue::fromStream(m_cursor.value());}
+    TreeValue value() const;
     constexpr explicit operator bool() const noexcept { return m_cursor.operator bool(); }
 
 private:
     BTree::Cursor m_cursor;
+    const DirectoryStructure* m_directoryStructure = nullptr;
 };
 
-//////////////////////////////////////////////////////////////////////////
-
-inline DirectoryStructure::Cursor DirectoryStructure::find(const DirectoryKey& dkey) const
-{
-    return m_btree.find(dkey);
-}
-
-
-
-
-
 }
@@ -36,6 +36,9 @@ struct FileDescriptor final
     }
 
     constexpr bool operator!=(const FileDescriptor& rhs) const noexcept { return !(*this == rhs); }
+
+    /// Small files are stored in the directory tree: they have a size but no pages.
+    constexpr bool isInline() const noexcept { return m_first == PageIdx::INVALID && m_fileSize > 0; }
 };
 
 }
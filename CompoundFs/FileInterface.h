@@ -3,6 +3,8 @@
 
 #include "Interval.h"
 #include <stddef.h>
+#include <optional>
+#include <memory>
 
 
 
@@ -42,10 +44,18 @@ public:
     virtual void flushFile() = 0;
     virtual void truncate(size_t numberOfPages) = 0;
 
+    /// The memory of a page for files that keep their pages in memory, nullptr for all others. The content
+    /// stays as it is while the pointer is held: later writes to the page must not change that memory.
+    virtual std::shared_ptr<const uint8_t> pageMemory(PageIndex) const { return nullptr; }
+
     virtual Lock defaultAccess() = 0;
     virtual Lock readAccess() = 0;
+    virtual std::optional<Lock> tryReadAccess() = 0;
     virtual Lock writeAccess() = 0;
     virtual CommitLock commitAccess(Lock&& writeLock) = 0;
+    virtual Lock snapshotAccess() = 0;
+    virtual Lock reclaimAccess() = 0;
+    virtual std::optional<Lock> tryReclaimAccess() = 0;
 };
 
 
@@ -6,13 +6,15 @@
 #include <vector>
 #include <array>
 #include <string.h>
+#include <algorithm>
+#include <optional>
 #include <stdexcept>
 
 namespace TxFs
 {
 struct SignedPage
 {
-    char m_data[4092];
+    char m_data[PageSize - sizeof(uint32_t)];
     mutable uint32_t m_checkSum;
 
     void addCheckSum() const { m_checkSum = hash32(m_data, sizeof(m_data)); }
@@ -24,12 +26,12 @@ struct SignedPage
     }
 };
 
-static_assert(sizeof(SignedPage) == 4096);
+static_assert(sizeof(SignedPage) == PageSize);
 
 inline bool testReadSignedPage(const FileInterface* fi, PageIndex idx, void* page)
 {
     uint8_t* buffer = static_cast<uint8_t*>(page);
-    fi->readPage(idx, 0, buffer, buffer + 4096);
+    fi->readPage(idx, 0, buffer, buffer + PageSize);
     SignedPage* sp = static_cast<SignedPage*>(page);
     return sp->validateCheckSum();
 }
@@ -40,36 +42,57 @@ inline void readSignedPage(const FileInterface* fi, PageIndex idx, void* page)
         throw std::runtime_error("Error validating checkSum");
 }
 
+/// Size of the signed page at the start of the file, found by trying the checksum of every supported
+/// page size. Files created with another TXFS_PAGE_SIZE fail readSignedPage(), this tells them apart
+/// from damaged files.
+inline std::optional<size_t> probePageSize(const FileInterface* fi)
+{
+    std::vector<uint8_t> buffer(MaxPageSize);
+    auto pages = std::min(fi->fileSizeInPages(), MaxPageSize / PageSize);
+    if (pages == 0)
+        return std::nullopt;
+    fi->readPages(Interval(0, static_cast<PageIndex>(pages)), buffer.data());
+
+    for (size_t pageSize = MinPageSize; pageSize <= pages * PageSize; pageSize *= 2)
+    {
+        uint32_t checkSum;
+        memcpy(&checkSum, buffer.data() + pageSize - sizeof(checkSum), sizeof(checkSum));
+        if (hash32(buffer.data(), pageSize - sizeof(checkSum)) == checkSum)
+            return pageSize;
+    }
+    return std::nullopt;
+}
+
 inline void writeSignedPage(FileInterface* fi, PageIndex idx, const void* page)
 {
     const SignedPage* sp = static_cast<const SignedPage*>(page);
     sp->addCheckSum();
     const uint8_t* buffer = static_cast<const uint8_t*>(page);
-    fi->writePage(idx, 0, buffer, buffer + 4096);
+    fi->writePage(idx, 0, buffer, buffer + PageSize);
 }
 
 inline void copyPage(FileInterface* fi, PageIndex from, PageIndex to)
 {
-    uint8_t buffer[4096];
+    uint8_t buffer[PageSize];
     readSignedPage(fi, from, buffer);
-    fi->writePage(to, 0, buffer, buffer + 4096); // no need to add checksum
+    fi->writePage(to, 0, buffer, buffer + PageSize); // no need to add checksum
 }
 
 inline bool isEqualPage(const FileInterface* fi, PageIndex p1, PageIndex p2)
 {
-    std::vector<std::array<uint8_t, 4096>> buffer(2);
+    std::vector<std::array<uint8_t, PageSize>> buffer(2);
     readSignedPage(fi, p1, buffer[0].data());
-    fi->readPage(p2, 0, buffer[1].data(), buffer[1].data() + 4096);
-    return memcmp(buffer[0].data(), buffer[1].data(), 4096) == 0;
+    fi->readPage(p2, 0, buffer[1].data(), buffer[1].data() + PageSize);
+    return memcmp(buffer[0].data(), buffer[1].data(), PageSize) == 0;
 }
 
 template <typename TCont>
 inline void clearPages(FileInterface* fi, const TCont& cont)
 {
-    uint8_t buf[4096];
+    uint8_t buf[PageSize];
     memset(buf, 0, sizeof(buf));
     for (auto idx: cont)
-        fi->writePage(idx, 0, buf, buf + 4096);
+        fi->writePage(idx, 0, buf, buf + PageSize);
 }
 
 }
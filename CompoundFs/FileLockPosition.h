@@ -15,6 +15,8 @@ namespace TxFs
           static constexpr int64_t SharedEnd = SharedBegin + 1LL;
           static constexpr int64_t WriteBegin = SharedEnd;
           static constexpr int64_t WriteEnd = WriteBegin + 1LL;
+          static constexpr int64_t SnapshotBegin = GateBegin - 1LL;
+          static constexpr int64_t SnapshotEnd = GateBegin;
     };
 }
 
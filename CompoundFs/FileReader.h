@@ -6,11 +6,48 @@
 #include "TypedCacheManager.h"
 #include "PageDef.h"
 #include "FileInterface.h"
+#include "Compression.h"
 #include <algorithm>
+#include <stdexcept>
+#include <vector>
+#include <memory>
 
 namespace TxFs
 {
 
+//////////////////////////////////////////////////////////////////////////
+/// Bytes of a file returned by FileReader::readView(). The view pins its memory and content, so it stays
+/// valid after further reads, after the file is closed and after its pages are reused.
+
+class ReadView final
+{
+public:
+    ReadView() = default;
+    ReadView(std::shared_ptr<const uint8_t> data, size_t size)
+        : m_data(std::move(data))
+        , m_size(size)
+    {}
+
+    const uint8_t* data() const { return m_data.get(); }
+    const uint8_t* begin() const { return m_data.get(); }
+    const uint8_t* end() const { return m_data.get() + m_size; }
+    size_t size() const { return m_size; }
+    bool empty() const { return m_size == 0; }
+
+private:
+    std::shared_ptr<const uint8_t> m_data;
+    size_t m_size = 0;
+};
+
+//////////////////////////////////////////////////////////////////////////
+/// One of several buffers filled in one go by FileReader::read().
+
+struct MutableBuffer
+{
+    void* m_data;
+    size_t m_size;
+};
+
 //////////////////////////////////////////////////////////////////////////
 
 class FileReader final
@@ -27,14 +64,105 @@ public:
     {
         m_curFilePos = 0;
         m_fileSize = fileId.m_fileSize;
-        if (fileId != FileDescriptor())
+        m_inlineContent.clear();
+        m_compressed = false;
+        m_firstFileTable = fileId != FileDescriptor() ? fileId.m_first : PageIdx::INVALID;
+        rewind();
+    }
+
+    /// Small files are stored in the directory tree: their content replaces the pages.
+    void openInline(std::vector<uint8_t> content)
+    {
+        m_curFilePos = 0;
+        m_fileSize = content.size();
+        m_inlineContent = std::move(content);
+        m_compressed = false;
+        m_pageSequence.clear();
+        m_firstFileTable = PageIdx::INVALID;
+        m_nextFileTable = PageIdx::INVALID;
+    }
+
+    /// Reads the pages of iv without a FileTable, e.g. a page shared by deduplicated files. Seeking
+    /// backwards is not supported.
+    void openPages(Interval iv)
+    {
+        open(FileDescriptor());
+        m_fileSize = uint64_t(iv.length()) * PageSize;
+        m_pageSequence.pushBack(iv);
+    }
+
+    /// The pages of compressed files hold chunks that are decompressed one at a time while reading.
+    /// The chunk index at chunkIndexPos maps positions of the content to the chunks, see seek().
+    void openCompressed(FileDescriptor fileId, uint64_t uncompressedSize, uint64_t chunkIndexPos)
+    {
+        open(fileId);
+        m_compressed = true;
+        m_uncompressedPos = 0;
+        m_uncompressedSize = uncompressedSize;
+        m_chunk.clear();
+        m_chunkPos = 0;
+        m_chunkIndexPos = chunkIndexPos;
+        m_chunkIndex.clear();
+        m_chunkIndexLoaded = false;
+    }
+
+    /// Moves the read position to position of the content. In compressed files only the chunk holding
+    /// that position is read and decompressed.
+    void seek(uint64_t position)
+    {
+        position = std::min(position, size());
+        if (!m_compressed)
         {
-            ConstPageDef<FileTable> fileTable = m_cacheManager.loadPage<FileTable>(fileId.m_first);
-            fileTable.m_page->insertInto(m_pageSequence);
-            m_nextFileTable = fileTable.m_page->getNext();
+            seekStored(position);
+            return;
         }
-        else
-            m_nextFileTable = PageIdx::INVALID;
+
+        uint64_t chunkBegin = m_uncompressedPos - m_chunkPos;
+        if (position == m_uncompressedSize)
+        {
+            // nothing left to read
+            m_chunk.clear();
+            chunkBegin = position;
+        }
+        else if (position < chunkBegin || position >= chunkBegin + m_chunk.size())
+        {
+            auto& index = chunkIndex();
+            auto it = std::upper_bound(index.begin(), index.end(), position,
+                                       [](uint64_t pos, const ChunkIndexEntry& entry) { return pos < entry.m_offset; });
+            if (it == index.begin())
+                throw std::runtime_error("Compressed file is corrupt");
+            --it;
+            seekStored(it->m_storedOffset);
+            readChunk();
+            chunkBegin = it->m_offset;
+            if (position - chunkBegin >= m_chunk.size())
+                throw std::runtime_error("Compressed file is corrupt");
+        }
+        m_chunkPos = size_t(position - chunkBegin);
+        m_uncompressedPos = position;
+    }
+
+    /// The chunks of a compressed file, read from the file on first use.
+    const std::vector<ChunkIndexEntry>& chunkIndex()
+    {
+        if (m_chunkIndexLoaded)
+            return m_chunkIndex;
+
+        uint64_t position = m_curFilePos;
+        seekStored(m_chunkIndexPos);
+        ChunkHeader header;
+        auto headerBegin = reinterpret_cast<uint8_t*>(&header);
+        if (readStored(headerBegin, headerBegin + sizeof(header)) != headerBegin + sizeof(header)
+            || !header.isChunkIndex() || header.m_storedSize % sizeof(ChunkIndexEntry)
+            || header.m_storedSize > m_fileSize - m_curFilePos)
+            throw std::runtime_error("Compressed file is corrupt");
+
+        m_chunkIndex.resize(header.m_storedSize / sizeof(ChunkIndexEntry));
+        auto indexBegin = reinterpret_cast<uint8_t*>(m_chunkIndex.data());
+        readStored(indexBegin, indexBegin + header.m_storedSize);
+        seekStored(position);
+        m_chunkIndexLoaded = true;
+        return m_chunkIndex;
     }
 
     Interval nextInterval(uint32_t maxSize)
@@ -54,6 +182,185 @@ public:
     uint8_t* read(uint8_t* begin, uint8_t* end)
     {
         assert(begin <= end);
+        if (!m_compressed)
+            return readStored(begin, end);
+
+        while (begin != end)
+        {
+            if (m_chunkPos == m_chunk.size())
+            {
+                if (m_uncompressedPos == m_uncompressedSize || m_curFilePos == m_fileSize)
+                    break;
+                readChunk();
+            }
+            size_t size = std::min(size_t(end - begin), m_chunk.size() - m_chunkPos);
+            begin = std::copy_n(m_chunk.begin() + m_chunkPos, size, begin);
+            m_chunkPos += size;
+            m_uncompressedPos += size;
+        }
+        return begin;
+    }
+
+    /// Fills the buffers one after the other and returns the number of bytes read. A page that holds bytes
+    /// for several buffers is read once and then distributed, but never beyond the requested bytes.
+    size_t read(const std::vector<MutableBuffer>& buffers)
+    {
+        size_t total = 0;
+        if (m_compressed || !m_inlineContent.empty())
+        {
+            // these are in memory anyway
+            for (auto& buffer : buffers)
+            {
+                auto begin = static_cast<uint8_t*>(buffer.m_data);
+                total += read(begin, begin + buffer.m_size) - begin;
+            }
+            return total;
+        }
+
+        uint64_t requested = 0;
+        for (auto& buffer : buffers)
+            requested += buffer.m_size;
+
+        std::vector<uint8_t> page;
+        size_t pagePos = 0;
+        for (auto& buffer : buffers)
+        {
+            auto begin = static_cast<uint8_t*>(buffer.m_data);
+            auto end = begin + buffer.m_size;
+            while (begin != end)
+            {
+                if (pagePos == page.size())
+                {
+                    size_t pageLeft = PageSize - size_t(m_curFilePos % PageSize);
+                    if (bytesLeft() == 0)
+                        return total;
+                    if (size_t(end - begin) >= pageLeft)
+                    {
+                        // the buffer reaches the page boundary by itself: read it up to its last page boundary
+                        auto last = end - (size_t(end - begin) - pageLeft) % PageSize;
+                        auto cur = read(begin, last);
+                        total += cur - begin;
+                        if (cur != last)
+                            return total;
+                        begin = cur;
+                        continue;
+                    }
+
+                    page.resize(size_t(std::min({ uint64_t(pageLeft), bytesLeft(), requested - total })));
+                    read(page.data(), page.data() + page.size());
+                    pagePos = 0;
+                }
+
+                size_t size = std::min(size_t(end - begin), page.size() - pagePos);
+                begin = std::copy_n(page.data() + pagePos, size, begin);
+                pagePos += size;
+                total += size;
+            }
+        }
+        return total;
+    }
+
+    /// Reads up to maxSize bytes like read(). If the file interface keeps the current page in memory, the
+    /// view points into that page without copying and ends at the page boundary at the latest. Otherwise
+    /// the bytes are copied into a buffer allocated for the view: that costs more than read() into a
+    /// buffer of the caller, so only use readView() for files in memory.
+    ReadView readView(size_t maxSize)
+    {
+        size_t size = size_t(std::min(uint64_t(maxSize), bytesLeft()));
+        if (size == 0)
+            return ReadView();
+
+        if (!m_compressed && m_inlineContent.empty())
+        {
+            size_t pageOffset = size_t(m_curFilePos % PageSize);
+            PageIndex pageId = pageOffset ? m_pageSequence.front().begin() : nextInterval(0).begin();
+            if (auto page = m_cacheManager.getFileInterface()->pageMemory(pageId))
+            {
+                size = std::min(size, PageSize - pageOffset);
+                if (pageOffset + size == PageSize)
+                    nextInterval(1); // remove that page
+                m_curFilePos += size;
+                return ReadView(std::shared_ptr<const uint8_t>(page, page.get() + pageOffset), size);
+            }
+        }
+
+        auto buffer = std::make_shared<std::vector<uint8_t>>(size);
+        read(buffer->data(), buffer->data() + size);
+        return ReadView(std::shared_ptr<const uint8_t>(buffer, buffer->data()), size);
+    }
+
+    uint64_t bytesLeft() const
+    {
+        return m_compressed ? m_uncompressedSize - m_uncompressedPos : m_fileSize - m_curFilePos;
+    }
+
+    uint64_t size() const { return m_compressed ? m_uncompressedSize : m_fileSize; }
+
+    template <class TIter>
+    uint8_t* readIterator(TIter begin, TIter end)
+    {
+        return read((uint8_t*) &begin[0], (uint8_t*) &begin[end - begin]);
+    }
+
+    using Visitor = std::function < bool(const ConstPageDef<FileTable>&)>;
+    bool visitAllFileTables(FileDescriptor fd, const Visitor& visitor) const 
+    { 
+        auto idx = fd.m_first;
+        while (idx != PageIdx::INVALID)
+        {
+            ConstPageDef<FileTable> ftp = m_cacheManager.loadPage<FileTable>(idx);
+            if (!visitor(ftp))
+                return false;
+            idx = ftp.m_page->getNext();
+            assert(idx != PageIdx::INVALID || ftp.m_index == fd.m_last);
+        }
+        return true;
+    }
+
+private:
+    void rewind()
+    {
+        m_curFilePos = 0;
+        m_pageSequence.clear();
+        m_nextFileTable = PageIdx::INVALID;
+        if (m_firstFileTable != PageIdx::INVALID)
+        {
+            ConstPageDef<FileTable> fileTable = m_cacheManager.loadPage<FileTable>(m_firstFileTable);
+            fileTable.m_page->insertInto(m_pageSequence);
+            m_nextFileTable = fileTable.m_page->getNext();
+        }
+    }
+
+    /// Moves the position of the stored bytes. Seeking backwards starts over at the first FileTable.
+    void seekStored(uint64_t position)
+    {
+        assert(position <= m_fileSize);
+        if (!m_inlineContent.empty())
+        {
+            m_curFilePos = position;
+            return;
+        }
+
+        if (position < m_curFilePos)
+            rewind();
+
+        // drop the pages before the one holding position
+        uint64_t pages = position / PageSize - m_curFilePos / PageSize;
+        while (pages > 0)
+        {
+            Interval iv = nextInterval(uint32_t(std::min<uint64_t>(pages, UINT32_MAX)));
+            if (iv.length() == 0)
+                throw std::runtime_error("File is corrupt");
+            pages -= iv.length();
+        }
+        if (position % PageSize && position < m_fileSize)
+            nextInterval(0); // loads the FileTable of the page holding position
+        m_curFilePos = position;
+    }
+
+    /// Reads the bytes as they are stored, i.e. the chunks of compressed files.
+    uint8_t* readStored(uint8_t* begin, uint8_t* end)
+    {
 
         // don't read over the end
         uint64_t blockSize = std::min(uint64_t(end - begin), m_fileSize - m_curFilePos);
@@ -61,16 +368,23 @@ public:
             return begin;
 
         end = begin + blockSize;
+        if (!m_inlineContent.empty())
+        {
+            auto pos = m_inlineContent.begin() + size_t(m_curFilePos);
+            begin = std::copy(pos, pos + size_t(blockSize), begin);
+            m_curFilePos += blockSize;
+            return begin;
+        }
 
         // read the remainder of this page
-        if (m_curFilePos % 4096)
+        if (m_curFilePos % PageSize)
         {
-            size_t pageOffset = size_t(m_curFilePos % 4096);
+            size_t pageOffset = size_t(m_curFilePos % PageSize);
             PageIndex pageId = m_pageSequence.front().begin();
-            if ((pageOffset + blockSize) >= 4096)
+            if ((pageOffset + blockSize) >= PageSize)
             {
                 begin = m_cacheManager.getFileInterface()->readPage(pageId, pageOffset, begin,
-                                                                       begin + (4096 - pageOffset));
+                                                                       begin + (PageSize - pageOffset));
                 nextInterval(1); // remove that page
             }
             else
@@ -80,7 +394,7 @@ public:
         }
 
         // read full pages
-        size_t pages = (end - begin) / 4096;
+        size_t pages = (end - begin) / PageSize;
         while (pages > 0)
         {
             Interval iv = nextInterval((uint32_t) pages);
@@ -99,37 +413,61 @@ public:
         return begin;
     }
 
-    uint64_t bytesLeft() const { return m_fileSize - m_curFilePos; }
-    uint64_t size() const { return m_fileSize; }
-
-    template <class TIter>
-    uint8_t* readIterator(TIter begin, TIter end)
+    void readChunk()
     {
-        return read((uint8_t*) &begin[0], (uint8_t*) &begin[end - begin]);
-    }
+        ChunkHeader header;
+        auto headerBegin = reinterpret_cast<uint8_t*>(&header);
+        if (readStored(headerBegin, headerBegin + sizeof(header)) != headerBegin + sizeof(header))
+            throw std::runtime_error("Compressed file is corrupt");
 
-    using Visitor = std::function < bool(const ConstPageDef<FileTable>&)>;
-    bool visitAllFileTables(FileDescriptor fd, const Visitor& visitor) const 
-    { 
-        auto idx = fd.m_first;
-        while (idx != PageIdx::INVALID)
+        m_chunkPos = 0;
+        if (header.isChunkIndex())
         {
-            ConstPageDef<FileTable> ftp = m_cacheManager.loadPage<FileTable>(idx);
-            if (!visitor(ftp))
-                return false;
-            idx = ftp.m_page->getNext();
-            assert(idx != PageIdx::INVALID || ftp.m_index == fd.m_last);
+            // appending leaves the index of the old content behind
+            if (header.m_storedSize > m_fileSize - m_curFilePos)
+                throw std::runtime_error("Compressed file is corrupt");
+            seekStored(m_curFilePos + header.m_storedSize);
+            m_chunk.clear();
+            return;
         }
-        return true;
+        if (header.m_size > ChunkSize || header.m_storedSize > maxCompressedSize(ChunkSize))
+            throw std::runtime_error("Compressed file is corrupt");
+
+        m_chunk.resize(header.m_size);
+        if (!header.isCompressed())
+        {
+            if (readStored(m_chunk.data(), m_chunk.data() + m_chunk.size()) != m_chunk.data() + m_chunk.size())
+                throw std::runtime_error("Compressed file is corrupt");
+            return;
+        }
+
+        m_chunkBuffer.resize(header.m_storedSize);
+        auto storedEnd = m_chunkBuffer.data() + m_chunkBuffer.size();
+        if (readStored(m_chunkBuffer.data(), storedEnd) != storedEnd
+            || decompress(m_chunkBuffer.data(), storedEnd, m_chunk.data(), m_chunk.data() + m_chunk.size())
+                   != m_chunk.data() + m_chunk.size())
+            throw std::runtime_error("Compressed file is corrupt");
     }
 
 private:
     mutable TypedCacheManager m_cacheManager;
     IntervalSequence m_pageSequence;
+    std::vector<uint8_t> m_inlineContent;
 
     uint64_t m_curFilePos;
     uint64_t m_fileSize;
-    uint32_t m_nextFileTable;
+    PageIndex m_firstFileTable = PageIdx::INVALID;
+    PageIndex m_nextFileTable;
+
+    bool m_compressed = false;
+    uint64_t m_uncompressedPos = 0;
+    uint64_t m_uncompressedSize = 0;
+    std::vector<uint8_t> m_chunk; // the decompressed chunk being read
+    size_t m_chunkPos = 0;
+    std::vector<uint8_t> m_chunkBuffer;
+    uint64_t m_chunkIndexPos = 0;
+    std::vector<ChunkIndexEntry> m_chunkIndex;
+    bool m_chunkIndexLoaded = false;
 };
 
 }
@@ -35,7 +35,12 @@ FileSystem::FileSystem(const Startup& startup)
     , m_directoryStructure(startup)
 {}
 
-std::optional<WriteHandle> FileSystem::createFile(Path path)
+/// Compressed files are written in chunks which readFile() decompresses transparently. Deduplicated files
+/// share their full pages with other deduplicated files of equal content. Hashed files keep the hashes of their
+/// content, which saves reading them in contentHashes(). Files small enough to be stored inline in the tree are
+/// neither compressed, deduplicated nor hashed.
+std::optional<WriteHandle> FileSystem::createFile(Path path, Compression compression, Deduplication deduplication,
+                                                  Hashing hashing)
 {
     RollbackOnException guard(*this);
 
@@ -45,10 +50,47 @@ std::optional<WriteHandle> FileSystem::createFile(Path path)
     if (!m_directoryStructure.createFile(DirectoryKey(path.m_parentFolder, path.m_relativePath)))
         return std::nullopt;
 
-    addOpenWriter(path);
+    auto& openWriter = addOpenWriter(path);
+    if (hashing != Hashing::Off)
+        openWriter.m_hasher.emplace();
+    if (compression != Compression::None)
+        openWriter.m_fileWriter.enableCompression();
+    if (deduplication != Deduplication::Off)
+        openWriter.m_fileWriter.enableDeduplication(m_directoryStructure.makePageDeduplicator());
     return WriteHandle { m_nextHandle++ };
 }
 
+/// Creates the files in one batch. Entries of paths that could not be created are empty.
+std::vector<std::optional<WriteHandle>> FileSystem::createFiles(const std::vector<Path>& paths)
+{
+    RollbackOnException guard(*this);
+
+    std::vector<size_t> indices; // into paths, of the paths that could be created
+    std::vector<Path> createdPaths;
+    std::vector<DirectoryKey> dkeys;
+    for (size_t i = 0; i < paths.size(); i++)
+    {
+        Path path = paths[i];
+        if (!path.create(&m_directoryStructure))
+            continue;
+        indices.push_back(i);
+        createdPaths.push_back(path);
+        dkeys.emplace_back(path.m_parentFolder, path.m_relativePath);
+    }
+
+    auto created = m_directoryStructure.createFiles(dkeys);
+    std::vector<std::optional<WriteHandle>> handles(paths.size());
+    for (size_t i = 0; i < indices.size(); i++)
+    {
+        if (!created[i])
+            continue;
+
+        addOpenWriter(createdPaths[i]);
+        handles[indices[i]] = WriteHandle { m_nextHandle++ };
+    }
+    return handles;
+}
+
 std::optional<WriteHandle> FileSystem::appendFile(Path path)
 {
     RollbackOnException guard(*this);
@@ -56,14 +98,41 @@ std::optional<WriteHandle> FileSystem::appendFile(Path path)
     if (!path.create(&m_directoryStructure))
         return std::nullopt;
 
-    auto fileDescriptor = m_directoryStructure.appendFile(DirectoryKey(path.m_parentFolder, path.m_relativePath));
+    DirectoryStructure::FileContent content;
+    DirectoryKey dkey(path.m_parentFolder, path.m_relativePath);
+    auto fileDescriptor = m_directoryStructure.appendFile(dkey, &content);
 
     if (!fileDescriptor)
         return std::nullopt;
 
-    auto& fileWriter = addOpenWriter(path);
-    if (*fileDescriptor != FileDescriptor())
-        fileWriter.openAppend(*fileDescriptor);
+    auto& openWriter = addOpenWriter(path);
+    if (fileDescriptor->isInline())
+        openWriter.m_inlineContent = std::move(content.m_inlineContent);
+    else if (*fileDescriptor != FileDescriptor() || content.m_uncompressedSize || content.m_deduplicated)
+    {
+        std::vector<ChunkIndexEntry> chunkIndex; // the new index covers the old chunks as well
+        auto hashes = m_directoryStructure.contentHashes(dkey);
+        if (content.m_uncompressedSize || hashes)
+        {
+            auto fileReader = makeReader(*fileDescriptor, content);
+            if (content.m_uncompressedSize)
+                chunkIndex = fileReader.chunkIndex();
+            if (hashes)
+            {
+                // hashing goes on with the partial last block
+                std::vector<uint8_t> lastBlock(size_t(hashes->m_size % HashBlockSize));
+                fileReader.seek(hashes->m_size - lastBlock.size());
+                fileReader.read(lastBlock.data(), lastBlock.data() + lastBlock.size());
+                openWriter.m_hasher.emplace(std::move(*hashes), std::move(lastBlock));
+            }
+        }
+        openWriter.m_fileWriter.openAppend(*fileDescriptor);
+        if (content.m_uncompressedSize)
+            openWriter.m_fileWriter.enableCompression(*content.m_uncompressedSize, std::move(chunkIndex));
+        if (content.m_deduplicated)
+            openWriter.m_fileWriter.enableDeduplication(m_directoryStructure.makePageDeduplicator());
+        openWriter.m_isInline = false;
+    }
     return WriteHandle { m_nextHandle++ };
 }
 
@@ -72,15 +141,17 @@ std::optional<ReadHandle> FileSystem::readFile(Path path)
     if (!path.normalize(&m_directoryStructure))
         return std::nullopt;
 
-    auto fileDescriptor = m_directoryStructure.openFile(DirectoryKey(path.m_parentFolder, path.m_relativePath));
+    DirectoryStructure::FileContent content;
+    auto fileDescriptor =
+        m_directoryStructure.openFile(DirectoryKey(path.m_parentFolder, path.m_relativePath), &content);
 
     if (!fileDescriptor)
         return std::nullopt;
 
-    auto res = m_openReaders.try_emplace(ReadHandle { m_nextHandle }, FileReader { m_cacheManager });
+    auto fileReader = makeReader(*fileDescriptor, content);
+    std::lock_guard lock(*m_readersMutex);
+    [[maybe_unused]] auto res = m_openReaders.try_emplace(ReadHandle { m_nextHandle }, std::move(fileReader));
     assert(res.second);
-    if (*fileDescriptor != FileDescriptor())
-        res.first->second.open(*fileDescriptor);
     return ReadHandle { m_nextHandle++ };
 }
 
@@ -89,29 +160,168 @@ std::optional<uint64_t> FileSystem::fileSize(Path path) const
     if (!path.normalize(&m_directoryStructure))
         return std::nullopt;
 
-    auto fileDescriptor = m_directoryStructure.openFile(DirectoryKey(path.m_parentFolder, path.m_relativePath));
+    DirectoryStructure::FileContent content;
+    auto fileDescriptor =
+        m_directoryStructure.openFile(DirectoryKey(path.m_parentFolder, path.m_relativePath), &content);
+
+    if (!fileDescriptor)
+        return std::nullopt;
+
+    return content.m_uncompressedSize.value_or(fileDescriptor->m_fileSize);
+}
+
+std::optional<FileSystem::FileMode> FileSystem::fileMode(Path path) const
+{
+    if (!path.normalize(&m_directoryStructure))
+        return std::nullopt;
+
+    DirectoryStructure::FileContent content;
+    if (!m_directoryStructure.openFile(DirectoryKey(path.m_parentFolder, path.m_relativePath), &content))
+        return std::nullopt;
+
+    return FileMode { content.m_uncompressedSize ? Compression::Lz4 : Compression::None,
+                      content.m_deduplicated ? Deduplication::Pages : Deduplication::Off };
+}
+
+/// Files created with Hashing::Content keep the hashes of their content. For other files the content is read
+/// once and the hashes are stored with the file, unless it is stored inline.
+std::optional<ContentHashes> FileSystem::contentHashes(Path path)
+{
+    RollbackOnException guard(*this);
+
+    if (!path.normalize(&m_directoryStructure))
+        return std::nullopt;
 
+    DirectoryKey dkey(path.m_parentFolder, path.m_relativePath);
+    if (auto hashes = m_directoryStructure.contentHashes(dkey))
+        return hashes;
+
+    DirectoryStructure::FileContent content;
+    auto fileDescriptor = m_directoryStructure.openFile(dkey, &content);
     if (!fileDescriptor)
         return std::nullopt;
 
-    return fileDescriptor->m_fileSize;
+    ContentHasher hasher;
+    auto fileReader = makeReader(*fileDescriptor, content);
+    std::vector<uint8_t> block(HashBlockSize);
+    while (auto size = fileReader.read(block.data(), block.data() + block.size()) - block.data())
+        hasher.update(block.data(), block.data() + size);
+
+    // inline and empty files are hashed on the fly
+    if (fileDescriptor->isInline() || *fileDescriptor == FileDescriptor())
+        return hasher.hashes();
+
+    content.m_hashes = hasher.hashes();
+    m_directoryStructure.updateFile(dkey, *fileDescriptor, content);
+    return content.m_hashes;
+}
+
+/// Copies a file by letting the copy share the pages of the source. Only metadata is written, however large
+/// the file is.
+bool FileSystem::cloneFile(Path sourcePath, Path destPath)
+{
+    RollbackOnException guard(*this);
+
+    if (!sourcePath.normalize(&m_directoryStructure))
+        return false;
+    if (!destPath.create(&m_directoryStructure))
+        return false;
+
+    return m_directoryStructure.cloneFile(DirectoryKey(sourcePath.m_parentFolder, sourcePath.m_relativePath),
+                                          DirectoryKey(destPath.m_parentFolder, destPath.m_relativePath));
 }
 
 size_t FileSystem::read(ReadHandle file, void* ptr, size_t size)
 {
     uint8_t* begin = (uint8_t*) ptr;
     uint8_t* end = begin + size;
-    auto cur = m_openReaders.at(file).read(begin, end);
+    auto& fileReader = openReader(file);
+    auto cur = fileReader.read(begin, end);
     return cur - begin;
 }
 
+/// Scatter read: fills the buffers in turn as one read() of their total size would.
+size_t FileSystem::read(ReadHandle file, const std::vector<MutableBuffer>& buffers)
+{
+    return openReader(file).read(buffers);
+}
+
+/// Like read() but avoids the copy where the file interface allows it: the view may hold fewer than
+/// maxSize bytes even before the end of the file.
+ReadView FileSystem::readView(ReadHandle file, size_t maxSize)
+{
+    return openReader(file).readView(maxSize);
+}
+
+/// Moves the read position; positions beyond the end of the file move to the end. Reading a compressed file
+/// after seek() decompresses the chunks from that position on only.
+void FileSystem::seek(ReadHandle file, uint64_t position)
+{
+    openReader(file).seek(position);
+}
+
 size_t FileSystem::write(WriteHandle file, const void* ptr, size_t size)
 {
     RollbackOnException guard(*this);
 
     const uint8_t* begin = (const uint8_t*) ptr;
     const uint8_t* end = begin + size;
-    m_openWriters.at(file).m_fileWriter.write(begin, end);
+    auto& openWriter = m_openWriters.at(file);
+    if (openWriter.m_hasher)
+        openWriter.m_hasher->update(begin, end);
+    if (openWriter.m_isInline)
+    {
+        auto& content = openWriter.m_inlineContent;
+        if (content.size() + size <= DirectoryStructure::maxInlineFileSize())
+        {
+            content.insert(content.end(), begin, end);
+            return size;
+        }
+
+        // the file outgrows the tree
+        if (!content.empty())
+            openWriter.m_fileWriter.write(content.data(), content.data() + content.size());
+        content.clear();
+        openWriter.m_isInline = false;
+    }
+    openWriter.m_fileWriter.write(begin, end);
+    return size;
+}
+
+/// Gather write: writes the buffers in turn as one write() of their concatenation would.
+size_t FileSystem::write(WriteHandle file, const std::vector<ConstBuffer>& buffers)
+{
+    RollbackOnException guard(*this);
+
+    size_t size = 0;
+    for (auto& buffer : buffers)
+        size += buffer.m_size;
+
+    auto& openWriter = m_openWriters.at(file);
+    if (openWriter.m_hasher)
+        for (auto& buffer : buffers)
+            openWriter.m_hasher->update(static_cast<const uint8_t*>(buffer.m_data),
+                                        static_cast<const uint8_t*>(buffer.m_data) + buffer.m_size);
+    if (openWriter.m_isInline)
+    {
+        auto& content = openWriter.m_inlineContent;
+        if (content.size() + size <= DirectoryStructure::maxInlineFileSize())
+        {
+            for (auto& buffer : buffers)
+                content.insert(content.end(), static_cast<const uint8_t*>(buffer.m_data),
+                               static_cast<const uint8_t*>(buffer.m_data) + buffer.m_size);
+            return size;
+        }
+
+        // the file outgrows the tree
+        std::vector<ConstBuffer> allBuffers { { content.data(), content.size() } };
+        allBuffers.insert(allBuffers.end(), buffers.begin(), buffers.end());
+        openWriter.m_fileWriter.write(allBuffers);
+        content.clear();
+        openWriter.m_isInline = false;
+        return size;
+    }
+    openWriter.m_fileWriter.write(buffers);
     return size;
 }
 
@@ -119,15 +329,13 @@ void FileSystem::close(WriteHandle file)
 {
     RollbackOnException guard(*this);
 
-    auto& openFile = m_openWriters.at(file);
-    auto fileDescriptor = openFile.m_fileWriter.close();
-    Path path = openFile.m_path;
-    m_directoryStructure.updateFile(DirectoryKey(path.m_parentFolder, path.m_relativePath), fileDescriptor);
+    closeWriter(m_openWriters.at(file));
     m_openWriters.erase(file);
 }
 
 void FileSystem::close(ReadHandle file)
 {
+    std::lock_guard lock(*m_readersMutex);
     [[maybe_unused]] auto res = m_openReaders.at(file); // throws if non-existant
     m_openReaders.erase(file);
 }
@@ -135,13 +343,13 @@ void FileSystem::close(ReadHandle file)
 uint64_t FileSystem::fileSize(WriteHandle file) const
 {
     const auto& openFile = m_openWriters.at(file);
-    return openFile.m_fileWriter.size();
+    return openFile.m_isInline ? openFile.m_inlineContent.size() : openFile.m_fileWriter.size();
 }
 
 uint64_t FileSystem::fileSize(ReadHandle file) const
 {
-    const auto& openFile = m_openReaders.at(file);
-    return openFile.size();
+    std::lock_guard lock(*m_readersMutex);
+    return m_openReaders.at(file).size();
 }
 
 std::optional<Folder> FileSystem::makeSubFolder(Path path)
@@ -172,6 +380,21 @@ bool FileSystem::addAttribute(Path path, const TreeValue& attribute)
     return m_directoryStructure.addAttribute(DirectoryKey(path.m_parentFolder, path.m_relativePath), attribute);
 }
 
+/// Adds the attributes in one batch and returns the number of attributes added.
+size_t FileSystem::addAttributes(const std::vector<std::pair<Path, TreeValue>>& attributes)
+{
+    RollbackOnException guard(*this);
+
+    std::vector<std::pair<DirectoryKey, TreeValue>> dkeyAttributes;
+    for (auto [path, attribute]: attributes)
+    {
+        if (path.create(&m_directoryStructure))
+            dkeyAttributes.emplace_back(DirectoryKey(path.m_parentFolder, path.m_relativePath), attribute);
+    }
+
+    return m_directoryStructure.addAttributes(dkeyAttributes);
+}
+
 std::optional<TreeValue> FileSystem::getAttribute(Path path) const
 {
     if (!path.normalize(&m_directoryStructure))
@@ -221,12 +444,30 @@ FileSystem::Cursor FileSystem::begin(Path path) const
     return m_directoryStructure.begin(DirectoryKey(path.m_parentFolder, path.m_relativePath));
 }
 
-void FileSystem::commit()
+/// Skips index entries of the folder without visiting them, e.g. to list a large folder page by page.
+FileSystem::Cursor FileSystem::begin(Path path, size_t index) const
+{
+    if (!path.normalize(&m_directoryStructure))
+        return Cursor();
+
+    return m_directoryStructure.begin(DirectoryKey(path.m_parentFolder, path.m_relativePath), index);
+}
+
+/// Number of entries begin(path) iterates over.
+size_t FileSystem::count(Path path) const
+{
+    if (!path.normalize(&m_directoryStructure))
+        return 0;
+
+    return m_directoryStructure.count(DirectoryKey(path.m_parentFolder, path.m_relativePath));
+}
+
+CommitStats FileSystem::commit()
 {
     RollbackOnException guard(*this);
 
     closeAllFiles();
-    m_directoryStructure.commit();
+    return m_directoryStructure.commit();
 }
 
 void FileSystem::rollback()
@@ -243,16 +484,51 @@ void FileSystem::init()
 void FileSystem::closeAllFiles()
 {
     for (auto& [key, openFile]: m_openWriters)
-    {
-        auto fileDescriptor = openFile.m_fileWriter.close();
-        Path path = openFile.m_path;
-        m_directoryStructure.updateFile(DirectoryKey(path.m_parentFolder, path.m_relativePath), fileDescriptor);
-    }
+        closeWriter(openFile);
     m_openWriters.clear();
+    std::lock_guard lock(*m_readersMutex);
     m_openReaders.clear();
 }
 
-FileWriter& TxFs::FileSystem::addOpenWriter(Path path)
+void FileSystem::closeWriter(OpenWriter& openWriter)
+{
+    Path path = openWriter.m_path;
+    DirectoryKey dkey(path.m_parentFolder, path.m_relativePath);
+    const auto& content = openWriter.m_inlineContent;
+    if (openWriter.m_isInline && !content.empty())
+        m_directoryStructure.updateFile(dkey, ByteStringView(content.data(), static_cast<uint8_t>(content.size())));
+    else if (openWriter.m_fileWriter.isCompressed() || openWriter.m_fileWriter.isDeduplicated()
+             || (openWriter.m_hasher && !openWriter.m_isInline))
+    {
+        DirectoryStructure::FileContent fileContent;
+        if (openWriter.m_hasher && !openWriter.m_isInline)
+            fileContent.m_hashes = openWriter.m_hasher->hashes();
+        if (openWriter.m_fileWriter.isCompressed())
+        {
+            fileContent.m_chunkIndex = openWriter.m_fileWriter.writeChunkIndex();
+            fileContent.m_uncompressedSize = openWriter.m_fileWriter.size();
+        }
+        fileContent.m_deduplicated = openWriter.m_fileWriter.isDeduplicated();
+        m_directoryStructure.updateFile(dkey, openWriter.m_fileWriter.close(), fileContent);
+    }
+    else
+        m_directoryStructure.updateFile(dkey, openWriter.m_fileWriter.close());
+}
+
+/// Opens a reader on a file as openFile() or appendFile() of the DirectoryStructure found it.
+FileReader FileSystem::makeReader(FileDescriptor fileDescriptor, DirectoryStructure::FileContent& content) const
+{
+    FileReader fileReader { m_cacheManager };
+    if (fileDescriptor.isInline())
+        fileReader.openInline(std::move(content.m_inlineContent));
+    else if (content.m_uncompressedSize)
+        fileReader.openCompressed(fileDescriptor, *content.m_uncompressedSize, content.m_chunkIndex);
+    else if (fileDescriptor != FileDescriptor())
+        fileReader.open(fileDescriptor);
+    return fileReader;
+}
+
+FileSystem::OpenWriter& TxFs::FileSystem::addOpenWriter(Path path)
 {
     RollbackOnException guard(*this);
 
@@ -260,8 +536,12 @@ FileWriter& TxFs::FileSystem::addOpenWriter(Path path)
                                          OpenWriter { PathHolder { path }, FileWriter { m_cacheManager } });
 
     assert(res.second);
-    auto& openWriter = res.first->second;
-    return openWriter.m_fileWriter;
+    return res.first->second;
 }
 
-
+/// The FileReader itself is not shared: only one thread at a time reads from a handle.
+FileReader& FileSystem::openReader(ReadHandle file)
+{
+    std::lock_guard lock(*m_readersMutex);
+    return m_openReaders.at(file);
+}
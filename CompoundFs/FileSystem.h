@@ -4,6 +4,7 @@
 #include "FileReader.h"
 #include "FileWriter.h"
 #include "Path.h"
+#include <mutex>
 
 namespace TxFs
 {
@@ -12,6 +13,8 @@ enum class ReadHandle : uint32_t;
 
 //////////////////////////////////////////////////////////////////////////
 
+/// Read operations (the const members, readFile(), the read() overloads, readView(), seek() and close(ReadHandle))
+/// can be called from several threads at the same time. All other operations need exclusive access.
 class FileSystem final
 {
 public:
@@ -19,19 +22,36 @@ public:
     using Startup = DirectoryStructure::Startup;
     struct RollbackOnException;
 
+    /// How a file is stored, as told to createFile().
+    struct FileMode
+    {
+        Compression m_compression = Compression::None;
+        Deduplication m_deduplication = Deduplication::Off;
+    };
+
 public:
     FileSystem(const Startup& startup);
 
     static Startup initialize(const std::shared_ptr<CacheManager>& cacheManager);
     void init();
 
-    std::optional<WriteHandle> createFile(Path path);
+    std::optional<WriteHandle> createFile(Path path, Compression compression = Compression::None,
+                                          Deduplication deduplication = Deduplication::Off,
+                                          Hashing hashing = Hashing::Off);
+    std::vector<std::optional<WriteHandle>> createFiles(const std::vector<Path>& paths);
     std::optional<WriteHandle> appendFile(Path path);
     std::optional<ReadHandle> readFile(Path path);
     std::optional<uint64_t> fileSize(Path path) const;
+    std::optional<FileMode> fileMode(Path path) const;
+    std::optional<ContentHashes> contentHashes(Path path);
+    bool cloneFile(Path sourcePath, Path destPath);
 
     size_t read(ReadHandle file, void* ptr, size_t size);
+    ReadView readView(ReadHandle file, size_t maxSize);
+    size_t read(ReadHandle file, const std::vector<MutableBuffer>& buffers);
+    void seek(ReadHandle file, uint64_t position);
     size_t write(WriteHandle file, const void* ptr, size_t size);
+    size_t write(WriteHandle file, const std::vector<ConstBuffer>& buffers);
 
     void close(WriteHandle file);
     void close(ReadHandle file);
@@ -42,6 +62,7 @@ public:
     std::optional<Folder> subFolder(Path path) const;
 
     bool addAttribute(Path path, const TreeValue& attribute);
+    size_t addAttributes(const std::vector<std::pair<Path, TreeValue>>& attributes);
     std::optional<TreeValue> getAttribute(Path path) const;
 
     bool rename(Path oldPath, Path newPath);
@@ -49,23 +70,34 @@ public:
 
     Cursor find(Path path) const;
     Cursor begin(Path path) const;
+    Cursor begin(Path path, size_t index) const;
     Cursor next(Cursor cursor) const;
+    size_t count(Path path) const;
 
-    void commit();
+    CommitStats commit();
     void rollback();
 
     bool reducePath(Path& p) const;
     bool createPath(Path& p);
 
 private:
+    struct OpenWriter;
     void closeAllFiles();
-    FileWriter& addOpenWriter(Path path);
+    void closeWriter(OpenWriter& openWriter);
+    FileReader& openReader(ReadHandle file);
+    FileReader makeReader(FileDescriptor fileDescriptor, DirectoryStructure::FileContent& content) const;
+    OpenWriter& addOpenWriter(Path path);
 
 private:
+    /// Files stay in m_inlineContent until they outgrow DirectoryStructure::maxInlineFileSize(); they
+    /// are then written to pages like all larger files.
     struct OpenWriter
     {
         PathHolder m_path;
         FileWriter m_fileWriter;
+        std::vector<uint8_t> m_inlineContent {};
+        bool m_isInline = true;
+        std::optional<ContentHasher> m_hasher {}; // files created with Hashing::Content and appends to them
     };
 
     std::shared_ptr<CacheManager> m_cacheManager;
@@ -73,6 +105,7 @@ private:
     std::unordered_map<ReadHandle, FileReader> m_openReaders;
     std::unordered_map<WriteHandle, OpenWriter> m_openWriters;
     uint32_t m_nextHandle = 1;
+    std::unique_ptr<std::mutex> m_readersMutex = std::make_unique<std::mutex>(); // guards m_openReaders
 };
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -2,22 +2,155 @@
 #include "FileSystemHelper.h"
 #include "FileSystem.h"
 #include "Path.h"
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <thread>
 #include <vector>
 
 using namespace TxFs;
 
 namespace
 {
+constexpr size_t MaxEntries = 64; // entries of a folder processed in one batch
+constexpr size_t BlockSize = PageSize * 32;
+
+/// Content of a file on its way from a reader thread to the writing thread. The last block of a file
+/// has no data and tells if the whole file could be read.
+struct Block
+{
+    size_t m_file;
+    std::vector<uint8_t> m_data;
+    bool m_last = false;
+    bool m_success = false;
+};
+
+/// Readers wait while the queue is full, so only a bounded number of blocks is held in memory.
+class BlockQueue final
+{
+public:
+    explicit BlockQueue(size_t maxBlocks)
+        : m_maxBlocks(maxBlocks)
+    {}
+
+    /// Returns false if the queue was closed, i.e. nobody takes the block any more.
+    bool push(Block block)
+    {
+        std::unique_lock lock(m_mutex);
+        m_notFull.wait(lock, [this] { return m_blocks.size() < m_maxBlocks || m_closed; });
+        if (m_closed)
+            return false;
+        m_blocks.push_back(std::move(block));
+        m_notEmpty.notify_one();
+        return true;
+    }
+
+    Block pop()
+    {
+        std::unique_lock lock(m_mutex);
+        m_notEmpty.wait(lock, [this] { return !m_blocks.empty(); });
+        Block block = std::move(m_blocks.front());
+        m_blocks.pop_front();
+        m_notFull.notify_one();
+        return block;
+    }
+
+    void close()
+    {
+        std::scoped_lock lock(m_mutex);
+        m_closed = true;
+        m_notFull.notify_all();
+    }
+
+private:
+    std::deque<Block> m_blocks;
+    size_t m_maxBlocks;
+    bool m_closed = false;
+    std::mutex m_mutex;
+    std::condition_variable m_notFull;
+    std::condition_variable m_notEmpty;
+};
+
+/// Reads nofFiles files on reader threads while the calling thread writes them. readFile(file, queue)
+/// pushes the data blocks of a file and returns if it succeeded; writeBlock(block) gets the blocks of
+/// each file in order, the last one included. Returns the number of files read successfully.
+template <typename TReadFile, typename TWriteBlock>
+size_t runPipeline(size_t nofFiles, unsigned readerThreads, const TReadFile& readFile, const TWriteBlock& writeBlock)
+{
+    BlockQueue queue(4 * size_t(readerThreads));
+    std::atomic<size_t> nextFile = 0;
+    auto reader = [&] {
+        for (size_t file = nextFile++; file < nofFiles; file = nextFile++)
+        {
+            bool success = false;
+            try
+            {
+                success = readFile(file, queue);
+            }
+            catch (const std::exception&)
+            {}
+            if (!queue.push(Block { file, {}, true, success }))
+                return;
+        }
+    };
+
+    std::vector<std::thread> readers;
+    for (size_t i = 0; i < std::min(size_t(readerThreads), nofFiles); i++)
+        readers.emplace_back(reader);
+
+    size_t numFiles = 0;
+    try
+    {
+        for (size_t filesDone = 0; filesDone < nofFiles;)
+        {
+            Block block = queue.pop();
+            writeBlock(block);
+            filesDone += block.m_last;
+            numFiles += block.m_last && block.m_success;
+        }
+    }
+    catch (...)
+    {
+        queue.close();
+        for (auto& thread: readers)
+            thread.join();
+        throw;
+    }
+
+    for (auto& thread: readers)
+        thread.join();
+    return numFiles;
+}
+
+/// Writes the blocks of a pipeline to the files opened with writeHandles; the last block closes a file.
+auto blockWriter(FileSystem& destFs, const std::vector<std::optional<WriteHandle>>& writeHandles)
+{
+    return [&destFs, &writeHandles](const Block& block) {
+        auto& writeHandle = writeHandles[block.m_file];
+        if (!writeHandle)
+            return;
+        destFs.write(*writeHandle, block.m_data.data(), block.m_data.size());
+        if (block.m_last)
+            destFs.close(*writeHandle);
+    };
+}
+
 struct CopyProcessor
 {
     FileSystem& m_sourceFs;
     FileSystem& m_destFs;
     std::vector<char> m_buffer;
+    unsigned m_readerThreads;
 
-    CopyProcessor(FileSystem& sourceFs, FileSystem& destFs)
+    CopyProcessor(FileSystem& sourceFs, FileSystem& destFs, unsigned readerThreads)
         : m_sourceFs(sourceFs)
         , m_destFs(destFs)
-        , m_buffer(4096L * 32)
+        , m_buffer(BlockSize)
+        , m_readerThreads(readerThreads)
     {
     }
 
@@ -58,13 +191,16 @@ struct CopyProcessor
 
     bool copyFile(Path sourcePath, Path destPath)
     {
+        if (&m_sourceFs == &m_destFs)
+            return m_destFs.cloneFile(sourcePath, destPath);
+
         auto readHandle = m_sourceFs.readFile(sourcePath);
         if (!readHandle)
-            return 0;
+            return false;
 
         auto writeHandle = m_destFs.createFile(destPath);
         if (!writeHandle)
-            return 0;
+            return false;
 
         bool succ = copyPhysicalFile(*readHandle, *writeHandle);
         m_sourceFs.close(*readHandle);
@@ -73,6 +209,88 @@ struct CopyProcessor
         return succ;
     }
 
+    bool copyFile(Path sourcePath, std::optional<WriteHandle> writeHandle)
+    {
+        if (!writeHandle)
+            return false;
+
+        auto readHandle = m_sourceFs.readFile(sourcePath);
+        bool succ = readHandle && copyPhysicalFile(*readHandle, *writeHandle);
+        if (readHandle)
+            m_sourceFs.close(*readHandle);
+        m_destFs.close(*writeHandle);
+
+        return succ;
+    }
+
+    /// Attributes and files of a chunk of the source folder are added to the destination folder in
+    /// one batch each, sub-folders one by one.
+    size_t copyEntries(const std::vector<TreeEntry>& treeEntries, Folder destFolder)
+    {
+        size_t numItems = 0;
+        std::vector<std::pair<Path, TreeValue>> attributes;
+        std::vector<Path> sourceFiles;
+        std::vector<Path> destFiles;
+        for (const auto& entry: treeEntries)
+        {
+            Path destPath(destFolder, Path(entry.m_key).m_relativePath);
+            switch (entry.m_value.getType())
+            {
+            case TreeValue::Type::File:
+                sourceFiles.push_back(entry.m_key);
+                destFiles.push_back(destPath);
+                break;
+            case TreeValue::Type::Folder:
+                numItems += copyType(entry, destFolder);
+                break;
+            default:
+                attributes.emplace_back(destPath, entry.m_value);
+            }
+        }
+
+        numItems += m_destFs.addAttributes(attributes);
+        if (&m_sourceFs == &m_destFs)
+        {
+            for (size_t i = 0; i < sourceFiles.size(); i++)
+                numItems += m_destFs.cloneFile(sourceFiles[i], destFiles[i]);
+            return numItems;
+        }
+
+        auto writeHandles = m_destFs.createFiles(destFiles);
+        if (m_readerThreads > 0)
+            return numItems + copyFiles(sourceFiles, writeHandles);
+
+        for (size_t i = 0; i < sourceFiles.size(); i++)
+            numItems += copyFile(sourceFiles[i], writeHandles[i]);
+        return numItems;
+    }
+
+    /// The source files are read on m_readerThreads threads while this thread writes the copies.
+    size_t copyFiles(const std::vector<Path>& sourceFiles, const std::vector<std::optional<WriteHandle>>& writeHandles)
+    {
+        auto readFile = [&](size_t file, BlockQueue& queue) {
+            if (!writeHandles[file])
+                return false;
+
+            auto readHandle = m_sourceFs.readFile(sourceFiles[file]);
+            if (!readHandle)
+                return false;
+
+            bool succ = true;
+            while (succ)
+            {
+                Block block { file, std::vector<uint8_t>(BlockSize) };
+                block.m_data.resize(m_sourceFs.read(*readHandle, block.m_data.data(), block.m_data.size()));
+                if (block.m_data.empty())
+                    break;
+                succ = queue.push(std::move(block));
+            }
+            m_sourceFs.close(*readHandle);
+            return succ;
+        };
+        return runPipeline(sourceFiles.size(), m_readerThreads, readFile, blockWriter(m_destFs, writeHandles));
+    }
+
     bool copyPhysicalFile(ReadHandle readHandle, WriteHandle writeHandle)
     {
         size_t fsize = m_sourceFs.fileSize(readHandle);
@@ -87,33 +305,246 @@ struct CopyProcessor
 
     size_t copyFolder(Folder sourceFolder, Folder destFolder)
     {
-        constexpr size_t MaxEntries = 64;
         size_t numItems = 0;
         std::vector<TreeEntry> treeEntries;
         treeEntries.reserve(MaxEntries);
 
-        auto sourceCursor = m_sourceFs.begin(Path(sourceFolder, ""));
-        while (sourceCursor)
+        // the cursor stays on the last entry of a chunk while the chunk is copied: next() then finds its
+        // way even if the copy changed the source tree
+        for (auto sourceCursor = m_sourceFs.begin(Path(sourceFolder, "")); sourceCursor;
+             sourceCursor = m_sourceFs.next(sourceCursor))
         {
-            for (size_t i = 0; sourceCursor && i < MaxEntries; sourceCursor = m_sourceFs.next(sourceCursor), i++)
-                treeEntries.emplace_back( sourceCursor.key(), sourceCursor.value() );
+            treeEntries.emplace_back(sourceCursor.key(), sourceCursor.value());
+            if (treeEntries.size() == MaxEntries)
+            {
+                numItems += copyEntries(treeEntries, destFolder);
+                treeEntries.clear();
+            }
+        }
+
+        return numItems + copyEntries(treeEntries, destFolder);
+    }
+};
 
-            assert(treeEntries.size() <= MaxEntries);
-            assert(treeEntries.size() > 0);
+/// Makes the destination tree equal to the source tree. Files are compared by their content hashes, so
+/// neither file is read: equal files stay untouched, files the source only extended get the new bytes
+/// appended and all other files are written anew, stored like the source file and with their hashes.
+struct SyncProcessor
+{
+    FileSystem& m_sourceFs;
+    FileSystem& m_destFs;
+    std::vector<uint8_t> m_buffer;
+    SyncStats m_stats;
 
-            for (const auto& entry: treeEntries)
-                numItems += copyType(entry, destFolder);
+    SyncProcessor(FileSystem& sourceFs, FileSystem& destFs)
+        : m_sourceFs(sourceFs)
+        , m_destFs(destFs)
+        , m_buffer(BlockSize)
+    {
+    }
 
-            sourceCursor = m_sourceFs.find(treeEntries.back().m_key);
+    static bool isAttribute(TreeValue::Type type)
+    {
+        return type != TreeValue::Type::File && type != TreeValue::Type::Folder;
+    }
 
-            if (sourceCursor)
-                sourceCursor = m_sourceFs.next(sourceCursor);
-            else
-                sourceCursor = m_sourceFs.begin(treeEntries.back().m_key);
-            treeEntries.clear();
+    static std::vector<std::pair<std::string, TreeValue>> folderEntries(const FileSystem& fs, Folder folder)
+    {
+        std::vector<std::pair<std::string, TreeValue>> entries;
+        for (auto cursor = fs.begin(Path(folder, "")); cursor; cursor = fs.next(cursor))
+            entries.emplace_back(std::string(cursor.key().m_relativePath), cursor.value());
+        return entries;
+    }
+
+    void syncFolder(Folder sourceFolder, Folder destFolder)
+    {
+        std::map<std::string, TreeValue> destEntries;
+        for (auto& [name, value]: folderEntries(m_destFs, destFolder))
+            destEntries.emplace(std::move(name), std::move(value));
+
+        for (const auto& [name, value]: folderEntries(m_sourceFs, sourceFolder))
+        {
+            std::optional<TreeValue> destValue;
+            if (auto it = destEntries.find(name); it != destEntries.end())
+            {
+                destValue = it->second;
+                destEntries.erase(it);
+            }
+            syncEntry(Path(sourceFolder, name), value, Path(destFolder, name), destValue);
         }
 
-        return numItems;
+        for (const auto& entry: destEntries)
+            m_stats.m_removedItems += m_destFs.remove(Path(destFolder, entry.first));
+    }
+
+    void syncEntry(Path sourcePath, const TreeValue& sourceValue, Path destPath, std::optional<TreeValue> destValue)
+    {
+        auto type = sourceValue.getType();
+        if (destValue && destValue->getType() != type && !(isAttribute(type) && isAttribute(destValue->getType())))
+        {
+            m_stats.m_removedItems += m_destFs.remove(destPath);
+            destValue.reset();
+        }
+
+        switch (type)
+        {
+        case TreeValue::Type::Folder: {
+            auto destFolder = destValue ? destValue->get<Folder>() : m_destFs.makeSubFolder(destPath);
+            m_stats.m_changedItems += !destValue;
+            if (destFolder)
+                syncFolder(sourceValue.get<Folder>(), *destFolder);
+            break;
+        }
+        case TreeValue::Type::File:
+            syncFile(sourcePath, destPath, destValue.has_value());
+            break;
+        default:
+            if (!destValue || !(*destValue == sourceValue))
+                m_stats.m_changedItems += m_destFs.addAttribute(destPath, sourceValue);
+        }
+    }
+
+    void syncFile(Path sourcePath, Path destPath, bool destExists)
+    {
+        auto sourceHashes = m_sourceFs.contentHashes(sourcePath);
+        auto sourceMode = m_sourceFs.fileMode(sourcePath);
+        if (!sourceHashes || !sourceMode)
+            return;
+
+        auto destHashes = destExists ? m_destFs.contentHashes(destPath) : std::nullopt;
+        auto destMode = destExists ? m_destFs.fileMode(destPath) : std::nullopt;
+        bool sameMode = destHashes && destMode && destMode->m_compression == sourceMode->m_compression
+                        && destMode->m_deduplication == sourceMode->m_deduplication;
+        if (sameMode && destHashes->m_size == sourceHashes->m_size && destHashes->m_hash == sourceHashes->m_hash)
+        {
+            m_stats.m_unchangedFiles++;
+            return;
+        }
+
+        auto readHandle = m_sourceFs.readFile(sourcePath);
+        if (!readHandle)
+            return;
+
+        if (sameMode && isPrefix(*destHashes, *sourceHashes, *readHandle))
+        {
+            if (auto writeHandle = m_destFs.appendFile(destPath))
+            {
+                m_sourceFs.seek(*readHandle, destHashes->m_size);
+                copyBytes(*readHandle, *writeHandle, sourceHashes->m_size - destHashes->m_size);
+                m_stats.m_appendedFiles++;
+            }
+        }
+        else if (auto writeHandle = m_destFs.createFile(destPath, sourceMode->m_compression,
+                                                        sourceMode->m_deduplication, Hashing::Content))
+        {
+            m_sourceFs.seek(*readHandle, 0);
+            copyBytes(*readHandle, *writeHandle, sourceHashes->m_size);
+            m_stats.m_writtenFiles++;
+        }
+        m_sourceFs.close(*readHandle);
+    }
+
+    /// Tells if the source starts with the content of the destination. Only a partial last block of the
+    /// destination is hashed again from the source: that takes reading one block.
+    bool isPrefix(const ContentHashes& dest, const ContentHashes& source, ReadHandle readHandle)
+    {
+        if (dest.m_size > source.m_size)
+            return false;
+
+        size_t fullBlocks = size_t(dest.m_size / HashBlockSize);
+        if (!std::equal(dest.m_blocks.begin(), dest.m_blocks.begin() + fullBlocks, source.m_blocks.begin()))
+            return false;
+        if (fullBlocks == dest.m_blocks.size())
+            return true;
+
+        std::vector<uint8_t> lastBlock(size_t(dest.m_size % HashBlockSize));
+        m_sourceFs.seek(readHandle, dest.m_size - lastBlock.size());
+        return m_sourceFs.read(readHandle, lastBlock.data(), lastBlock.size()) == lastBlock.size()
+               && hash64(lastBlock.data(), lastBlock.size()) == dest.m_blocks.back();
+    }
+
+    void copyBytes(ReadHandle readHandle, WriteHandle writeHandle, uint64_t size)
+    {
+        for (uint64_t left = size; left > 0;)
+        {
+            auto readSize = m_sourceFs.read(readHandle, m_buffer.data(), size_t(std::min(left, uint64_t(BlockSize))));
+            if (readSize == 0)
+                break;
+            m_destFs.write(writeHandle, m_buffer.data(), readSize);
+            m_stats.m_bytesWritten += readSize;
+            left -= readSize;
+        }
+        m_destFs.close(writeHandle);
+    }
+};
+
+/// Imports files and folders of the host file system. The host files of a batch are read on reader
+/// threads while the calling thread writes them.
+struct HostImporter
+{
+    FileSystem& m_destFs;
+    unsigned m_readerThreads;
+
+    size_t importFolder(const std::filesystem::path& hostFolder, Folder destFolder)
+    {
+        size_t numItems = 0;
+        std::vector<std::filesystem::path> hostFiles;
+        std::vector<std::string> names;
+        for (const auto& entry: std::filesystem::directory_iterator(hostFolder))
+        {
+            auto name = entry.path().filename().u8string();
+            if (entry.is_directory())
+            {
+                auto folder = m_destFs.makeSubFolder(Path(destFolder, name));
+                numItems += folder ? importFolder(entry.path(), *folder) + 1 : 0;
+            }
+            else if (entry.is_regular_file())
+            {
+                hostFiles.push_back(entry.path());
+                names.push_back(std::move(name));
+                if (hostFiles.size() == MaxEntries)
+                {
+                    numItems += importFiles(hostFiles, names, destFolder);
+                    hostFiles.clear();
+                    names.clear();
+                }
+            }
+        }
+        return numItems + importFiles(hostFiles, names, destFolder);
+    }
+
+    size_t importFiles(const std::vector<std::filesystem::path>& hostFiles, const std::vector<std::string>& names,
+                       Folder destFolder)
+    {
+        std::vector<Path> destFiles;
+        for (const auto& name: names)
+            destFiles.emplace_back(destFolder, name);
+        return importFiles(hostFiles, m_destFs.createFiles(destFiles));
+    }
+
+    size_t importFiles(const std::vector<std::filesystem::path>& hostFiles,
+                       const std::vector<std::optional<WriteHandle>>& writeHandles)
+    {
+        auto readFile = [&](size_t file, BlockQueue& queue) {
+            if (!writeHandles[file])
+                return false;
+
+            std::ifstream in(hostFiles[file], std::ios::binary);
+            if (!in)
+                return false;
+
+            for (;;)
+            {
+                Block block { file, std::vector<uint8_t>(BlockSize) };
+                in.read(reinterpret_cast<char*>(block.m_data.data()), block.m_data.size());
+                block.m_data.resize(size_t(in.gcount()));
+                if (block.m_data.empty())
+                    return !in.bad();
+                if (!queue.push(std::move(block)))
+                    return false;
+            }
+        };
+        return runPipeline(hostFiles.size(), m_readerThreads, readFile, blockWriter(m_destFs, writeHandles));
     }
 };
 }
@@ -157,9 +588,9 @@ public:
 
 ///////////////////////////////////////////////////////////////////////////////
 
-size_t TxFs::copy(FileSystem& sourceFs, Path sourcePath, FileSystem& destFs, Path destPath)
+size_t TxFs::copy(FileSystem& sourceFs, Path sourcePath, FileSystem& destFs, Path destPath, unsigned readerThreads)
 {
-    CopyProcessor cp(sourceFs, destFs);
+    CopyProcessor cp(sourceFs, destFs, readerThreads);
     if (sourcePath == RootPath)
     {
         auto destFolder = destFs.makeSubFolder(destPath);
@@ -179,6 +610,45 @@ size_t TxFs::copy(FileSystem& sourceFs, Path sourcePath, FileSystem& destFs, Pat
     return cp.copyType(sourceCursor, destPath);
 }
 
+size_t TxFs::importHostFiles(const std::filesystem::path& hostPath, FileSystem& destFs, Path destPath,
+                             unsigned readerThreads)
+{
+    HostImporter importer { destFs, std::max(readerThreads, 1U) };
+    if (std::filesystem::is_directory(hostPath))
+    {
+        if (destPath == RootPath)
+            return importer.importFolder(hostPath, Folder::Root);
+
+        auto destFolder = destFs.makeSubFolder(destPath);
+        return destFolder ? importer.importFolder(hostPath, *destFolder) + 1 : 0;
+    }
+
+    if (!std::filesystem::is_regular_file(hostPath) || !destFs.createPath(destPath))
+        return 0;
+    return importer.importFiles({ hostPath }, { destFs.createFile(destPath) });
+}
+
+SyncStats TxFs::sync(FileSystem& sourceFs, Path sourcePath, FileSystem& destFs, Path destPath)
+{
+    SyncProcessor sp(sourceFs, destFs);
+    if (sourcePath == RootPath)
+    {
+        if (auto destFolder = destFs.makeSubFolder(destPath))
+            sp.syncFolder(Folder::Root, *destFolder);
+        return sp.m_stats;
+    }
+
+    auto sourceCursor = sourceFs.find(sourcePath);
+    if (!sourceCursor || !destFs.createPath(destPath))
+        return sp.m_stats;
+
+    PathHolder sourceKey(sourceCursor.key());
+    auto sourceValue = sourceCursor.value();
+    auto destCursor = destFs.find(destPath);
+    sp.syncEntry(sourceKey, sourceValue, destPath, destCursor ? std::optional(destCursor.value()) : std::nullopt);
+    return sp.m_stats;
+}
+
 FolderContents TxFs::retrieveFolderContents(Path path, const FileSystem& fs)
 {
     FolderContents fc;
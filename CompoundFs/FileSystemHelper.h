@@ -3,6 +3,7 @@
 #include "FileSystem.h"
 #include "FileSystemVisitor.h"
 #include "Path.h"
+#include <filesystem>
 #include <string_view>
 #include <string>
 
@@ -15,12 +16,34 @@ using FolderContents = std::vector<std::pair<PathHolder, TreeValue>>;
 
 
 
-size_t copy(FileSystem& sourceFs, Path sourcePath, FileSystem& destFs, Path destPath);
+/// Copies files, folders and attributes. With readerThreads > 0 the files of each folder are read on that
+/// many threads while the calling thread writes them to destFs.
+size_t copy(FileSystem& sourceFs, Path sourcePath, FileSystem& destFs, Path destPath, unsigned readerThreads = 0);
 inline size_t copy(FileSystem& sourceFs, Path sourcePath, Path destPath)
 {
     return copy(sourceFs, sourcePath, sourceFs, destPath);
 }
 
+/// What sync() changed in the destination.
+struct SyncStats
+{
+    size_t m_unchangedFiles = 0;
+    size_t m_appendedFiles = 0; // the destination held the start of the file: only the rest was written
+    size_t m_writtenFiles = 0;  // created or written anew
+    size_t m_changedItems = 0;  // folders created and attributes added or changed
+    size_t m_removedItems = 0;  // items that are not in the source any more
+    uint64_t m_bytesWritten = 0;
+};
+
+/// Makes destPath equal to sourcePath and writes only what differs: files are compared by their content
+/// hashes, unchanged files are left alone and files that grew at the end only get the new bytes appended.
+/// Files without hashes, in either file system, are read once to store them; see FileSystem::contentHashes().
+SyncStats sync(FileSystem& sourceFs, Path sourcePath, FileSystem& destFs, Path destPath);
+
+/// Imports a host file or folder tree to destPath, reading host files on readerThreads threads.
+size_t importHostFiles(const std::filesystem::path& hostPath, FileSystem& destFs, Path destPath,
+                       unsigned readerThreads = 4);
+
 FolderContents retrieveFolderContents(Path path, const FileSystem& fs);
 
 
@@ -1,6 +1,10 @@
 #pragma warning(disable : 4996)
 #include "FileSystemVisitor.h"
 #include <filesystem>
+#include <cstring>
+#include <cerrno>
+#include <stdexcept>
+#include <system_error>
 
 using namespace TxFs;
 using namespace TxFs::Private;
@@ -323,3 +327,202 @@ char* FsCopyVisitor::getLazyMemoryBuffer()
     return m_buffer.get();
 }
 
+
+///////////////////////////////////////////////////////////////////////////////
+
+namespace
+{
+constexpr size_t TarBlockSize = 512;
+
+struct TarHeader
+{
+    char m_name[100];
+    char m_mode[8];
+    char m_uid[8];
+    char m_gid[8];
+    char m_size[12];
+    char m_mtime[12];
+    char m_checksum[8];
+    char m_type;
+    char m_linkName[100];
+    char m_magic[6];
+    char m_version[2];
+    char m_userName[32];
+    char m_groupName[32];
+    char m_devMajor[8];
+    char m_devMinor[8];
+    char m_prefix[155];
+    char m_padding[12];
+};
+static_assert(sizeof(TarHeader) == TarBlockSize);
+
+/// Writes value as N - 1 octal digits and a terminating NUL. Returns false if it does not fit.
+template <size_t N>
+bool toOctal(char (&field)[N], uint64_t value)
+{
+    field[N - 1] = '\0';
+    for (size_t i = N - 1; i > 0; i--, value >>= 3)
+        field[i - 1] = char('0' + (value & 7));
+    return value == 0;
+}
+
+/// Puts name into the name field or, if it is too long, splits it at a '/' into prefix and name.
+bool setName(TarHeader& header, const std::string& name)
+{
+    if (name.size() <= sizeof(header.m_name))
+    {
+        std::memcpy(header.m_name, name.data(), name.size());
+        return true;
+    }
+
+    for (auto pos = name.find('/'); pos != std::string::npos && pos <= sizeof(header.m_prefix);
+         pos = name.find('/', pos + 1))
+    {
+        size_t nameSize = name.size() - pos - 1;
+        if (nameSize > 0 && nameSize <= sizeof(header.m_name))
+        {
+            std::memcpy(header.m_prefix, name.data(), pos);
+            std::memcpy(header.m_name, name.data() + pos + 1, nameSize);
+            return true;
+        }
+    }
+    return false;
+}
+
+/// A pax record is "<length> <key>=<value>\n" where the length counts its own digits too.
+std::string paxRecord(const std::string& key, const std::string& value)
+{
+    std::string record = " " + key + "=" + value + "\n";
+    size_t length = record.size() + 1;
+    while (std::to_string(length).size() + record.size() != length)
+        length = std::to_string(length).size() + record.size();
+    return std::to_string(length) + record;
+}
+
+/// Names and sizes that do not fit are cut: a pax header in front of this one has them in full.
+TarHeader makeHeader(const std::string& name, char type, uint64_t size)
+{
+    TarHeader header {};
+    if (!setName(header, name))
+        setName(header, name.substr(0, sizeof(header.m_name)));
+    if (!toOctal(header.m_size, size))
+        toOctal(header.m_size, 0);
+    toOctal(header.m_mode, type == '5' ? 0755 : 0644);
+    toOctal(header.m_uid, 0);
+    toOctal(header.m_gid, 0);
+    toOctal(header.m_mtime, 0);
+    header.m_type = type;
+    std::memcpy(header.m_magic, "ustar", 6);
+    std::memcpy(header.m_version, "00", 2);
+
+    std::memset(header.m_checksum, ' ', sizeof(header.m_checksum));
+    uint64_t checksum = 0;
+    for (auto c: std::string_view(reinterpret_cast<const char*>(&header), sizeof(header)))
+        checksum += uint8_t(c);
+    char digits[7];
+    toOctal(digits, checksum);
+    std::memcpy(header.m_checksum, digits, sizeof(digits)); // the last byte stays a space
+    return header;
+}
+
+}
+
+VisitorControl FsTarVisitor::operator()(Path path, const TreeValue& value)
+{
+    auto name = currentName(path);
+    switch (value.getType())
+    {
+    case TreeValue::Type::Folder:
+        if (!name.empty())
+        {
+            name += '/';
+            writeHeader(name, '5', 0);
+        }
+        m_stack.push_back({ value.get<Folder>(), name });
+        break;
+    case TreeValue::Type::File:
+        writeFile(path, name);
+        break;
+    default:
+        break;
+    }
+    return VisitorControl::Continue;
+}
+
+std::string FsTarVisitor::currentName(Path path)
+{
+    while (!m_stack.empty() && m_stack.back().m_folder != path.m_parentFolder)
+        m_stack.pop_back();
+    return (m_stack.empty() ? std::string() : m_stack.back().m_name) + std::string(path.m_relativePath);
+}
+
+void FsTarVisitor::writeHeader(const std::string& name, char type, uint64_t size)
+{
+    std::string records;
+    TarHeader probe {};
+    if (!setName(probe, name))
+        records += paxRecord("path", name);
+    if (!toOctal(probe.m_size, size))
+        records += paxRecord("size", std::to_string(size));
+
+    if (!records.empty())
+    {
+        auto paxHeader = makeHeader("PaxHeader", 'x', records.size());
+        write(&paxHeader, sizeof(paxHeader));
+        write(records.data(), records.size());
+        pad(records.size());
+    }
+    auto header = makeHeader(name, type, size);
+    write(&header, sizeof(header));
+}
+
+void FsTarVisitor::writeFile(Path path, const std::string& name)
+{
+    auto handle = m_fs.readFile(path);
+    if (!handle)
+        return;
+
+    uint64_t size = m_fs.fileSize(*handle);
+    writeHeader(name, '0', size);
+    auto data = getLazyMemoryBuffer();
+    for (uint64_t left = size; left > 0;)
+    {
+        auto readSize = m_fs.read(*handle, data, size_t(std::min(left, uint64_t(BufferSize))));
+        if (readSize == 0)
+            throw std::runtime_error("FsTarVisitor: file is shorter than its size");
+        write(data, readSize);
+        left -= readSize;
+    }
+    m_fs.close(*handle);
+    pad(size);
+}
+
+void FsTarVisitor::write(const void* data, size_t size)
+{
+    if (fwrite(data, 1, size, m_file) != size)
+        throw std::system_error(errno, std::generic_category(), "FsTarVisitor");
+}
+
+/// Fills the last block of data that is size bytes long with zeros.
+void FsTarVisitor::pad(uint64_t size)
+{
+    static constexpr char zeros[TarBlockSize] = {};
+    if (size % TarBlockSize)
+        write(zeros, TarBlockSize - size % TarBlockSize);
+}
+
+/// The archive ends with two zero blocks.
+void FsTarVisitor::finish()
+{
+    static constexpr char zeros[2 * TarBlockSize] = {};
+    write(zeros, sizeof(zeros));
+    if (fflush(m_file) != 0)
+        throw std::system_error(errno, std::generic_category(), "FsTarVisitor");
+}
+
+char* FsTarVisitor::getLazyMemoryBuffer()
+{
+    if (!m_buffer)
+        m_buffer = std::make_unique<char[]>(BufferSize);
+    return m_buffer.get();
+}
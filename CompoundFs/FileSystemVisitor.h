@@ -5,6 +5,7 @@
 #include "Path.h"
 #include "SmallBufferStack.h"
 #include "TreeValue.h"
+#include <cstdio>
 #include <vector>
 #include <string>
 #include <string_view>
@@ -118,7 +119,7 @@ private:
     Result m_result;
     SmallBufferStack<SourceDestFolder, 10> m_stack;
     std::unique_ptr<char[]> m_buffer;
-    static constexpr size_t BufferSize = 32 * 4096;
+    static constexpr size_t BufferSize = 32 * PageSize;
 
 public:
     FsCompareVisitor(FileSystem& sourceFs, FileSystem& destFs, Path path)
@@ -203,7 +204,7 @@ namespace Private
         size_t m_bufferSize;
 
     public:
-        explicit TempFileBuffer(size_t bufferSize = 4096);
+        explicit TempFileBuffer(size_t bufferSize = PageSize);
         ~TempFileBuffer();
         void write(Path path, const TreeValue& value);
         std::optional<TreeEntry> startReading();
@@ -268,7 +269,7 @@ private:
     PathHolder m_destPath;
     SmallBufferStack<SourceDestFolder, 10> m_stack;
     std::unique_ptr<char[]> m_buffer;
-    static constexpr size_t BufferSize = 32 * 4096;
+    static constexpr size_t BufferSize = 32 * PageSize;
 
 public:
     FsCopyVisitor(FileSystem& sourceFs, FileSystem& destFs, Path path)
@@ -297,6 +298,55 @@ private:
     char* getLazyMemoryBuffer();
 };
 
+///////////////////////////////////////////////////////////////////////////////
+/// Streams the visited subtree to file as a tar archive in ustar format. Names that do not fit into
+/// a ustar header and huge sizes go to pax extended headers. Entries are named relative to the parent
+/// of the visited path. Attributes have no counterpart in tar and are left out.
+
+class FsTarVisitor
+{
+private:
+    struct FolderName
+    {
+        Folder m_folder;
+        std::string m_name; // with a trailing '/' unless it is the root
+    };
+
+private:
+    FileSystem& m_fs;
+    FILE* m_file;
+    std::vector<FolderName> m_stack;
+    std::unique_ptr<char[]> m_buffer;
+    static constexpr size_t BufferSize = 32 * PageSize;
+
+public:
+    FsTarVisitor(FileSystem& fs, FILE* file)
+        : m_fs(fs)
+        , m_file(file)
+    {
+    }
+
+    VisitorControl operator()(Path path, const TreeValue& value);
+
+    template <typename TIterator = std::nullptr_t>
+    void done(TIterator begin = nullptr, TIterator end = nullptr)
+    {
+        if constexpr (!std::is_null_pointer_v<TIterator>)
+            for (; begin != end; ++begin)
+                operator()(begin->m_key, begin->m_value);
+        finish();
+    }
+
+private:
+    std::string currentName(Path path);
+    void writeHeader(const std::string& name, char type, uint64_t size);
+    void writeFile(Path path, const std::string& name);
+    void write(const void* data, size_t size);
+    void pad(uint64_t size);
+    void finish();
+    char* getLazyMemoryBuffer();
+};
+
 ///////////////////////////////////////////////////////////////////////////////
 
 }
@@ -7,16 +7,24 @@
 #include "Node.h"
 #include "IntervalSequence.h"
 #include <iterator>
+#include <algorithm>
 
 namespace TxFs
 {
+#pragma pack(push)
+#pragma pack(1)
 
 class FileTable final
 {
+public:
+    /// Number of bytes available for the intervals.
+    static constexpr size_t DataSize = PageSize - 2 * sizeof(uint16_t) - sizeof(PageIndex) - sizeof(uint32_t);
+
+private:
     uint16_t m_begin;
     uint16_t m_end;
     PageIndex m_next;
-    uint8_t m_data[4084];
+    uint8_t m_data[DataSize];
 
 public:
     uint32_t m_checkSum;
@@ -28,7 +36,7 @@ public:
         , m_next(PageIdx::INVALID)
     {
         // m_data[0] = 0;
-        static_assert(sizeof(FileTable) == 4096);
+        static_assert(sizeof(FileTable) == PageSize);
     }
 
     constexpr void setNext(PageIndex next) noexcept { m_next = next; }
@@ -39,6 +47,45 @@ public:
         m_end = sizeof(m_data);
     }
 
+#ifdef TXFS_PAGE_INDEX_64
+    /// With 64 bit page indices each interval is stored as a variable-length delta to the end of the
+    /// previous one, followed by its length if it spans more than one page. Files with few or contiguous
+    /// pages thus need a few bytes per interval instead of two full page indices.
+    void transferFrom(IntervalSequence& is) noexcept
+    {
+        clear();
+        PageIndex prevEnd = 0;
+        while (!is.empty())
+        {
+            Interval iv = is.front();
+            uint8_t buffer[2 * MaxVarIntSize];
+            uint8_t* end = encode(iv, prevEnd, buffer);
+            if (size_t(end - buffer) > size_t(m_end - m_begin))
+                break;
+            std::copy(buffer, end, m_data + m_begin);
+            m_begin += uint16_t(end - buffer);
+            prevEnd = iv.end();
+            is.popFront();
+        }
+    }
+
+    void insertInto(IntervalSequence& is) const
+    {
+        PageIndex prevEnd = 0;
+        const uint8_t* it = m_data;
+        while (it < m_data + m_begin)
+        {
+            uint64_t head;
+            it = readVarInt(it, head);
+            PageIndex begin = prevEnd + PageIndex(head & 2 ? ~(head >> 2) : head >> 2);
+            uint64_t length = 1;
+            if (head & 1)
+                it = readVarInt(it, length);
+            prevEnd = begin + length;
+            is.pushBack(Interval(begin, prevEnd));
+        }
+    }
+#else
     void transferFrom(IntervalSequence& is) noexcept
     {
         clear();
@@ -86,10 +133,47 @@ public:
             }
         }
     }
+#endif
 
     constexpr bool empty() const noexcept { return m_begin == 0 && m_end == sizeof(m_data); }
 
 private:
+#ifdef TXFS_PAGE_INDEX_64
+    static constexpr size_t MaxVarIntSize = 10;
+
+    /// The head holds the zigzag encoded delta shifted by one and a flag for a trailing length.
+    static uint8_t* encode(Interval iv, PageIndex prevEnd, uint8_t* out) noexcept
+    {
+        assert(iv.begin() < iv.end());
+        int64_t delta = int64_t(iv.begin() - prevEnd);
+        uint64_t zigzag = (uint64_t(delta) << 1) ^ uint64_t(delta >> 63);
+        out = writeVarInt((zigzag << 1) | (iv.length() > 1 ? 1 : 0), out);
+        if (iv.length() > 1)
+            out = writeVarInt(iv.length(), out);
+        return out;
+    }
+
+    static uint8_t* writeVarInt(uint64_t value, uint8_t* out) noexcept
+    {
+        for (; value >= 0x80; value >>= 7)
+            *out++ = uint8_t(value | 0x80);
+        *out++ = uint8_t(value);
+        return out;
+    }
+
+    static const uint8_t* readVarInt(const uint8_t* in, uint64_t& value) noexcept
+    {
+        value = 0;
+        for (unsigned shift = 0;; shift += 7)
+        {
+            uint8_t byte = *in++;
+            value |= uint64_t(byte & 0x7f) << shift;
+            if (!(byte & 0x80))
+                return in;
+        }
+    }
+#endif
+
     uint16_t* beginTable() const noexcept { return (uint16_t*) (m_data + m_end); }
     uint16_t* endTable() const noexcept { return (uint16_t*) (m_data + sizeof(m_data)); }
     PageIndex* beginIds() const noexcept { return (PageIndex*) m_data; }
@@ -102,6 +186,7 @@ private:
     }
 };
 
+#pragma pack(pop)
 }
 
 #endif // FILETABLE_H
@@ -8,11 +8,33 @@
 #include "TypedCacheManager.h"
 #include "PageDef.h"
 #include "FileInterface.h"
+#include "Compression.h"
 #include <algorithm>
+#include <cstring>
+#include <functional>
+#include <optional>
+#include <vector>
 
 namespace TxFs
 {
 
+enum class Deduplication : uint8_t { Off, Pages };
+
+/// Lets files share pages of equal content. m_find returns a page with the same content as page and counts
+/// the new reference to it; m_add offers a newly written page for sharing.
+struct PageDeduplicator
+{
+    std::function<std::optional<PageIndex>(const uint8_t* page)> m_find;
+    std::function<void(const uint8_t* page, PageIndex index)> m_add;
+};
+
+/// One of several buffers written in one go by FileWriter::write().
+struct ConstBuffer
+{
+    const void* m_data;
+    size_t m_size;
+};
+
 class FileWriter final
 {
 public:
@@ -28,8 +50,44 @@ public:
         m_fileDescriptor = FileDescriptor();
         m_pageSequence = IntervalSequence();
         m_fileTable = ConstPageDef<FileTable>();
+        m_compressed = false;
+        m_uncompressedSize = 0;
+        m_chunkIndex.clear();
+        m_deduplicator = PageDeduplicator();
     }
 
+    /// From now on the writer stores compressed chunks; size() is then the size before compression. For
+    /// appending to a compressed file, uncompressedSize is its current size and chunkIndex its chunk index.
+    void enableCompression(uint64_t uncompressedSize = 0, std::vector<ChunkIndexEntry> chunkIndex = {})
+    {
+        m_compressed = true;
+        m_uncompressedSize = uncompressedSize;
+        m_chunkIndex = std::move(chunkIndex);
+    }
+
+    /// Writes the last chunk and the chunk index of a compressed file and returns the position of the index
+    /// in the stored bytes. Call it right before close(). The index of an appended file lists all chunks: the
+    /// index written before stays in the file and is skipped like that of every close.
+    uint64_t writeChunkIndex()
+    {
+        assert(m_compressed);
+        writeChunk();
+        uint64_t position = storedFileSize();
+        ChunkHeader header { uint32_t(m_chunkIndex.size() * sizeof(ChunkIndexEntry)), 0 };
+        writeStored(reinterpret_cast<const uint8_t*>(&header), reinterpret_cast<const uint8_t*>(&header + 1));
+        if (!m_chunkIndex.empty())
+            writeStored(reinterpret_cast<const uint8_t*>(m_chunkIndex.data()),
+                        reinterpret_cast<const uint8_t*>(m_chunkIndex.data() + m_chunkIndex.size()));
+        return position;
+    }
+
+    bool isCompressed() const { return m_compressed; }
+
+    /// From now on full pages are only written if the deduplicator does not find an equal page.
+    void enableDeduplication(PageDeduplicator deduplicator) { m_deduplicator = std::move(deduplicator); }
+
+    bool isDeduplicated() const { return bool(m_deduplicator.m_find); }
+
     void openAppend(FileDescriptor fileId)
     {
         if (fileId != FileDescriptor())
@@ -44,54 +102,86 @@ public:
 
     FileDescriptor close()
     {
+        writeChunk();
+        if (!m_page.empty())
+            writePages(m_page.data(), m_page.data() + m_page.size());
+        m_page.clear();
         pushFileTable();
         if (m_fileTable.m_page)
             m_fileDescriptor.m_last = m_fileTable.m_index;
         FileDescriptor res = m_fileDescriptor;
         m_fileDescriptor = FileDescriptor();
         m_fileTable = ConstPageDef<FileTable>();
+        m_compressed = false;
+        m_uncompressedSize = 0;
+        m_chunkIndex.clear();
+        m_deduplicator = PageDeduplicator();
         return res;
     }
 
     void write(const uint8_t* begin, const uint8_t* end)
     {
-        const size_t blockSize = end - begin;
-
-        // fill last page at max to page boundary
-        if (m_fileDescriptor.m_fileSize % 4096)
+        if (!m_compressed)
         {
-            size_t pageOffset = size_t(m_fileDescriptor.m_fileSize % 4096);
-            const uint8_t* newEndInPage = begin + std::min(4096 - pageOffset, blockSize);
-            m_cacheManager.getFileInterface()->writePage(m_pageSequence.back().end() - 1, pageOffset, begin,
-                                                            newEndInPage);
-            begin = newEndInPage;
+            writeStored(begin, end);
+            return;
         }
 
-        // write full pages
-        size_t pages = (end - begin) / 4096;
-        while (pages > 0)
+        while (begin != end)
         {
-            Interval iv = m_cacheManager.allocatePageInterval(pages);
-            m_pageSequence.pushBack(iv);
-            m_cacheManager.getFileInterface()->writePages(iv, begin);
-            begin += static_cast<size_t>(iv.length()) * 4096;
-            pages -= iv.length();
+            size_t size = std::min(size_t(end - begin), ChunkSize - m_chunk.size());
+            m_chunk.insert(m_chunk.end(), begin, begin + size);
+            m_uncompressedSize += size;
+            begin += size;
+            if (m_chunk.size() == ChunkSize)
+                writeChunk();
         }
+    }
 
-        // write remaining bytes to partially filled page
-        if (end - begin)
+    /// Writes the buffers one after the other. Bytes that end up in a page together with bytes of other
+    /// buffers are collected first, so that such a page is written once instead of once per buffer.
+    void write(const std::vector<ConstBuffer>& buffers)
+    {
+        if (m_compressed || isDeduplicated())
         {
-            Interval iv = m_cacheManager.allocatePageInterval(1);
-            m_pageSequence.pushBack(iv);
-            m_cacheManager.getFileInterface()->writePage(iv.begin(), 0, begin, end);
+            // these collect chunks or pages in memory anyway
+            for (auto& buffer : buffers)
+            {
+                auto begin = static_cast<const uint8_t*>(buffer.m_data);
+                write(begin, begin + buffer.m_size);
+            }
+            return;
         }
-        m_fileDescriptor.m_fileSize += blockSize;
 
-        if (m_pageSequence.size() >= m_highWaterMark)
+        std::vector<uint8_t> page;
+        for (auto& buffer : buffers)
         {
-            pushFileTable();
-            m_fileTable.m_page->insertInto(m_pageSequence);
+            auto begin = static_cast<const uint8_t*>(buffer.m_data);
+            auto end = begin + buffer.m_size;
+            while (begin != end)
+            {
+                size_t pageLeft = PageSize - size_t((m_fileDescriptor.m_fileSize + page.size()) % PageSize);
+                if (page.empty() && size_t(end - begin) >= pageLeft)
+                {
+                    // the buffer reaches the page boundary by itself: write it up to its last page boundary
+                    auto last = end - (size_t(end - begin) - pageLeft) % PageSize;
+                    writePages(begin, last);
+                    begin = last;
+                    continue;
+                }
+
+                size_t size = std::min(size_t(end - begin), pageLeft);
+                page.insert(page.end(), begin, begin + size);
+                begin += size;
+                if (size == pageLeft)
+                {
+                    writePages(page.data(), page.data() + page.size());
+                    page.clear();
+                }
+            }
         }
+        if (!page.empty())
+            writePages(page.data(), page.data() + page.size());
     }
 
     void pushFileTable()
@@ -125,7 +215,128 @@ public:
         write((uint8_t*) &begin[0], (uint8_t*) &begin[0] + (end - begin));
     }
 
-    uint64_t size() const { return m_fileDescriptor.m_fileSize; }
+    uint64_t size() const { return m_compressed ? m_uncompressedSize : storedFileSize(); }
+
+    /// Adds pages that already hold size bytes of the file, e.g. pages shared with another file. Only the
+    /// last pages of a file may be partially filled.
+    void appendPages(Interval iv, uint64_t size)
+    {
+        assert(m_fileDescriptor.m_fileSize % PageSize == 0 && m_page.empty());
+        m_pageSequence.pushBack(iv);
+        m_fileDescriptor.m_fileSize += size;
+        if (m_pageSequence.size() >= m_highWaterMark)
+        {
+            pushFileTable();
+            m_fileTable.m_page->insertInto(m_pageSequence);
+        }
+    }
+
+private:
+    uint64_t storedFileSize() const { return m_fileDescriptor.m_fileSize + m_page.size(); }
+
+    /// Without deduplication the bytes go straight to pages. Otherwise they are collected in m_page and
+    /// written page by page, after the partially filled last page of an appended file is completed.
+    void writeStored(const uint8_t* begin, const uint8_t* end)
+    {
+        if (!isDeduplicated())
+        {
+            writePages(begin, end);
+            return;
+        }
+
+        if (m_fileDescriptor.m_fileSize % PageSize)
+        {
+            size_t pageOffset = size_t(m_fileDescriptor.m_fileSize % PageSize);
+            auto pageEnd = begin + std::min(PageSize - pageOffset, size_t(end - begin));
+            writePages(begin, pageEnd);
+            begin = pageEnd;
+        }
+
+        while (begin != end)
+        {
+            size_t size = std::min(size_t(end - begin), PageSize - m_page.size());
+            m_page.insert(m_page.end(), begin, begin + size);
+            begin += size;
+            if (m_page.size() == PageSize)
+                writeDeduplicatedPage();
+        }
+    }
+
+    void writeDeduplicatedPage()
+    {
+        auto index = m_deduplicator.m_find(m_page.data());
+        if (!index)
+        {
+            index = m_cacheManager.allocatePageInterval(1).begin();
+            m_cacheManager.getFileInterface()->writePage(*index, 0, m_page.data(), m_page.data() + PageSize);
+            m_deduplicator.m_add(m_page.data(), *index);
+        }
+        m_page.clear();
+        appendPages(Interval(*index), PageSize);
+    }
+
+    void writePages(const uint8_t* begin, const uint8_t* end)
+    {
+        const size_t blockSize = end - begin;
+
+        // fill last page at max to page boundary
+        if (m_fileDescriptor.m_fileSize % PageSize)
+        {
+            size_t pageOffset = size_t(m_fileDescriptor.m_fileSize % PageSize);
+            const uint8_t* newEndInPage = begin + std::min(PageSize - pageOffset, blockSize);
+            m_cacheManager.getFileInterface()->writePage(m_pageSequence.back().end() - 1, pageOffset, begin,
+                                                            newEndInPage);
+            begin = newEndInPage;
+        }
+
+        // write full pages
+        size_t pages = (end - begin) / PageSize;
+        while (pages > 0)
+        {
+            Interval iv = m_cacheManager.allocatePageInterval(pages);
+            m_pageSequence.pushBack(iv);
+            m_cacheManager.getFileInterface()->writePages(iv, begin);
+            begin += static_cast<size_t>(iv.length()) * PageSize;
+            pages -= iv.length();
+        }
+
+        // write remaining bytes to partially filled page
+        if (end - begin)
+        {
+            Interval iv = m_cacheManager.allocatePageInterval(1);
+            m_pageSequence.pushBack(iv);
+            m_cacheManager.getFileInterface()->writePage(iv.begin(), 0, begin, end);
+        }
+        m_fileDescriptor.m_fileSize += blockSize;
+
+        if (m_pageSequence.size() >= m_highWaterMark)
+        {
+            pushFileTable();
+            m_fileTable.m_page->insertInto(m_pageSequence);
+        }
+    }
+
+    /// Writes the buffered chunk compressed, or as it is if that does not make it smaller.
+    void writeChunk()
+    {
+        if (m_chunk.empty())
+            return;
+
+        m_chunkBuffer.resize(sizeof(ChunkHeader) + maxCompressedSize(m_chunk.size()));
+        auto chunkBegin = m_chunkBuffer.data() + sizeof(ChunkHeader);
+        size_t storedSize = compress(m_chunk.data(), m_chunk.data() + m_chunk.size(), chunkBegin);
+        if (storedSize >= m_chunk.size())
+        {
+            storedSize = m_chunk.size();
+            std::copy(m_chunk.begin(), m_chunk.end(), chunkBegin);
+        }
+
+        ChunkHeader header { uint32_t(storedSize), uint32_t(m_chunk.size()) };
+        std::memcpy(m_chunkBuffer.data(), &header, sizeof(header));
+        m_chunkIndex.push_back({ m_uncompressedSize - m_chunk.size(), storedFileSize() });
+        writeStored(m_chunkBuffer.data(), chunkBegin + storedSize);
+        m_chunk.clear();
+    }
 
 private:
     IntervalSequence m_pageSequence;
@@ -133,6 +344,13 @@ private:
     ConstPageDef<FileTable> m_fileTable;
     FileDescriptor m_fileDescriptor;
     size_t m_highWaterMark;
+    bool m_compressed = false;
+    uint64_t m_uncompressedSize = 0;
+    std::vector<uint8_t> m_chunk;
+    std::vector<uint8_t> m_chunkBuffer;
+    std::vector<ChunkIndexEntry> m_chunkIndex;
+    PageDeduplicator m_deduplicator;
+    std::vector<uint8_t> m_page; // collects the next page to deduplicate
 };
 
 //////////////////////////////////////////////////////////////////////////
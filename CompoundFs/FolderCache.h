@@ -0,0 +1,73 @@
+
+
+#pragma once
+
+#include "ByteString.h"
+#include <unordered_map>
+#include <string>
+#include <mutex>
+#include <memory>
+#include <optional>
+
+namespace TxFs
+{
+enum class Folder : uint32_t;
+
+///////////////////////////////////////////////////////////////////////////////
+/// Bounded map from the key of a folder entry (parent folder and name) to the folder, so that paths
+/// resolve without descending the tree for every segment. The owner keeps it correct by erasing or
+/// clearing entries whenever folders are renamed, removed or rolled back. When full, an arbitrary
+/// entry makes room for the new one. Lookups may come from concurrent readers.
+
+class FolderCache final
+{
+public:
+    explicit FolderCache(size_t maxEntries = 4096)
+        : m_maxEntries(maxEntries)
+    {}
+
+    std::optional<Folder> find(ByteStringView key) const
+    {
+        std::scoped_lock lock(*m_mutex);
+        auto it = m_folders.find(toString(key));
+        if (it == m_folders.end())
+            return std::nullopt;
+        return it->second;
+    }
+
+    void insert(ByteStringView key, Folder folder)
+    {
+        std::scoped_lock lock(*m_mutex);
+        if (m_folders.size() >= m_maxEntries)
+            m_folders.erase(m_folders.begin());
+        m_folders.insert_or_assign(toString(key), folder);
+    }
+
+    void erase(ByteStringView key)
+    {
+        std::scoped_lock lock(*m_mutex);
+        m_folders.erase(toString(key));
+    }
+
+    void clear()
+    {
+        std::scoped_lock lock(*m_mutex);
+        m_folders.clear();
+    }
+
+    size_t size() const
+    {
+        std::scoped_lock lock(*m_mutex);
+        return m_folders.size();
+    }
+
+private:
+    static std::string toString(ByteStringView key) { return std::string(key.data(), key.end()); }
+
+private:
+    std::unordered_map<std::string, Folder> m_folders;
+    size_t m_maxEntries;
+    std::unique_ptr<std::mutex> m_mutex = std::make_unique<std::mutex>();
+};
+
+}
@@ -57,26 +57,29 @@ public:
         }
 
         auto iv = m_current.popFront(maxPages);
-        m_currentFileSize -= iv.length() * 4096ULL;
+        m_currentFileSize -= iv.length() * uint64_t(PageSize);
         return iv;
     }
 
     /// Return meta-data-pages to the FreeStore. These pages will be available in the next transaction.
-    void deallocate(uint32_t page) { m_freeMetaDataPages.insert(page); }
-    void deallocateStillInUse(uint32_t page) { m_stillInUsePages.insert(page); }
+    void deallocate(PageIndex page) { m_freeMetaDataPages.insert(page); }
+    void deallocateStillInUse(PageIndex page) { m_stillInUsePages.insert(page); }
 
     /// Defered file deletion. Upon commit-time when close() is called we will add these files to the FreeStore. The
     /// space of these files will be available in the next transaction.
     void deleteFile(FileDescriptor fd)
     {
-        if (fd == FileDescriptor())
+        if (fd == FileDescriptor() || fd.isInline())
             return;
 
         // round up to page size
-        fd.m_fileSize = ((fd.m_fileSize + 4096 - 1) / 4096) * 4096;
+        fd.m_fileSize = ((fd.m_fileSize + PageSize - 1) / PageSize) * PageSize;
         m_filesToDelete.push_back(fd);
     }
 
+    /// Defered deletion of single pages, e.g. of files whose pages are partly shared with other files.
+    void deletePages(Interval iv) { m_pagesToDelete.pushBack(iv); }
+
     FileDescriptor close()
     {
         // if anything was changed establish consistancy before calling finalize()
@@ -178,7 +181,7 @@ private:
 
         auto pageId = is.popFront(1).begin();
         return m_freeMetaDataPages.count(pageId) ? m_cacheManager.repurpose<FileTable>(pageId)
-                                                 : m_cacheManager.asNewPage<FileTable>(pageId);
+                                                 : m_cacheManager.asFreedPage<FileTable>(pageId);
     }
 
     /// Pushes the IntervalSequence back into FileTable pages. If more than one 
@@ -219,11 +222,13 @@ private:
     {
         for (const auto& fd: m_filesToDelete)
             m_fileDescriptor.m_fileSize += fd.m_fileSize;
+        m_fileDescriptor.m_fileSize += m_pagesToDelete.totalLength() * uint64_t(PageSize);
 
         auto is = onePageOptimization();
+        m_pagesToDelete.moveTo(is);
         addRemainingPagesToIntervalSequence(is);
-        m_fileDescriptor.m_fileSize += m_freeMetaDataPages.size() * 4096ULL;
-        m_fileDescriptor.m_fileSize += m_stillInUsePages.size() * 4096ULL;
+        m_fileDescriptor.m_fileSize += m_freeMetaDataPages.size() * uint64_t(PageSize);
+        m_fileDescriptor.m_fileSize += m_stillInUsePages.size() * uint64_t(PageSize);
 
         FileDescriptor cur = pushFileTables(is);
         for (const auto& fd: m_filesToDelete)
@@ -239,8 +244,8 @@ private:
         assert(ft.m_page->getNext() == PageIdx::INVALID);
         m_cacheManager.makePageWritable(ft).m_page->setNext(next.m_first);
 
-        assert(prev.m_fileSize % 4096 == 0);
-        assert(next.m_fileSize % 4096 == 0);
+        assert(prev.m_fileSize % PageSize == 0);
+        assert(next.m_fileSize % PageSize == 0);
 
         prev.m_last = next.m_last;
         return prev;
@@ -251,6 +256,7 @@ private:
     FileDescriptor m_fileDescriptor;            // the FreeStore looks like a file
     uint64_t m_currentFileSize;                 // tracks the space left before close()
     std::vector<FileDescriptor> m_filesToDelete;
+    IntervalSequence m_pagesToDelete;
     std::unordered_set<PageIndex> m_freeMetaDataPages;
     std::unordered_set<PageIndex> m_stillInUsePages;
     IntervalSequence m_current;
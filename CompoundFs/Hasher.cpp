@@ -1,6 +1,8 @@
 
 #include "Hasher.h"
 #include <xxhash.h>
+#include <algorithm>
+#include <assert.h>
 
 
 uint32_t TxFs::hash32(const void* p, size_t size)
@@ -12,3 +14,46 @@ uint64_t TxFs::hash64(const void* p, size_t size)
 {
     return XXH3_64bits(p, size);
 }
+
+/// Continues hashing after the content hashes were computed of. lastBlock holds the bytes of its partial
+/// last block, if any.
+TxFs::ContentHasher::ContentHasher(ContentHashes hashes, std::vector<uint8_t> lastBlock)
+    : m_size(hashes.m_size)
+    , m_blocks(std::move(hashes.m_blocks))
+    , m_block(std::move(lastBlock))
+{
+    assert(m_block.size() == m_size % HashBlockSize);
+    if (!m_block.empty())
+        m_blocks.pop_back();
+}
+
+void TxFs::ContentHasher::update(const uint8_t* begin, const uint8_t* end)
+{
+    m_size += end - begin;
+    if (!m_block.empty())
+    {
+        size_t size = std::min(size_t(end - begin), HashBlockSize - m_block.size());
+        m_block.insert(m_block.end(), begin, begin + size);
+        begin += size;
+        if (m_block.size() < HashBlockSize)
+            return;
+        m_blocks.push_back(hash64(m_block.data(), m_block.size()));
+        m_block.clear();
+    }
+
+    // full blocks are hashed in place
+    for (; size_t(end - begin) >= HashBlockSize; begin += HashBlockSize)
+        m_blocks.push_back(hash64(begin, HashBlockSize));
+    m_block.assign(begin, end);
+}
+
+TxFs::ContentHashes TxFs::ContentHasher::hashes() const
+{
+    ContentHashes hashes { m_size, 0, m_blocks };
+    if (!m_block.empty())
+        hashes.m_blocks.push_back(hash64(m_block.data(), m_block.size()));
+    hashes.m_hash = hashes.m_blocks.size() == 1
+                        ? hashes.m_blocks.front()
+                        : hash64(hashes.m_blocks.data(), hashes.m_blocks.size() * sizeof(uint64_t));
+    return hashes;
+}
@@ -3,6 +3,7 @@
 
 #include <stdint.h>
 #include <stddef.h>
+#include <vector>
 
 
 namespace TxFs
@@ -11,6 +12,36 @@ namespace TxFs
 uint32_t hash32(const void* p, size_t size);
 uint64_t hash64(const void* p, size_t size);
 
+/// Files are hashed in blocks of this size, the size of the chunks of compressed files.
+constexpr size_t HashBlockSize = 64 * 1024;
+
+/// Hashes of the content of a file: one per block, the last of which may be partial, and one of the whole
+/// content. That is the hash of the only block or the hash of the hashes of all blocks.
+struct ContentHashes
+{
+    uint64_t m_size = 0;
+    uint64_t m_hash = 0;
+    std::vector<uint64_t> m_blocks;
+};
+
+/// Tells FileSystem::createFile() to store the ContentHashes of a file with it, see FileSystem::contentHashes().
+enum class Hashing : uint8_t { Off, Content };
+
+/// Computes the ContentHashes of content given in pieces of any size.
+class ContentHasher
+{
+public:
+    ContentHasher() = default;
+    ContentHasher(ContentHashes hashes, std::vector<uint8_t> lastBlock);
+
+    void update(const uint8_t* begin, const uint8_t* end);
+    ContentHashes hashes() const;
+
+private:
+    uint64_t m_size = 0;
+    std::vector<uint64_t> m_blocks; // of the full blocks
+    std::vector<uint8_t> m_block;   // the bytes after the full blocks
+};
 
 }
 
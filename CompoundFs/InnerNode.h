@@ -5,61 +5,119 @@
 #define INNERNODE_H
 
 #include <algorithm>
+#include <vector>
+#include <iterator>
 #include <assert.h>
 
 #include "Node.h"
 #include "ByteString.h"
 #include "TableKeyCompare.h"
+#include "SlotTable.h"
 
 namespace TxFs
 {
+/// A separator key with the page to its right and the number of leaf entries below that page, used
+/// to rebuild an InnerNode.
+struct InnerNodeEntry
+{
+    ByteString m_key;
+    PageIndex m_page;
+    uint64_t m_count = 0;
+};
+
 #pragma pack(push)
 #pragma pack(1)
 
+/// Separator keys with the page to their right. As in the Leaf, m_data starts with a prefix shared
+/// by all keys and each entry only stores the remainder of its key. Every page is stored with the
+/// number of leaf entries in its subtree, so that entries can be counted and accessed by position.
 class InnerNode final : public Node
 {
-    uint8_t m_data[4083];
+    uint8_t m_data[PageSize - sizeof(Node) - sizeof(PageIndex) - sizeof(uint64_t) - sizeof(uint32_t)];
     PageIndex m_leftMost;
+    uint64_t m_leftMostCount;
 
 public:
     uint32_t m_checkSum;
 
+    using Entry = InnerNodeEntry;
+
 public:
     InnerNode() noexcept
-        : Node(0, sizeof(m_data), NodeType::Inner)
+        : Node(1, sizeof(m_data), NodeType::Inner)
         , m_leftMost(PageIdx::INVALID)
+        , m_leftMostCount(0)
     {
-        m_data[0] = 0;
-        static_assert(sizeof(InnerNode) == 4096);
+        m_data[0] = 0; // empty prefix
+        static_assert(sizeof(InnerNode) == PageSize);
     }
 
-    InnerNode(ByteStringView key, PageIndex left, PageIndex right) noexcept
-        : Node(0, sizeof(m_data), NodeType::Inner)
+    InnerNode(ByteStringView key, PageIndex left, PageIndex right, uint64_t leftCount = 0,
+              uint64_t rightCount = 0) noexcept
+        : Node(1, sizeof(m_data), NodeType::Inner)
     {
-        auto end = toStream(key, m_data);
+        m_data[0] = 0;
+        auto end = toStream(key, m_data + m_begin);
         m_leftMost = left;
+        m_leftMostCount = leftCount;
         end = setPageId(end, right);
-        m_end -= sizeof(uint16_t);
+        end = setChildCount(end, rightCount);
+        m_end -= SlotTable::SlotSize;
         *beginTable() = m_begin;
+        slotTable().setHead(0, SlotTable::keyHead(key));
         m_begin = toIndex(end);
     }
 
-    constexpr bool empty() const noexcept { return m_begin == 0; }
-    constexpr size_t nofItems() const noexcept { return (sizeof(m_data) - m_end) / sizeof(uint16_t); }
+    constexpr bool empty() const noexcept { return nofItems() == 0; }
+    static constexpr size_t capacity() noexcept { return sizeof(m_data); }
+    constexpr size_t nofItems() const noexcept { return (sizeof(m_data) - m_end) / SlotTable::SlotSize; }
     constexpr size_t size() const noexcept { return sizeof(m_data) - bytesLeft(); }
     uint16_t toIndex(const uint8_t* pos) const { return static_cast<uint16_t>(pos - m_data); }
 
- 
+
     constexpr size_t bytesLeft() const noexcept
     {
         assert(m_end >= m_begin);
         return m_end - m_begin;
     }
 
-    constexpr bool hasSpace(ByteStringView key) const noexcept
+    /// Size of an entry without prefix compression.
+    static constexpr size_t entrySize(ByteStringView key) noexcept
     {
-        size_t size = key.size() + 1 + sizeof(PageIndex) + sizeof(uint16_t);
-        return size <= bytesLeft();
+        return key.size() + 1 + ChildSize + SlotTable::SlotSize;
+    }
+
+    /// Size of a node holding nofItems keys with keyBytes bytes and a common prefix.
+    static constexpr size_t packedSize(size_t nofItems, size_t keyBytes, size_t prefixSize) noexcept
+    {
+        return 1 + prefixSize + nofItems * (1 + ChildSize + SlotTable::SlotSize) + keyBytes
+               - nofItems * prefixSize;
+    }
+
+    static size_t packedSize(const Entry* begin, const Entry* end) noexcept
+    {
+        if (begin == end)
+            return packedSize(0, 0, 0);
+
+        size_t keyBytes = 0;
+        for (auto it = begin; it < end; ++it)
+            keyBytes += it->m_key.size();
+        return packedSize(end - begin, keyBytes, commonPrefixSize(begin->m_key, (end - 1)->m_key));
+    }
+
+    /// Bytes needed to insert the key, including the cost of shrinking the prefix.
+    size_t requiredSpace(ByteStringView key) const noexcept
+    {
+        auto prefix = getPrefix();
+        size_t common = commonPrefixSize(prefix, key);
+        size_t shrink = prefix.size() - common;
+        size_t grow = entrySize(key) - common + shrink * nofItems();
+        return grow > shrink ? grow - shrink : 0;
+    }
+
+    bool hasSpace(ByteStringView key) const noexcept
+    {
+        return requiredSpace(key) <= bytesLeft();
     }
 
     uint16_t* beginTable() const noexcept
@@ -68,14 +126,18 @@ public:
         return (uint16_t*) &m_data[m_end];
     }
 
-    uint16_t* endTable() const noexcept { return (uint16_t*) (m_data + sizeof(m_data)); }
+    uint16_t* endTable() const noexcept { return beginTable() + nofItems(); }
 
-    ByteStringView getKey(const uint16_t* it) const noexcept
+    ByteStringView getPrefix() const noexcept { return ByteStringView::fromStream(m_data); }
+
+    ByteStringView getSuffix(const uint16_t* it) const noexcept
     {
         assert(it != endTable());
         return ByteStringView::fromStream(m_data + *it);
     }
 
+    ByteString getKey(const uint16_t* it) const noexcept { return ByteString(getPrefix(), getSuffix(it)); }
+
     PageIndex getLeft(const uint16_t* it) const noexcept
     {
         if (it == beginTable())
@@ -86,28 +148,122 @@ public:
     PageIndex getRight(const uint16_t* it) const noexcept
     {
         assert(it != endTable());
-        return getPageId(getKey(it).end());
+        return getPageId(getSuffix(it).end());
+    }
+
+    uint64_t getLeftCount(const uint16_t* it) const noexcept
+    {
+        if (it == beginTable())
+            return m_leftMostCount;
+        return getRightCount(it - 1);
+    }
+
+    uint64_t getRightCount(const uint16_t* it) const noexcept
+    {
+        assert(it != endTable());
+        return getChildCount(getSuffix(it).end() + sizeof(PageIndex));
+    }
+
+    /// Number of leaf entries below this node.
+    uint64_t totalCount() const noexcept
+    {
+        uint64_t count = m_leftMostCount;
+        for (auto it = beginTable(); it < endTable(); ++it)
+            count += getRightCount(it);
+        return count;
+    }
+
+    /// Number of leaf entries in the subtrees left of the page findPage(key) returns.
+    uint64_t countBefore(ByteStringView key) const noexcept
+    {
+        auto entry = findEntry(key);
+        if (!entry)
+            return 0;
+        uint64_t count = m_leftMostCount;
+        for (auto it = beginTable(); it < entry; ++it)
+            count += getRightCount(it);
+        return count;
+    }
+
+    /// Page whose subtree holds the entry at position index; index becomes the position within it.
+    PageIndex findPosition(uint64_t& index) const noexcept
+    {
+        if (index < m_leftMostCount)
+            return m_leftMost;
+        index -= m_leftMostCount;
+        for (auto it = beginTable(); it < endTable(); ++it)
+        {
+            auto count = getRightCount(it);
+            if (index < count || it + 1 == endTable())
+                return getRight(it);
+            index -= count;
+        }
+        return m_leftMost;
+    }
+
+    /// Sets the count of the given child page.
+    void setCount(PageIndex page, uint64_t count) noexcept
+    {
+        if (m_leftMost == page)
+        {
+            m_leftMostCount = count;
+            return;
+        }
+        for (auto it = beginTable(); it < endTable(); ++it)
+            if (getRight(it) == page)
+            {
+                setChildCount(const_cast<uint8_t*>(getSuffix(it).end()) + sizeof(PageIndex), count);
+                return;
+            }
+        assert(false);
+    }
+
+    /// Adds delta to the count of the page findPage(key) returns.
+    void addCount(ByteStringView key, int64_t delta) noexcept
+    {
+        auto entry = findEntry(key);
+        if (!entry)
+        {
+            m_leftMostCount += delta;
+            return;
+        }
+        auto pos = const_cast<uint8_t*>(getSuffix(entry).end()) + sizeof(PageIndex);
+        setChildCount(pos, getChildCount(pos) + delta);
     }
 
     uint16_t* lowerBound(ByteStringView key) const noexcept
     {
-        TableKeyCompare keyCmp(m_data);
-        return std::lower_bound(beginTable(), endTable(), key, keyCmp);
+        auto prefix = getPrefix();
+        int cmp = comparePrefix(prefix, key);
+        if (cmp != 0)
+            return cmp < 0 ? beginTable() : endTable();
+
+        return beginTable() + slotTable().lowerBound(m_data, key.substr(prefix.size()));
     }
 
-    void insert(ByteStringView key, PageIndex right) noexcept
+    void insert(ByteStringView key, PageIndex right, uint64_t count = 0) noexcept
     {
         assert(hasSpace(key));
 
+        auto prefix = getPrefix();
+        size_t common = commonPrefixSize(prefix, key);
+        if (common < prefix.size())
+        {
+            const InnerNode tmp = *this;
+            auto entries = tmp.getEntries();
+            assign(tmp.leftMost(), entries.data(), entries.data() + entries.size(), tmp.getPrefix().substr(0, common));
+        }
+
         uint16_t begin = m_begin;
-        auto end = toStream(key, m_data + m_begin);
+        auto suffix = key.substr(common);
+        auto end = toStream(suffix, m_data + m_begin);
         end = setPageId(end, right);
+        end = setChildCount(end, count);
         m_begin = toIndex(end);
 
         uint16_t* it = lowerBound(key);
-        std::copy(beginTable(), it, beginTable() - 1);
-        *(it - 1) = begin;
-        m_end -= sizeof(uint16_t);
+        slotTable().insert(it - beginTable(), begin, SlotTable::keyHead(suffix));
+        m_end -= SlotTable::SlotSize;
     }
 
     uint16_t* findKey(ByteStringView key) const noexcept
@@ -124,7 +280,7 @@ public:
         uint16_t* it = lowerBound(key);
         if (it == endTable())
             return getLeft(it);
-        if (getKey(it) == key)
+        if (isKey(it, key))
             return getRight(it);
         return getLeft(it);
     }
@@ -139,11 +295,15 @@ public:
             --it;
         else
         {
-            if (getKey(it) != key)
+            if (!isKey(it, key))
             {
                 // must be the left PageId
                 if (it == beginTable())
-                    m_leftMost = getRight(it); // there is no element before
+                {
+                    // there is no element before
+                    m_leftMost = getRight(it);
+                    m_leftMostCount = getRightCount(it);
+                }
                 else
                     --it;
             }
@@ -152,14 +312,13 @@ public:
 
         uint16_t index = *it;
         // copy what comes after to this place
-        const uint8_t* end = getKey(it).end() + sizeof(PageIndex);
+        const uint8_t* end = getSuffix(it).end() + ChildSize;
         uint16_t size = toIndex(end) - *it;
         std::copy(end, (const uint8_t*) m_data + m_begin, m_data + *it);
         m_begin -= size;
 
-        // copy what comes before to this place
-        std::copy(beginTable(), it, beginTable() + 1);
-        m_end += sizeof(uint16_t);
+        slotTable().remove(it - beginTable());
+        m_end += SlotTable::SlotSize;
 
         // adjust indices of entries that came after
         for (it = beginTable(); it < endTable(); ++it)
@@ -173,109 +332,166 @@ public:
         const InnerNode tmp = *this;
         const uint16_t* const it = tmp.findSplitPoint(m_begin / 2U);
         assert(it != tmp.endTable());
-        fill(tmp, tmp.beginTable(), it);
-        rightNode->fill(tmp, it + 1, tmp.endTable());
-        ByteString middleKey = ByteStringView::fromStream(tmp.m_data + *it);
-        return middleKey;
+        auto entries = tmp.getEntries();
+        return assignAround(tmp.leftMost(), entries, it - tmp.beginTable(), *this, *rightNode);
     }
 
     // returns middle key
-    ByteString split(InnerNode* rightNode, ByteStringView key, PageIndex page) noexcept
+    ByteString split(InnerNode* rightNode, ByteStringView key, PageIndex page, uint64_t count = 0) noexcept
     {
+        const InnerNode tmp = *this;
         auto keyMiddle = split(rightNode);
 
-        if (key < keyMiddle)
-            insert(key, page);
-        else
-            rightNode->insert(key, page);
+        InnerNode* target = key < keyMiddle ? this : rightNode;
+        if (target->hasSpace(key))
+        {
+            target->insert(key, page, count);
+            return keyMiddle;
+        }
+
+        // the key lies outside of the node's range and would shrink the prefix too much: keep it apart
+        auto entries = tmp.getEntries();
+        if (key < entries.front().m_key)
+        {
+            entries.insert(entries.begin(), { key, page, count });
+            return assignAround(tmp.leftMost(), entries, 1, *this, *rightNode);
+        }
 
-        return keyMiddle;
+        assert(entries.back().m_key < key);
+        entries.push_back({ key, page, count });
+        return assignAround(tmp.leftMost(), entries, entries.size() - 2, *this, *rightNode);
     }
 
     static ByteString redistribute(InnerNode& left, InnerNode& right, ByteStringView parentKey) noexcept
     {
+        auto entries = left.getEntries();
+        size_t boundary = entries.size();
+        entries.push_back({ parentKey, right.m_leftMost, right.m_leftMostCount });
+        auto rightEntries = right.getEntries();
+        std::move(rightEntries.begin(), rightEntries.end(), std::back_inserter(entries));
+
+        size_t middle;
         if (left.size() < right.size())
         {
-            const InnerNode tmp = right;
             size_t splitPoint = (right.m_begin - left.m_begin) / 2;
-            const uint16_t* const sp = tmp.findSplitPoint(splitPoint);
-            assert(sp != tmp.endTable());
-            left.insert(parentKey, right.m_leftMost);
-            left.copyToBack(tmp, tmp.beginTable(), sp);
-            right.reset();
-            right.copyToFront(tmp, sp + 1, tmp.endTable());
-            return tmp.getKey(sp);
+            const uint16_t* const sp = right.findSplitPoint(splitPoint);
+            assert(sp != right.endTable());
+            middle = boundary + 1 + (sp - right.beginTable());
         }
         else
         {
-            const InnerNode tmp = left;
             size_t splitPoint = left.m_begin - size_t(left.m_begin - right.m_begin) / 2;
-            const uint16_t* const sp = tmp.findSplitPoint(splitPoint);
-            assert(sp != tmp.endTable());
-            left.reset();
-            left.copyToFront(tmp, tmp.beginTable(), sp);
-            right.insert(parentKey, right.m_leftMost);
-            right.copyToFront(tmp, sp + 1, tmp.endTable());
-            return tmp.getKey(sp);
+            const uint16_t* const sp = left.findSplitPoint(splitPoint);
+            assert(sp != left.endTable());
+            middle = sp - left.beginTable();
+        }
+
+        // moved keys may lose their prefix: move fewer of them until both sides fit
+        auto fits = [&](size_t middle) {
+            return packedSize(entries.data(), entries.data() + middle) <= capacity()
+                   && packedSize(entries.data() + middle + 1, entries.data() + entries.size()) <= capacity();
+        };
+        while (middle != boundary && !fits(middle))
+        {
+            if (middle < boundary)
+                middle++;
+            else
+                middle--;
         }
+
+        return assignAround(left.leftMost(), entries, middle, left, right);
     }
 
     constexpr void reset() noexcept
     {
-        m_begin = 0;
+        m_data[0] = 0;
+        m_begin = 1;
         m_end = sizeof(m_data);
         m_leftMost = PageIdx::INVALID;
+        m_leftMostCount = 0;
     }
 
     void copyToFront(const InnerNode& from, const uint16_t* begin, const uint16_t* end) noexcept
     {
-        size_t idxSize = end - begin;
-        auto idx = beginTable() - idxSize;
-        auto data = m_data + m_begin;
-        for (auto it = begin; it < end; ++it)
-        {
-            *idx = static_cast<uint16_t>(data - m_data);
-            auto xend = from.getKey(it).end() + sizeof(PageIndex);
-            data = std::copy(from.m_data + *it, xend, data);
-            idx++;
-        }
-        assert(idx == beginTable());
-        m_begin = static_cast<uint16_t>(data - m_data);
-        m_end -= static_cast<uint16_t>(idxSize * sizeof(uint16_t));
-        assert(m_begin <= m_end);
-        m_leftMost = from.getLeft(begin);
+        auto entries = from.getEntries(begin, end);
+        auto ownEntries = getEntries();
+        std::move(ownEntries.begin(), ownEntries.end(), std::back_inserter(entries));
+        assign({ ByteString(), from.getLeft(begin), from.getLeftCount(begin) }, entries.data(),
+               entries.data() + entries.size());
     }
 
     void copyToBack(const InnerNode& from, const uint16_t* begin, const uint16_t* end) noexcept
     {
-        size_t idxSize = end - begin;
-        auto idx = std::copy(beginTable(), endTable(), beginTable() - idxSize);
-        auto data = m_data + m_begin;
-        for (auto it = begin; it < end; ++it)
-        {
-            *idx = static_cast<uint16_t>(data - m_data);
-            auto xend = from.getKey(it).end() + sizeof(PageIndex);
-            data = std::copy(from.m_data + *it, xend, data);
-            idx++;
-        }
-        assert(idx == endTable());
-        m_begin = static_cast<uint16_t>(data - m_data);
-        m_end -= static_cast<uint16_t>(idxSize * sizeof(uint16_t));
-        assert(m_begin <= m_end);
+        auto entries = getEntries();
+        auto fromEntries = from.getEntries(begin, end);
+        std::move(fromEntries.begin(), fromEntries.end(), std::back_inserter(entries));
+        assign(leftMost(), entries.data(), entries.data() + entries.size());
     }
 
-    bool canMergeWith(const InnerNode& right, ByteStringView parentKey) noexcept
+    bool canMergeWith(const InnerNode& right, ByteStringView parentKey) const noexcept
     {
-        return bytesLeft() >= (right.size() + parentKey.size() + sizeof(PageIndex) + sizeof(uint16_t));
+        auto first = empty() ? ByteString(parentKey) : getKey(beginTable());
+        auto last = right.empty() ? ByteString(parentKey) : right.getKey(right.endTable() - 1);
+        size_t nofMergedItems = nofItems() + 1 + right.nofItems();
+        size_t keyBytes = this->keyBytes() + parentKey.size() + right.keyBytes();
+        return packedSize(nofMergedItems, keyBytes, commonPrefixSize(first, last)) <= capacity();
     }
 
     void mergeWith(const InnerNode& right, ByteStringView parentKey) noexcept
     {
-        insert(parentKey, right.m_leftMost);
-        copyToBack(right, right.beginTable(), right.endTable());
+        auto entries = getEntries();
+        entries.push_back({ parentKey, right.m_leftMost, right.m_leftMostCount });
+        auto rightEntries = right.getEntries();
+        std::move(rightEntries.begin(), rightEntries.end(), std::back_inserter(entries));
+        assign(leftMost(), entries.data(), entries.data() + entries.size());
+    }
+
+    /// Recomputes the longest prefix common to all keys.
+    void compact() noexcept
+    {
+        auto entries = getEntries();
+        assign(leftMost(), entries.data(), entries.data() + entries.size());
+    }
+
+    /// Rebuilds the node from sorted entries. Only the page and count of leftMost are used.
+    void assign(const Entry& leftMost, const Entry* begin, const Entry* end) noexcept
+    {
+        if (begin == end)
+            assign(leftMost, begin, end, ByteStringView());
+        else
+        {
+            ByteStringView first = begin->m_key;
+            assign(leftMost, begin, end, first.substr(0, commonPrefixSize(first, (end - 1)->m_key)));
+        }
+    }
+
+    std::vector<Entry> getEntries() const noexcept { return getEntries(beginTable(), endTable()); }
+
+    std::vector<Entry> getEntries(const uint16_t* begin, const uint16_t* end) const noexcept
+    {
+        std::vector<Entry> entries;
+        entries.reserve(end - begin);
+        for (auto it = begin; it < end; ++it)
+            entries.push_back({ getKey(it), getRight(it), getRightCount(it) });
+        return entries;
     }
 
 private:
+    static constexpr size_t ChildSize = sizeof(PageIndex) + sizeof(uint64_t);
+
+    SlotTable slotTable() const noexcept { return SlotTable(const_cast<uint8_t*>(m_data) + m_end, nofItems()); }
+
+    Entry leftMost() const { return { ByteString(), m_leftMost, m_leftMostCount }; }
+
+    /// The entry whose right page findPage(key) returns, or nullptr for the leftmost page.
+    const uint16_t* findEntry(ByteStringView key) const noexcept
+    {
+        uint16_t* it = lowerBound(key);
+        if (it != endTable() && isKey(it, key))
+            return it;
+        return it == beginTable() ? nullptr : it - 1;
+    }
+
     PageIndex getPageId(const uint8_t* src) const noexcept
     {
         PageIndex res;
@@ -290,12 +506,40 @@ private:
         return std::copy(src, src + sizeof(PageIndex), dest);
     }
 
+    uint64_t getChildCount(const uint8_t* src) const noexcept
+    {
+        uint64_t res;
+        uint8_t* dest = (uint8_t*) &res;
+        std::copy(src, src + sizeof(uint64_t), dest);
+        return res;
+    }
+
+    uint8_t* setChildCount(uint8_t* dest, uint64_t count) noexcept
+    {
+        const uint8_t* src = (uint8_t*) &count;
+        return std::copy(src, src + sizeof(uint64_t), dest);
+    }
+
+    bool isKey(const uint16_t* it, ByteStringView key) const noexcept
+    {
+        auto prefix = getPrefix();
+        return comparePrefix(prefix, key) == 0 && getSuffix(it) == key.substr(prefix.size());
+    }
+
+    size_t keyBytes() const noexcept
+    {
+        size_t bytes = nofItems() * getPrefix().size();
+        for (auto it = beginTable(); it < endTable(); ++it)
+            bytes += getSuffix(it).size();
+        return bytes;
+    }
+
     const uint16_t* findSplitPoint(size_t splitPoint) const noexcept
     {
         size_t size = 0;
         for (uint16_t* it = beginTable(); it < endTable(); ++it)
         {
-            size += (toIndex(getKey(it).end()) + sizeof(PageIndex)) - *it;
+            size += (toIndex(getSuffix(it).end()) + ChildSize) - *it;
             if (size > splitPoint)
                 return it;
         }
@@ -303,10 +547,39 @@ private:
         return endTable();
     }
 
-    void fill(const InnerNode& node, const uint16_t* begin, const uint16_t* end) noexcept
+    void assign(const Entry& leftMost, const Entry* begin, const Entry* end, ByteStringView prefix) noexcept
     {
         reset();
-        copyToFront(node, begin, end);
+        m_leftMost = leftMost.m_page;
+        m_leftMostCount = leftMost.m_count;
+        m_begin = toIndex(toStream(prefix, m_data));
+        m_end = uint16_t(sizeof(m_data) - SlotTable::SlotSize * (end - begin));
+        uint16_t* destTable = beginTable();
+        auto slots = slotTable();
+        for (auto it = begin; it < end; ++it)
+        {
+            ByteStringView key = it->m_key;
+            assert(commonPrefixSize(prefix, key) == prefix.size());
+            auto suffix = key.substr(prefix.size());
+            slots.setHead(destTable - beginTable(), SlotTable::keyHead(suffix));
+            auto xend = toStream(suffix, m_data + m_begin);
+            xend = setPageId(xend, it->m_page);
+            xend = setChildCount(xend, it->m_count);
+            *destTable++ = m_begin;
+            m_begin = toIndex(xend);
+        }
+        assert(m_begin <= m_end);
+    }
+
+    /// Splits the entries at middle: the entries before it go to left, the ones after it to right.
+    static ByteString assignAround(const Entry& leftMost, const std::vector<Entry>& entries, size_t middle,
+                                   InnerNode& left, InnerNode& right) noexcept
+    {
+        assert(middle < entries.size());
+        auto data = entries.data();
+        left.assign(leftMost, data, data + middle);
+        right.assign(entries[middle], data + middle + 1, data + entries.size());
+        return entries[middle].m_key;
     }
 };
 
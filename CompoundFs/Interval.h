@@ -35,7 +35,7 @@ public:
         return m_begin == rhs.m_begin ? m_end < rhs.m_end : m_begin < rhs.m_begin;
     }
 
-    constexpr uint32_t length() const noexcept { return m_end - m_begin; }
+    constexpr PageIndex length() const noexcept { return m_end - m_begin; }
     constexpr bool empty() const noexcept { return length() == 0; }
     constexpr PageIndex begin() const noexcept { return m_begin; }
     constexpr PageIndex end() const noexcept { return m_end; }
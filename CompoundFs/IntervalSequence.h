@@ -71,7 +71,7 @@ public:
         assert(!empty());
         PageIndex id = m_intervals.front().begin();
 
-        PageIndex size = std::min(maxSize, m_intervals.front().length());
+        PageIndex size = std::min<PageIndex>(maxSize, m_intervals.front().length());
         m_intervals.front().begin() += size;
         if (m_intervals.front().empty())
             m_intervals.pop_front();
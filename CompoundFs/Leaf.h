@@ -10,15 +10,19 @@
 #include "Node.h"
 #include "ByteString.h"
 #include "TableKeyCompare.h"
+#include "SlotTable.h"
 
 namespace TxFs
 {
 #pragma pack(push)
 #pragma pack(1)
 
+/// Sorted key/value pairs. m_data starts with a prefix shared by all keys, so that each entry only
+/// stores the remainder of its key. The prefix shrinks on insert if needed and is recomputed when the
+/// leaf is split or compacted.
 class Leaf final : public Node
 {
-    uint8_t m_data[4079];
+    uint8_t m_data[PageSize - sizeof(Node) - 2 * sizeof(PageIndex) - sizeof(uint32_t)];
     PageIndex m_prev;
     PageIndex m_next;
 
@@ -27,21 +31,22 @@ public:
 
 public:
     Leaf(PageIndex prev = PageIdx::INVALID, PageIndex next = PageIdx::INVALID) noexcept
-        : Node(0, sizeof(m_data), NodeType::Leaf)
+        : Node(1, sizeof(m_data), NodeType::Leaf)
         , m_prev(prev)
         , m_next(next)
     {
-        m_data[0] = 0; // make the compiler happy
-        static_assert(sizeof(Leaf) == 4096);
+        m_data[0] = 0; // empty prefix
+        static_assert(sizeof(Leaf) == PageSize);
     }
 
     constexpr PageIndex getNext() const noexcept { return m_next; }
     constexpr void setNext(PageIndex next) noexcept { m_next = next; }
     constexpr PageIndex getPrev() const noexcept { return m_prev; }
     constexpr void setPrev(PageIndex prev) noexcept { m_prev = prev; }
-    constexpr bool empty() const noexcept { return m_begin == 0; }
+    constexpr bool empty() const noexcept { return nofItems() == 0; }
+    static constexpr size_t capacity() noexcept { return sizeof(m_data); }
 
-    constexpr size_t nofItems() const noexcept { return (sizeof(m_data) - m_end) / sizeof(uint16_t); }
+    constexpr size_t nofItems() const noexcept { return (sizeof(m_data) - m_end) / SlotTable::SlotSize; }
 
     constexpr size_t bytesLeft() const noexcept
     {
@@ -49,10 +54,31 @@ public:
         return m_end - m_begin;
     }
 
-    constexpr bool hasSpace(ByteStringView key, ByteStringView value) const noexcept
+    /// Size of an entry without prefix compression.
+    static constexpr size_t entrySize(ByteStringView key, ByteStringView value) noexcept
     {
-        size_t size = sizeof(uint16_t) + key.size() + value.size() + 2;
-        return size <= bytesLeft();
+        return SlotTable::SlotSize + key.size() + value.size() + 2;
+    }
+
+    /// Size of a leaf holding nofItems entries with keyValueBytes bytes and a common key prefix.
+    static constexpr size_t packedSize(size_t nofItems, size_t keyValueBytes, size_t prefixSize) noexcept
+    {
+        return 1 + prefixSize + nofItems * (SlotTable::SlotSize + 2) + keyValueBytes - nofItems * prefixSize;
+    }
+
+    /// Bytes needed to insert the entry, including the cost of shrinking the prefix.
+    size_t requiredSpace(ByteStringView key, ByteStringView value) const noexcept
+    {
+        auto prefix = getPrefix();
+        size_t common = commonPrefixSize(prefix, key);
+        size_t shrink = prefix.size() - common;
+        size_t grow = entrySize(key, value) - common + shrink * nofItems();
+        return grow > shrink ? grow - shrink : 0;
+    }
+
+    bool hasSpace(ByteStringView key, ByteStringView value) const noexcept
+    {
+        return requiredSpace(key, value) <= bytesLeft();
     }
 
     uint16_t toIndex(const uint8_t* pos) const { return static_cast<uint16_t>(pos - m_data);}
@@ -63,47 +89,62 @@ public:
         return (uint16_t*) &m_data[m_end];
     }
 
-    uint16_t* endTable() const noexcept { return (uint16_t*) (m_data + sizeof(m_data)); }
+    uint16_t* endTable() const noexcept { return beginTable() + nofItems(); }
+
+    ByteStringView getPrefix() const noexcept { return ByteStringView::fromStream(m_data); }
 
-    ByteStringView getKey(const uint16_t* it) const noexcept
+    ByteStringView getSuffix(const uint16_t* it) const noexcept
     {
         assert(it != endTable());
         return ByteStringView::fromStream(m_data + *it);
     }
 
-    ByteStringView getLowestKey() const noexcept
+    ByteString getKey(const uint16_t* it) const noexcept { return ByteString(getPrefix(), getSuffix(it)); }
+
+    ByteString getLowestKey() const noexcept
     {
         assert(beginTable() != endTable());
-        return ByteStringView::fromStream(m_data + *beginTable());
+        return getKey(beginTable());
     }
 
     ByteStringView getValue(const uint16_t* it) const noexcept
     {
         assert(it != endTable());
-        auto key = getKey(it);
-        return ByteStringView::fromStream(key.data() + key.size());
+        auto suffix = getSuffix(it);
+        return ByteStringView::fromStream(suffix.end());
     }
 
     void insert(ByteStringView key, ByteStringView value) noexcept
     {
         assert(hasSpace(key, value));
 
+        auto prefix = getPrefix();
+        size_t common = commonPrefixSize(prefix, key);
+        if (common < prefix.size())
+        {
+            const Leaf tmp = *this;
+            fill(tmp, tmp.beginTable(), tmp.endTable(), tmp.getPrefix().substr(0, common));
+        }
+
         uint16_t begin = m_begin;
-        auto end = toStream(key, &m_data[m_begin]);
+        auto suffix = key.substr(common);
+        auto end = toStream(suffix, &m_data[m_begin]);
         end = toStream(value, end);
-        //m_begin += key.size() + 1 + value.size() + 1;
         m_begin = toIndex(end);
 
         uint16_t* it = lowerBound(key);
-        std::copy(beginTable(), it, beginTable() - 1);
-        *(it - 1) = begin;
-        m_end -= sizeof(uint16_t);
+        slotTable().insert(it - beginTable(), begin, SlotTable::keyHead(suffix));
+        m_end -= SlotTable::SlotSize;
     }
 
     uint16_t* lowerBound(ByteStringView key) const noexcept
     {
-        TableKeyCompare keyCmp(m_data);
-        return std::lower_bound(beginTable(), endTable(), key, keyCmp);
+        auto prefix = getPrefix();
+        int cmp = comparePrefix(prefix, key);
+        if (cmp != 0)
+            return cmp < 0 ? beginTable() : endTable();
+
+        return beginTable() + slotTable().lowerBound(m_data, key.substr(prefix.size()));
     }
 
     uint16_t* find(ByteStringView key) const noexcept
@@ -111,30 +152,26 @@ public:
         uint16_t* it = lowerBound(key);
         if (it == endTable())
             return it;
-        if (getKey(it) == key)
+        if (isKey(it, key))
             return it;
         return endTable();
     }
 
     void remove(ByteStringView key) noexcept
     {
-        uint16_t* it = lowerBound(key);
+        uint16_t* it = find(key);
         if (it == endTable())
             return;
-        auto kentry = getKey(it);
-        if (kentry != key)
-            return;
 
         uint16_t index = *it;
         // copy what comes after to this place
-        auto ventry = getValue(it);    
+        auto ventry = getValue(it);
         uint16_t size = toIndex(ventry.end()) - *it;
         std::copy(ventry.end(), (const uint8_t*)&m_data[m_begin], &m_data[*it]);
         m_begin -= size;
 
-        // copy what comes before to this place
-        std::copy(beginTable(), it, beginTable() + 1);
-        m_end += sizeof(uint16_t);
+        slotTable().remove(it - beginTable());
+        m_end += SlotTable::SlotSize;
 
         // adjust indices of entries that came after
         for (it = beginTable(); it < endTable(); ++it)
@@ -144,20 +181,50 @@ public:
 
     void split(Leaf* rightLeaf, ByteStringView key, ByteStringView value) noexcept
     {
-        Leaf tmp = *this;
+        const Leaf tmp = *this;
         const uint16_t* it = tmp.findSplitPoint();
         assert(it != tmp.endTable());
         fill(tmp, tmp.beginTable(), it);
         rightLeaf->fill(tmp, it, tmp.endTable());
 
-        TableKeyCompare keyCmp(m_data);
-        if (keyCmp(*(endTable() - 1), key))
-            rightLeaf->insert(key, value);
+        Leaf* target = getKey(endTable() - 1) < key ? rightLeaf : this;
+        if (target->hasSpace(key, value))
+        {
+            target->insert(key, value);
+            return;
+        }
+
+        // the key lies outside of the leaf's range and would shrink the prefix too much: keep it apart
+        if (target == this)
+        {
+            assert(key < tmp.getLowestKey());
+            fill(tmp, tmp.beginTable(), tmp.beginTable());
+            rightLeaf->fill(tmp, tmp.beginTable(), tmp.endTable());
+        }
         else
-            insert(key, value);
+        {
+            fill(tmp, tmp.beginTable(), tmp.endTable());
+            rightLeaf->fill(tmp, tmp.endTable(), tmp.endTable());
+        }
+        target->insert(key, value);
+    }
+
+    /// Recomputes the longest prefix common to all keys.
+    void compact() noexcept
+    {
+        const Leaf tmp = *this;
+        fill(tmp, tmp.beginTable(), tmp.endTable());
     }
 
 private:
+    SlotTable slotTable() const noexcept { return SlotTable(const_cast<uint8_t*>(m_data) + m_end, nofItems()); }
+
+    bool isKey(const uint16_t* it, ByteStringView key) const noexcept
+    {
+        auto prefix = getPrefix();
+        return comparePrefix(prefix, key) == 0 && getSuffix(it) == key.substr(prefix.size());
+    }
+
     const uint16_t* findSplitPoint() const noexcept
     {
         size_t size = 0;
@@ -173,17 +240,33 @@ private:
 
     void fill(const Leaf& leaf, const uint16_t* begin, const uint16_t* end) noexcept
     {
-        m_begin = 0;
-        m_end = uint16_t(sizeof(m_data) - sizeof(uint16_t) * (end - begin));
+        if (begin == end)
+        {
+            fill(leaf, begin, end, ByteStringView());
+            return;
+        }
+
+        auto first = leaf.getKey(begin);
+        auto last = leaf.getKey(end - 1);
+        fill(leaf, begin, end, ByteStringView(first).substr(0, commonPrefixSize(first, last)));
+    }
+
+    void fill(const Leaf& leaf, const uint16_t* begin, const uint16_t* end, ByteStringView prefix) noexcept
+    {
+        m_begin = toIndex(toStream(prefix, m_data));
+        m_end = uint16_t(sizeof(m_data) - SlotTable::SlotSize * (end - begin));
         uint16_t* destTable = beginTable();
+        auto slots = slotTable();
         for (const uint16_t* it = begin; it < end; ++it)
         {
-            auto xend = toStream(leaf.getKey(it), &m_data[m_begin]);
+            auto xend = toStream(leaf.getPrefix(), leaf.getSuffix(it), prefix.size(), &m_data[m_begin]);
+            slots.setHead(destTable - beginTable(), SlotTable::keyHead(ByteStringView::fromStream(&m_data[m_begin])));
             xend = toStream(leaf.getValue(it), xend);
             *destTable = m_begin;
             destTable++;
             m_begin = toIndex(xend);
         }
+        assert(m_begin <= m_end);
     }
 };
 
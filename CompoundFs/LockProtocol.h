@@ -17,7 +17,7 @@ class LockProtocol final
 {
 public:
     LockProtocol() = default;
-    LockProtocol(TSharedMutex&& gate, TSharedMutex&& shared, TMutex&& writer);
+    LockProtocol(TSharedMutex&& gate, TSharedMutex&& shared, TMutex&& writer, TSharedMutex&& snapshot);
 
     Lock readAccess();
     std::optional<Lock> tryReadAccess();
@@ -28,19 +28,26 @@ public:
     CommitLock commitAccess(Lock&& writeLock);
     std::variant<CommitLock, Lock> tryCommitAccess(Lock&& writeLock);
 
+    Lock snapshotAccess();
+    Lock reclaimAccess();
+    std::optional<Lock> tryReclaimAccess();
+
 private:
     TSharedMutex m_gate;
     TSharedMutex m_shared;
     TMutex m_writer;
+    TSharedMutex m_snapshot;
 };
 
 ///////////////////////////////////////////////////////////////////////////
 
 template <typename TSMutex, typename TXMutex>
-inline LockProtocol<TSMutex, TXMutex>::LockProtocol(TSMutex&& gate, TSMutex&& shared, TXMutex&& writer)
+inline LockProtocol<TSMutex, TXMutex>::LockProtocol(TSMutex&& gate, TSMutex&& shared, TXMutex&& writer,
+                                                    TSMutex&& snapshot)
     : m_gate(std::move(gate))
     , m_shared(std::move(shared))
     , m_writer(std::move(writer))
+    , m_snapshot(std::move(snapshot))
 {
 }
 
@@ -109,4 +116,30 @@ std::variant<CommitLock, Lock> LockProtocol<TSMutex, TXMutex>::tryCommitAccess(L
     return CommitLock(std::move(writeLock), Lock(&m_shared, [](void* m) { static_cast<TSMutex*>(m)->unlock(); }));
 }
 
+/// Held by readers working on the logged copies of a commit in progress. Does not interact with the
+/// other locks: readers never wait for a commit to get it.
+template <typename TSMutex, typename TXMutex>
+inline Lock LockProtocol<TSMutex, TXMutex>::snapshotAccess()
+{
+    m_snapshot.lock_shared();
+    return Lock(&m_snapshot, [](void* m) { static_cast<TSMutex*>(m)->unlock_shared(); });
+}
+
+/// Needed by the writer before it removes the copies of a commit. Waits for the snapshot readers to leave.
+template <typename TSMutex, typename TXMutex>
+inline Lock LockProtocol<TSMutex, TXMutex>::reclaimAccess()
+{
+    m_snapshot.lock();
+    return Lock(&m_snapshot, [](void* m) { static_cast<TSMutex*>(m)->unlock(); });
+}
+
+template <typename TSMutex, typename TXMutex>
+inline std::optional<Lock> LockProtocol<TSMutex, TXMutex>::tryReclaimAccess()
+{
+    if (!m_snapshot.try_lock())
+        return std::nullopt;
+
+    return Lock(&m_snapshot, [](void* m) { static_cast<TSMutex*>(m)->unlock(); });
+}
+
 }
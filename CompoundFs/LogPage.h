@@ -1,23 +1,23 @@
 #pragma once
 
+#include "Node.h"
 #include <random>
 #include <vector>
 #include <algorithm>
 
 namespace TxFs
 {
-using PageIndex = uint32_t;
 
 class LogPage final
 {
 public:
     struct PageCopies
     {
-        uint32_t m_original;
-        uint32_t m_copy;
+        PageIndex m_original;
+        PageIndex m_copy;
     };
 
-    constexpr static size_t MAX_ENTRIES = 509;
+    constexpr static size_t MAX_ENTRIES = (PageSize - 6 * sizeof(uint32_t)) / sizeof(PageCopies);
 
 private:
     uint32_t m_signature[4];
@@ -33,7 +33,7 @@ public:
     LogPage(PageIndex pageIndex) noexcept
         : m_size(0)
     {
-        std::minstd_rand mt(pageIndex);
+        std::minstd_rand mt(static_cast<std::minstd_rand::result_type>(pageIndex));
         m_signature[0] = (uint32_t) mt();
         m_signature[1] = (uint32_t) mt();
         m_signature[2] = (uint32_t) mt();
@@ -42,7 +42,7 @@ public:
 
     bool checkSignature(PageIndex pageIndex) const noexcept
     {
-        std::minstd_rand mt(pageIndex);
+        std::minstd_rand mt(static_cast<std::minstd_rand::result_type>(pageIndex));
         uint32_t sig[4] = { (uint32_t) mt(), (uint32_t) mt(), (uint32_t) mt(), (uint32_t) mt() };
         return std::equal(sig, sig + 4, m_signature, m_signature + 4) && m_size <= MAX_ENTRIES;
     }
@@ -85,5 +85,5 @@ constexpr bool operator==(LogPage::PageCopies lhs, LogPage::PageCopies rhs) noex
     return lhs.m_copy == rhs.m_copy && lhs.m_original == rhs.m_original;
 }
 
-static_assert(sizeof(LogPage) == 4096);
+static_assert(sizeof(LogPage) == PageSize);
 }
@@ -15,16 +15,20 @@ Interval MemoryFileBase::newInterval(size_t maxPages)
 {
     PageIndex idx = (PageIndex) m_file.size();
     for (size_t i = 0; i < maxPages; i++)
-        m_file.emplace_back(m_allocator.allocate());
+    {
+        // like a file that grows, new pages read as zeros even if the allocator recycled them
+        auto page = m_allocator.allocate();
+        std::fill(page.get(), page.get() + PageSize, uint8_t(0));
+        m_file.emplace_back(std::move(page));
+    }
     return Interval(idx, idx + uint32_t(maxPages));
 }
 
 const uint8_t* MemoryFileBase::writePage(PageIndex idx, size_t pageOffset, const uint8_t* begin, const uint8_t* end)
 {
-    auto p = m_file.at(idx);
-    if (pageOffset + (end - begin) > 4096)
+    if (pageOffset + (end - begin) > PageSize)
         throw std::runtime_error("MemoryFileBase::writePage over page boundary");
-    std::copy(begin, end, p.get() + pageOffset);
+    std::copy(begin, end, writablePage(idx) + pageOffset);
     return end;
 }
 
@@ -32,17 +36,29 @@ const uint8_t* MemoryFileBase::writePages(Interval iv, const uint8_t* page)
 {
     for (auto idx = iv.begin(); idx < iv.end(); idx++)
     {
-        auto p = m_file.at(idx);
-        std::copy(page, page + 4096, p.get());
-        page += 4096;
+        std::copy(page, page + PageSize, writablePage(idx));
+        page += PageSize;
     }
     return page;
 }
 
+/// Pages handed out by pageMemory() keep their content: while such a page is held, writes go to a copy.
+uint8_t* MemoryFileBase::writablePage(PageIndex idx)
+{
+    auto& p = m_file.at(idx);
+    if (p.use_count() > 1)
+    {
+        auto page = m_allocator.allocate();
+        std::copy(p.get(), p.get() + PageSize, page.get());
+        p = std::move(page);
+    }
+    return p.get();
+}
+
 uint8_t* MemoryFileBase::readPage(PageIndex idx, size_t pageOffset, uint8_t* begin, uint8_t* end) const
 {
     auto p = m_file.at(idx);
-    if (pageOffset + (end - begin) > 4096)
+    if (pageOffset + (end - begin) > PageSize)
         throw std::runtime_error("MemoryFileBase::readPage over page boundary");
     return std::copy(p.get() + pageOffset, p.get() + pageOffset + (end - begin), begin);
 }
@@ -52,11 +68,16 @@ uint8_t* MemoryFileBase::readPages(Interval iv, uint8_t* page) const
     for (auto idx = iv.begin(); idx < iv.end(); idx++)
     {
         auto p = m_file.at(idx);
-        page = std::copy(p.get(), p.get() + 4096, page);
+        page = std::copy(p.get(), p.get() + PageSize, page);
     }
     return page;
 }
 
+std::shared_ptr<const uint8_t> MemoryFileBase::pageMemory(PageIndex idx) const
+{
+    return m_file.at(idx);
+}
+
 void MemoryFileBase::flushFile()
 {}
 
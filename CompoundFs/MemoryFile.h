@@ -36,6 +36,10 @@ public:
     void flushFile() override;
     size_t fileSizeInPages() const override;
     void truncate(size_t numberOfPages) override;
+    std::shared_ptr<const uint8_t> pageMemory(PageIndex idx) const override;
+
+private:
+    uint8_t* writablePage(PageIndex idx);
 
 private:
     PageAllocator m_allocator;
@@ -66,8 +70,12 @@ public:
 
     Lock defaultAccess() override;
     Lock readAccess() override;
+    std::optional<Lock> tryReadAccess() override;
     Lock writeAccess() override;
     CommitLock commitAccess(Lock&& writeLock) override;
+    Lock snapshotAccess() override;
+    Lock reclaimAccess() override;
+    std::optional<Lock> tryReclaimAccess() override;
 
 private:
     std::unique_ptr<TLockProtocol> m_lockProtocol;
@@ -90,6 +98,12 @@ Lock LockedMemoryFile<TSharedMutex, TMutex>::readAccess()
     return m_lockProtocol->readAccess();
 }
 
+template <typename TSharedMutex, typename TMutex>
+std::optional<Lock> LockedMemoryFile<TSharedMutex, TMutex>::tryReadAccess()
+{
+    return m_lockProtocol->tryReadAccess();
+}
+
 template <typename TSharedMutex, typename TMutex>
 Lock LockedMemoryFile<TSharedMutex, TMutex>::writeAccess()
 {
@@ -102,5 +116,23 @@ CommitLock LockedMemoryFile<TSharedMutex, TMutex>::commitAccess(Lock&& writeLock
     return m_lockProtocol->commitAccess(std::move(writeLock));
 }
 
+template <typename TSharedMutex, typename TMutex>
+Lock LockedMemoryFile<TSharedMutex, TMutex>::snapshotAccess()
+{
+    return m_lockProtocol->snapshotAccess();
+}
+
+template <typename TSharedMutex, typename TMutex>
+Lock LockedMemoryFile<TSharedMutex, TMutex>::reclaimAccess()
+{
+    return m_lockProtocol->reclaimAccess();
+}
+
+template <typename TSharedMutex, typename TMutex>
+std::optional<Lock> LockedMemoryFile<TSharedMutex, TMutex>::tryReclaimAccess()
+{
+    return m_lockProtocol->tryReclaimAccess();
+}
+
 
 }
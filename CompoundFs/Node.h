@@ -5,14 +5,49 @@
 #define NODE_H
 
 #include <cstdint>
+#include <cstddef>
+
+#ifndef TXFS_PAGE_SIZE
+#define TXFS_PAGE_SIZE 4096
+#endif
 
 namespace TxFs
 {
 
+/// Width of page indices, which is part of the file format as well. 32 bit indices limit a composite
+/// file to 2^32 pages (16 TiB with 4 KiB pages); TXFS_PAGE_INDEX_64 lifts that limit at the cost of
+/// larger tree nodes and log entries.
+#ifdef TXFS_PAGE_INDEX_64
+using PageIndex = uint64_t;
+enum PageIdx : PageIndex { INVALID = UINT64_MAX };
+#else
 using PageIndex = uint32_t;
 enum PageIdx : PageIndex { INVALID = UINT32_MAX };
+#endif
+
+/// Size of all pages of a composite file. It is part of the file format: a file can only be opened
+/// with the page size it was created with. Node offsets are 16 bit, which limits pages to 64 KiB.
+constexpr size_t PageSize = TXFS_PAGE_SIZE;
+constexpr size_t MinPageSize = 4096;
+constexpr size_t MaxPageSize = 65536;
+static_assert(PageSize >= MinPageSize && PageSize <= MaxPageSize && (PageSize & (PageSize - 1)) == 0,
+              "TXFS_PAGE_SIZE must be a power of two between 4096 and 65536");
+
+/// Largest number of pages of a composite file. With 64 bit indices the byte offsets have to stay
+/// below the lock ranges at the top of the int64_t range.
+#ifdef TXFS_PAGE_INDEX_64
+constexpr uint64_t MaxPages = INT64_MAX / PageSize - 1;
+#else
+constexpr uint64_t MaxPages = UINT32_MAX - 1ULL;
+#endif
+
+/// Version of the node layout. Format 0 nodes store full keys behind 2 byte slots and inner nodes keep
+/// no entry counts; format 1 adds the key prefix, the cached key heads and the counts.
+constexpr uint8_t DirectoryFormat = 1;
 
-enum class NodeType : uint8_t { Undefined, Leaf, Inner };
+/// The node types are numbered anew with every DirectoryFormat, so that the root node tells the format
+/// of a file before the tree is read.
+enum class NodeType : uint8_t { Undefined, LeafFormat0, InnerFormat0, Leaf, Inner };
 
 //////////////////////////////////////////////////////////////////////////
 
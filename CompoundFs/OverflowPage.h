@@ -0,0 +1,53 @@
+
+
+#pragma once
+#ifndef OVERFLOWPAGE_H
+#define OVERFLOWPAGE_H
+
+#include "Node.h"
+#include <algorithm>
+
+namespace TxFs
+{
+#pragma pack(push)
+#pragma pack(1)
+
+/// Holds a part of a value that is too large for a leaf. The pages of one value form a chain; the leaf
+/// only keeps the index of the first page and the size of the value.
+class OverflowPage final
+{
+    PageIndex m_next;
+    uint16_t m_size;
+    uint8_t m_data[PageSize - sizeof(PageIndex) - sizeof(uint16_t) - sizeof(uint32_t)];
+
+public:
+    uint32_t m_checkSum;
+
+public:
+    OverflowPage(PageIndex next = PageIdx::INVALID) noexcept
+        : m_next(next)
+        , m_size(0)
+    {
+        static_assert(sizeof(OverflowPage) == PageSize);
+    }
+
+    constexpr PageIndex getNext() const noexcept { return m_next; }
+    constexpr void setNext(PageIndex next) noexcept { m_next = next; }
+    static constexpr size_t capacity() noexcept { return sizeof(m_data); }
+
+    /// Copies as much of [begin, end) as fits and returns the end of the copied part.
+    const uint8_t* fill(const uint8_t* begin, const uint8_t* end) noexcept
+    {
+        m_size = uint16_t(std::min(size_t(end - begin), capacity()));
+        std::copy(begin, begin + m_size, m_data);
+        return begin + m_size;
+    }
+
+    const uint8_t* begin() const noexcept { return m_data; }
+    const uint8_t* end() const noexcept { return m_data + m_size; }
+};
+
+#pragma pack(pop)
+}
+
+#endif
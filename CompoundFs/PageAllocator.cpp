@@ -17,20 +17,22 @@ std::shared_ptr<uint8_t> PageAllocator::allocate()
     if (!m_block)
     {
         m_blocksAllocated = 0;
-        m_freePages = std::make_unique<std::vector<BlockPage>>();
+        m_freePages = std::make_unique<FreePages>();
         m_block = allocBlock();
         m_currentPosInBlock = m_block.get();
     }
-    if (!m_freePages->empty())
+
+    std::lock_guard lock(m_freePages->m_mutex);
+    if (!m_freePages->m_pages.empty())
     {
-        auto page = m_freePages->back();
-        m_freePages->pop_back();
+        auto page = m_freePages->m_pages.back();
+        m_freePages->m_pages.pop_back();
         return makePage(page.first, page.second);
     }
 
     auto page = makePage(m_block, m_currentPosInBlock);
-    m_currentPosInBlock += 4096;
-    if ((m_block.get() + m_pagesPerBlock * 4096) != m_currentPosInBlock)
+    m_currentPosInBlock += PageSize;
+    if ((m_block.get() + m_pagesPerBlock * PageSize) != m_currentPosInBlock)
         return page;
 
     m_block = allocBlock();
@@ -43,9 +45,11 @@ std::pair<size_t, size_t> PageAllocator::trim()
     if (!m_freePages)
         return std::pair<size_t, size_t>(0, 0);
 
+    std::lock_guard lock(m_freePages->m_mutex);
+    auto& freePages = m_freePages->m_pages;
     std::unordered_map<std::shared_ptr<uint8_t>, std::vector<uint8_t*>> blockToPage;
     blockToPage.reserve(m_blocksAllocated);
-    for (const auto& bp: *m_freePages)
+    for (const auto& bp: freePages)
     {
         auto it = blockToPage.find(bp.first);
         if (it == blockToPage.end())
@@ -56,20 +60,20 @@ std::pair<size_t, size_t> PageAllocator::trim()
         it->second.push_back(bp.second);
     }
 
-    m_freePages->clear();
+    freePages.clear();
     m_blocksAllocated -= blockToPage.size();
     for (const auto& it: blockToPage)
     {
         if (it.second.size() != m_pagesPerBlock)
         {
             for (auto p: it.second)
-                m_freePages->emplace_back(it.first, p);
+                freePages.emplace_back(it.first, p);
             m_blocksAllocated++;
         }
     }
-    m_freePages->shrink_to_fit();
+    freePages.shrink_to_fit();
     blockToPage.clear();
-    return std::make_pair(m_blocksAllocated, m_freePages->size());
+    return std::make_pair(m_blocksAllocated, freePages.size());
 }
 
 #ifdef _WINDOWS
@@ -80,10 +84,10 @@ std::pair<size_t, size_t> PageAllocator::trim()
 std::shared_ptr<uint8_t> PageAllocator::allocBlock()
 {
     // reserves the memory but allocates only on touch (when you start using it)
-    uint8_t* block = (uint8_t*) ::VirtualAlloc(nullptr, m_pagesPerBlock * 4096, MEM_COMMIT, PAGE_READWRITE);
+    uint8_t* block = (uint8_t*) ::VirtualAlloc(nullptr, m_pagesPerBlock * PageSize, MEM_COMMIT, PAGE_READWRITE);
 
     // actually allocates the memory immediately 
-    //uint8_t* block = (uint8_t*) ::VirtualAlloc(nullptr, m_pagesPerBlock * 4096, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+    //uint8_t* block = (uint8_t*) ::VirtualAlloc(nullptr, m_pagesPerBlock * PageSize, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
 
     if (block == nullptr)
         throw std::system_error(static_cast<int>(::GetLastError()), std::system_category(), "PageAllocator");
@@ -96,7 +100,7 @@ std::shared_ptr<uint8_t> PageAllocator::allocBlock()
 
 std::shared_ptr<uint8_t> PageAllocator::allocBlock()
 {
-    std::shared_ptr<uint8_t> block(new uint8_t[m_pagesPerBlock * 4096], [](uint8_t* b) { delete[] b; });
+    std::shared_ptr<uint8_t> block(new uint8_t[m_pagesPerBlock * PageSize], [](uint8_t* b) { delete[] b; });
     m_blocksAllocated++;
     return block;
 }
@@ -105,8 +109,11 @@ std::shared_ptr<uint8_t> PageAllocator::allocBlock()
 
 std::shared_ptr<uint8_t> PageAllocator::makePage(std::shared_ptr<uint8_t> block, uint8_t* page)
 {
-    // Note that m_freePage is a unique_ptr<> and the lambda uses the raw pointer to the vector<>
-    // which makes PageAllocator movable. The raw pointer to the vector<> after a move operation 
+    // Note that m_freePage is a unique_ptr<> and the lambda uses the raw pointer to the FreePages
+    // which makes PageAllocator movable. The raw pointer to the FreePages after a move operation 
     // is still the same.
-    return std::shared_ptr<uint8_t>(page, [block,fp=m_freePages.get()](uint8_t* page) { fp->emplace_back(block, page); });
+    return std::shared_ptr<uint8_t>(page, [block, fp = m_freePages.get()](uint8_t* page) {
+        std::lock_guard lock(fp->m_mutex);
+        fp->m_pages.emplace_back(block, page);
+    });
 }
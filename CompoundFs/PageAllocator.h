@@ -2,9 +2,11 @@
 
 #pragma once
 
+#include "Node.h"
 #include <vector>
 #include <cstdint>
 #include <memory>
+#include <mutex>
 
 namespace TxFs
 {
@@ -14,7 +16,8 @@ namespace TxFs
 /// std::shared_ptr<> which upon deletion returns the memory to the PageAllocator
 /// instance where it is kept in container for re-usage. PageAllocator can be 
 /// moved. PageAllocator::trim() will return as many blocks as possible to the 
-/// system.
+/// system. allocate() and trim() are thread-safe as pages may be released by any 
+/// thread.
 
 class PageAllocator final
 {
@@ -30,9 +33,15 @@ private:
 
 private:
     using BlockPage = std::pair<std::shared_ptr<uint8_t>, uint8_t*>;
+    struct FreePages
+    {
+        std::mutex m_mutex;
+        std::vector<BlockPage> m_pages;
+    };
+
     size_t m_blocksAllocated;
     size_t m_pagesPerBlock;
-    std::unique_ptr<std::vector<BlockPage>> m_freePages; // to make lambdas immune to move ops
+    std::unique_ptr<FreePages> m_freePages; // to make lambdas immune to move ops
     std::shared_ptr<uint8_t> m_block;
     uint8_t* m_currentPosInBlock;
 };
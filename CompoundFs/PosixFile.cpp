@@ -10,6 +10,7 @@
 #else
     #pragma warning(disable : 4996) // disable "'open': The POSIX name for this item is deprecated."
     #include <io.h>
+    #include <mutex>
 #endif
 
 using namespace TxFs;
@@ -50,12 +51,17 @@ constexpr auto read = WrapOsCall<::read>();
     constexpr auto lseek = WrapOsCall<::lseek>();
     constexpr auto fsync = WrapOsCall<::fsync>();
     constexpr auto ftruncate = WrapOsCall<::ftruncate>();
+    constexpr auto pread = WrapOsCall<::pread>();
+    constexpr auto pwrite = WrapOsCall<::pwrite>();
+
+    int64_t fileLength(int fd) { return lseek(fd, 0, SEEK_END); }
 
     int fileHandleToLockHandle(int file) { return file; }
 
 #else
     constexpr auto lseek = WrapOsCall<::_lseeki64>();
     constexpr auto fsync = WrapOsCall<::_commit>();
+    constexpr auto fileLength = WrapOsCall<::_filelengthi64>();
 
     int ftruncate(int fd, int64_t size)
     {
@@ -71,12 +77,28 @@ constexpr auto read = WrapOsCall<::read>();
     {
         return (void*) (file < 0 ? intptr_t (-1LL) : ::_get_osfhandle(file));
     }
+
+    // no positional i/o available: seek and read/write under a lock as all threads share the file offset
+    std::mutex fileOffsetMutex;
+
+    int pread(int fd, void* buf, unsigned count, int64_t offset)
+    {
+        std::lock_guard lock(fileOffsetMutex);
+        lseek(fd, offset, SEEK_SET);
+        return read(fd, buf, count);
+    }
+
+    int pwrite(int fd, const void* buf, unsigned count, int64_t offset)
+    {
+        std::lock_guard lock(fileOffsetMutex);
+        lseek(fd, offset, SEEK_SET);
+        return write(fd, buf, count);
+    }
 #endif
 }
 
 namespace
 {
-constexpr uint64_t PageSize = 4096ULL;
 constexpr uint32_t BlockSize = 16 * 1024 * 1024;
 }
 
@@ -118,7 +140,9 @@ PosixFile::PosixFile(std::filesystem::path path, OpenMode mode)
     if (mode == OpenMode::CreateAlways)
     {   // truncate with commit lock
         auto lock = commitAccess(writeAccess());
+        auto reclaimLock = reclaimAccess();
         truncate(0);
+        reclaimLock.release();
         lock.release();
     }
 }
@@ -159,20 +183,23 @@ PosixFile::PosixFile(int file, bool readOnly)
         FileLock { posix::fileHandleToLockHandle(file), FileLockPosition::GateBegin, FileLockPosition::GateEnd },
         FileLock { posix::fileHandleToLockHandle(file), FileLockPosition::SharedBegin, FileLockPosition::SharedEnd },
         FileLock { posix::fileHandleToLockHandle(file), FileLockPosition::WriteBegin, FileLockPosition::WriteEnd },
+        FileLock { posix::fileHandleToLockHandle(file), FileLockPosition::SnapshotBegin, FileLockPosition::SnapshotEnd }
     }
 {
-    static constexpr int64_t MaxFileSize = 4096LL * int64_t(std::numeric_limits<uint32_t>::max() - 1LL);
+    static constexpr int64_t MaxFileSize = int64_t(PageSize) * int64_t(MaxPages);
     static_assert(MaxFileSize < FileLockPosition::GateBegin);
     static_assert(FileLockPosition::GateBegin < FileLockPosition::GateEnd);
     static_assert(MaxFileSize < FileLockPosition::SharedBegin);
     static_assert(FileLockPosition::SharedBegin < FileLockPosition::SharedEnd);
     static_assert(MaxFileSize < FileLockPosition::WriteBegin);
     static_assert(FileLockPosition::WriteBegin < FileLockPosition::WriteEnd);
+    static_assert(MaxFileSize < FileLockPosition::SnapshotBegin);
+    static_assert(FileLockPosition::SnapshotBegin < FileLockPosition::SnapshotEnd);
 }
 
 Interval PosixFile::newInterval(size_t maxPages)
 {
-    auto length = posix::lseek(m_file, 0, SEEK_END);
+    auto length = posix::fileLength(m_file);
     posix::ftruncate(m_file, length + maxPages * PageSize);
     return Interval(PageIndex(length / PageSize), PageIndex(length / PageSize + maxPages));
 }
@@ -184,8 +211,7 @@ const uint8_t* PosixFile::writePage(PageIndex id, size_t pageOffset, const uint8
     if (fileSizeInPages() <= id)
         throw std::runtime_error("File::writePage outside file");
 
-    posix::lseek(m_file, id * PageSize + pageOffset, SEEK_SET);
-    posix::write(m_file, begin, unsigned(end - begin));
+    posix::pwrite(m_file, begin, unsigned(end - begin), id * PageSize + pageOffset);
     return end;
 }
 
@@ -194,19 +220,18 @@ const uint8_t* PosixFile::writePages(Interval iv, const uint8_t* page)
     if (fileSizeInPages() < iv.end())
         throw std::runtime_error("File::writePages outside file");
 
-    posix::lseek(m_file, iv.begin() * PageSize, SEEK_SET);
     auto end = page + (iv.length() * PageSize);
-    writePagesInBlocks(page, end);
+    writePagesInBlocks(iv.begin() * PageSize, page, end);
 
     return end;
 }
 
-void PosixFile::writePagesInBlocks(const uint8_t* begin, const uint8_t* end)
+void PosixFile::writePagesInBlocks(uint64_t position, const uint8_t* begin, const uint8_t* end)
 {
-    for (; (begin + BlockSize) < end; begin += BlockSize)
-        posix::write(m_file, begin, BlockSize);
+    for (; (begin + BlockSize) < end; begin += BlockSize, position += BlockSize)
+        posix::pwrite(m_file, begin, BlockSize, position);
 
-    posix::write(m_file, begin, unsigned(end-begin));
+    posix::pwrite(m_file, begin, unsigned(end - begin), position);
 }
 
 uint8_t* PosixFile::readPage(PageIndex id, size_t pageOffset, uint8_t* begin, uint8_t* end) const
@@ -216,8 +241,7 @@ uint8_t* PosixFile::readPage(PageIndex id, size_t pageOffset, uint8_t* begin, ui
     if (fileSizeInPages() <= id)
         throw std::runtime_error("File::readPage outside file");
 
-    posix::lseek(m_file, id * PageSize + pageOffset, SEEK_SET);
-    int bytesRead = posix::read(m_file, begin, unsigned(end - begin));
+    auto bytesRead = posix::pread(m_file, begin, unsigned(end - begin), id * PageSize + pageOffset);
     return begin + bytesRead;
 }
 
@@ -226,26 +250,26 @@ uint8_t* PosixFile::readPages(Interval iv, uint8_t* page) const
     if (fileSizeInPages() < iv.end())
         throw std::runtime_error("File::readPages outside file");
 
-    posix::lseek(m_file, iv.begin() * PageSize, SEEK_SET);
     auto end = page + (iv.length() * PageSize);
-    size_t bytesRead = readPagesInBlocks(page, end);
+    size_t bytesRead = readPagesInBlocks(iv.begin() * PageSize, page, end);
 
     return page + bytesRead;
 }
 
-size_t PosixFile::readPagesInBlocks(uint8_t* begin, uint8_t* end) const
+/// Uses positional reads: several threads may read through the same file handle.
+size_t PosixFile::readPagesInBlocks(uint64_t position, uint8_t* begin, uint8_t* end) const
 {
     size_t bytesRead = 0;
     for (; (begin + BlockSize) < end; begin += BlockSize)
-        bytesRead += posix::read(m_file, begin, BlockSize);
+        bytesRead += posix::pread(m_file, begin, BlockSize, position + bytesRead);
 
-    bytesRead += posix::read(m_file, begin, unsigned(end - begin));
+    bytesRead += posix::pread(m_file, begin, unsigned(end - begin), position + bytesRead);
     return bytesRead;
 }
 
 size_t PosixFile::fileSizeInPages() const
 {
-    auto bytes = posix::lseek(m_file, 0, SEEK_END);
+    auto bytes = posix::fileLength(m_file);
     bytes += PageSize - 1;
     return bytes / PageSize; // pages rounded up
 }
@@ -270,6 +294,11 @@ Lock PosixFile::readAccess()
     return m_lockProtocol.readAccess();
 }
 
+std::optional<Lock> PosixFile::tryReadAccess()
+{
+    return m_lockProtocol.tryReadAccess();
+}
+
 Lock PosixFile::writeAccess()
 {
     return m_lockProtocol.writeAccess();
@@ -280,3 +309,18 @@ CommitLock PosixFile::commitAccess(Lock&& writeLock)
     return m_lockProtocol.commitAccess(std::move(writeLock));
 }
 
+Lock PosixFile::snapshotAccess()
+{
+    return m_lockProtocol.snapshotAccess();
+}
+
+Lock PosixFile::reclaimAccess()
+{
+    return m_lockProtocol.reclaimAccess();
+}
+
+std::optional<Lock> PosixFile::tryReclaimAccess()
+{
+    return m_lockProtocol.tryReclaimAccess();
+}
+
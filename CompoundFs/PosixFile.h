@@ -41,14 +41,18 @@ public:
     void truncate(size_t numberOfPages) override;
     Lock defaultAccess() override;
     Lock readAccess() override;
+    std::optional<Lock> tryReadAccess() override;
     Lock writeAccess() override;
     CommitLock commitAccess(Lock&& writeLock) override;
+    Lock snapshotAccess() override;
+    Lock reclaimAccess() override;
+    std::optional<Lock> tryReclaimAccess() override;
     
 private:
     PosixFile(int file, bool readOnly);
     static int open(std::filesystem::path path, OpenMode mode);
-    void writePagesInBlocks(const uint8_t* begin, const uint8_t* end);
-    size_t readPagesInBlocks(uint8_t* begin, uint8_t* end) const;
+    void writePagesInBlocks(uint64_t position, const uint8_t* begin, const uint8_t* end);
+    size_t readPagesInBlocks(uint64_t position, uint8_t* begin, uint8_t* end) const;
 
 
 private:
@@ -2,6 +2,7 @@
 #pragma once
 
 #include "FileInterface.h"
+#include "Lock.h"
 #include <stdexcept>
 #include <utility>
 
@@ -28,6 +29,20 @@ public:
     Lock defaultAccess() override;
     Lock writeAccess() override;
     CommitLock commitAccess(Lock&& writeLock) override;
+    Lock reclaimAccess() override;
+    std::optional<Lock> tryReclaimAccess() override;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+/// Read-only decorator for snapshot readers. No lock is taken when the CacheManager is created:
+/// RollbackHandler::acquireSnapshot() decides between a read lock and a snapshot lock.
+template <typename TFile>
+class SnapshotFile : public ReadOnlyFile<TFile>
+{
+public:
+    using ReadOnlyFile<TFile>::ReadOnlyFile;
+
+    Lock defaultAccess() override;
 };
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -100,6 +115,26 @@ CommitLock ReadOnlyFile<TFile>::commitAccess(Lock&&)
     throw IllegalWriteOperation();
 }
 
+template <typename TFile>
+Lock ReadOnlyFile<TFile>::reclaimAccess()
+{
+    throw IllegalWriteOperation();
+}
+
+template <typename TFile>
+std::optional<Lock> ReadOnlyFile<TFile>::tryReclaimAccess()
+{
+    throw IllegalWriteOperation();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+template <typename TFile>
+Lock SnapshotFile<TFile>::defaultAccess()
+{
+    return Lock();
+}
+
 
 
 }
@@ -3,9 +3,28 @@
 #include "LogPage.h"
 #include "FileIo.h"
 #include <assert.h>
+#include <algorithm>
 
 using namespace TxFs;
 
+namespace
+{
+/// A commit in progress wrote its copies in one interval right in front of its log pages. The logs are
+/// complete if they cover exactly that interval and all log pages up to the end of the file.
+bool isCompleteLog(const std::vector<std::pair<PageIndex, PageIndex>>& logs, size_t fileSize)
+{
+    if (logs.empty())
+        return false;
+
+    auto [minIt, maxIt] = std::minmax_element(logs.begin(), logs.end(),
+                                              [](const auto& lhs, const auto& rhs) { return lhs.second < rhs.second; });
+    size_t copiesBegin = minIt->second;
+    size_t copiesEnd = size_t(maxIt->second) + 1;
+    size_t logPages = (logs.size() + LogPage::MAX_ENTRIES - 1) / LogPage::MAX_ENTRIES;
+    return copiesEnd - copiesBegin == logs.size() && copiesEnd + logPages == fileSize;
+}
+}
+
 RollbackHandler::RollbackHandler(Cache& cache) noexcept
     : m_cache(cache)
 {}
@@ -22,12 +41,18 @@ void RollbackHandler::rollback(size_t compositeSize)
 {
     m_cache.m_pageCache.clear();
     m_cache.m_newPageIds.clear();
+    m_cache.m_freedPageIds.clear();
     m_cache.m_divertedPageIds.clear();
+    auto& copies = m_cache.m_unreclaimedCopies; // the ones behind compositeSize are truncated below
+    copies.erase(std::remove_if(copies.begin(), copies.end(), [=](Interval iv) { return iv.begin() >= compositeSize; }),
+                 copies.end());
     assert(compositeSize <= m_cache.file()->fileSizeInPages());
     if (compositeSize < m_cache.file()->fileSizeInPages())
     {
         auto commitLock = m_cache.commitAccess();
+        auto reclaimLock = m_cache.file()->reclaimAccess();
         m_cache.m_fileInterface->truncate(compositeSize);
+        reclaimLock.release();
         m_cache.m_lock = commitLock.release();
     }
 }
@@ -39,6 +64,41 @@ void RollbackHandler::virtualRevertPartialCommit()
         m_cache.m_divertedPageIds[orig] = cpy;
 }
 
+/// Acquires the lock of a reader without waiting for a commit in progress. If the writer holds the
+/// commit lock the reader works on the logged copies of the overwritten pages instead, i.e. on the
+/// state before the commit. The copies stay in place as long as the snapshot lock is held.
+void RollbackHandler::acquireSnapshot()
+{
+    if (auto readLock = m_cache.file()->tryReadAccess())
+    {
+        m_cache.m_lock = std::move(*readLock);
+        virtualRevertPartialCommit();
+        return;
+    }
+
+    auto snapshotLock = m_cache.file()->snapshotAccess();
+    try
+    {
+        // the writer removes the log pages as soon as the commit is done: verify we have seen them all
+        auto fileSize = m_cache.file()->fileSizeInPages();
+        auto logs = readLogs();
+        if (isCompleteLog(logs, fileSize) && fileSize == m_cache.file()->fileSizeInPages())
+        {
+            for (auto [orig, cpy]: logs)
+                m_cache.m_divertedPageIds[orig] = cpy;
+            m_cache.m_lock = std::move(snapshotLock);
+            return;
+        }
+    }
+    catch (std::exception&)
+    {   // log pages got truncated while reading
+    }
+
+    snapshotLock.release(); // never wait for the commit holding the snapshot lock
+    m_cache.m_lock = m_cache.file()->readAccess();
+    virtualRevertPartialCommit();
+}
+
 std::vector<std::pair<PageIndex, PageIndex>> RollbackHandler::readLogs() const
 {
     std::vector<std::pair<PageIndex, PageIndex>> res;
@@ -13,6 +13,7 @@ public:
     void revertPartialCommit();
     void rollback(size_t compositeSize);
     void virtualRevertPartialCommit();
+    void acquireSnapshot();
     std::vector<std::pair<PageIndex, PageIndex>> readLogs() const;
 
 private:
@@ -1,24 +1,40 @@
 
 #pragma once
 
+#include <atomic>
 #include <mutex>
 #include <condition_variable>
+#include <thread>
 #include <cassert>
+#include <cstdint>
+#include <memory>
 
 namespace TxFs
 {
 
 ///////////////////////////////////////////////////////////////////////////////
+/// Reader/writer lock whose state is one atomic word: a writer bit, a writer-waiting bit and the number
+/// of readers. Readers lock and unlock with a single atomic operation as long as no writer holds or waits
+/// for the lock; only then they block on the mutex. A waiting writer keeps new readers out. With a spin
+/// count, lock() and lock_shared() retry that many times before they block.
 
-    class SharedLock
+class SharedLock
 {
+    static constexpr uint32_t Writer = 1U << 31;
+    static constexpr uint32_t WriterWaiting = 1U << 30;
+    static constexpr uint32_t ReaderMask = WriterWaiting - 1;
+
+    std::atomic<uint32_t> m_state = 0;
     std::mutex m_mutex;
     std::condition_variable m_cv;
-
-    bool m_exclusive = false;
-    int m_shared = 0;
+    uint32_t m_waitingWriters = 0; // guarded by m_mutex
+    unsigned m_spinCount;
 
 public:
+    explicit SharedLock(unsigned spinCount = 0)
+        : m_spinCount(spinCount)
+    {}
+
     void lock();
     bool try_lock();
     void unlock();
@@ -26,6 +42,10 @@ public:
     void lock_shared();
     bool try_lock_shared();
     void unlock_shared();
+
+private:
+    bool tryLockWaiting();
+    void notifyWaiting();
 };
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -66,67 +86,94 @@ public:
 
 inline void SharedLock::lock()
 {
+    if (try_lock())
+        return;
+    for (unsigned i = 0; i < m_spinCount; i++)
     {
-        std::unique_lock ul(m_mutex);
-        while (m_exclusive || m_shared > 0)
-            m_cv.wait(ul);
-        m_exclusive = true;
+        std::this_thread::yield();
+        if (try_lock())
+            return;
     }
+
+    std::unique_lock ul(m_mutex);
+    if (m_waitingWriters++ == 0)
+        m_state.fetch_or(WriterWaiting);
+    m_cv.wait(ul, [this] { return tryLockWaiting(); });
 }
 
 inline bool SharedLock::try_lock()
 {
-    {
-        std::unique_lock ul(m_mutex);
-        if (m_exclusive || m_shared > 0)
-            return false;
-        m_exclusive = true;
-    }
-    return true;
+    uint32_t expected = 0;
+    return m_state.compare_exchange_strong(expected, Writer, std::memory_order_acquire, std::memory_order_relaxed);
 }
 
 inline void SharedLock::unlock()
 {
-    {
-        std::unique_lock ul(m_mutex);
-        assert(m_exclusive && m_shared == 0);
-        m_exclusive = false;
-    }
-    m_cv.notify_all();
+    [[maybe_unused]] auto state = m_state.fetch_and(~Writer, std::memory_order_release);
+    assert((state & Writer) && (state & ReaderMask) == 0);
+    notifyWaiting();
 }
 
 inline void SharedLock::lock_shared()
 {
+    if (try_lock_shared())
+        return;
+    for (unsigned i = 0; i < m_spinCount; i++)
     {
-        std::unique_lock ul(m_mutex);
-        while (m_exclusive)
-            m_cv.wait(ul);
-        assert(!m_exclusive && m_shared >= 0);
-        m_shared++;
+        std::this_thread::yield();
+        if (try_lock_shared())
+            return;
     }
+
+    std::unique_lock ul(m_mutex);
+    m_cv.wait(ul, [this] { return try_lock_shared(); });
 }
 
 inline bool SharedLock::try_lock_shared()
 {
+    auto state = m_state.load(std::memory_order_relaxed);
+    while ((state & (Writer | WriterWaiting)) == 0)
     {
-        std::unique_lock ul(m_mutex);
-        if (m_exclusive)
-            return false;
-        assert(!m_exclusive && m_shared >= 0);
-        m_shared++;
+        assert((state & ReaderMask) != ReaderMask);
+        if (m_state.compare_exchange_weak(state, state + 1, std::memory_order_acquire, std::memory_order_relaxed))
+            return true;
     }
-    return true;
+    return false;
 }
 
 inline void SharedLock::unlock_shared()
+{
+    auto state = m_state.fetch_sub(1, std::memory_order_release);
+    assert((state & ReaderMask) > 0 && !(state & Writer));
+    if ((state & ReaderMask) == 1 && (state & WriterWaiting))
+        notifyWaiting();
+}
+
+/// Called by a waiting writer under m_mutex: takes the lock once it is free. The writer-waiting bit
+/// stays set for the other waiting writers.
+inline bool SharedLock::tryLockWaiting()
+{
+    auto state = m_state.load(std::memory_order_relaxed);
+    while ((state & (Writer | ReaderMask)) == 0)
+    {
+        uint32_t locked = m_waitingWriters > 1 ? Writer | WriterWaiting : Writer;
+        if (m_state.compare_exchange_weak(state, locked, std::memory_order_acquire, std::memory_order_relaxed))
+        {
+            m_waitingWriters--;
+            return true;
+        }
+    }
+    return false;
+}
+
+/// The state changed outside of m_mutex: taking it once makes sure that each waiter either sees the
+/// change or already waits for the notification.
+inline void SharedLock::notifyWaiting()
 {
     {
-        std::unique_lock ul(m_mutex);
-        m_shared--;
-        assert(!m_exclusive && m_shared >= 0);
+        std::scoped_lock lock(m_mutex);
     }
-    if (m_shared == 0)
-        m_cv.notify_all();
+    m_cv.notify_all();
 }
 
 ///////////////////////////////////////////////////////////////////////////////
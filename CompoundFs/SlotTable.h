@@ -0,0 +1,153 @@
+
+
+#pragma once
+
+#include "ByteString.h"
+#include "TableKeyCompare.h"
+
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#define TXFS_SLOT_TABLE_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace TxFs
+{
+
+///////////////////////////////////////////////////////////////////////////////
+/// The slot table sits at the end of a node's data area: n uint16_t offsets of the stored keys,
+/// followed by the n key heads of these keys. A key head holds the first 4 bytes of the stored key
+/// in big-endian order, so comparing heads as integers gives the key order unless they are equal.
+
+class SlotTable final
+{
+public:
+    static constexpr size_t SlotSize = sizeof(uint16_t) + sizeof(uint32_t);
+
+    SlotTable(uint8_t* begin, size_t nofItems) noexcept
+        : m_offsets(begin)
+        , m_heads(begin + nofItems * sizeof(uint16_t))
+        , m_nofItems(nofItems)
+    {}
+
+    static uint32_t keyHead(ByteStringView key) noexcept
+    {
+        uint32_t head = 0;
+        for (size_t i = 0; i < sizeof(head); i++)
+            head = (head << 8) | (i < key.size() ? key.data()[i] : 0);
+        return head;
+    }
+
+    uint32_t head(size_t index) const noexcept
+    {
+        uint32_t head;
+        std::memcpy(&head, m_heads + index * sizeof(uint32_t), sizeof(head));
+        return head;
+    }
+
+    void setHead(size_t index, uint32_t head) noexcept
+    {
+        std::memcpy(m_heads + index * sizeof(uint32_t), &head, sizeof(head));
+    }
+
+    /// The table grows by one slot towards lower addresses: the new begin is SlotSize bytes lower.
+    void insert(size_t index, uint16_t offset, uint32_t head) noexcept
+    {
+        assert(index <= m_nofItems);
+        auto offsets = m_offsets - SlotSize;
+        auto heads = m_heads - sizeof(uint32_t);
+        std::memmove(offsets, m_offsets, index * sizeof(uint16_t));
+        std::memmove(offsets + (index + 1) * sizeof(uint16_t), m_offsets + index * sizeof(uint16_t),
+                     (m_nofItems - index) * sizeof(uint16_t));
+        std::memcpy(offsets + index * sizeof(uint16_t), &offset, sizeof(offset));
+        std::memmove(heads, m_heads, index * sizeof(uint32_t));
+
+        m_offsets = offsets;
+        m_heads = heads;
+        m_nofItems++;
+        setHead(index, head);
+    }
+
+    /// The table shrinks by one slot: the new begin is SlotSize bytes higher.
+    void remove(size_t index) noexcept
+    {
+        assert(index < m_nofItems);
+        auto offsets = m_offsets + SlotSize;
+        auto heads = m_heads + sizeof(uint32_t);
+        std::memmove(heads, m_heads, index * sizeof(uint32_t));
+        std::memmove(offsets + index * sizeof(uint16_t), m_offsets + (index + 1) * sizeof(uint16_t),
+                     (m_nofItems - index - 1) * sizeof(uint16_t));
+        std::memmove(offsets, m_offsets, index * sizeof(uint16_t));
+
+        m_offsets = offsets;
+        m_heads = heads;
+        m_nofItems--;
+    }
+
+    /// First index whose key is not less than key. Most probes are decided by the heads; only keys
+    /// with the same head as key are compared in full.
+    size_t lowerBound(const uint8_t* data, ByteStringView key) const noexcept
+    {
+        auto keyHead = SlotTable::keyHead(key);
+        size_t begin = headBound(keyHead, false);
+        size_t end = headBound(keyHead, true);
+        if (begin == end)
+            return begin;
+
+        auto offsets = reinterpret_cast<const uint16_t*>(m_offsets);
+        TableKeyCompare keyCmp(data);
+        return std::lower_bound(offsets + begin, offsets + end, key, keyCmp) - offsets;
+    }
+
+private:
+    /// First index with a head not less (upper: greater) than keyHead. Binary search narrows the
+    /// range down to a few slots which are then counted in one sweep.
+    size_t headBound(uint32_t keyHead, bool upper) const noexcept
+    {
+        size_t begin = 0;
+        size_t end = m_nofItems;
+        while (end - begin > 16)
+        {
+            size_t middle = begin + (end - begin) / 2;
+            auto h = head(middle);
+            if (h < keyHead || (upper && h == keyHead))
+                begin = middle + 1;
+            else
+                end = middle;
+        }
+        return begin + countBelow(begin, end, keyHead, upper);
+    }
+
+    /// Number of heads in [begin, end) less than (upper: not greater than) keyHead.
+    size_t countBelow(size_t begin, size_t end, uint32_t keyHead, bool upper) const noexcept
+    {
+        size_t count = 0;
+        size_t i = begin;
+#ifdef TXFS_SLOT_TABLE_SSE2
+        // SSE2 only compares signed integers: flipping the sign bit preserves the unsigned order
+        static constexpr uint8_t bitCount[16] = { 0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4 };
+        const __m128i signBit = _mm_set1_epi32(INT32_MIN);
+        const __m128i k = _mm_xor_si128(_mm_set1_epi32(static_cast<int32_t>(keyHead)), signBit);
+        for (; i + 4 <= end; i += 4)
+        {
+            auto h = _mm_loadu_si128(reinterpret_cast<const __m128i*>(m_heads + i * sizeof(uint32_t)));
+            h = _mm_xor_si128(h, signBit);
+            auto below = _mm_cmplt_epi32(h, k);
+            if (upper)
+                below = _mm_or_si128(below, _mm_cmpeq_epi32(h, k));
+            count += bitCount[_mm_movemask_ps(_mm_castsi128_ps(below))];
+        }
+#endif
+        for (; i < end; i++)
+            count += (head(i) < keyHead || (upper && head(i) == keyHead)) ? 1 : 0;
+        return count;
+    }
+
+private:
+    uint8_t* m_offsets;
+    uint8_t* m_heads;
+    size_t m_nofItems;
+};
+
+}
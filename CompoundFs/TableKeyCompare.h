@@ -37,6 +37,44 @@ private:
     const uint8_t* m_data;
 };
 
+///////////////////////////////////////////////////////////////////////////////
+// Helpers for nodes that store the common prefix of their keys only once.
+
+inline size_t commonPrefixSize(ByteStringView lhs, ByteStringView rhs) noexcept
+{
+    auto [l, r] = std::mismatch(lhs.data(), lhs.end(), rhs.data(), rhs.end());
+    return l - lhs.data();
+}
+
+/// Orders key relative to all keys starting with prefix: negative if it sorts before all of them,
+/// zero if it starts with prefix and positive if it sorts after all of them.
+inline int comparePrefix(ByteStringView prefix, ByteStringView key) noexcept
+{
+    size_t common = commonPrefixSize(prefix, key);
+    if (common == prefix.size())
+        return 0;
+    if (common == key.size() || key.data()[common] < prefix.data()[common])
+        return -1;
+    return 1;
+}
+
+/// Streams the key head + tail without its first skip bytes.
+inline uint8_t* toStream(ByteStringView head, ByteStringView tail, size_t skip, uint8_t* dest) noexcept
+{
+    assert(skip <= head.size() + tail.size());
+    if (skip < head.size())
+        head = head.substr(skip);
+    else
+    {
+        tail = tail.substr(skip - head.size());
+        head = ByteStringView();
+    }
+
+    *dest++ = static_cast<uint8_t>(head.size() + tail.size());
+    dest = std::copy(head.data(), head.end(), dest);
+    return std::copy(tail.data(), tail.end(), dest);
+}
+
 
 }
 
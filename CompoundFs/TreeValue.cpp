@@ -30,7 +30,7 @@ std::string_view TreeValue::getTypeName() const
 
 void TreeValue::toStream(ByteStringStream& bss) const
 {
-    static_assert(sizeof(FileDescriptor) == 16);
+    static_assert(sizeof(FileDescriptor) == 2 * sizeof(PageIndex) + sizeof(uint64_t));
     static_assert(sizeof(Version) == 12);
 
     auto index = static_cast<uint8_t>(m_variant.index());
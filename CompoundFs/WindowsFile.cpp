@@ -57,11 +57,21 @@ void Seek(HANDLE handle, uint64_t position)
     pos.QuadPart = position;
     Win32::SetFilePointerEx(handle, pos, nullptr, FILE_BEGIN);
 }
+
+/// Positional read: does not depend on the file pointer shared by all threads.
+DWORD ReadAt(HANDLE handle, uint64_t position, void* buffer, DWORD size)
+{
+    OVERLAPPED overlapped {};
+    overlapped.Offset = static_cast<DWORD>(position);
+    overlapped.OffsetHigh = static_cast<DWORD>(position >> 32);
+    DWORD bytesRead;
+    Win32::ReadFile(handle, buffer, size, &bytesRead, &overlapped);
+    return bytesRead;
+}
 }
 
 namespace
 {
-constexpr uint64_t PageSize = 4096ULL;
 constexpr uint32_t BlockSize = 16 * 1024 * 1024;
 }
 
@@ -83,15 +93,18 @@ WindowsFile::WindowsFile(void* handle, bool readOnly)
         FileLockWindows { handle, FileLockPosition::GateBegin, FileLockPosition::GateEnd},
         FileLockWindows { handle, FileLockPosition::SharedBegin, FileLockPosition::SharedEnd},
         FileLockWindows { handle, FileLockPosition::WriteBegin, FileLockPosition::WriteEnd},
+        FileLockWindows { handle, FileLockPosition::SnapshotBegin, FileLockPosition::SnapshotEnd}
     }
 {
-    static constexpr int64_t MaxFileSize = 4096LL * int64_t(std::numeric_limits<uint32_t>::max() - 1LL);
+    static constexpr int64_t MaxFileSize = int64_t(PageSize) * int64_t(MaxPages);
     static_assert(MaxFileSize < FileLockPosition::GateBegin);
     static_assert(FileLockPosition::GateBegin < FileLockPosition::GateEnd);
     static_assert(MaxFileSize < FileLockPosition::SharedBegin);
     static_assert(FileLockPosition::SharedBegin < FileLockPosition::SharedEnd);
     static_assert(MaxFileSize < FileLockPosition::WriteBegin);
     static_assert(FileLockPosition::WriteBegin < FileLockPosition::WriteEnd);
+    static_assert(MaxFileSize < FileLockPosition::SnapshotBegin);
+    static_assert(FileLockPosition::SnapshotBegin < FileLockPosition::SnapshotEnd);
 }
 
 WindowsFile::WindowsFile(std::filesystem::path path, OpenMode mode)
@@ -100,7 +113,9 @@ WindowsFile::WindowsFile(std::filesystem::path path, OpenMode mode)
     if (mode == OpenMode::CreateAlways)
     {   // truncate with commit lock
         auto lock = commitAccess(writeAccess());
+        auto reclaimLock = reclaimAccess();
         truncate(0);
+        reclaimLock.release();
         lock.release();
     }
 }
@@ -220,10 +235,7 @@ uint8_t* WindowsFile::readPage(PageIndex id, size_t pageOffset, uint8_t* begin,
     if (fileSizeInPages() <= id)
         throw std::runtime_error("WindowsFile::readPage outside file");
 
-    Win32::Seek(m_handle, PageSize * id + pageOffset);
-    DWORD bytesRead;
-    Win32::ReadFile(m_handle, begin, static_cast<DWORD>(end - begin), &bytesRead, nullptr);
-
+    auto bytesRead = Win32::ReadAt(m_handle, PageSize * id + pageOffset, begin, static_cast<DWORD>(end - begin));
     return begin + bytesRead;
 }
 
@@ -232,25 +244,20 @@ uint8_t* WindowsFile::readPages(Interval iv, uint8_t* page) const
     if (fileSizeInPages() < iv.end())
         throw std::runtime_error("WindowsFile::readPages outside file");
 
-    Win32::Seek(m_handle, PageSize * iv.begin());
     auto end = page + (iv.length() * PageSize);
-    size_t bytesRead = readPagesInBlocks(page, end);
+    size_t bytesRead = readPagesInBlocks(PageSize * iv.begin(), page, end);
 
     return page + bytesRead;
 }
 
-size_t WindowsFile::readPagesInBlocks(uint8_t* begin, uint8_t* end) const
+size_t WindowsFile::readPagesInBlocks(uint64_t position, uint8_t* begin, uint8_t* end) const
 {
-    DWORD bytesRead;
     size_t totalBytesRead = 0;
     for (; (begin + BlockSize) < end; begin += BlockSize)
-    {
-        Win32::ReadFile(m_handle, begin, BlockSize, &bytesRead, nullptr);
-        totalBytesRead += bytesRead;
-    }
+        totalBytesRead += Win32::ReadAt(m_handle, position + totalBytesRead, begin, BlockSize);
 
-    Win32::ReadFile(m_handle, begin, static_cast<DWORD>(end - begin), &bytesRead, nullptr);
-    return totalBytesRead + bytesRead;
+    totalBytesRead += Win32::ReadAt(m_handle, position + totalBytesRead, begin, static_cast<DWORD>(end - begin));
+    return totalBytesRead;
 }
 
 size_t WindowsFile::fileSizeInPages() const
@@ -282,6 +289,11 @@ Lock WindowsFile::readAccess()
     return m_lockProtocol.readAccess();
 }
 
+std::optional<Lock> WindowsFile::tryReadAccess()
+{
+    return m_lockProtocol.tryReadAccess();
+}
+
 Lock WindowsFile::writeAccess()
 {
     return m_lockProtocol.writeAccess();
@@ -292,6 +304,21 @@ CommitLock WindowsFile::commitAccess(Lock&& writeLock)
     return m_lockProtocol.commitAccess(std::move(writeLock));
 }
 
+Lock WindowsFile::snapshotAccess()
+{
+    return m_lockProtocol.snapshotAccess();
+}
+
+Lock WindowsFile::reclaimAccess()
+{
+    return m_lockProtocol.reclaimAccess();
+}
+
+std::optional<Lock> WindowsFile::tryReclaimAccess()
+{
+    return m_lockProtocol.tryReclaimAccess();
+}
+
 std::filesystem::path WindowsFile::getFileName() const
 {
     std::wstring buffer(1028, 0);
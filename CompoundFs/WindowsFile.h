@@ -33,8 +33,12 @@ public:
 
     Lock defaultAccess() override;
     Lock readAccess() override;
+    std::optional<Lock> tryReadAccess() override;
     Lock writeAccess() override;
     CommitLock commitAccess(Lock&& writeLock) override;
+    Lock snapshotAccess() override;
+    Lock reclaimAccess() override;
+    std::optional<Lock> tryReclaimAccess() override;
 
     std::filesystem::path getFileName() const;
 
@@ -42,7 +46,7 @@ private:
     WindowsFile(void* handle, bool readOnly);
     static void* open(std::filesystem::path path, OpenMode mode);
     void writePagesInBlocks(const uint8_t* begin, const uint8_t* end);
-    size_t readPagesInBlocks(uint8_t* begin, uint8_t* end) const;
+    size_t readPagesInBlocks(uint64_t position, uint8_t* begin, uint8_t* end) const;
 
 private:
     void* m_handle;
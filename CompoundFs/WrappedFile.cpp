@@ -34,6 +34,11 @@ uint8_t* WrappedFile::readPages(Interval iv, uint8_t* page) const
     return m_wrappedFile->readPages(iv, page);
 }
 
+std::shared_ptr<const uint8_t> WrappedFile::pageMemory(PageIndex id) const
+{
+    return m_wrappedFile->pageMemory(id);
+}
+
 size_t WrappedFile::fileSizeInPages() const
 {
     return m_wrappedFile->fileSizeInPages();
@@ -59,6 +64,11 @@ Lock WrappedFile::readAccess()
     return m_wrappedFile->readAccess();
 }
 
+std::optional<Lock> WrappedFile::tryReadAccess()
+{
+    return m_wrappedFile->tryReadAccess();
+}
+
 Lock WrappedFile::writeAccess()
 {
     return m_wrappedFile->writeAccess();
@@ -69,3 +79,18 @@ CommitLock WrappedFile::commitAccess(Lock&& writeLock)
     return m_wrappedFile->commitAccess(std::move(writeLock));
 }
 
+Lock WrappedFile::snapshotAccess()
+{
+    return m_wrappedFile->snapshotAccess();
+}
+
+Lock WrappedFile::reclaimAccess()
+{
+    return m_wrappedFile->reclaimAccess();
+}
+
+std::optional<Lock> WrappedFile::tryReclaimAccess()
+{
+    return m_wrappedFile->tryReclaimAccess();
+}
+
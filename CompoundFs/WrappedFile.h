@@ -20,10 +20,15 @@ public:
     size_t fileSizeInPages() const override;
     void flushFile() override;
     void truncate(size_t numberOfPages) override;
+    std::shared_ptr<const uint8_t> pageMemory(PageIndex id) const override;
     Lock defaultAccess() override;
     Lock readAccess() override;
+    std::optional<Lock> tryReadAccess() override;
     Lock writeAccess() override;
     CommitLock commitAccess(Lock&& writeLock) override;
+    Lock snapshotAccess() override;
+    Lock reclaimAccess() override;
+    std::optional<Lock> tryReclaimAccess() override;
 
 private:
     std::shared_ptr<FileInterface> m_wrappedFile;
@@ -50,7 +50,7 @@ TYPED_TEST_P(FileInterfaceTester, truncateReducesFileSize)
 
 TYPED_TEST_P(FileInterfaceTester, readWriteOutsideCurrentFileSizeThrows)
 {
-    uint8_t buf[4096];
+    uint8_t buf[PageSize];
     this->m_fileInterface->newInterval(5);
 
     ASSERT_THROW(this->m_fileInterface->readPage(5, 0, buf, buf + 1), std::exception);
@@ -61,22 +61,22 @@ TYPED_TEST_P(FileInterfaceTester, readWriteOutsideCurrentFileSizeThrows)
 
 TYPED_TEST_P(FileInterfaceTester, readWritePageOverPageBounderiesThrows)
 {
-    uint8_t buf[4096];
+    uint8_t buf[PageSize];
     this->m_fileInterface->newInterval(5);
 
-    ASSERT_THROW(this->m_fileInterface->readPage(1, 4095, buf, buf + 2), std::exception);
-    ASSERT_THROW(this->m_fileInterface->writePage(1, 4095, buf, buf + 2), std::exception);
+    ASSERT_THROW(this->m_fileInterface->readPage(1, PageSize - 1, buf, buf + 2), std::exception);
+    ASSERT_THROW(this->m_fileInterface->writePage(1, PageSize - 1, buf, buf + 2), std::exception);
 }
 
 TYPED_TEST_P(FileInterfaceTester, readPagesReturnsDataOfWritePages)
 {
-    std::string outString(3 * 4096, 'X');
+    std::string outString(3 * PageSize, 'X');
     auto begin = (uint8_t*) outString.data();
     this->m_fileInterface->newInterval(5);
 
     ASSERT_EQ(this->m_fileInterface->writePages(Interval(1, 4), begin), begin + outString.size());
 
-    std::string inString(3 * 4096, 'Y');
+    std::string inString(3 * PageSize, 'Y');
     begin = (uint8_t*) inString.data();
     ASSERT_EQ(this->m_fileInterface->readPages(Interval(1, 4), begin), begin + inString.size());
     ASSERT_EQ(inString, outString);
@@ -84,7 +84,7 @@ TYPED_TEST_P(FileInterfaceTester, readPagesReturnsDataOfWritePages)
 
 TYPED_TEST_P(FileInterfaceTester, readPageReturnsDataOfWritePage)
 {
-    std::string outString(3 * 4096, 'X');
+    std::string outString(3 * PageSize, 'X');
     auto begin = (uint8_t*) outString.data();
     this->m_fileInterface->newInterval(5);
     this->m_fileInterface->writePages(Interval(1, 4), begin);
@@ -101,10 +101,10 @@ TYPED_TEST_P(FileInterfaceTester, readPageReturnsDataOfWritePage)
     ASSERT_EQ(this->m_fileInterface->readPage(2, 100, in, in + sizeof(in)), in + sizeof(in));
     ASSERT_EQ("0123456789X", ByteStringView(in, sizeof(in)));
 
-    ASSERT_EQ(this->m_fileInterface->readPage(3, 4096 - 11, in, in + sizeof(in)), in + sizeof(in));
+    ASSERT_EQ(this->m_fileInterface->readPage(3, PageSize - 11, in, in + sizeof(in)), in + sizeof(in));
     ASSERT_EQ("XXXXXXXXXXX", ByteStringView(in, sizeof(in)));
-    ASSERT_EQ(this->m_fileInterface->writePage(3, 4096 - 10, out.data(), out.end()), out.end());
-    ASSERT_EQ(this->m_fileInterface->readPage(3, 4096 - 11, in, in + sizeof(in)), in + sizeof(in));
+    ASSERT_EQ(this->m_fileInterface->writePage(3, PageSize - 10, out.data(), out.end()), out.end());
+    ASSERT_EQ(this->m_fileInterface->readPage(3, PageSize - 11, in, in + sizeof(in)), in + sizeof(in));
     ASSERT_EQ("X0123456789", ByteStringView(in, sizeof(in)));
 }
 
@@ -8,6 +8,7 @@
 #include "CompoundFs/ByteString.h"
 #include <algorithm>
 #include <random>
+#include <set>
 #include "CompoundFs/FileIo.h"
 
 using namespace TxFs;
@@ -18,6 +19,10 @@ using namespace TxFs;
 #define MANYITERATION 200000
 #endif
 
+// Key counts of tests that depend on the shape of the tree are chosen for 4K pages: scale them with the page
+// size so that the trees get the same number of leaves for every page size.
+constexpr size_t PageScale = PageSize / 4096;
+
 TEST(BTree, trivialFind)
 {
     auto cm = std::make_shared<CacheManager>(std::make_unique<MemoryFile>());
@@ -257,39 +262,42 @@ TEST(BTree, removeOfSomeValuesLeavesTheOthersIntact)
     BTree bt(cm);
 
     std::vector<std::string> keys;
+    const size_t nofKeys = 3000 * PageScale;
+    const size_t nofKept = 1000 * PageScale;
+    const size_t nofLeft = 800 * PageScale;
 
-    keys.reserve(3000);
-    for (size_t i = 0; i < 3000; i++)
+    keys.reserve(nofKeys);
+    for (size_t i = 0; i < nofKeys; i++)
     {
         keys.push_back(std::to_string(i));
         bt.insert(keys.back().c_str(), keys.back().c_str());
     }
 
     std::shuffle(keys.begin(), keys.end(), std::mt19937(std::random_device()()));
-    for (size_t i = 1000; i < 3000; i++)
+    for (size_t i = nofKept; i < nofKeys; i++)
     {
         auto res = bt.remove(keys[i].c_str());
         ASSERT_TRUE(res);
     }
     TxFs::clearPages(cm->getFileInterface(), bt.getFreePages());
 
-    for (size_t i = 0; i < 1000; i++)
+    for (size_t i = 0; i < nofKept; i++)
     {
         auto res = bt.find(keys[i].c_str());
         ASSERT_TRUE(res);
     }
 
-    for (size_t i = 1000; i < 3000; i++)
+    for (size_t i = nofKept; i < nofKeys; i++)
     {
         auto res = bt.find(keys[i].c_str());
         ASSERT_TRUE(!res);
     }
 
-    std::sort(keys.begin(), keys.begin() + 1000);
+    std::sort(keys.begin(), keys.begin() + nofKept);
 
     // make sure at least one page is completely empty
     auto size = bt.getFreePages().size();
-    for (size_t i = 800; i < 1000; i++)
+    for (size_t i = nofLeft; i < nofKept; i++)
     {
         auto res = bt.remove(keys[i].c_str());
         ASSERT_TRUE(res);
@@ -298,7 +306,7 @@ TEST(BTree, removeOfSomeValuesLeavesTheOthersIntact)
     clearPages(cm->getFileInterface(), bt.getFreePages());
 
     auto cursor = bt.begin("");
-    for (size_t i = 0; i < 800; i++)
+    for (size_t i = 0; i < nofLeft; i++)
     {
         ASSERT_EQ(cursor.key() , keys[i]);
         cursor = bt.next(cursor);
@@ -356,16 +364,19 @@ TEST(BTree, removeInReverseOrder)
     BTree bt(cm);
 
     std::vector<std::string> keys;
+    const size_t nofKeys = 3000 * PageScale;
+    const size_t nofKept = 1000 * PageScale;
 
-    keys.reserve(3000);
-    for (size_t i = 0; i < 3000; i++)
+    // keys of equal length are sorted like their numbers
+    keys.reserve(nofKeys);
+    for (size_t i = 0; i < nofKeys; i++)
     {
-        keys.push_back(std::to_string(i));
+        keys.push_back(std::to_string(1000000 + i));
         bt.insert(keys.back().c_str(), keys.back().c_str());
     }
 
     std::reverse(keys.begin(), keys.end());
-    for (size_t i = 1000; i < 3000; i++)
+    for (size_t i = nofKept; i < nofKeys; i++)
     {
         auto res = bt.remove(keys[i].c_str());
         ASSERT_TRUE(res);
@@ -374,7 +385,7 @@ TEST(BTree, removeInReverseOrder)
 
     std::reverse(keys.begin(), keys.end());
     auto cursor = bt.begin("");
-    for (size_t i = 2000; i < 3000; i++)
+    for (size_t i = nofKeys - nofKept; i < nofKeys; i++)
     {
         ASSERT_EQ(cursor.key() , keys[i]);
         ASSERT_EQ(bt.find(keys[i]) , cursor);
@@ -518,3 +529,521 @@ TEST(BTree, interruptedVisit)
     }));
     ASSERT_EQ(nodes, 5);
 }
+
+namespace
+{
+std::vector<std::pair<std::string, std::string>> sortedKeyValues(size_t count)
+{
+    std::vector<std::pair<std::string, std::string>> keyValues;
+    for (size_t i = 0; i < count; i++)
+    {
+        auto key = std::to_string(i);
+        keyValues.emplace_back(key, "value" + key);
+    }
+    std::sort(keyValues.begin(), keyValues.end());
+    return keyValues;
+}
+
+size_t countNodes(BTree& bt)
+{
+    size_t nodes = 0;
+    bt.visitAllNodes([&](const BTree::TreeNode&) {
+        nodes++;
+        return true;
+    });
+    return nodes;
+}
+}
+
+TEST(BTree, bulkLoadFindsAllKeysInOrder)
+{
+    auto keyValues = sortedKeyValues(MANYITERATION);
+    auto cm = std::make_shared<CacheManager>(std::make_unique<MemoryFile>());
+    BTree bt(cm);
+    bt.bulkLoad(keyValues.begin(), keyValues.end());
+
+    for (const auto& [key, value]: keyValues)
+        ASSERT_EQ(bt.find(key).value(), ByteStringView(value));
+
+    auto it = keyValues.begin();
+    for (auto cursor = bt.begin(""); cursor; cursor = bt.next(cursor), ++it)
+        ASSERT_EQ(cursor.key(), ByteStringView(it->first));
+    ASSERT_EQ(it, keyValues.end());
+}
+
+TEST(BTree, bulkLoadOfFewKeysStaysInRootLeaf)
+{
+    auto keyValues = sortedKeyValues(10);
+    auto cm = std::make_shared<CacheManager>(std::make_unique<MemoryFile>());
+    BTree bt(cm);
+    bt.bulkLoad(keyValues.begin(), keyValues.end());
+
+    ASSERT_EQ(countNodes(bt), 1);
+    ASSERT_EQ(bt.find("7").value(), ByteStringView("value7"));
+}
+
+TEST(BTree, bulkLoadPacksTighterThanInsert)
+{
+    auto keyValues = sortedKeyValues(MANYITERATION);
+    auto cm = std::make_shared<CacheManager>(std::make_unique<MemoryFile>());
+    BTree inserted(cm);
+    for (const auto& [key, value]: keyValues)
+        inserted.insert(key, value);
+
+    BTree loaded(cm, PageIdx::INVALID);
+    loaded.bulkLoad(keyValues.begin(), keyValues.end());
+
+    BTree halfLoaded(cm, PageIdx::INVALID);
+    halfLoaded.bulkLoad(keyValues.begin(), keyValues.end(), 0.5);
+
+    ASSERT_LT(countNodes(loaded), countNodes(inserted));
+    ASSERT_LT(countNodes(loaded), countNodes(halfLoaded));
+}
+
+TEST(BTree, bulkLoadThrowsOnUnsortedKeys)
+{
+    std::vector<std::pair<std::string, std::string>> keyValues { { "b", "" }, { "a", "" } };
+    auto cm = std::make_shared<CacheManager>(std::make_unique<MemoryFile>());
+    BTree bt(cm);
+    ASSERT_THROW(bt.bulkLoad(keyValues.begin(), keyValues.end()), std::runtime_error);
+    ASSERT_THROW(bt.bulkLoad(keyValues.begin(), keyValues.begin(), 0.), std::runtime_error);
+}
+
+TEST(BTree, bulkLoadFreesTheLoadedLeavesOnUnsortedKeys)
+{
+    auto keyValues = sortedKeyValues(MANYITERATION);
+    keyValues.push_back(keyValues.back()); // duplicate after many full leaves
+    auto cm = std::make_shared<CacheManager>(std::make_unique<MemoryFile>());
+    BTree bt(cm);
+    ASSERT_THROW(bt.bulkLoad(keyValues.begin(), keyValues.end()), std::runtime_error);
+
+    ASSERT_GT(bt.getFreePages().size(), 1U);
+    ASSERT_EQ(countNodes(bt), 1);
+    ASSERT_FALSE(bt.find(keyValues.front().first));
+}
+
+TEST(BTree, bulkLoadedTreeSupportsInsertAndRemove)
+{
+    auto keyValues = sortedKeyValues(MANYITERATION);
+    auto cm = std::make_shared<CacheManager>(std::make_unique<MemoryFile>());
+    BTree bt(cm);
+    bt.bulkLoad(keyValues.begin(), keyValues.end());
+
+    for (size_t i = 0; i < keyValues.size(); i += 2)
+        ASSERT_TRUE(bt.remove(keyValues[i].first));
+    bt.insert("new", "key");
+
+    for (size_t i = 0; i < keyValues.size(); i++)
+        ASSERT_EQ(!!bt.find(keyValues[i].first), i % 2 == 1);
+    ASSERT_EQ(bt.find("new").value(), ByteStringView("key"));
+}
+
+TEST(BTree, bulkLoadIntoNonEmptyTreeInserts)
+{
+    auto keyValues = sortedKeyValues(100);
+    auto cm = std::make_shared<CacheManager>(std::make_unique<MemoryFile>());
+    BTree bt(cm);
+    bt.insert("zzz", "last");
+    bt.bulkLoad(keyValues.begin(), keyValues.end());
+
+    ASSERT_EQ(bt.find("zzz").value(), ByteStringView("last"));
+    for (const auto& [key, value]: keyValues)
+        ASSERT_EQ(bt.find(key).value(), ByteStringView(value));
+}
+
+TEST(BTree, keysWithLongCommonPrefixesCanBeInsertedAndRemoved)
+{
+    std::vector<std::string> keys;
+    for (char folder = 'a'; folder < 'e'; folder++)
+        for (size_t i = 0; i < 2000; i++)
+            keys.push_back(std::string(150, folder) + std::to_string(i));
+    for (size_t i = 0; i < 100; i++)
+        keys.push_back(std::to_string(i));
+
+    auto rng = std::mt19937(std::random_device()());
+    std::shuffle(keys.begin(), keys.end(), rng);
+
+    auto cm = std::make_shared<CacheManager>(std::make_unique<MemoryFile>());
+    BTree bt(cm);
+    for (const auto& key: keys)
+        bt.insert(key, "value");
+
+    auto sorted = keys;
+    std::sort(sorted.begin(), sorted.end());
+    auto it = sorted.begin();
+    for (auto cursor = bt.begin(""); cursor; cursor = bt.next(cursor), ++it)
+        ASSERT_EQ(cursor.key(), ByteStringView(*it));
+    ASSERT_EQ(it, sorted.end());
+
+    std::shuffle(keys.begin(), keys.end(), rng);
+    for (size_t i = 0; i < keys.size(); i += 2)
+        ASSERT_TRUE(bt.remove(keys[i]));
+    for (size_t i = 0; i < keys.size(); i++)
+        ASSERT_EQ(!!bt.find(keys[i]), i % 2 == 1);
+
+    for (size_t i = 1; i < keys.size(); i += 2)
+        ASSERT_TRUE(bt.remove(keys[i]));
+    ASSERT_FALSE(bt.begin(""));
+}
+
+TEST(BTree, splitLinksLeavesInBothDirections)
+{
+    std::vector<std::string> keys;
+    for (size_t i = 0; i < 5000 * PageScale; i++)
+        keys.push_back(std::to_string(i));
+    std::shuffle(keys.begin(), keys.end(), std::mt19937(std::random_device()()));
+
+    auto cm = std::make_shared<CacheManager>(std::make_unique<MemoryFile>());
+    BTree bt(cm);
+    for (const auto& key: keys)
+        bt.insert(key, "");
+
+    std::vector<ConstPageDef<Leaf>> leaves;
+    bt.visitAllNodes([&](const BTree::TreeNode& tn) {
+        if (auto leaf = std::get_if<ConstPageDef<Leaf>>(&tn))
+            leaves.push_back(*leaf);
+        return true;
+    });
+
+    ASSERT_GT(leaves.size(), 2);
+    for (size_t i = 0; i < leaves.size(); i++)
+    {
+        ASSERT_EQ(leaves[i].m_page->getPrev(), i == 0 ? PageIdx::INVALID : leaves[i - 1].m_index);
+        ASSERT_EQ(leaves[i].m_page->getNext(), i + 1 == leaves.size() ? PageIdx::INVALID : leaves[i + 1].m_index);
+    }
+}
+
+TEST(BTree, insertBatchFindsAllKeys)
+{
+    std::vector<std::string> keys;
+    for (size_t i = 0; i < 10000; i++)
+        keys.push_back(std::to_string(i));
+    std::shuffle(keys.begin(), keys.end(), std::mt19937(std::random_device()()));
+
+    auto cm = std::make_shared<CacheManager>(std::make_unique<MemoryFile>());
+    BTree bt(cm);
+    for (size_t i = 0; i < keys.size(); i += 2)
+        bt.insert(keys[i], keys[i]);
+
+    std::vector<BTree::KeyValue> keyValues;
+    for (const auto& key: keys)
+        keyValues.emplace_back(key, key);
+    bt.insertBatch(keyValues);
+
+    std::sort(keys.begin(), keys.end());
+    auto cursor = bt.begin("");
+    for (const auto& key: keys)
+    {
+        ASSERT_EQ(cursor.key(), ByteStringView(key));
+        ASSERT_EQ(cursor.value(), ByteStringView(key));
+        cursor = bt.next(cursor);
+    }
+    ASSERT_FALSE(cursor);
+}
+
+TEST(BTree, insertBatchReportsResultForEachEntry)
+{
+    auto cm = std::make_shared<CacheManager>(std::make_unique<MemoryFile>());
+    BTree bt(cm);
+    bt.insert("b", "keep");
+    bt.insert("c", "old");
+
+    std::vector<BTree::KeyValue> keyValues { { "c", "new" }, { "a", "1" }, { "b", "2" }, { "a", "3" } };
+    std::vector<BTree::InsertResult> results(keyValues.size());
+    bt.insertBatch(
+        keyValues, [](ByteStringView value) { return value != ByteStringView("keep"); },
+        [&](size_t index, const BTree::InsertResult& res) { results[index] = res; });
+
+    ASSERT_EQ(std::get<BTree::Replaced>(results[0]).m_beforeValue, ByteString("old"));
+    ASSERT_TRUE(std::holds_alternative<BTree::Inserted>(results[1]));
+    ASSERT_TRUE(std::holds_alternative<BTree::Unchanged>(results[2]));
+    ASSERT_EQ(std::get<BTree::Replaced>(results[3]).m_beforeValue, ByteString("1"));
+
+    ASSERT_EQ(bt.find("a").value(), ByteStringView("3"));
+    ASSERT_EQ(bt.find("b").value(), ByteStringView("keep"));
+    ASSERT_EQ(bt.find("c").value(), ByteStringView("new"));
+}
+
+TEST(BTree, removeRangeRemovesKeysWithinRangeOnly)
+{
+    auto keyValues = sortedKeyValues(20000);
+    auto cm = std::make_shared<CacheManager>(std::make_unique<MemoryFile>());
+    BTree bt(cm);
+    for (const auto& [key, value]: keyValues)
+        bt.insert(key, value);
+
+    std::vector<std::string> reported;
+    auto removed = bt.removeRange("12", "17", [&](ByteStringView key, ByteStringView value) {
+        reported.emplace_back(reinterpret_cast<const char*>(key.data()), key.size());
+        ASSERT_EQ(ByteString("value" + reported.back()), value);
+    });
+
+    std::vector<std::string> expected;
+    for (const auto& [key, value]: keyValues)
+        if (key >= "12" && key < "17")
+            expected.push_back(key);
+    ASSERT_EQ(reported, expected);
+    ASSERT_EQ(removed, expected.size());
+    ASSERT_FALSE(bt.getFreePages().empty());
+
+    auto cursor = bt.begin("");
+    for (const auto& [key, value]: keyValues)
+    {
+        if (key >= "12" && key < "17")
+            continue;
+        ASSERT_EQ(cursor.key(), ByteStringView(key));
+        cursor = bt.next(cursor);
+    }
+    ASSERT_FALSE(cursor);
+}
+
+TEST(BTree, removeRangeKeepsTreeConsistent)
+{
+    auto rng = std::mt19937(std::random_device()());
+    auto keyValues = sortedKeyValues(30000);
+    std::vector<std::string> keys;
+    for (const auto& [key, value]: keyValues)
+        keys.push_back(key);
+
+    auto cm = std::make_shared<CacheManager>(std::make_unique<MemoryFile>());
+    BTree bt(cm);
+    for (const auto& key: keys)
+        bt.insert(key, "");
+
+    while (!keys.empty())
+    {
+        auto low = keys[rng() % keys.size()];
+        auto high = keys[rng() % keys.size()];
+        if (high < low)
+            std::swap(low, high);
+        auto begin = std::lower_bound(keys.begin(), keys.end(), low);
+        auto end = rng() % 4 ? std::lower_bound(keys.begin(), keys.end(), high) : keys.end();
+        auto removed = bt.removeRange(low, end == keys.end() ? "" : high);
+        ASSERT_EQ(removed, size_t(end - begin));
+        keys.erase(begin, end);
+
+        std::set<PageIndex> freePages(bt.getFreePages().begin(), bt.getFreePages().end());
+        ASSERT_EQ(freePages.size(), bt.getFreePages().size());
+        std::vector<ConstPageDef<Leaf>> leaves;
+        bt.visitAllNodes([&](const BTree::TreeNode& tn) {
+            std::visit([&](const auto& pageDef) { EXPECT_EQ(freePages.count(pageDef.m_index), 0); }, tn);
+            if (auto leaf = std::get_if<ConstPageDef<Leaf>>(&tn))
+                leaves.push_back(*leaf);
+            return true;
+        });
+        for (size_t i = 0; i < leaves.size(); i++)
+        {
+            ASSERT_EQ(leaves[i].m_page->getPrev(), i == 0 ? PageIdx::INVALID : leaves[i - 1].m_index);
+            ASSERT_EQ(leaves[i].m_page->getNext(), i + 1 == leaves.size() ? PageIdx::INVALID : leaves[i + 1].m_index);
+        }
+
+        auto cursor = bt.begin("");
+        for (const auto& key: keys)
+        {
+            ASSERT_EQ(cursor.key(), ByteStringView(key));
+            cursor = bt.next(cursor);
+        }
+        ASSERT_FALSE(cursor);
+        for (size_t i = 0; i < keys.size(); i += 97)
+            ASSERT_TRUE(bt.find(keys[i]));
+    }
+
+    bt.insert("key", "value");
+    ASSERT_EQ(bt.find("key").value(), ByteStringView("value"));
+}
+
+TEST(BTree, beginFindsFirstKeyNotLess)
+{
+    auto keyValues = sortedKeyValues(10000);
+    std::vector<std::string> keys;
+    auto cm = std::make_shared<CacheManager>(std::make_unique<MemoryFile>());
+    BTree bt(cm);
+    for (const auto& [key, value]: keyValues)
+    {
+        keys.push_back(key);
+        bt.insert(key, value);
+    }
+
+    for (size_t i = 0; i < 20000; i += 7)
+    {
+        auto probe = std::to_string(i) + "x";
+        auto expected = std::lower_bound(keys.begin(), keys.end(), probe);
+        auto cursor = bt.begin(probe);
+        ASSERT_EQ(bool(cursor), expected != keys.end());
+        if (cursor)
+        {
+            ASSERT_EQ(cursor.key(), ByteStringView(*expected));
+        }
+    }
+}
+
+TEST(BTree, prevIteratesBackwards)
+{
+    auto keyValues = sortedKeyValues(10000);
+    auto cm = std::make_shared<CacheManager>(std::make_unique<MemoryFile>());
+    BTree bt(cm);
+    for (const auto& [key, value]: keyValues)
+        bt.insert(key, value);
+
+    auto cursor = bt.find(keyValues.back().first);
+    for (auto it = keyValues.rbegin(); it != keyValues.rend(); ++it)
+    {
+        ASSERT_EQ(cursor.key(), ByteStringView(it->first));
+        ASSERT_EQ(cursor.value(), ByteStringView(it->second));
+        cursor = bt.prev(cursor);
+    }
+    ASSERT_FALSE(cursor);
+}
+
+TEST(BTree, boundedCursorStaysWithinRange)
+{
+    auto keyValues = sortedKeyValues(10000);
+    auto cm = std::make_shared<CacheManager>(std::make_unique<MemoryFile>());
+    BTree bt(cm);
+    for (const auto& [key, value]: keyValues)
+        bt.insert(key, value);
+
+    std::vector<std::string> expected;
+    for (const auto& [key, value]: keyValues)
+        if (key >= "3" && key < "4")
+            expected.push_back(key);
+
+    std::vector<std::string> forward;
+    auto cursor = bt.begin("3", "4");
+    for (; cursor; cursor = bt.next(cursor))
+        forward.emplace_back(reinterpret_cast<const char*>(cursor.key().data()), cursor.key().size());
+    ASSERT_EQ(forward, expected);
+
+    cursor = bt.seek(bt.begin("3", "4"), expected.back());
+    std::vector<std::string> backward;
+    for (; cursor; cursor = bt.prev(cursor))
+        backward.emplace_back(reinterpret_cast<const char*>(cursor.key().data()), cursor.key().size());
+    std::reverse(backward.begin(), backward.end());
+    ASSERT_EQ(backward, expected);
+
+    ASSERT_FALSE(bt.seek(bt.begin("3", "4"), "4"));
+    ASSERT_EQ(bt.seek(bt.begin("3", "4"), "2").key(), ByteStringView("3"));
+}
+
+TEST(BTree, seekFindsKeysAheadOfTheCursor)
+{
+    auto keyValues = sortedKeyValues(10000);
+    auto cm = std::make_shared<CacheManager>(std::make_unique<MemoryFile>());
+    BTree bt(cm);
+    for (const auto& [key, value]: keyValues)
+        bt.insert(key, value);
+
+    auto cursor = bt.begin("");
+    for (size_t i = 0; i < keyValues.size(); i += 13)
+    {
+        cursor = bt.seek(cursor, keyValues[i].first);
+        ASSERT_EQ(cursor.key(), ByteStringView(keyValues[i].first));
+    }
+    cursor = bt.seek(cursor, keyValues.front().first);
+    ASSERT_EQ(cursor.key(), ByteStringView(keyValues.front().first));
+}
+
+TEST(BTree, cursorRevalidatesAfterTreeChanged)
+{
+    auto keyValues = sortedKeyValues(10000);
+    auto cm = std::make_shared<CacheManager>(std::make_unique<MemoryFile>());
+    BTree bt(cm);
+    for (size_t i = 0; i < keyValues.size(); i += 2)
+        bt.insert(keyValues[i].first, keyValues[i].second);
+
+    auto cursor = bt.find(keyValues[1000].first);
+    for (size_t i = 1; i < keyValues.size(); i += 2)
+        bt.insert(keyValues[i].first, keyValues[i].second);
+    cursor = bt.next(cursor);
+    ASSERT_EQ(cursor.key(), ByteStringView(keyValues[1001].first));
+
+    bt.remove(keyValues[1001].first);
+    bt.remove(keyValues[1002].first);
+    cursor = bt.next(cursor);
+    ASSERT_EQ(cursor.key(), ByteStringView(keyValues[1003].first));
+
+    bt.remove(keyValues[1003].first);
+    cursor = bt.prev(cursor);
+    ASSERT_EQ(cursor.key(), ByteStringView(keyValues[1000].first));
+}
+
+TEST(BTree, countFollowsInsertsAndRemoves)
+{
+    auto rng = std::mt19937(std::random_device()());
+    auto cm = std::make_shared<CacheManager>(std::make_unique<MemoryFile>());
+    BTree bt(cm);
+    std::set<std::string> keys;
+
+    auto checkCounts = [&]() {
+        ASSERT_EQ(bt.count("", ""), keys.size());
+        for (int i = 0; i < 20; i++)
+        {
+            auto low = std::to_string(rng() % 20000);
+            auto high = std::to_string(rng() % 20000);
+            if (high < low)
+                std::swap(low, high);
+            auto expected = std::distance(keys.lower_bound(low), keys.lower_bound(high));
+            ASSERT_EQ(bt.count(low, high), size_t(expected));
+        }
+    };
+
+    for (int round = 0; round < 10; round++)
+    {
+        for (int i = 0; i < 3000; i++)
+        {
+            auto key = std::to_string(rng() % 20000);
+            bt.insert(key, std::string(rng() % 100, 'x'));
+            keys.insert(key);
+        }
+        checkCounts();
+
+        std::vector<std::string> batchKeys;
+        for (int i = 0; i < 1000; i++)
+            batchKeys.push_back(std::to_string(rng() % 20000));
+        std::vector<BTree::KeyValue> batch;
+        for (const auto& key: batchKeys)
+            batch.emplace_back(key, key);
+        bt.insertBatch(batch);
+        keys.insert(batchKeys.begin(), batchKeys.end());
+        checkCounts();
+
+        for (int i = 0; i < 2000; i++)
+        {
+            auto key = std::to_string(rng() % 20000);
+            bt.remove(key);
+            keys.erase(key);
+        }
+        checkCounts();
+
+        auto low = std::to_string(rng() % 20000);
+        auto high = std::to_string(rng() % 20000);
+        if (high < low)
+            std::swap(low, high);
+        bt.removeRange(low, high);
+        keys.erase(keys.lower_bound(low), keys.lower_bound(high));
+        checkCounts();
+    }
+}
+
+TEST(BTree, beginAtIndexPagesThroughRange)
+{
+    auto keyValues = sortedKeyValues(30000);
+    auto cm = std::make_shared<CacheManager>(std::make_unique<MemoryFile>());
+    BTree bt(cm);
+    bt.bulkLoad(keyValues.begin(), keyValues.end());
+
+    const auto& low = keyValues[1000].first;
+    const auto& high = keyValues[25000].first;
+    ASSERT_EQ(bt.count(low, high), 24000U);
+    for (size_t index = 0; index < 24000; index += 997)
+    {
+        auto cursor = bt.begin(low, high, index);
+        for (size_t i = index; i < std::min<size_t>(index + 50, 24000); i++)
+        {
+            ASSERT_EQ(cursor.key(), ByteStringView(keyValues[1000 + i].first));
+            cursor = bt.next(cursor);
+        }
+    }
+    ASSERT_FALSE(bt.begin(low, high, 24000));
+    ASSERT_EQ(bt.begin("", "", 29999).key(), ByteStringView(keyValues.back().first));
+}
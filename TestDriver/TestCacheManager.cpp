@@ -21,7 +21,7 @@ namespace
 
     void writeFirstByteFromPage(FileInterface* fi, PageIndex idx, uint8_t val)
     {
-        uint8_t page[4096];
+        uint8_t page[PageSize];
         page[0] = val;
         writeSignedPage(fi, idx, page);
     }
@@ -6,6 +6,8 @@
 #include "CompoundFs/CommitHandler.h"
 #include <random>
 #include <numeric>
+#include <future>
+#include <thread>
 #include "CompoundFs/FileIo.h"
 
 using namespace TxFs;
@@ -89,7 +91,7 @@ TEST(CommitHandler, copyDirtyPagesMakesACopyOfTheOriginalPage)
     {
         ASSERT_NE(orig , cpy);
         ASSERT_TRUE(TxFs::isEqualPage(cm.getFileInterface(), orig, cpy));
-        uint8_t buffer[4096];
+        uint8_t buffer[PageSize];
         TxFs::readSignedPage(cm.getFileInterface(), orig, buffer);
         ASSERT_TRUE(*buffer < 100);
     }
@@ -133,8 +135,236 @@ TEST(CommitHandler, updateDirtyPagesChangesOriginalPages)
     // do the test...
     for (auto orig: dirtyPageIds)
     {
-        uint8_t buffer[4096];
+        uint8_t buffer[PageSize];
         TxFs::readSignedPage(cm.getFileInterface(), orig, buffer);
         ASSERT_TRUE(*buffer > 100);
     }
 }
+
+namespace
+{
+struct CommitAccessCountingFile : MemoryFile
+{
+    bool m_commitAccess = false;
+    mutable size_t m_lockedReads = 0;
+    size_t m_lockedWrites = 0;
+
+    CommitLock commitAccess(Lock&& writeLock) override
+    {
+        m_commitAccess = true;
+        return MemoryFile::commitAccess(std::move(writeLock));
+    }
+
+    const uint8_t* writePage(PageIndex idx, size_t pageOffset, const uint8_t* begin, const uint8_t* end) override
+    {
+        m_lockedWrites += m_commitAccess;
+        return MemoryFile::writePage(idx, pageOffset, begin, end);
+    }
+
+    uint8_t* readPage(PageIndex idx, size_t pageOffset, uint8_t* begin, uint8_t* end) const override
+    {
+        m_lockedReads += m_commitAccess;
+        return MemoryFile::readPage(idx, pageOffset, begin, end);
+    }
+};
+}
+
+TEST(CommitHandler, exclusiveLockOnlyCoversUpdatesOfDirtyPages)
+{
+    std::unique_ptr<FileInterface> file = std::make_unique<CommitAccessCountingFile>();
+    {
+        // prepare some pages with contents
+        CacheManager cm(std::move(file));
+        for (int i = 0; i < 50; i++)
+        {
+            auto p = cm.newPage().m_page;
+            *p = i;
+        }
+        cm.trim(0);
+        file = cm.handOverFile();
+    }
+
+    CacheManager cm(std::move(file));
+
+    // some diverted dirty pages
+    for (int i = 10; i < 20; i++)
+    {
+        auto p = cm.makePageWritable(cm.loadPage(i)).m_page;
+        *p += 100;
+    }
+    cm.trim(0);
+
+    // some dirty pages in the cache
+    for (int i = 20; i < 30; i++)
+    {
+        auto p = cm.makePageWritable(cm.loadPage(i)).m_page;
+        *p += 100;
+    }
+
+    // some new pages
+    for (int i = 0; i < 10; i++)
+        cm.newPage();
+
+    auto stats = cm.getCommitHandler().commit();
+    auto countingFile = static_cast<CommitAccessCountingFile*>(cm.getFileInterface());
+    ASSERT_EQ(countingFile->m_lockedWrites, 20U);
+    ASSERT_EQ(countingFile->m_lockedReads, 0U);
+    ASSERT_GT(stats.m_exclusiveLockDuration.count(), 0);
+
+    for (int i = 10; i < 30; i++)
+    {
+        uint8_t buffer[PageSize];
+        TxFs::readSignedPage(cm.getFileInterface(), i, buffer);
+        ASSERT_EQ(*buffer, i + 100);
+    }
+}
+
+namespace
+{
+struct CommitRequestSignalingFile : MemoryFile
+{
+    std::promise<void> m_commitRequested;
+
+    CommitLock commitAccess(Lock&& writeLock) override
+    {
+        m_commitRequested.set_value();
+        return MemoryFile::commitAccess(std::move(writeLock));
+    }
+};
+}
+
+TEST(CommitHandler, freedPagesAreNotWrittenWhileReadersSeeThem)
+{
+    std::unique_ptr<FileInterface> file = std::make_unique<CommitRequestSignalingFile>();
+    {
+        CacheManager cm(std::move(file));
+        for (int i = 0; i < 10; i++)
+            *cm.newPage().m_page = uint8_t(i);
+        cm.trim(0);
+        file = cm.handOverFile();
+    }
+
+    CacheManager cm(std::move(file));
+    auto signalingFile = static_cast<CommitRequestSignalingFile*>(cm.getFileInterface());
+    *cm.makePageWritable(cm.loadPage(0)).m_page = 100;
+    *cm.asFreedPage(5).m_page = 105; // e.g. a page of a file deleted by this transaction
+
+    std::promise<void> readerStarted;
+    uint8_t seenByReader = 0;
+    std::thread reader([&] {
+        auto readLock = signalingFile->readAccess();
+        readerStarted.set_value();
+        signalingFile->m_commitRequested.get_future().wait();
+
+        uint8_t buffer[PageSize];
+        TxFs::readSignedPage(signalingFile, 5, buffer);
+        seenByReader = *buffer;
+    });
+    readerStarted.get_future().wait();
+    cm.getCommitHandler().commit();
+    reader.join();
+
+    EXPECT_EQ(seenByReader, 5);
+    uint8_t buffer[PageSize];
+    TxFs::readSignedPage(cm.getFileInterface(), 5, buffer);
+    EXPECT_EQ(*buffer, 105);
+}
+
+TEST(CommitHandler, commitLeavesCopiesToSnapshotReaders)
+{
+    CacheManager cm(std::make_unique<MemoryFile>());
+    for (int i = 0; i < 10; i++)
+        cm.newPage();
+    cm.getCommitHandler().commit();
+    auto fileSize = cm.getFileInterface()->fileSizeInPages();
+
+    for (int i = 0; i < 5; i++)
+        *cm.makePageWritable(cm.loadPage(i)).m_page = 42;
+    auto snapshotLock = cm.getFileInterface()->snapshotAccess();
+    auto stats = cm.getCommitHandler().commit(); // does not wait for the snapshot reader
+    ASSERT_EQ(stats.m_unreclaimedPages, 5U);
+    ASSERT_EQ(cm.getFileInterface()->fileSizeInPages(), fileSize + 5);
+
+    auto commitHandler = cm.getCommitHandler();
+    ASSERT_TRUE(commitHandler.reclaimCopies().empty());
+    ASSERT_EQ(cm.getFileInterface()->fileSizeInPages(), fileSize + 5);
+
+    snapshotLock.release();
+    ASSERT_TRUE(commitHandler.reclaimCopies().empty());
+    ASSERT_EQ(cm.getFileInterface()->fileSizeInPages(), fileSize);
+}
+
+TEST(CommitHandler, copiesTheFileGrewBeyondAreReturnedToBeFreed)
+{
+    CacheManager cm(std::make_unique<MemoryFile>());
+    for (int i = 0; i < 10; i++)
+        cm.newPage();
+    cm.getCommitHandler().commit();
+    auto fileSize = cm.getFileInterface()->fileSizeInPages();
+
+    for (int i = 0; i < 5; i++)
+        *cm.makePageWritable(cm.loadPage(i)).m_page = 42;
+    auto snapshotLock = cm.getFileInterface()->snapshotAccess();
+    cm.getCommitHandler().commit();
+    snapshotLock.release();
+
+    cm.newPage();
+    auto copies = cm.getCommitHandler().reclaimCopies();
+    ASSERT_EQ(copies, std::vector<Interval>({ Interval(PageIndex(fileSize), PageIndex(fileSize + 5)) }));
+}
+
+TEST(CommitHandler, writeNewPagesKeepsDirtyPagesInCache)
+{
+    CacheManager cm(std::make_unique<MemoryFile>());
+    for (int i = 0; i < 10; i++)
+        cm.newPage();
+    cm.getCommitHandler().commit();
+
+    for (int i = 0; i < 5; i++)
+        *cm.makePageWritable(cm.loadPage(i)).m_page = 42;
+    for (int i = 0; i < 5; i++)
+        *cm.newPage().m_page = 43;
+
+    auto commitHandler = cm.getCommitHandler();
+    commitHandler.writeNewPages();
+    auto dirtyPageIds = commitHandler.getDirtyPageIds();
+    std::sort(dirtyPageIds.begin(), dirtyPageIds.end());
+    ASSERT_EQ(dirtyPageIds, std::vector<PageIndex>({ 0, 1, 2, 3, 4 }));
+
+    for (PageIndex i = 10; i < 15; i++)
+    {
+        uint8_t buffer[PageSize];
+        TxFs::readSignedPage(cm.getFileInterface(), i, buffer);
+        ASSERT_EQ(*buffer, 43);
+    }
+}
+
+TEST(CommitHandler, commitReportsCommitStats)
+{
+    std::unique_ptr<FileInterface> file = std::make_unique<MemoryFile>();
+    {
+        CacheManager cm(std::move(file));
+        for (int i = 0; i < 50; i++)
+            cm.newPage();
+        cm.trim(0);
+        file = cm.handOverFile();
+    }
+
+    CacheManager cm(std::move(file));
+    for (int i = 10; i < 20; i++)
+        cm.makePageWritable(cm.loadPage(i));
+    cm.trim(0);
+    for (int i = 20; i < 30; i++)
+        cm.makePageWritable(cm.loadPage(i));
+    for (int i = 0; i < 5; i++)
+        cm.newPage();
+
+    auto stats = cm.getCommitHandler().commit();
+    ASSERT_EQ(stats.m_dirtyPages, 20U);
+    ASSERT_EQ(stats.m_divertedPages, 10U);
+    ASSERT_EQ(stats.m_stagedPages, 10U);
+    ASSERT_EQ(stats.m_copiedPages, 20U);
+    ASSERT_EQ(stats.m_newPages, 5U);
+    ASSERT_EQ(stats.m_logPages, 1U);
+    ASSERT_GE(stats.m_totalDuration, stats.m_lockWaitDuration + stats.m_exclusiveLockDuration);
+}
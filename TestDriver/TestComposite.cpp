@@ -64,12 +64,74 @@ TEST(Composite, openNonTxFsFileThrows)
     ASSERT_THROW(Composite::open<WrappedFile>(file), std::exception);
 }
 
+TEST(Composite, openFileOfOtherPageSizeThrows)
+{
+    constexpr size_t otherPageSize = PageSize == MinPageSize ? 4 * MinPageSize : MinPageSize;
+    std::vector<uint8_t> buffer(std::max(otherPageSize, PageSize));
+    std::fill_n(buffer.begin(), otherPageSize - sizeof(uint32_t), uint8_t('X'));
+    uint32_t checkSum = hash32(buffer.data(), otherPageSize - sizeof(checkSum));
+    memcpy(buffer.data() + otherPageSize - sizeof(checkSum), &checkSum, sizeof(checkSum));
+
+    std::shared_ptr<FileInterface> file = std::make_shared<MemoryFile>();
+    auto iv = file->newInterval(buffer.size() / PageSize);
+    file->writePages(iv, buffer.data());
+
+    try
+    {
+        Composite::open<WrappedFile>(file);
+        FAIL();
+    }
+    catch (const std::runtime_error& e)
+    {
+        ASSERT_NE(std::string(e.what()).find("page size of " + std::to_string(otherPageSize)), std::string::npos);
+    }
+}
+
+TEST(Composite, openBaselineFormatFileThrows)
+{
+    // non-zero bytes of a file written by directory format 0, holding the attribute "attribute"
+    const std::vector<std::pair<size_t, std::vector<uint8_t>>> baselineFile = {
+        { 0, { 0x47, 0x00, 0xeb, 0x0f, 0x01, 0x0f, 0x01 } },
+        { 10, { 0x43, 0x6f, 0x6d, 0x6d, 0x69, 0x74, 0x42, 0x6c, 0x6f, 0x63, 0x6b, 0x1e, 0x06 } },
+        { 32, { 0x01 } },
+        { 36, { 0x01 } },
+        { 40, { 0x02 } },
+        { 48, { 0x02 } },
+        { 52, { 0x0d } },
+        { 57, { 0x61, 0x74, 0x74, 0x72, 0x69, 0x62, 0x75, 0x74, 0x65, 0x09, 0x06, 0x62, 0x61, 0x73, 0x65, 0x6c,
+                0x69, 0x6e, 0x65 } },
+        { 4080, { 0x2f } },
+        { 4084, { 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0x6c, 0x04, 0x36, 0x83 } },
+        { 4098, { 0xf4, 0x0f, 0xff, 0xff, 0xff, 0xff } },
+        { 8188, { 0x2a, 0xbb, 0x0d, 0xc5 } },
+    };
+    std::vector<uint8_t> buffer(std::max(2 * MinPageSize, PageSize));
+    for (auto& [offset, bytes]: baselineFile)
+        std::copy(bytes.begin(), bytes.end(), buffer.begin() + offset);
+
+    std::shared_ptr<FileInterface> file = std::make_shared<MemoryFile>();
+    auto iv = file->newInterval(buffer.size() / PageSize);
+    file->writePages(iv, buffer.data());
+
+    try
+    {
+        Composite::open<WrappedFile>(file);
+        FAIL();
+    }
+    catch (const std::runtime_error& e)
+    {
+        auto expected = PageSize == MinPageSize ? "directory format 0" : "page size of 4096";
+        ASSERT_NE(std::string(e.what()).find(expected), std::string::npos);
+    }
+}
+
 struct CompositeTester : ::testing::Test
 {
     using MemoryFile = LockedMemoryFile<DebugSharedLock, DebugSharedLock>;
     DebugSharedLock m_gateLock;
     DebugSharedLock m_sharedLock;
     DebugSharedLock m_writerLock;
+    DebugSharedLock m_snapshotLock;
     std::shared_ptr<FileInterface> m_file;
     FileSystemUtility m_helper;
 
@@ -78,7 +140,9 @@ struct CompositeTester : ::testing::Test
         auto gate = m_gateLock;
         auto shared = m_sharedLock;
         auto writer = m_writerLock;
-        auto lp = std::make_unique<MemoryFile::TLockProtocol>(std::move(gate), std::move(shared), std::move(writer));
+        auto snapshot = m_snapshotLock;
+        auto lp = std::make_unique<MemoryFile::TLockProtocol>(std::move(gate), std::move(shared), std::move(writer),
+                                                              std::move(snapshot));
         m_file = std::make_shared<MemoryFile>(std::move(lp));
         auto fsys = Composite::open<WrappedFile>(m_file);
         m_helper.fillFileSystem(fsys);
@@ -301,3 +365,50 @@ TEST_F(CompositeTester, CommitUnlocksFileAfterTruncate)
     m_sharedLock.unlockRelease(); // release the thread
     th.join();                    // wait until thread completed
 }
+
+TEST_F(CompositeTester, openSnapshotWithoutCommitSeesCommittedState)
+{
+    auto fsys = Composite::openSnapshot<WrappedFile>(m_file);
+    m_helper.checkFileSystem(fsys);
+}
+
+TEST_F(CompositeTester, SnapshotReaderDoesNotWaitForCommit)
+{
+    auto fsys = Composite::open<WrappedFile>(m_file);
+    fsys.remove("test");
+    m_sharedLock.lock_shared();             // fsys cannot commit - blocks on commit lock
+    std::thread th([&]() { fsys.commit(); });
+    m_sharedLock.waitForWaiting(1);         // wait until it blocks
+
+    auto snapshot = std::make_unique<FileSystem>(Composite::openSnapshot<WrappedFile>(m_file));
+    EXPECT_TRUE(snapshot->getAttribute("test/attribute")); // sees the state before the commit
+
+    m_sharedLock.unlock_shared();           // let fsys commit
+    th.join();                              // the commit does not wait for the snapshot reader
+    auto sizeWithCopies = m_file->fileSizeInPages();
+    ASSERT_TRUE(snapshot->getAttribute("test/attribute"));
+    m_helper.checkFileSystem(*snapshot);
+    {
+        auto fsys2 = Composite::openReadOnly<WrappedFile>(m_file);
+        ASSERT_FALSE(fsys2.getAttribute("test/attribute"));
+    }
+
+    snapshot.reset();
+    fsys.commit(); // removes the copies left for the snapshot reader
+    ASSERT_LT(m_file->fileSizeInPages(), sizeWithCopies);
+    auto fsys2 = Composite::openSnapshot<WrappedFile>(m_file);
+    ASSERT_FALSE(fsys2.getAttribute("test/attribute"));
+}
+
+TEST_F(CompositeTester, CopiesLeftForSnapshotReadersAreRemovedOnClose)
+{
+    auto fsys = std::make_unique<FileSystem>(Composite::open<WrappedFile>(m_file));
+    fsys->remove("test");
+    auto snapshotLock = m_file->snapshotAccess(); // like a snapshot reader working on the copies
+    fsys->commit();
+    auto sizeWithCopies = m_file->fileSizeInPages();
+
+    snapshotLock.release();
+    fsys.reset();
+    ASSERT_LT(m_file->fileSizeInPages(), sizeWithCopies);
+}
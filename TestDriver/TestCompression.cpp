@@ -0,0 +1,126 @@
+
+
+#include <gtest/gtest.h>
+#include "CompoundFs/Compression.h"
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+using namespace TxFs;
+
+namespace
+{
+std::vector<uint8_t> compressVector(const std::vector<uint8_t>& data)
+{
+    std::vector<uint8_t> compressed(maxCompressedSize(data.size()));
+    compressed.resize(compress(data.data(), data.data() + data.size(), compressed.data()));
+    return compressed;
+}
+
+std::vector<uint8_t> decompressVector(const std::vector<uint8_t>& compressed, size_t size)
+{
+    std::vector<uint8_t> data(size);
+    auto end = decompress(compressed.data(), compressed.data() + compressed.size(), data.data(),
+                          data.data() + data.size());
+    data.resize(end - data.data());
+    return data;
+}
+
+std::vector<uint8_t> makeText(size_t size)
+{
+    const std::string words[] = { "page ", "index ", "file ", "table ", "commit ", "folder ", "tree " };
+    std::minstd_rand rnd(size);
+    std::vector<uint8_t> data;
+    while (data.size() < size)
+    {
+        const auto& word = words[rnd() % std::size(words)];
+        data.insert(data.end(), word.begin(), word.end());
+    }
+    data.resize(size);
+    return data;
+}
+
+/// A literal run, a long overlapping match, a match 640 bytes back and the closing literals.
+std::vector<uint8_t> makeReferenceData()
+{
+    std::vector<uint8_t> data;
+    for (uint8_t i = 0; i < 40; i++)
+        data.push_back(i);
+    data.insert(data.end(), 600, 'y');
+    data.insert(data.end(), data.begin(), data.begin() + 40);
+    const std::string end = "end of data";
+    data.insert(data.end(), end.begin(), end.end());
+    return data;
+}
+
+/// Output of LZ4_compress_default() of the reference implementation (lz4 1.9.4).
+const std::vector<uint8_t> ReferenceRun = { 0x1f, 0x78, 0x01, 0x00, 0x4b, 0x50, 0x78, 0x78, 0x78, 0x78, 0x78 };
+const std::vector<uint8_t> ReferenceData = {
+    0xff, 0x1a, 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d,
+    0x0e, 0x0f, 0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16, 0x17, 0x18, 0x19, 0x1a, 0x1b, 0x1c, 0x1d,
+    0x1e, 0x1f, 0x20, 0x21, 0x22, 0x23, 0x24, 0x25, 0x26, 0x27, 0x79, 0x01, 0x00, 0xff, 0xff, 0x46,
+    0x0f, 0x80, 0x02, 0x15, 0xb0, 0x65, 0x6e, 0x64, 0x20, 0x6f, 0x66, 0x20, 0x64, 0x61, 0x74, 0x61
+};
+}
+
+TEST(Compression, repetitiveDataGetsSmaller)
+{
+    auto data = makeText(ChunkSize);
+    auto compressed = compressVector(data);
+    ASSERT_LT(compressed.size(), data.size() / 2);
+    ASSERT_EQ(decompressVector(compressed, data.size()), data);
+}
+
+TEST(Compression, longRunsUseOverlappingMatches)
+{
+    std::vector<uint8_t> data(10000, 'x');
+    auto compressed = compressVector(data);
+    ASSERT_LT(compressed.size(), 100U);
+    ASSERT_EQ(decompressVector(compressed, data.size()), data);
+}
+
+TEST(Compression, randomDataStaysWithinBound)
+{
+    std::minstd_rand rnd(7);
+    std::vector<uint8_t> data(ChunkSize);
+    for (auto& byte: data)
+        byte = uint8_t(rnd());
+    auto compressed = compressVector(data);
+    ASSERT_LE(compressed.size(), maxCompressedSize(data.size()));
+    ASSERT_EQ(decompressVector(compressed, data.size()), data);
+}
+
+TEST(Compression, smallInputsRoundTrip)
+{
+    for (size_t size = 0; size < 40; size++)
+    {
+        auto data = makeText(size);
+        ASSERT_EQ(decompressVector(compressVector(data), data.size()), data);
+    }
+}
+
+TEST(Compression, decompressesOutputOfReferenceLz4)
+{
+    ASSERT_EQ(decompressVector(ReferenceRun, 100), std::vector<uint8_t>(100, 'x'));
+    ASSERT_EQ(decompressVector(ReferenceData, 691), makeReferenceData());
+}
+
+TEST(Compression, compressesLikeReferenceLz4)
+{
+    ASSERT_EQ(compressVector(std::vector<uint8_t>(100, 'x')), ReferenceRun);
+    ASSERT_EQ(compressVector(makeReferenceData()), ReferenceData);
+}
+
+TEST(Compression, corruptDataThrows)
+{
+    auto data = makeText(1000);
+    auto compressed = compressVector(data);
+    ASSERT_THROW(decompressVector(compressed, data.size() - 1), std::runtime_error);
+
+    // one literal followed by a match that starts before the output
+    std::vector<uint8_t> badOffset { 0x10, 'a', 0x05, 0x00 };
+    ASSERT_THROW(decompressVector(badOffset, 100), std::runtime_error);
+
+    compressed.resize(compressed.size() / 2);
+    ASSERT_NE(decompressVector(compressed, data.size()), data);
+}
@@ -71,6 +71,41 @@ TEST(DirectoryStructure, makeSubFolder)
     ASSERT_EQ(subsub , ds.subFolder(DirectoryKey(*subFolder, "subsub")));
 }
 
+TEST(DirectoryStructure, renamedFolderIsNotFoundUnderOldName)
+{
+    DirectoryStructure ds = makeDirectoryStructure();
+
+    auto subFolder = ds.makeSubFolder(DirectoryKey("subFolder"));
+    ASSERT_EQ(ds.subFolder(DirectoryKey("subFolder")), subFolder);
+    ASSERT_TRUE(ds.rename(DirectoryKey("subFolder"), DirectoryKey("renamed")));
+    ASSERT_FALSE(ds.subFolder(DirectoryKey("subFolder")));
+    ASSERT_EQ(ds.subFolder(DirectoryKey("renamed")), subFolder);
+    ASSERT_NE(ds.makeSubFolder(DirectoryKey("subFolder")), subFolder);
+}
+
+TEST(DirectoryStructure, rollbackForgetsFolders)
+{
+    DirectoryStructure ds = makeDirectoryStructure();
+    ds.commit();
+
+    auto subFolder = ds.makeSubFolder(DirectoryKey("subFolder"));
+    ASSERT_EQ(ds.subFolder(DirectoryKey("subFolder")), subFolder);
+    ds.rollback();
+    ASSERT_FALSE(ds.subFolder(DirectoryKey("subFolder")));
+}
+
+TEST(DirectoryStructure, removedFolderIsNotFound)
+{
+    DirectoryStructure ds = makeDirectoryStructure();
+
+    auto subFolder = ds.makeSubFolder(DirectoryKey("subFolder")).value();
+    ds.makeSubFolder(DirectoryKey(subFolder, "subsub"));
+    ASSERT_TRUE(ds.subFolder(DirectoryKey(subFolder, "subsub")));
+    ds.remove(DirectoryKey("subFolder"));
+    ASSERT_FALSE(ds.subFolder(DirectoryKey(subFolder, "subsub")));
+    ASSERT_FALSE(ds.subFolder(DirectoryKey("subFolder")));
+}
+
 TEST(DirectoryStructure, simpleRemove)
 {
     DirectoryStructure ds = makeDirectoryStructure();
@@ -150,6 +185,30 @@ TEST(DirectoryStructure, addGetAttribute)
     ASSERT_EQ(res->get<double>(), 42.42);
 }
 
+TEST(DirectoryStructure, addGetLargeAttribute)
+{
+    DirectoryStructure ds = makeDirectoryStructure();
+
+    std::string large(3 * PageSize + 17, 'x');
+    ASSERT_TRUE(ds.addAttribute(DirectoryKey("attrib"), large));
+    auto res = ds.getAttribute(DirectoryKey("attrib"));
+    ASSERT_TRUE(res);
+    ASSERT_EQ(res->get<std::string>(), large);
+    ASSERT_EQ(ds.find(DirectoryKey("attrib")).value().get<std::string>(), large);
+
+    ASSERT_TRUE(ds.addAttribute(DirectoryKey("attrib"), "small"));
+    ASSERT_EQ(ds.getAttribute(DirectoryKey("attrib"))->get<std::string>(), "small");
+}
+
+TEST(DirectoryStructure, largeAttributesDoNotReplaceFolders)
+{
+    DirectoryStructure ds = makeDirectoryStructure();
+
+    ds.makeSubFolder(DirectoryKey("subFolder"));
+    ASSERT_FALSE(ds.addAttribute(DirectoryKey("subFolder"), std::string(PageSize, 'x')));
+    ASSERT_FALSE(ds.getAttribute(DirectoryKey("subFolder")));
+}
+
 TEST(DirectoryStructure, attributesDoNotReplaceFolders)
 {
     DirectoryStructure ds = makeDirectoryStructure();
@@ -216,6 +275,35 @@ TEST(DirectoryStructure, nonFileEntryPreventsCreationOfFile)
     ASSERT_TRUE(!ds.updateFile(dkey, desc));
 }
 
+TEST(DirectoryStructure, addAttributesDoesNotReplaceFilesOrFolders)
+{
+    DirectoryStructure ds = makeDirectoryStructure();
+    ds.makeSubFolder(DirectoryKey("folder"));
+    ds.createFile(DirectoryKey("test.file"));
+
+    std::vector<std::pair<DirectoryKey, TreeValue>> attributes { { DirectoryKey("folder"), 1.1 },
+                                                                  { DirectoryKey("attrib"), "test" },
+                                                                  { DirectoryKey("test.file"), 2.2 } };
+    ASSERT_EQ(ds.addAttributes(attributes), 1);
+    ASSERT_EQ(ds.getAttribute(DirectoryKey("attrib"))->get<std::string>(), "test");
+    ASSERT_TRUE(ds.subFolder(DirectoryKey("folder")));
+    ASSERT_TRUE(ds.openFile(DirectoryKey("test.file")));
+}
+
+TEST(DirectoryStructure, createFilesReplacesFilesOnly)
+{
+    DirectoryStructure ds = makeDirectoryStructure();
+    ds.addAttribute(DirectoryKey("attrib"), 1.1);
+    ds.createFile(DirectoryKey("test.file"));
+    FileDescriptor desc(100);
+    ds.updateFile(DirectoryKey("test.file"), desc);
+
+    std::vector<DirectoryKey> dkeys { DirectoryKey("test.file"), DirectoryKey("attrib"), DirectoryKey("new.file") };
+    ASSERT_EQ(ds.createFiles(dkeys), std::vector<bool>({ true, false, true }));
+    ASSERT_EQ(*ds.openFile(DirectoryKey("test.file")), FileDescriptor());
+    ASSERT_EQ(*ds.openFile(DirectoryKey("new.file")), FileDescriptor());
+}
+
 TEST(DirectoryStructure, storeCommitBlockEqualsRetrieveCommitBlock)
 {
     auto ds = makeDirectoryStructure();
@@ -225,6 +313,36 @@ TEST(DirectoryStructure, storeCommitBlockEqualsRetrieveCommitBlock)
     ASSERT_EQ(in.m_freeStoreDescriptor, out.m_freeStoreDescriptor);
     ASSERT_EQ(in.m_compositSize, out.m_compositSize);
     ASSERT_EQ(in.m_maxFolderId, out.m_maxFolderId);
+    ASSERT_EQ(in.m_pageSize, PageSize);
+    ASSERT_EQ(in.m_pageIndexSize, sizeof(PageIndex));
+    ASSERT_EQ(in.m_directoryFormat, DirectoryFormat);
+}
+
+TEST(DirectoryStructure, initThrowsOnDifferentPageSize)
+{
+    auto ds = makeDirectoryStructure();
+    CommitBlock cb;
+    cb.m_pageSize = PageSize * 2;
+    ds.storeCommitBlock(cb);
+    ASSERT_THROW(ds.init(), std::runtime_error);
+}
+
+TEST(DirectoryStructure, initThrowsOnDifferentPageIndexSize)
+{
+    auto ds = makeDirectoryStructure();
+    CommitBlock cb;
+    cb.m_pageIndexSize = sizeof(PageIndex) == sizeof(uint32_t) ? sizeof(uint64_t) : sizeof(uint32_t);
+    ds.storeCommitBlock(cb);
+    ASSERT_THROW(ds.init(), std::runtime_error);
+}
+
+TEST(DirectoryStructure, initThrowsOnDifferentDirectoryFormat)
+{
+    auto ds = makeDirectoryStructure();
+    CommitBlock cb;
+    cb.m_directoryFormat = DirectoryFormat + 1;
+    ds.storeCommitBlock(cb);
+    ASSERT_THROW(ds.init(), std::runtime_error);
 }
 
 TEST(DirectoryStructure, EmptyFolderReturnsNullCursorOnBegin)
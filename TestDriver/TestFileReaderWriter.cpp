@@ -4,6 +4,7 @@
 #include "CompoundFs/MemoryFile.h"
 #include "CompoundFs/FileReader.h"
 #include "CompoundFs/FileWriter.h"
+#include "CompoundFs/FileTable.h"
 #include "CompoundFs/ByteString.h"
 #include <string>
 #include <algorithm>
@@ -11,6 +12,16 @@
 
 using namespace TxFs;
 
+// number of single page intervals a FileTable holds, with 64 bit indices if the pages are close to each other
+#ifdef TXFS_PAGE_INDEX_64
+constexpr size_t SinglePagesPerFileTable = FileTable::DataSize;
+#else
+constexpr size_t SinglePagesPerFileTable = FileTable::DataSize / sizeof(PageIndex);
+#endif
+
+// number of small writes that make a bit more than one page
+constexpr size_t SmallWrites = 1000 * (PageSize / 4096);
+
 TEST(FileWriter, CtorCreatesEmptyFileDesc)
 {
     auto cm = std::make_shared<CacheManager>(std::make_unique<MemoryFile>());
@@ -123,12 +134,12 @@ TEST(FileWriter, SmallWritesOverPageBoundery)
 
     FileWriter f(cm);
     ByteStringView data("Test0");
-    for (int i = 0; i < 1000; i++)
+    for (size_t i = 0; i < SmallWrites; i++)
         f.write(data.data(), data.end());
 
     FileDescriptor fd = f.close();
     ASSERT_EQ(fd.m_first , fd.m_last);
-    ASSERT_EQ(fd.m_fileSize , 1000ULL * data.size());
+    ASSERT_EQ(fd.m_fileSize , SmallWrites * data.size());
 
     auto fileTablePage = tcm.loadPage<FileTable>(fd.m_last);
     ASSERT_EQ(fileTablePage.m_index , fd.m_last);
@@ -146,20 +157,20 @@ TEST(FileWriter, SmallWritesWithAppendOverPageBoundery)
 
     FileWriter f(cm);
     ByteStringView data("Test0");
-    for (int i = 0; i < 1000; i++)
+    for (size_t i = 0; i < SmallWrites; i++)
         f.write(data.data(), data.end());
 
     FileDescriptor fd = f.close();
     ASSERT_EQ(fd.m_first , fd.m_last);
-    ASSERT_EQ(fd.m_fileSize , 1000ULL * data.size());
+    ASSERT_EQ(fd.m_fileSize , SmallWrites * data.size());
 
     f.openAppend(fd);
-    for (int i = 0; i < 1000; i++)
+    for (size_t i = 0; i < SmallWrites; i++)
         f.write(data.data(), data.end());
 
     fd = f.close();
     ASSERT_EQ(fd.m_first , fd.m_last);
-    ASSERT_EQ(fd.m_fileSize , 2000ULL * data.size());
+    ASSERT_EQ(fd.m_fileSize , 2 * SmallWrites * data.size());
 
     auto fileTablePage = tcm.loadPage<FileTable>(fd.m_last);
     ASSERT_EQ(fileTablePage.m_index , fd.m_last);
@@ -173,7 +184,7 @@ TEST(FileWriter, SmallWritesWithAppendOverPageBoundery)
 
 TEST(FileWriter, PageSizeWrites)
 {
-    std::string str(4096, 'X');
+    std::string str(PageSize, 'X');
     auto cm = std::make_shared<CacheManager>(std::make_unique<MemoryFile>());
     TypedCacheManager tcm(cm);
 
@@ -193,7 +204,7 @@ TEST(FileWriter, PageSizeWrites)
 
 TEST(FileWriter, OverPageSizeWrites)
 {
-    std::string str(4097, 'X');
+    std::string str(PageSize + 1, 'X');
     auto cm = std::make_shared<CacheManager>(std::make_unique<MemoryFile>());
     TypedCacheManager tcm(cm);
 
@@ -213,7 +224,7 @@ TEST(FileWriter, OverPageSizeWrites)
 
 TEST(FileWriter, UnderPageSizeWrites)
 {
-    std::string str(4095, 'X');
+    std::string str(PageSize - 1, 'X');
     auto cm = std::make_shared<CacheManager>(std::make_unique<MemoryFile>());
     TypedCacheManager tcm(cm);
 
@@ -233,7 +244,7 @@ TEST(FileWriter, UnderPageSizeWrites)
 
 TEST(FileWriter, LargePageSizeWrites)
 {
-    std::string str(8192, 'X');
+    std::string str(2 * PageSize, 'X');
     auto cm = std::make_shared<CacheManager>(std::make_unique<MemoryFile>());
     TypedCacheManager tcm(cm);
 
@@ -268,7 +279,7 @@ TEST(FileWriter, LargeSizeWrites)
     auto fileTablePage = tcm.loadPage<FileTable>(fd.m_last);
     IntervalSequence is;
     fileTablePage.m_page->insertInto(is);
-    ASSERT_EQ(is.front() , Interval(0, uint32_t(10 * str.size() / 4096 + 1)));
+    ASSERT_EQ(is.front() , Interval(0, uint32_t(10 * str.size() / PageSize + 1)));
 }
 
 TEST(FileWriter, LargeSizeWritesMultiFiles)
@@ -294,22 +305,24 @@ TEST(FileWriter, LargeSizeWritesMultiFiles)
     auto fileTablePage2 = tcm.loadPage<FileTable>(fd2.m_last);
     IntervalSequence is;
     fileTablePage.m_page->insertInto(is);
-    ASSERT_EQ(is.front() , Interval(0, uint32_t(str.size() / 4096 + 1)));
+    ASSERT_EQ(is.front() , Interval(0, uint32_t(str.size() / PageSize + 1)));
 
     IntervalSequence is2;
     fileTablePage2.m_page->insertInto(is2);
-    ASSERT_EQ(is2.totalLength() , 10 * str.size() / 4096 + 1);
+    ASSERT_EQ(is2.totalLength() , 10 * str.size() / PageSize + 1);
 }
 
 TEST(FileWriter, FillPageTable)
 {
-    std::string str(4096, 'X');
+    std::string str(PageSize, 'X');
     auto cm = std::make_shared<CacheManager>(std::make_unique<MemoryFile>());
     TypedCacheManager tcm(cm);
 
+    // the pages of both files alternate: each page is an interval of its own
+    const size_t nofPages = SinglePagesPerFileTable + 1;
     FileWriter f(cm);
     FileWriter f2(cm);
-    for (int i = 0; i < 2000; i++)
+    for (size_t i = 0; i < nofPages; i++)
     {
         f.write((const uint8_t*) str.c_str(), (const uint8_t*) str.c_str() + str.size());
         f2.write((const uint8_t*) str.c_str(), (const uint8_t*) str.c_str() + str.size());
@@ -317,10 +330,10 @@ TEST(FileWriter, FillPageTable)
 
     FileDescriptor fd = f.close();
     FileDescriptor fd2 = f2.close();
-    ASSERT_EQ(fd.m_fileSize , 2000ULL * str.size());
+    ASSERT_EQ(fd.m_fileSize , nofPages * str.size());
     ASSERT_NE(fd.m_first , fd.m_last);
 
-    ASSERT_EQ(fd2.m_fileSize , 2000ULL * str.size());
+    ASSERT_EQ(fd2.m_fileSize , nofPages * str.size());
     ASSERT_NE(fd2.m_first , fd2.m_last);
 
     auto fileTablePage = tcm.loadPage<FileTable>(fd.m_first);
@@ -328,13 +341,13 @@ TEST(FileWriter, FillPageTable)
     fileTablePage.m_page->insertInto(is);
     fileTablePage = tcm.loadPage<FileTable>(fd.m_last);
     fileTablePage.m_page->insertInto(is);
-    ASSERT_EQ(is.size() , 2000);
+    ASSERT_EQ(is.size() , nofPages);
 
     fileTablePage = tcm.loadPage<FileTable>(fd2.m_first);
     fileTablePage.m_page->insertInto(is);
     fileTablePage = tcm.loadPage<FileTable>(fd2.m_last);
     fileTablePage.m_page->insertInto(is);
-    ASSERT_EQ(is.size() , 4000);
+    ASSERT_EQ(is.size() , 2 * nofPages);
 }
 
 TEST(FileReader, ReadNullFile)
@@ -375,12 +388,12 @@ FileDescriptor writeFragmentedFile(const std::vector<uint8_t>& v, std::shared_pt
 {
     FileWriter fr(cacheManager);
     FileWriter fr2(cacheManager);
-    size_t s = (v.size() / 4096) * 4096;
+    size_t s = (v.size() / PageSize) * PageSize;
     auto it = v.begin();
-    for (auto it = v.begin(); it < (v.begin() + s); it += 4096)
+    for (auto it = v.begin(); it < (v.begin() + s); it += PageSize)
     {
-        fr.writeIterator(it, it + 4096);
-        fr2.writeIterator(it, it + 4096);
+        fr.writeIterator(it, it + PageSize);
+        fr2.writeIterator(it, it + PageSize);
     }
 
     fr.writeIterator(v.begin() + s, v.end());
@@ -409,6 +422,21 @@ FileDescriptor writeFile(const std::vector<uint8_t>& v, std::shared_ptr<CacheMan
     return fr.close();
 }
 
+// chains the FileTables of a file too fragmented for one table without writing its pages
+FileDescriptor writeFileTables(size_t nofTables, std::shared_ptr<CacheManager> cacheManager)
+{
+    TypedCacheManager tcm(cacheManager);
+    auto first = tcm.newPage<FileTable>();
+    auto last = first;
+    for (size_t i = 1; i < nofTables; i++)
+    {
+        auto next = tcm.newPage<FileTable>();
+        last.m_page->setNext(next.m_index);
+        last = next;
+    }
+    return FileDescriptor(first.m_index, last.m_index, nofTables * SinglePagesPerFileTable * PageSize);
+}
+
 uint8_t* readFile(FileDescriptor fd, std::vector<uint8_t>& v, std::shared_ptr<CacheManager> cacheManager, size_t sizes)
 {
     FileReader fr(cacheManager);
@@ -454,7 +482,7 @@ TEST(FileReader, ReadSmallFile)
 
 TEST(FileReader, ReadPageSizedFile)
 {
-    std::vector<uint8_t> v = makeRandomVector(5 * 4096);
+    std::vector<uint8_t> v = makeRandomVector(5 * PageSize);
     auto cacheManager = std::make_shared<CacheManager>(std::make_unique<MemoryFile>());
     FileDescriptor fd = writeFile(v, cacheManager);
     {
@@ -477,13 +505,13 @@ TEST(FileReader, ReadPageSizedFile)
     }
     {
         std::vector<uint8_t> res(v.size());
-        uint8_t* end = readFile(fd, res, cacheManager, 4095);
+        uint8_t* end = readFile(fd, res, cacheManager, PageSize - 1);
         ASSERT_EQ(end , (&res[0] + res.size()));
         ASSERT_EQ(res , v);
     }
     {
         std::vector<uint8_t> res(v.size());
-        uint8_t* end = readFile(fd, res, cacheManager, 4096);
+        uint8_t* end = readFile(fd, res, cacheManager, PageSize);
         ASSERT_EQ(end , (&res[0] + res.size()));
         ASSERT_EQ(res , v);
     }
@@ -520,13 +548,13 @@ TEST(FileReader, ReadBigFile)
     }
     {
         std::vector<uint8_t> res(v.size());
-        uint8_t* end = readFile(fd, res, cacheManager, 4095);
+        uint8_t* end = readFile(fd, res, cacheManager, PageSize - 1);
         ASSERT_EQ(end , (&res[0] + res.size()));
         ASSERT_EQ(res , v);
     }
     {
         std::vector<uint8_t> res(v.size());
-        uint8_t* end = readFile(fd, res, cacheManager, 4096);
+        uint8_t* end = readFile(fd, res, cacheManager, PageSize);
         ASSERT_EQ(end , (&res[0] + res.size()));
         ASSERT_EQ(res , v);
     }
@@ -563,13 +591,13 @@ TEST(FileReader, ReadFragmentedFile)
     }
     {
         std::vector<uint8_t> res(v.size());
-        uint8_t* end = readFile(fd, res, cacheManager, 4095);
+        uint8_t* end = readFile(fd, res, cacheManager, PageSize - 1);
         ASSERT_EQ(end , (&res[0] + res.size()));
         ASSERT_EQ(res , v);
     }
     {
         std::vector<uint8_t> res(v.size());
-        uint8_t* end = readFile(fd, res, cacheManager, 4096);
+        uint8_t* end = readFile(fd, res, cacheManager, PageSize);
         ASSERT_EQ(end , (&res[0] + res.size()));
         ASSERT_EQ(res , v);
     }
@@ -583,9 +611,8 @@ TEST(FileReader, ReadFragmentedFile)
 
 TEST(FileReader, visitAllFileTables)
 {
-    std::vector<uint8_t> v = makeVector(2200 * 4097); // => 3 filetable pages
     auto cacheManager = std::make_shared<CacheManager>(std::make_unique<MemoryFile>());
-    FileDescriptor fd = writeFragmentedFile(v, cacheManager);
+    FileDescriptor fd = writeFileTables(3, cacheManager);
 
     FileReader fr(cacheManager);
     int i = 0;
@@ -599,9 +626,8 @@ TEST(FileReader, visitAllFileTables)
 
 TEST(FileReader, visitAllFileTablesInterruptsOnReturnFalse)
 {
-    std::vector<uint8_t> v = makeVector(2200 * 4097); // => 3 filetable pages
     auto cacheManager = std::make_shared<CacheManager>(std::make_unique<MemoryFile>());
-    FileDescriptor fd = writeFragmentedFile(v, cacheManager);
+    FileDescriptor fd = writeFileTables(3, cacheManager);
 
     FileReader fr(cacheManager);
     int i = 0;
@@ -7,6 +7,11 @@
 #include "CompoundFs/Path.h"
 #include "CompoundFs/FileSystem.h"
 
+#include <thread>
+#include <atomic>
+#include <algorithm>
+#include <random>
+
 using namespace TxFs;
 
 namespace
@@ -20,6 +25,45 @@ FileSystem makeFileSystem()
     return fs;
 }
 
+class PageWriteCountingFile : public MemoryFile
+{
+public:
+    const uint8_t* writePage(PageIndex idx, size_t pageOffset, const uint8_t* begin, const uint8_t* end) override
+    {
+        m_pageWrites++;
+        return MemoryFile::writePage(idx, pageOffset, begin, end);
+    }
+
+    size_t m_pageWrites = 0;
+};
+
+class ByteReadCountingFile : public MemoryFile
+{
+public:
+    uint8_t* readPage(PageIndex idx, size_t pageOffset, uint8_t* begin, uint8_t* end) const override
+    {
+        m_bytesRead += end - begin;
+        return MemoryFile::readPage(idx, pageOffset, begin, end);
+    }
+
+    uint8_t* readPages(Interval iv, uint8_t* page) const override
+    {
+        m_bytesRead += size_t(iv.length()) * PageSize;
+        return MemoryFile::readPages(iv, page);
+    }
+
+    mutable size_t m_bytesRead = 0;
+};
+
+std::string makeRandomData(size_t size)
+{
+    std::minstd_rand rnd(1);
+    std::string data(size, ' ');
+    for (auto& c: data)
+        c = char(rnd());
+    return data;
+}
+
 void createFile(Path path, FileSystem& fs)
 {
     auto fh = *fs.createFile(path);
@@ -87,6 +131,324 @@ TEST(FileSystem, readAfterAppendAfterWrite)
     ASSERT_EQ(2 * size, fs.read(*readHandle, buf, sizeof(buf)));
 }
 
+TEST(FileSystem, readViewPointsIntoPagesOfMemoryFile)
+{
+    auto fs = makeFileSystem();
+    std::string data;
+    for (int i = 0; data.size() < 3 * PageSize; i++)
+        data += std::to_string(i) + ' ';
+    auto handle = *fs.createFile("file.file");
+    fs.write(handle, data.data(), data.size());
+    fs.close(handle);
+
+    auto readHandle = *fs.readFile("file.file");
+    auto first = fs.readView(readHandle, 100);
+    ASSERT_EQ(first.size(), 100U);
+    auto second = fs.readView(readHandle, 2 * PageSize);
+    ASSERT_EQ(second.size(), PageSize - 100);
+    ASSERT_EQ(first.end(), second.begin());
+
+    std::string result(first.begin(), first.end());
+    result.append(second.begin(), second.end());
+    for (auto view = fs.readView(readHandle, PageSize); !view.empty(); view = fs.readView(readHandle, PageSize))
+        result.append(view.begin(), view.end());
+    fs.close(readHandle);
+    ASSERT_EQ(result, data);
+    ASSERT_EQ(std::string(first.begin(), first.end()), data.substr(0, 100));
+}
+
+TEST(FileSystem, readViewKeepsContentWhenPagesAreReused)
+{
+    auto fs = makeFileSystem();
+    std::string data(2 * PageSize, 'a');
+    auto handle = *fs.createFile("file.file");
+    fs.write(handle, data.data(), data.size());
+    fs.close(handle);
+    fs.commit();
+
+    auto readHandle = *fs.readFile("file.file");
+    auto view = fs.readView(readHandle, PageSize);
+    fs.close(readHandle);
+    fs.remove("file.file");
+    fs.commit();
+
+    // the new file gets the freed pages
+    std::string other(10 * PageSize, 'b');
+    handle = *fs.createFile("other.file");
+    fs.write(handle, other.data(), other.size());
+    fs.close(handle);
+    fs.commit();
+
+    ASSERT_EQ(std::string(view.begin(), view.end()), data.substr(0, PageSize));
+}
+
+TEST(FileSystem, gatherWriteAndScatterReadRoundTrip)
+{
+    auto fs = makeFileSystem();
+    std::string header(20, 'h');
+    std::string payload(2 * PageSize + 100, 'p');
+    std::string trailer(8, 't');
+    auto handle = *fs.createFile("file.file");
+    for (int i = 0; i < 3; i++)
+        ASSERT_EQ(fs.write(handle, { { header.data(), header.size() }, { payload.data(), payload.size() },
+                                     { trailer.data(), trailer.size() } }),
+                  header.size() + payload.size() + trailer.size());
+    fs.close(handle);
+    auto data = header + payload + trailer;
+    ASSERT_EQ(fs.fileSize("file.file"), 3 * data.size());
+
+    std::string buf1(data.size() - 10, ' ');
+    std::string buf2(30, ' ');
+    std::string buf3(1, ' ');
+    auto readHandle = *fs.readFile("file.file");
+    ASSERT_EQ(fs.read(readHandle, { { buf1.data(), buf1.size() }, { buf2.data(), buf2.size() } }),
+              buf1.size() + buf2.size());
+    ASSERT_EQ(buf1 + buf2, (data + data).substr(0, buf1.size() + buf2.size()));
+
+    // the scatter read did not read ahead
+    ASSERT_EQ(fs.read(readHandle, buf3.data(), buf3.size()), 1U);
+    ASSERT_EQ(buf3, data.substr(20, 1));
+
+    std::string rest(2 * data.size(), ' ');
+    ASSERT_EQ(fs.read(readHandle, { { rest.data(), 10 }, { rest.data() + 10, rest.size() - 10 } }),
+              2 * data.size() - 21);
+    ASSERT_EQ(rest.substr(0, 2 * data.size() - 21), (data + data + data).substr(data.size() + 21));
+}
+
+TEST(FileSystem, gatherWriteWritesSharedPageOnce)
+{
+    auto file = std::make_unique<PageWriteCountingFile>();
+    auto counter = file.get();
+    auto cm = std::make_shared<CacheManager>(std::move(file));
+    auto fs = FileSystem(FileSystem::initialize(cm));
+    fs.commit();
+
+    std::vector<std::string> records(100, std::string(30, 'r'));
+    std::vector<ConstBuffer> buffers;
+    for (auto& record : records)
+        buffers.push_back({ record.data(), record.size() });
+
+    auto handle = *fs.createFile("file.file");
+    counter->m_pageWrites = 0;
+    fs.write(handle, buffers);
+    fs.write(handle, buffers);
+    ASSERT_LE(counter->m_pageWrites, 3U); // instead of one per record
+    fs.close(handle);
+
+    std::string data(2 * 100 * 30, ' ');
+    auto readHandle = *fs.readFile("file.file");
+    ASSERT_EQ(fs.read(readHandle, data.data(), data.size()), data.size());
+    ASSERT_EQ(data, std::string(data.size(), 'r'));
+}
+
+TEST(FileSystem, readViewCopiesCompressedAndInlineFiles)
+{
+    auto fs = makeFileSystem();
+    std::string data(2 * ChunkSize, 'x');
+    auto handle = *fs.createFile("compressed.file", Compression::Lz4);
+    fs.write(handle, data.data(), data.size());
+    fs.close(handle);
+    createFile("inline.file", fs);
+
+    auto readHandle = *fs.readFile("compressed.file");
+    auto view = fs.readView(readHandle, data.size() + 10);
+    fs.close(readHandle);
+    ASSERT_EQ(std::string(view.begin(), view.end()), data);
+
+    readHandle = *fs.readFile("inline.file");
+    view = fs.readView(readHandle, 100);
+    ASSERT_EQ(std::string(view.begin(), view.end()), "test");
+    ASSERT_TRUE(fs.readView(readHandle, 100).empty());
+}
+
+TEST(FileSystem, smallFilesAreStoredInline)
+{
+    auto cm = std::make_shared<CacheManager>(std::make_unique<MemoryFile>());
+    auto fs = FileSystem(FileSystem::initialize(cm));
+    fs.commit();
+
+    auto compositSize = cm->getFileInterface()->fileSizeInPages();
+    std::string data(DirectoryStructure::maxInlineFileSize(), 'x');
+    auto handle = *fs.createFile("file.file");
+    fs.write(handle, data.data(), data.size());
+    fs.close(handle);
+    ASSERT_EQ(cm->getFileInterface()->fileSizeInPages(), compositSize);
+    ASSERT_EQ(fs.fileSize("file.file"), data.size());
+    ASSERT_EQ(fs.find("file.file").value().getType(), TreeValue::Type::File);
+
+    std::string buf(data.size(), ' ');
+    auto readHandle = *fs.readFile("file.file");
+    ASSERT_EQ(fs.read(readHandle, buf.data(), buf.size()), data.size());
+    ASSERT_EQ(buf, data);
+}
+
+TEST(FileSystem, inlineFileMovesToPagesWhenItGrows)
+{
+    auto fs = makeFileSystem();
+    std::string data(DirectoryStructure::maxInlineFileSize() - 10, 'x');
+    auto handle = *fs.createFile("file.file");
+    fs.write(handle, data.data(), data.size());
+    fs.close(handle);
+
+    std::string more(PageSize, 'y');
+    handle = *fs.appendFile("file.file");
+    fs.write(handle, more.data(), more.size());
+    ASSERT_EQ(fs.fileSize(handle), data.size() + more.size());
+    fs.close(handle);
+    fs.commit();
+
+    std::string buf(data.size() + more.size(), ' ');
+    auto readHandle = *fs.readFile("file.file");
+    ASSERT_EQ(fs.read(readHandle, buf.data(), buf.size()), buf.size());
+    ASSERT_EQ(buf, data + more);
+}
+
+TEST(FileSystem, compressedFilesTakeLessSpace)
+{
+    auto cm = std::make_shared<CacheManager>(std::make_unique<MemoryFile>());
+    auto fs = FileSystem(FileSystem::initialize(cm));
+    fs.commit();
+
+    // enough pages that the file table and the changed tree pages don't count for large page sizes
+    std::string data;
+    for (int i = 0; data.size() < std::max<size_t>(3 * ChunkSize, 16 * PageSize); i++)
+        data += "line " + std::to_string(i % 100) + " of some repetitive text\n";
+
+    auto compositSize = cm->getFileInterface()->fileSizeInPages();
+    auto handle = *fs.createFile("file.file", Compression::Lz4);
+    fs.write(handle, data.data(), data.size());
+    ASSERT_EQ(fs.fileSize(handle), data.size());
+    fs.close(handle);
+    fs.commit();
+    ASSERT_LT(cm->getFileInterface()->fileSizeInPages() - compositSize, data.size() / PageSize / 2);
+    ASSERT_EQ(fs.fileSize("file.file"), data.size());
+
+    std::string buf(data.size() + 10, ' ');
+    auto readHandle = *fs.readFile("file.file");
+    ASSERT_EQ(fs.fileSize(readHandle), data.size());
+    ASSERT_EQ(fs.read(readHandle, buf.data(), 1000), 1000U);
+    ASSERT_EQ(fs.read(readHandle, buf.data() + 1000, buf.size() - 1000), data.size() - 1000);
+    buf.resize(data.size());
+    ASSERT_EQ(buf, data);
+}
+
+TEST(FileSystem, appendingToCompressedFileKeepsItCompressed)
+{
+    auto fs = makeFileSystem();
+    std::string data(ChunkSize + 1000, 'x');
+    auto handle = *fs.createFile("file.file", Compression::Lz4);
+    fs.write(handle, data.data(), data.size());
+    fs.close(handle);
+
+    std::string more(2 * PageSize, 'y');
+    handle = *fs.appendFile("file.file");
+    fs.write(handle, more.data(), more.size());
+    ASSERT_EQ(fs.fileSize(handle), data.size() + more.size());
+    fs.close(handle);
+    fs.commit();
+
+    ASSERT_LT(fs.find("file.file").value().get<FileDescriptor>().m_fileSize, uint64_t(PageSize));
+    std::string buf(data.size() + more.size(), ' ');
+    auto readHandle = *fs.readFile("file.file");
+    ASSERT_EQ(fs.read(readHandle, buf.data(), buf.size()), buf.size());
+    ASSERT_EQ(buf, data + more);
+}
+
+TEST(FileSystem, seekInCompressedFileReadsOneChunk)
+{
+    auto file = std::make_unique<ByteReadCountingFile>();
+    auto counter = file.get();
+    auto cm = std::make_shared<CacheManager>(std::move(file));
+    auto fs = FileSystem(FileSystem::initialize(cm));
+    fs.commit();
+
+    auto data = makeRandomData(16 * ChunkSize);
+    auto handle = *fs.createFile("file.file", Compression::Lz4);
+    fs.write(handle, data.data(), data.size());
+    fs.close(handle);
+    fs.commit();
+
+    auto readHandle = *fs.readFile("file.file");
+    counter->m_bytesRead = 0;
+    std::string buf(1000, ' ');
+    fs.seek(readHandle, 11 * ChunkSize + 100);
+    ASSERT_EQ(fs.read(readHandle, buf.data(), buf.size()), buf.size());
+    ASSERT_EQ(buf, data.substr(11 * ChunkSize + 100, buf.size()));
+    ASSERT_LT(counter->m_bytesRead, 4 * ChunkSize);
+
+    fs.seek(readHandle, 2 * ChunkSize - 500);
+    ASSERT_EQ(fs.read(readHandle, buf.data(), buf.size()), buf.size());
+    ASSERT_EQ(buf, data.substr(2 * ChunkSize - 500, buf.size()));
+
+    fs.seek(readHandle, data.size() + 10);
+    ASSERT_EQ(fs.read(readHandle, buf.data(), buf.size()), 0U);
+}
+
+TEST(FileSystem, seekInAppendedAndUncompressedFiles)
+{
+    auto fs = makeFileSystem();
+    auto data = makeRandomData(3 * ChunkSize + 1000);
+    auto handle = *fs.createFile("compressed.file", Compression::Lz4);
+    fs.write(handle, data.data(), ChunkSize + 300);
+    fs.close(handle);
+    handle = *fs.appendFile("compressed.file");
+    fs.write(handle, data.data() + ChunkSize + 300, data.size() - ChunkSize - 300);
+    fs.close(handle);
+    handle = *fs.createFile("plain.file");
+    fs.write(handle, data.data(), data.size());
+    fs.close(handle);
+    fs.commit();
+
+    for (auto path: { "compressed.file", "plain.file" })
+    {
+        auto readHandle = *fs.readFile(path);
+        std::string buf(data.size(), ' ');
+        ASSERT_EQ(fs.read(readHandle, buf.data(), buf.size()), data.size());
+        ASSERT_EQ(buf, data);
+
+        for (uint64_t pos: { uint64_t(ChunkSize + 200), uint64_t(PageSize + 1), uint64_t(3 * ChunkSize), uint64_t(0) })
+        {
+            fs.seek(readHandle, pos);
+            buf.assign(500, ' ');
+            ASSERT_EQ(fs.read(readHandle, buf.data(), buf.size()), buf.size());
+            ASSERT_EQ(buf, data.substr(size_t(pos), buf.size()));
+        }
+    }
+}
+
+TEST(FileSystem, filesKeepTheHashesOfTheirContent)
+{
+    auto fs = makeFileSystem();
+    auto data = makeRandomData(2 * HashBlockSize + 100);
+    auto handle = *fs.createFile("file.file", Compression::Lz4, Deduplication::Off, Hashing::Content);
+    fs.write(handle, data.data(), HashBlockSize + 10);
+    fs.close(handle);
+    handle = *fs.appendFile("file.file");
+    fs.write(handle, data.data() + HashBlockSize + 10, data.size() - HashBlockSize - 10);
+    fs.close(handle);
+    createFile("inline.file", fs);
+    ASSERT_TRUE(fs.cloneFile("file.file", "clone.file"));
+    fs.commit();
+
+    ContentHasher hasher;
+    hasher.update(reinterpret_cast<const uint8_t*>(data.data()),
+                  reinterpret_cast<const uint8_t*>(data.data() + data.size()));
+    auto expected = hasher.hashes();
+    ASSERT_EQ(expected.m_blocks.size(), 3U);
+    for (auto path: { "file.file", "clone.file" })
+    {
+        auto hashes = *fs.contentHashes(path);
+        ASSERT_EQ(hashes.m_size, data.size());
+        ASSERT_EQ(hashes.m_hash, expected.m_hash);
+        ASSERT_EQ(hashes.m_blocks, expected.m_blocks);
+    }
+
+    auto hashes = *fs.contentHashes("inline.file");
+    ASSERT_EQ(hashes.m_size, 4U);
+    ASSERT_EQ(hashes.m_hash, hash64("test", 4));
+    ASSERT_FALSE(fs.contentHashes("missing.file"));
+}
+
 TEST(FileSystem, doubleCloseWriteHandleThrows)
 {
     auto fs = makeFileSystem();
@@ -141,6 +503,60 @@ TEST(FileSystem, attribute)
     ASSERT_EQ(attribute->get<double>(), 42.42);
 }
 
+TEST(FileSystem, addAttributesCreatesPaths)
+{
+    auto fs = makeFileSystem();
+    std::vector<std::pair<Path, TreeValue>> attributes { { "folder/a", 1.1 }, { "folder/b", "test" } };
+    ASSERT_EQ(fs.addAttributes(attributes), 2);
+    ASSERT_EQ(fs.getAttribute("folder/a")->get<double>(), 1.1);
+    ASSERT_EQ(fs.getAttribute("folder/b")->get<std::string>(), "test");
+}
+
+TEST(FileSystem, createFilesReturnsHandleForEachCreatedFile)
+{
+    auto fs = makeFileSystem();
+    fs.addAttribute("folder/attribute", 42.42);
+    auto handles = fs.createFiles({ "folder/file1", "folder/attribute", "folder/file2" });
+    ASSERT_EQ(handles.size(), 3);
+    ASSERT_TRUE(handles[0] && handles[2]);
+    ASSERT_FALSE(handles[1]);
+
+    ByteStringView data("test");
+    fs.write(*handles[2], data.data(), data.size());
+    fs.close(*handles[0]);
+    fs.close(*handles[2]);
+    ASSERT_EQ(fs.fileSize("folder/file1"), 0);
+    ASSERT_EQ(fs.fileSize("folder/file2"), data.size());
+}
+
+TEST(FileSystem, countAndBeginAtIndexPageThroughFolder)
+{
+    auto fs = makeFileSystem();
+    auto folder = *fs.makeSubFolder("folder");
+    fs.addAttribute("other/attribute", 1.0);
+    std::vector<std::string> names;
+    for (int i = 0; i < 5000; i++)
+        names.push_back("attribute" + std::to_string(i));
+    std::sort(names.begin(), names.end());
+    std::vector<std::pair<Path, TreeValue>> attributes;
+    for (const auto& name: names)
+        attributes.emplace_back(Path(folder, name), 1.0);
+    fs.addAttributes(attributes);
+
+    ASSERT_EQ(fs.count(Path(folder, "")), names.size());
+    ASSERT_EQ(fs.count(Path(folder, names[100])), names.size() - 100);
+    for (size_t page = 0; page * 100 < names.size(); page++)
+    {
+        auto cursor = fs.begin(Path(folder, ""), page * 100);
+        for (size_t i = page * 100; i < std::min(names.size(), page * 100 + 100); i++)
+        {
+            ASSERT_EQ(cursor.key().m_relativePath, names[i]);
+            cursor = fs.next(cursor);
+        }
+    }
+    ASSERT_FALSE(fs.begin(Path(folder, ""), names.size()));
+}
+
 TEST(FileSystem, remove)
 {
     auto fs = makeFileSystem();
@@ -330,6 +746,230 @@ TEST_F(FileSystemTester, commitedDeletedSpaceGetsReused)
     ASSERT_EQ(m_cacheManager->getFileInterface()->fileSizeInPages(), compositSize);
 }
 
+TEST_F(FileSystemTester, largeAttributesSurviveCommit)
+{
+    std::string large(2 * PageSize, 'x');
+    m_fileSystem.addAttribute("test/large", large);
+    m_fileSystem.commit();
+    ASSERT_EQ(m_fileSystem.getAttribute("test/large")->get<std::string>(), large);
+}
+
+TEST_F(FileSystemTester, removedLargeAttributeSpaceGetsReused)
+{
+    std::string large(8 * PageSize, 'x');
+    m_fileSystem.addAttribute("large", large);
+    m_fileSystem.commit();
+    m_fileSystem.remove("large");
+    m_fileSystem.commit();
+    auto compositSize = m_cacheManager->getFileInterface()->fileSizeInPages();
+    m_fileSystem.addAttribute("large", large);
+    ASSERT_EQ(m_cacheManager->getFileInterface()->fileSizeInPages(), compositSize);
+}
+
+TEST_F(FileSystemTester, removedCompressedFileSpaceGetsReused)
+{
+    std::vector<uint8_t> data(4 * ChunkSize);
+    for (size_t i = 0; i < data.size(); i++)
+        data[i] = uint8_t(i * i % 251);
+
+    auto handle = *m_fileSystem.createFile("file", Compression::Lz4);
+    m_fileSystem.write(handle, data.data(), data.size());
+    m_fileSystem.close(handle);
+    m_fileSystem.commit();
+    auto size = m_cacheManager->getFileInterface()->fileSizeInPages();
+
+    m_fileSystem.remove("file");
+    m_fileSystem.commit();
+    handle = *m_fileSystem.createFile("file", Compression::Lz4);
+    m_fileSystem.write(handle, data.data(), data.size());
+    m_fileSystem.close(handle);
+    m_fileSystem.commit();
+    ASSERT_EQ(m_cacheManager->getFileInterface()->fileSizeInPages(), size);
+}
+
+TEST_F(FileSystemTester, deduplicatedFilesShareEqualPages)
+{
+    std::vector<uint8_t> data(20 * PageSize + 100);
+    for (size_t i = 0; i < data.size(); i++)
+        data[i] = uint8_t(i * 7 % 253);
+
+    auto compositSize = m_cacheManager->getFileInterface()->fileSizeInPages();
+    auto handle = *m_fileSystem.createFile("file1", Compression::None, Deduplication::Pages);
+    m_fileSystem.write(handle, data.data(), data.size());
+    m_fileSystem.close(handle);
+    auto oneFileSize = m_cacheManager->getFileInterface()->fileSizeInPages() - compositSize;
+    ASSERT_GT(oneFileSize, 20U);
+
+    // write in small pieces: pages are collected before they are deduplicated
+    handle = *m_fileSystem.createFile("file2", Compression::None, Deduplication::Pages);
+    for (size_t pos = 0; pos < data.size(); pos += 1000)
+        m_fileSystem.write(handle, data.data() + pos, std::min<size_t>(1000, data.size() - pos));
+    ASSERT_EQ(m_fileSystem.fileSize(handle), data.size());
+    m_fileSystem.close(handle);
+    m_fileSystem.commit();
+    ASSERT_LT(m_cacheManager->getFileInterface()->fileSizeInPages() - compositSize, oneFileSize + 10);
+
+    m_fileSystem.remove("file1");
+    m_fileSystem.commit();
+    std::vector<uint8_t> buf(data.size());
+    auto readHandle = *m_fileSystem.readFile("file2");
+    ASSERT_EQ(m_fileSystem.read(readHandle, buf.data(), buf.size()), data.size());
+    ASSERT_EQ(buf, data);
+}
+
+TEST_F(FileSystemTester, lastReferenceFreesDeduplicatedPages)
+{
+    std::vector<uint8_t> data(10 * PageSize);
+    for (size_t i = 0; i < data.size(); i++)
+        data[i] = uint8_t(i * 13 % 251);
+
+    auto writeFile = [&](Path path) {
+        auto handle = *m_fileSystem.createFile(path, Compression::None, Deduplication::Pages);
+        m_fileSystem.write(handle, data.data(), data.size());
+        m_fileSystem.close(handle);
+    };
+    writeFile("file1");
+    writeFile("file2");
+    m_fileSystem.commit();
+    auto size = m_cacheManager->getFileInterface()->fileSizeInPages();
+
+    m_fileSystem.remove("file1");
+    m_fileSystem.remove("file2");
+    m_fileSystem.commit();
+    for (size_t i = 0; i < data.size(); i++)
+        data[i] = uint8_t(i * 17 % 247);
+    writeFile("file3");
+    m_fileSystem.commit();
+    ASSERT_EQ(m_cacheManager->getFileInterface()->fileSizeInPages(), size);
+}
+
+TEST_F(FileSystemTester, appendingToDeduplicatedFileKeepsSharing)
+{
+    std::vector<uint8_t> data(4 * PageSize);
+    for (size_t i = 0; i < data.size(); i++)
+        data[i] = uint8_t(i * 11 % 241);
+
+    auto handle = *m_fileSystem.createFile("file1", Compression::None, Deduplication::Pages);
+    m_fileSystem.write(handle, data.data(), data.size());
+    m_fileSystem.close(handle);
+
+    handle = *m_fileSystem.createFile("file2", Compression::None, Deduplication::Pages);
+    m_fileSystem.write(handle, data.data(), PageSize + 100);
+    m_fileSystem.close(handle);
+    handle = *m_fileSystem.appendFile("file2");
+    m_fileSystem.write(handle, data.data() + PageSize + 100, data.size() - PageSize - 100);
+    m_fileSystem.close(handle);
+    m_fileSystem.commit();
+
+    std::vector<uint8_t> buf(data.size());
+    auto readHandle = *m_fileSystem.readFile("file2");
+    ASSERT_EQ(m_fileSystem.read(readHandle, buf.data(), buf.size()), data.size());
+    ASSERT_EQ(buf, data);
+
+    m_fileSystem.remove("file2");
+    m_fileSystem.commit();
+    readHandle = *m_fileSystem.readFile("file1");
+    ASSERT_EQ(m_fileSystem.read(readHandle, buf.data(), buf.size()), data.size());
+    ASSERT_EQ(buf, data);
+}
+
+TEST_F(FileSystemTester, clonedFileSharesPagesUntilAppended)
+{
+    std::string data(50 * PageSize + 100, ' ');
+    for (size_t i = 0; i < data.size(); i++)
+        data[i] = char('a' + i % 23);
+    auto handle = *m_fileSystem.createFile("file");
+    m_fileSystem.write(handle, data.data(), data.size());
+    m_fileSystem.close(handle);
+    m_fileSystem.commit();
+
+    auto compositSize = m_cacheManager->getFileInterface()->fileSizeInPages();
+    ASSERT_TRUE(m_fileSystem.cloneFile("file", "folder/clone"));
+    ASSERT_LT(m_cacheManager->getFileInterface()->fileSizeInPages() - compositSize, 5U);
+    ASSERT_EQ(m_fileSystem.fileSize("folder/clone"), data.size());
+
+    handle = *m_fileSystem.appendFile("folder/clone");
+    m_fileSystem.write(handle, "clone", 5);
+    m_fileSystem.close(handle);
+    handle = *m_fileSystem.appendFile("file");
+    m_fileSystem.write(handle, "file", 4);
+    m_fileSystem.close(handle);
+    m_fileSystem.commit();
+
+    auto readAll = [&](Path path) {
+        std::string content(size_t(*m_fileSystem.fileSize(path)), ' ');
+        auto readHandle = *m_fileSystem.readFile(path);
+        m_fileSystem.read(readHandle, content.data(), content.size());
+        m_fileSystem.close(readHandle);
+        return content;
+    };
+    ASSERT_EQ(readAll("folder/clone"), data + "clone");
+    ASSERT_EQ(readAll("file"), data + "file");
+
+    m_fileSystem.remove("file");
+    m_fileSystem.commit();
+    ASSERT_EQ(readAll("folder/clone"), data + "clone");
+}
+
+TEST_F(FileSystemTester, cloneBeforeCommitCopiesTheLastPage)
+{
+    std::string data(3 * PageSize + 100, ' ');
+    for (size_t i = 0; i < data.size(); i++)
+        data[i] = char('a' + i % 23);
+    auto handle = *m_fileSystem.createFile("file");
+    m_fileSystem.write(handle, data.data(), data.size());
+    m_fileSystem.close(handle);
+    ASSERT_TRUE(m_fileSystem.cloneFile("file", "clone"));
+
+    handle = *m_fileSystem.appendFile("clone");
+    m_fileSystem.write(handle, "clone", 5);
+    m_fileSystem.close(handle);
+
+    auto readAll = [&](Path path) {
+        std::string content(size_t(*m_fileSystem.fileSize(path)), ' ');
+        auto readHandle = *m_fileSystem.readFile(path);
+        m_fileSystem.read(readHandle, content.data(), content.size());
+        m_fileSystem.close(readHandle);
+        return content;
+    };
+    ASSERT_EQ(readAll("file"), data);
+    ASSERT_EQ(readAll("clone"), data + "clone");
+    m_fileSystem.commit();
+    ASSERT_EQ(readAll("file"), data);
+    ASSERT_EQ(readAll("clone"), data + "clone");
+}
+
+TEST_F(FileSystemTester, lastCloneFreesSharedPages)
+{
+    std::vector<uint8_t> data(30 * PageSize);
+    auto handle = *m_fileSystem.createFile("file");
+    m_fileSystem.write(handle, data.data(), data.size());
+    m_fileSystem.close(handle);
+    m_fileSystem.cloneFile("file", "clone1");
+    m_fileSystem.cloneFile("clone1", "clone2");
+    m_fileSystem.commit();
+    auto size = m_cacheManager->getFileInterface()->fileSizeInPages();
+
+    m_fileSystem.remove("clone1");
+    m_fileSystem.remove("file");
+    m_fileSystem.commit();
+    handle = *m_fileSystem.createFile("other");
+    m_fileSystem.write(handle, data.data(), data.size());
+    m_fileSystem.close(handle);
+    m_fileSystem.commit();
+    ASSERT_GT(m_cacheManager->getFileInterface()->fileSizeInPages(), size);
+
+    m_fileSystem.remove("other");
+    m_fileSystem.remove("clone2");
+    m_fileSystem.commit();
+    handle = *m_fileSystem.createFile("other");
+    m_fileSystem.write(handle, data.data(), data.size());
+    m_fileSystem.write(handle, data.data(), data.size());
+    m_fileSystem.close(handle);
+    m_fileSystem.commit();
+    ASSERT_LE(m_cacheManager->getFileInterface()->fileSizeInPages(), size + 35);
+}
+
 TEST_F(FileSystemTester, treeSpaceGetsReused)
 {
     m_fileSystem.rollback();
@@ -353,3 +993,52 @@ TEST_F(FileSystemTester, treeSpaceGetsReused)
     }
     ASSERT_EQ(file->fileSizeInPages(), csize);
 }
+
+TEST(FileSystem, concurrentReadersShareOneInstance)
+{
+    auto cm = std::make_shared<CacheManager>(std::make_unique<MemoryFile>(), 16); // force frequent trims
+    auto fs = FileSystem(FileSystem::initialize(cm));
+    constexpr int numFiles = 200;
+    for (int i = 0; i < numFiles; i++)
+    {
+        auto path = "folder" + std::to_string(i % 10) + "/file" + std::to_string(i);
+        auto fh = *fs.createFile(Path(path));
+        std::string data(1000 + i * 50, char('a' + i % 26));
+        fs.write(fh, data.data(), data.size());
+        fs.close(fh);
+    }
+    fs.commit();
+
+    std::atomic<int> errors = 0;
+    auto reader = [&](int offset) {
+        for (int j = 0; j < numFiles; j++)
+        {
+            int i = (j + offset) % numFiles;
+            auto path = "folder" + std::to_string(i % 10) + "/file" + std::to_string(i);
+            auto fh = fs.readFile(Path(path));
+            if (!fh)
+            {
+                errors++;
+                continue;
+            }
+            std::string data(fs.fileSize(*fh), ' ');
+            fs.read(*fh, data.data(), data.size());
+            fs.close(*fh);
+            if (data != std::string(1000 + i * 50, char('a' + i % 26)))
+                errors++;
+        }
+
+        int entries = 0;
+        for (auto cursor = fs.begin(Path(*fs.subFolder("folder3"), "")); cursor; cursor = fs.next(cursor))
+            entries++;
+        if (entries != numFiles / 10)
+            errors++;
+    };
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 8; t++)
+        threads.emplace_back(reader, t * 25);
+    for (auto& th: threads)
+        th.join();
+    ASSERT_EQ(errors, 0);
+}
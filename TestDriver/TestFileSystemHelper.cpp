@@ -6,6 +6,9 @@
 #include "CompoundFs/DirectoryStructure.h"
 #include "CompoundFs/Path.h"
 #include "CompoundFs/FileSystemHelper.h"
+#include "CompoundFs/FileSystemVisitor.h"
+#include <fstream>
+#include <random>
 #include <string>
 
 using namespace std::string_literals;
@@ -22,14 +25,52 @@ FileSystem makeFileSystem()
     return fs;
 }
 
-void createFile(Path path, FileSystem& fs)
+void createFile(Path path, FileSystem& fs, std::string_view data = "test", Hashing hashing = Hashing::Off)
 {
-    auto fh = *fs.createFile(path);
-    ByteStringView data("test");
+    auto fh = *fs.createFile(path, Compression::None, Deduplication::Off, hashing);
     fs.write(fh, data.data(), data.size());
     fs.close(fh);
 }
 
+class ByteReadCountingFile : public MemoryFile
+{
+public:
+    uint8_t* readPage(PageIndex idx, size_t pageOffset, uint8_t* begin, uint8_t* end) const override
+    {
+        m_bytesRead += end - begin;
+        return MemoryFile::readPage(idx, pageOffset, begin, end);
+    }
+
+    uint8_t* readPages(Interval iv, uint8_t* page) const override
+    {
+        m_bytesRead += size_t(iv.length()) * PageSize;
+        return MemoryFile::readPages(iv, page);
+    }
+
+    mutable size_t m_bytesRead = 0;
+};
+
+bool areEqual(FileSystem& sourceFs, Path sourcePath, FileSystem& destFs, Path destPath)
+{
+    FsCompareVisitor compareVisitor(sourceFs, destFs, destPath);
+    FileSystemVisitor(sourceFs).visit(sourcePath, compareVisitor);
+    return compareVisitor.result() == FsCompareVisitor::Result::Equal;
+}
+
+std::string readFile(Path path, FileSystem& fs)
+{
+    auto fh = *fs.readFile(path);
+    std::string data(size_t(fs.fileSize(fh)), ' ');
+    fs.read(fh, data.data(), data.size());
+    fs.close(fh);
+    return data;
+}
+
+std::string makeContent(int i)
+{
+    return std::string(size_t(i) * 997 % (200 * PageSize), char('a' + i % 26));
+}
+
 }
 
 TEST(FileSystemHelper, retrieveFolderContents)
@@ -61,6 +102,189 @@ TEST(FileSystemHelper, RootFileToFolderFile)
     ASSERT_EQ(fs.fileSize("folder/file2"), 4);
 }
 
+TEST(FileSystemHelper, copyWithinOneFileSystemSharesPages)
+{
+    auto cm = std::make_shared<CacheManager>(std::make_unique<MemoryFile>());
+    auto fs = FileSystem(FileSystem::initialize(cm));
+    std::vector<uint8_t> data(100 * PageSize, 'x');
+    auto fh = *fs.createFile("folder/file1");
+    fs.write(fh, data.data(), data.size());
+    fs.close(fh);
+    fs.commit();
+
+    auto compositSize = cm->getFileInterface()->fileSizeInPages();
+    ASSERT_EQ(copy(fs, "folder", "folder2"), 2);
+    ASSERT_EQ(fs.fileSize("folder2/file1"), data.size());
+    ASSERT_LT(cm->getFileInterface()->fileSizeInPages() - compositSize, 10U);
+}
+
+TEST(FileSystemHelper, copyBetweenFileSystemsWithReaderThreads)
+{
+    auto source = makeFileSystem();
+    auto dest = makeFileSystem();
+    for (int i = 0; i < 150; i++)
+    {
+        auto fh = *source.createFile(Path("folder/"s + (i % 3 ? "" : "sub/") + std::to_string(i)));
+        auto content = makeContent(i);
+        source.write(fh, content.data(), content.size());
+        source.close(fh);
+    }
+    source.addAttribute("folder/attribute", 42.0);
+
+    ASSERT_EQ(copy(source, "folder", dest, "folder2", 4), 1 + 1 + 150 + 1);
+    for (int i = 0; i < 150; i++)
+        ASSERT_EQ(readFile(Path("folder2/"s + (i % 3 ? "" : "sub/") + std::to_string(i)), dest), makeContent(i));
+    ASSERT_EQ(*dest.getAttribute("folder2/attribute"), TreeValue(42.0));
+}
+
+TEST(FileSystemHelper, importHostFilesReadsFolderTree)
+{
+    auto hostFolder = std::filesystem::temp_directory_path() / ("TxFsImport" + std::to_string(std::random_device()()));
+    std::filesystem::create_directories(hostFolder / "sub");
+    for (int i = 0; i < 100; i++)
+    {
+        std::ofstream out(hostFolder / (i % 2 ? "" : "sub") / std::to_string(i), std::ios::binary);
+        out << makeContent(i);
+    }
+
+    auto fs = makeFileSystem();
+    auto numItems = importHostFiles(hostFolder, fs, "import");
+    auto singleFile = importHostFiles(hostFolder / "1", fs, "folder/file");
+    std::filesystem::remove_all(hostFolder);
+
+    ASSERT_EQ(numItems, 1 + 1 + 100);
+    for (int i = 0; i < 100; i++)
+        ASSERT_EQ(readFile(Path("import/"s + (i % 2 ? "" : "sub/") + std::to_string(i)), fs), makeContent(i));
+    ASSERT_EQ(singleFile, 1);
+    ASSERT_EQ(readFile("folder/file", fs), makeContent(1));
+}
+
+TEST(FileSystemHelper, syncWritesOnlyWhatDiffers)
+{
+    auto source = makeFileSystem();
+    auto dest = makeFileSystem();
+    std::string big(10 * PageSize, 'b');
+    createFile("folder/same", source, big);
+    createFile("folder/same", dest, big);
+    createFile("folder/changed", source, big + "x");
+    createFile("folder/changed", dest, "y" + big);
+    createFile("folder/grown", source, big + big);
+    createFile("folder/grown", dest, big);
+    createFile("folder/new/file", source, big);
+    createFile("folder/obsolete/file", dest, big);
+    createFile("folder/fileOrFolder", source);
+    createFile("folder/fileOrFolder/file", dest);
+    source.addAttribute("folder/attribute", 1.0);
+    dest.addAttribute("folder/attribute", 2.0);
+    source.addAttribute("folder/sameAttribute", "value");
+    dest.addAttribute("folder/sameAttribute", "value");
+
+    auto stats = sync(source, "folder", dest, "folder");
+    ASSERT_TRUE(areEqual(source, "folder", dest, "folder"));
+    ASSERT_TRUE(areEqual(dest, "folder", source, "folder"));
+    ASSERT_EQ(stats.m_unchangedFiles, 1U);
+    ASSERT_EQ(stats.m_appendedFiles, 1U);
+    ASSERT_EQ(stats.m_writtenFiles, 3U);
+    ASSERT_EQ(stats.m_changedItems, 2U);
+    ASSERT_EQ(stats.m_removedItems, 4U);
+    ASSERT_EQ(stats.m_bytesWritten, 3 * big.size() + 1 + 4);
+
+    stats = sync(source, "folder", dest, "folder");
+    ASSERT_EQ(stats.m_unchangedFiles, 5U);
+    ASSERT_EQ(stats.m_bytesWritten, 0U);
+    ASSERT_EQ(stats.m_changedItems + stats.m_removedItems + stats.m_writtenFiles + stats.m_appendedFiles, 0U);
+}
+
+TEST(FileSystemHelper, syncComparesHashesInsteadOfContent)
+{
+    auto file = std::make_unique<ByteReadCountingFile>();
+    auto counter = file.get();
+    auto cm = std::make_shared<CacheManager>(std::move(file));
+    auto source = FileSystem(FileSystem::initialize(cm));
+    auto dest = makeFileSystem();
+
+    std::string big(10 * HashBlockSize, 'b');
+    createFile("folder/same", source, big, Hashing::Content);
+    createFile("folder/grown", source, big + "x", Hashing::Content);
+    createFile("folder/same", dest, big);
+    createFile("folder/grown", dest, big);
+    source.commit();
+
+    counter->m_bytesRead = 0;
+    auto stats = sync(source, "folder", dest, "folder");
+    ASSERT_EQ(stats.m_unchangedFiles, 1U);
+    ASSERT_EQ(stats.m_appendedFiles, 1U);
+    ASSERT_EQ(stats.m_bytesWritten, 1U);
+    ASSERT_LT(counter->m_bytesRead, big.size()); // neither file is read in full
+    ASSERT_EQ(readFile("folder/grown", dest), big + "x");
+}
+
+TEST(FileSystemHelper, syncReadsFilesWithoutHashesOnce)
+{
+    auto file = std::make_unique<ByteReadCountingFile>();
+    auto counter = file.get();
+    auto cm = std::make_shared<CacheManager>(std::move(file));
+    auto source = FileSystem(FileSystem::initialize(cm));
+    auto dest = makeFileSystem();
+
+    std::string big(10 * HashBlockSize, 'b');
+    createFile("file", source, big);
+    source.commit();
+
+    counter->m_bytesRead = 0;
+    ASSERT_EQ(sync(source, "", dest, "").m_writtenFiles, 1U);
+    ASSERT_GE(counter->m_bytesRead, big.size());
+
+    counter->m_bytesRead = 0;
+    ASSERT_EQ(sync(source, "", dest, "").m_unchangedFiles, 1U);
+    ASSERT_LT(counter->m_bytesRead, big.size());
+}
+
+TEST(FileSystemHelper, syncKeepsHowFilesAreStored)
+{
+    auto source = makeFileSystem();
+    auto dest = makeFileSystem();
+    std::string big(3 * HashBlockSize, 'b');
+    auto fh = *source.createFile("compressed", Compression::Lz4);
+    source.write(fh, big.data(), big.size());
+    source.close(fh);
+    fh = *source.createFile("deduplicated", Compression::None, Deduplication::Pages);
+    source.write(fh, big.data(), big.size());
+    source.close(fh);
+    createFile("compressed", dest, big);
+
+    auto stats = sync(source, "", dest, "");
+    ASSERT_EQ(stats.m_writtenFiles, 2U);
+    ASSERT_TRUE(areEqual(source, "", dest, ""));
+    for (auto path: { "compressed", "deduplicated" })
+    {
+        auto sourceMode = *source.fileMode(path);
+        auto destMode = *dest.fileMode(path);
+        ASSERT_EQ(destMode.m_compression, sourceMode.m_compression);
+        ASSERT_EQ(destMode.m_deduplication, sourceMode.m_deduplication);
+    }
+    ASSERT_EQ(dest.fileMode("compressed")->m_compression, Compression::Lz4);
+}
+
+TEST(FileSystemHelper, syncToNewPathCopies)
+{
+    auto source = makeFileSystem();
+    auto dest = makeFileSystem();
+    createFile("folder/file1", source);
+    createFile("folder/sub/file2", source);
+    createFile("file3", source);
+
+    auto stats = sync(source, "folder", dest, "a/b");
+    ASSERT_EQ(stats.m_writtenFiles, 2U);
+    ASSERT_TRUE(areEqual(source, "folder", dest, "a/b"));
+
+    stats = sync(source, "", dest, "");
+    ASSERT_EQ(stats.m_writtenFiles, 3U);
+    ASSERT_EQ(stats.m_removedItems, 5U);
+    ASSERT_TRUE(areEqual(source, "", dest, ""));
+    ASSERT_TRUE(areEqual(dest, "", source, ""));
+}
+
 TEST(FileSystemHelper, folderToFolder2)
 {
     auto fs = makeFileSystem();
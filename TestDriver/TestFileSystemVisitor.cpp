@@ -7,6 +7,8 @@
 #include "CompoundFs/DirectoryStructure.h"
 #include "CompoundFs/Path.h"
 #include "CompoundFs/FileSystemHelper.h"
+#include <cstdio>
+#include <map>
 #include <string>
 
 using namespace std::string_literals;
@@ -60,6 +62,53 @@ FileSystem createEnvironment()
     createFile("folder/subFolder/file3", fs);
     return fs;
 }
+
+std::string writeTar(FileSystem& fs, Path path)
+{
+    FILE* file = std::tmpfile();
+    FsTarVisitor tarVisitor(fs, file);
+    FileSystemVisitor(fs).visit(path, tarVisitor);
+
+    std::string archive(size_t(ftell(file)), '\0');
+    rewind(file);
+    archive.resize(fread(archive.data(), 1, archive.size(), file));
+    fclose(file);
+    return archive;
+}
+
+/// Maps the names of the entries to their type and content. Understands the pax path record only.
+std::map<std::string, std::pair<char, std::string>> readTar(const std::string& archive)
+{
+    std::map<std::string, std::pair<char, std::string>> entries;
+    std::string paxPath;
+    for (size_t pos = 0; archive.compare(pos, 512, std::string(512, '\0')) != 0;)
+    {
+        auto header = archive.substr(pos, 512);
+        unsigned checksum = 0;
+        for (size_t i = 0; i < header.size(); i++)
+            checksum += i >= 148 && i < 156 ? ' ' : uint8_t(header[i]);
+        EXPECT_EQ(checksum, std::stoul(header.substr(148, 7), nullptr, 8));
+
+        auto field = [&](size_t offset, size_t size) {
+            return std::string(header.c_str() + offset, strnlen(header.c_str() + offset, size));
+        };
+        auto prefix = field(345, 155);
+        auto name = prefix.empty() ? field(0, 100) : prefix + '/' + field(0, 100);
+        auto size = std::stoull(field(124, 12), nullptr, 8);
+        auto content = archive.substr(pos + 512, size);
+        pos += 512 + (size + 511) / 512 * 512;
+
+        if (header[156] == 'x')
+        {
+            auto record = content.find(" path=");
+            paxPath = content.substr(record + 6, content.find('\n', record) - record - 6);
+            continue;
+        }
+        entries[paxPath.empty() ? name : paxPath] = { header[156], content };
+        paxPath.clear();
+    }
+    return entries;
+}
 }
 
 TEST(FileSystemVisitor, NonExistantMakesNoVisitation)
@@ -343,6 +392,59 @@ TEST(FsCompareVisitor, ComplexFsIsNotEqual)
 
 ///////////////////////////////////////////////////////////////////////////////
 
+TEST(FsTarVisitor, archivesFolderTree)
+{
+    auto fs = createEnvironment();
+    std::string bigData(300 * 1000 + 7, 'x');
+    createFile("folder/subFolder/big", fs, bigData);
+    fs.addAttribute("folder/attribute", 42.0);
+
+    auto archive = writeTar(fs, "folder");
+    ASSERT_EQ(archive.size() % 512, 0U);
+    auto entries = readTar(archive);
+    std::map<std::string, std::pair<char, std::string>> expected {
+        { "folder/", { '5', "" } },
+        { "folder/file1", { '0', "test" } },
+        { "folder/file2", { '0', "test" } },
+        { "folder/subFolder/", { '5', "" } },
+        { "folder/subFolder/file3", { '0', "test" } },
+        { "folder/subFolder/big", { '0', bigData } }
+    };
+    ASSERT_EQ(entries, expected);
+}
+
+TEST(FsTarVisitor, rootArchiveHasNoRootEntry)
+{
+    auto fs = createEnvironment();
+    auto entries = readTar(writeTar(fs, ""));
+    ASSERT_EQ(entries.size(), 6U);
+    ASSERT_EQ(entries["file0"].second, "test");
+    ASSERT_EQ(entries["folder/subFolder/file3"].second, "test");
+}
+
+TEST(FsTarVisitor, longNamesUsePrefixOrPaxHeader)
+{
+    auto fs = makeFileSystem();
+    std::string folder(120, 'f');
+    std::string longName(150, 'n');
+    createFile(Path(folder + "/short"), fs, "1");
+    createFile(Path(folder + "/" + longName), fs, "2");
+
+    auto entries = readTar(writeTar(fs, ""));
+    ASSERT_EQ(entries[folder + "/short"].second, "1");
+    ASSERT_EQ(entries[folder + "/" + longName].second, "2");
+    ASSERT_EQ(entries.size(), 3U);
+}
+
+TEST(FsTarVisitor, missingPathGivesEmptyArchive)
+{
+    auto fs = makeFileSystem();
+    auto archive = writeTar(fs, "folder");
+    ASSERT_EQ(archive, std::string(1024, '\0'));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
 TEST(TempFileBuffer, EmptyFileBufferReturnsEmptyOptional)
 {
     Private::TempFileBuffer tfb;
@@ -425,7 +527,8 @@ TEST(TempFileBuffer, fileSizeIsMoreThanBufferSize)
     Private::TempFileBuffer tfb;
     std::vector<std::string> entries;
 
-    int i = 1000;
+    // all keys need the same number of digits, even for the buffers of large page sizes
+    int i = 1000000;
     auto str = std::to_string(i++);
     tfb.write(str.c_str(), std::string(""));
     entries.push_back(str);
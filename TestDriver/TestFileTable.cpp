@@ -12,7 +12,7 @@ using namespace TxFs;
 TEST(FileTable, Empty)
 {
     FileTable ft;
-    ASSERT_EQ(sizeof(ft) , 4096);
+    ASSERT_EQ(sizeof(ft) , PageSize);
 
     IntervalSequence is;
     ft.insertInto(is);
@@ -35,10 +35,72 @@ TEST(FileTable, transferBackAndForth)
     ASSERT_EQ(is , is2);
 }
 
+TEST(FileTable, transferScatteredIntervals)
+{
+    IntervalSequence is;
+    constexpr auto maxPage = PageIndex(MaxPages);
+    is.pushBack(Interval(maxPage - 10, maxPage - 1));
+    is.pushBack(Interval(0));
+    is.pushBack(Interval(maxPage / 2, maxPage / 2 + 3));
+    is.pushBack(Interval(7));
+
+    IntervalSequence is2 = is;
+    FileTable ft;
+    ft.transferFrom(is);
+    ASSERT_TRUE(is.empty());
+
+    ft.insertInto(is);
+    ASSERT_EQ(is, is2);
+}
+
+TEST(FileTable, transferGapsOfAllSizesForwardAndBackward)
+{
+    // with 64 bit page indices the gaps and lengths are stored as variable-length integers of all sizes
+    constexpr auto maxPage = PageIndex(MaxPages);
+    constexpr auto base = maxPage / 4;
+    IntervalSequence is;
+    for (PageIndex gap = 1; gap < maxPage / 4; gap *= 2)
+    {
+        is.pushBack(Interval(base + 2 * gap, base + 3 * gap));
+        is.pushBack(Interval(base));
+    }
+    is.pushBack(Interval(1, maxPage - 1));
+    is.pushBack(Interval(0));
+
+    IntervalSequence is2 = is;
+    FileTable ft;
+    ft.transferFrom(is);
+    ASSERT_TRUE(is.empty());
+
+    ft.insertInto(is);
+    ASSERT_EQ(is, is2);
+}
+
+#ifdef TXFS_PAGE_INDEX_64
+TEST(FileTable, singlePagesCloseToEachOtherTakeOneByte)
+{
+    IntervalSequence is;
+    for (PageIndex i = 0; i <= FileTable::DataSize; i++)
+        is.pushBack(Interval(2 * i));
+
+    IntervalSequence is2 = is;
+    FileTable ft;
+    ft.transferFrom(is);
+    ASSERT_EQ(is.size(), 1);
+    ASSERT_EQ(is.front(), Interval(2 * FileTable::DataSize));
+
+    IntervalSequence is3;
+    ft.insertInto(is3);
+    is3.pushBack(is.front());
+    ASSERT_EQ(is3, is2);
+}
+#endif
+
 TEST(FileTable, transferNotEnoughSpace)
 {
+    // every interval takes at least one byte
     IntervalSequence is;
-    for (uint32_t i = 0; i < 1500; i++)
+    for (uint32_t i = 0; i <= FileTable::DataSize; i++)
         is.pushBack(Interval(i * 2, i * 2 + 1));
 
     IntervalSequence is2 = is;
@@ -57,7 +119,7 @@ TEST(FileTable, transferNotEnoughSpace)
 TEST(FileTable, transferNotEnoughSpace2)
 {
     IntervalSequence is;
-    for (uint32_t i = 0; i < 500; i++)
+    for (uint32_t i = 0; i <= FileTable::DataSize; i++)
         is.pushBack(Interval(i * 3, i * 3 + 2));
 
     IntervalSequence is2 = is;
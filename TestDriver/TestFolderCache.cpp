@@ -0,0 +1,34 @@
+
+
+#include <gtest/gtest.h>
+#include "CompoundFs/FolderCache.h"
+#include "CompoundFs/DirectoryStructure.h"
+
+using namespace TxFs;
+
+TEST(FolderCache, findReturnsInsertedFolder)
+{
+    FolderCache cache;
+    DirectoryKey dkey("folder");
+    ASSERT_FALSE(cache.find(dkey));
+
+    cache.insert(dkey, Folder { 5 });
+    ASSERT_EQ(cache.find(dkey), Folder { 5 });
+    ASSERT_FALSE(cache.find(DirectoryKey(Folder { 5 }, "folder")));
+
+    cache.erase(dkey);
+    ASSERT_FALSE(cache.find(dkey));
+}
+
+TEST(FolderCache, sizeIsBounded)
+{
+    FolderCache cache(10);
+    for (uint32_t i = 0; i < 100; i++)
+        cache.insert(DirectoryKey(std::to_string(i)), Folder { i });
+
+    ASSERT_EQ(cache.size(), 10);
+    ASSERT_EQ(cache.find(DirectoryKey("99")), Folder { 99 });
+
+    cache.clear();
+    ASSERT_EQ(cache.size(), 0);
+}
@@ -15,6 +15,12 @@ using namespace TxFs;
 
 namespace 
 {
+// number of single page intervals a FileTable holds, with 64 bit indices if the pages are close to each other
+#ifdef TXFS_PAGE_INDEX_64
+constexpr size_t SinglePagesPerFileTable = FileTable::DataSize;
+#else
+constexpr size_t SinglePagesPerFileTable = FileTable::DataSize / sizeof(PageIndex);
+#endif
 
 FileDescriptor createFile(std::shared_ptr<CacheManager> cm)
 {
@@ -26,7 +32,7 @@ FileDescriptor createFile(std::shared_ptr<CacheManager> cm)
 
 std::vector<FileDescriptor> createFiles(std::shared_ptr<CacheManager> cm, size_t files, size_t pages)
 {
-    std::vector<uint8_t> data(4096, 'Y');
+    std::vector<uint8_t> data(PageSize, 'Y');
     std::vector<FileWriter> writers(files, cm);
     for (size_t i = 0; i < pages; i++)
         for (auto& writer: writers)
@@ -101,7 +107,7 @@ TEST(FreeStore, forEveryDeletedFileThereIsAtLeastAFreePage)
     fsfd = fs.close();
     auto is = readAllFreeStorePages(cm, fsfd.m_first);
     ASSERT_TRUE(is.totalLength() >= 50);
-    ASSERT_TRUE(fsfd.m_fileSize >= 50 * 4096);
+    ASSERT_TRUE(fsfd.m_fileSize >= 50 * PageSize);
     ASSERT_EQ(fsfd.m_first , freeStorePage.m_index);
 }
 
@@ -127,7 +133,7 @@ TEST(FreeStore, smallFilesAreConsolidatedInOnePageTable)
 
     auto is = readAllFreeStorePages(cm, fsfd.m_first);
     ASSERT_EQ(is.size() , 1);
-    ASSERT_EQ(fsfd.m_fileSize , is.totalLength() * 4096ULL);
+    ASSERT_EQ(fsfd.m_fileSize , is.totalLength() * uint64_t(PageSize));
 }
 
 TEST(FreeStore, deleteBigAndSmallFiles)
@@ -150,7 +156,7 @@ TEST(FreeStore, deleteBigAndSmallFiles)
 
     fsfd = fs.close();
     auto is = readAllFreeStorePages(cm, fsfd.m_first);
-    ASSERT_EQ(fsfd.m_fileSize, is.totalLength() * 4096ULL);
+    ASSERT_EQ(fsfd.m_fileSize, is.totalLength() * uint64_t(PageSize));
 }
 
 TEST(FreeStore, deleteManyMetaDataPages)
@@ -207,7 +213,7 @@ TEST(FreeStore, DivertedPagesDoNotGetUsedAsFileTables)
     struct TestPage
     {
         uint32_t m_value;
-        char m_filler[4096 - 8];
+        char m_filler[PageSize - 8];
         uint32_t m_checkSum;
     };
     std::vector<FileDescriptor> fileDescriptors;
@@ -324,6 +330,30 @@ TEST(FreeStore, deallocatedPagesAreAvailableAfterClose)
     ASSERT_EQ(fsfd.m_fileSize , 0);
 }
 
+TEST(FreeStore, deletedPagesAreAvailableAfterClose)
+{
+    auto cm = std::make_shared<CacheManager>(std::make_unique<MemoryFile>());
+    TypedCacheManager tcm(cm);
+    auto freeStorePage = tcm.newPage<FileTable>();
+    auto pages = cm->allocatePageInterval(10);
+
+    FileDescriptor fsfd(freeStorePage.m_index);
+    {
+        FreeStore fs(cm, fsfd);
+        fs.deletePages(Interval(pages.begin(), pages.begin() + 3));
+        fs.deletePages(Interval(pages.begin() + 5, pages.end()));
+
+        ASSERT_EQ(fs.allocate(1), Interval()); // available after close
+        fsfd = fs.close();
+        ASSERT_EQ(fsfd.m_fileSize, 8ULL * PageSize);
+    }
+
+    FreeStore fs(cm, fsfd);
+    ASSERT_EQ(fs.allocate(10).length(), 3);
+    ASSERT_EQ(fs.allocate(10).length(), 5);
+    ASSERT_EQ(fs.allocate(10).length(), 0);
+}
+
 TEST(FreeStore, singlePageConsumed)
 {
     auto cm = std::make_shared<CacheManager>(std::make_unique<MemoryFile>());
@@ -359,8 +389,9 @@ TEST(FreeStore, deleteBigAndSmallFilesAndAllocateUntilEmpty)
     {
         FreeStore fs(cm, fsfd);
 
+        // the interleaved pages of the large files need more than one FileTable
         std::vector<FileDescriptor> fileDescriptors = createFiles(cm, 1500, 1);
-        for (auto& large: createFiles(cm, 3, 2200))
+        for (auto& large: createFiles(cm, 2, SinglePagesPerFileTable + 1))
             fileDescriptors.push_back(large);
 
         std::shuffle(fileDescriptors.begin(), fileDescriptors.end(), std::mt19937(std::random_device()()));
@@ -2,9 +2,13 @@
 
 #include <gtest/gtest.h>
 #include "CompoundFs/LockProtocol.h"
+#include "CompoundFs/SharedLock.h"
 
 #include <mutex>
 #include <shared_mutex>
+#include <thread>
+#include <atomic>
+#include <chrono>
 
 using namespace TxFs;
 
@@ -97,3 +101,43 @@ TEST(LockProtocol, commitAccessIsBlockedByReadAccess)
 //    //rlock = slp.readAccess();
 //    t.join();
 //}
+
+TEST(LockProtocol, snapshotAccessIsNotBlockedByCommitAccess)
+{
+    SimpleLockProtocoll slp;
+    auto commit = slp.commitAccess(slp.writeAccess());
+
+    ASSERT_FALSE(slp.tryReadAccess());
+    auto lock = slp.snapshotAccess();
+    auto lock2 = slp.snapshotAccess();
+}
+
+TEST(LockProtocol, reclaimAccessWaitsForSnapshotAccess)
+{
+    DebugSharedLock snapshot;
+    auto snapshotCopy = snapshot;
+    LockProtocol<DebugSharedLock, DebugSharedLock> lp(DebugSharedLock(), DebugSharedLock(), DebugSharedLock(),
+                                                      std::move(snapshotCopy));
+    auto lock = lp.snapshotAccess();
+
+    std::atomic<bool> reclaimed = false;
+    std::thread th([&]() {
+        auto reclaim = lp.reclaimAccess();
+        reclaimed = true;
+    });
+    snapshot.waitForWaiting(1); // reclaimAccess() blocks
+    EXPECT_FALSE(reclaimed);
+    lock.release();
+    th.join();
+    EXPECT_TRUE(reclaimed);
+}
+
+TEST(LockProtocol, tryReclaimAccessFailsWhileSnapshotAccessIsHeld)
+{
+    LockProtocol<DebugSharedLock, DebugSharedLock> lp;
+    auto lock = lp.snapshotAccess();
+    ASSERT_FALSE(lp.tryReclaimAccess());
+
+    lock.release();
+    ASSERT_TRUE(lp.tryReclaimAccess());
+}
@@ -8,7 +8,7 @@ using namespace TxFs;
 TEST(LogPage, size)
 {
     LogPage log(0);
-    ASSERT_EQ(sizeof(log) , 4096);
+    ASSERT_EQ(sizeof(log) , PageSize);
 }
 
 TEST(LogPage, checkSignature)
@@ -23,7 +23,7 @@ TEST(LogPage, storingRetrieving)
     LogPage lp(100);
 
     auto pageCopies = lp.getPageCopies();
-    for (uint32_t i = 0; i < 500; i++)
+    for (uint32_t i = 0; i < LogPage::MAX_ENTRIES; i++)
         pageCopies.push_back({ i, i });
 
     for (auto pc: pageCopies)
@@ -53,7 +53,7 @@ TEST(LogPage, pushBackIterator)
     auto pageCopies = lp.getPageCopies();
     ASSERT_EQ(lp.pushBack(pageCopies.begin(), pageCopies.end()) , pageCopies.end());
     ASSERT_EQ(lp.size() , 2 * (LogPage::MAX_ENTRIES / 2) );
-    ASSERT_TRUE(lp.pushBack({ 1, 1 }));
+    ASSERT_EQ(lp.pushBack({ 1, 1 }), LogPage::MAX_ENTRIES % 2 == 1); // the odd entry left
     ASSERT_TRUE(!lp.pushBack({ 1, 1 }));
 }
 
@@ -13,8 +13,8 @@ TEST(Node, hasPageSize)
     Leaf l;
     InnerNode n;
 
-    ASSERT_EQ(sizeof(l) , 4096);
-    ASSERT_EQ(sizeof(n) , 4096);
+    ASSERT_EQ(sizeof(l) , PageSize);
+    ASSERT_EQ(sizeof(n) , PageSize);
 }
 
 TEST(Leaf, insert)
@@ -25,11 +25,11 @@ TEST(Leaf, insert)
 
     l.insert("Test", "");
     ASSERT_EQ(l.nofItems() , 1);
-    ASSERT_EQ(l.bytesLeft() , s - 8);
+    ASSERT_EQ(l.bytesLeft() , s - 12);
 
     l.insert("Anfang", "");
     ASSERT_EQ(l.nofItems() , 2);
-    ASSERT_EQ(l.bytesLeft() , s - 18);
+    ASSERT_EQ(l.bytesLeft() , s - 26);
 }
 
 TEST(Leaf, keysAreSorted)
@@ -609,3 +609,146 @@ TEST(InnerNode, mergeWithRightPage)
     ASSERT_EQ(n.getRight(n.beginTable() + 4) , 400);
     ASSERT_EQ(n.getRight(n.beginTable() + 5) , 500);
 }
+
+TEST(Leaf, keysWithCommonPrefixAreStoredOnce)
+{
+    Leaf plain;
+    Leaf packed;
+    std::string prefix(40, 'x');
+    for (size_t i = 100; i < 400; i++)
+    {
+        plain.insert(std::to_string(i), "");
+        if (!packed.hasSpace(prefix + std::to_string(i), ""))
+            packed.compact();
+        packed.insert(prefix + std::to_string(i), "");
+    }
+
+    packed.compact();
+    ASSERT_EQ(packed.getPrefix(), ByteStringView(prefix));
+    ASSERT_EQ(packed.nofItems(), 300);
+    ASSERT_EQ(packed.bytesLeft(), plain.bytesLeft() - prefix.size());
+    for (size_t i = 100; i < 400; i++)
+        ASSERT_NE(packed.find(prefix + std::to_string(i)), packed.endTable());
+    ASSERT_EQ(packed.getKey(packed.beginTable()), ByteString(prefix + "100"));
+}
+
+TEST(Leaf, insertShrinksThePrefix)
+{
+    Leaf l;
+    l.insert("Folder/b", "1");
+    l.insert("Folder/c", "2");
+    l.compact();
+    ASSERT_EQ(l.getPrefix(), ByteStringView("Folder/"));
+
+    auto required = l.requiredSpace("File", "3");
+    auto bytesLeft = l.bytesLeft();
+    l.insert("File", "3");
+    ASSERT_EQ(l.getPrefix(), ByteStringView("F"));
+    ASSERT_EQ(l.bytesLeft(), bytesLeft - required);
+
+    ASSERT_EQ(l.getKey(l.beginTable()), ByteString("File"));
+    ASSERT_EQ(l.getValue(l.find("Folder/c")), ByteStringView("2"));
+    ASSERT_EQ(l.find("Folder"), l.endTable());
+    ASSERT_EQ(l.lowerBound("A"), l.beginTable());
+    ASSERT_EQ(l.lowerBound("Z"), l.endTable());
+}
+
+TEST(Leaf, splitKeepsAKeyOutsideOfTheRangeApart)
+{
+    Leaf l;
+    std::string prefix(200, 'x');
+    for (size_t i = 100; l.hasSpace(prefix + std::to_string(i), ""); i++)
+    {
+        l.insert(prefix + std::to_string(i), "");
+        l.compact();
+    }
+    auto nofItems = l.nofItems();
+    ASSERT_FALSE(l.hasSpace("a", ""));
+
+    Leaf m;
+    l.split(&m, "a", "");
+    ASSERT_EQ(l.nofItems(), 1);
+    ASSERT_EQ(l.getKey(l.beginTable()), ByteString("a"));
+    ASSERT_EQ(m.nofItems(), nofItems);
+}
+
+TEST(InnerNode, keysWithCommonPrefixAreStoredOnce)
+{
+    std::string prefix(20, 'x');
+    InnerNode n(prefix + "200", 0, 200);
+    n.insert(prefix + "100", 100);
+    n.insert(prefix + "300", 300);
+    n.compact();
+
+    ASSERT_EQ(n.getPrefix(), ByteStringView(prefix));
+    ASSERT_EQ(n.findPage(prefix + "150"), 100);
+    ASSERT_EQ(n.findPage(prefix + "300"), 300);
+    ASSERT_EQ(n.findPage("a"), 0);
+    ASSERT_EQ(n.findPage("z"), 300);
+    ASSERT_EQ(n.getKey(n.beginTable() + 1), ByteString(prefix + "200"));
+
+    n.insert("a", 50);
+    ASSERT_EQ(n.getPrefix(), ByteStringView());
+    ASSERT_EQ(n.findPage("b"), 50);
+    ASSERT_EQ(n.findPage(prefix + "250"), 200);
+}
+
+TEST(InnerNode, splitKeepsAKeyOutsideOfTheRangeApart)
+{
+    // fixed width numbers keep the keys sorted like the numbers for any number of items per page
+    std::string prefix(200, 'x');
+    auto numbered = [&](PageIndex i) {
+        auto number = std::to_string(i);
+        return prefix + std::string(6 - number.size(), '0') + number;
+    };
+
+    InnerNode n(numbered(100), 0, 100);
+    for (PageIndex i = 101; n.hasSpace(numbered(i)); i++)
+    {
+        n.insert(numbered(i), i);
+        n.compact();
+    }
+    auto nofItems = n.nofItems();
+    ASSERT_FALSE(n.hasSpace("z"));
+
+    InnerNode right;
+    auto key = n.split(&right, "z", 1000);
+    ASSERT_EQ(n.nofItems(), nofItems - 1);
+    ASSERT_EQ(key, ByteString(numbered(PageIndex(100 + nofItems - 1))));
+    ASSERT_EQ(right.nofItems(), 1);
+    ASSERT_EQ(right.findPage("z"), 1000);
+}
+
+TEST(InnerNode, mergeWithRightPageRecomputesPrefix)
+{
+    InnerNode n("a100", 0, 100);
+    InnerNode m("a300", 250, 300);
+
+    ASSERT_TRUE(n.canMergeWith(m, "a200"));
+    n.mergeWith(m, "a200");
+    ASSERT_EQ(n.getPrefix(), ByteStringView("a"));
+    ASSERT_EQ(n.nofItems(), 3);
+    ASSERT_EQ(n.findPage("a250"), 250);
+    ASSERT_EQ(n.findPage("a350"), 300);
+}
+
+TEST(Leaf, keysWithEqualHeadsAreFound)
+{
+    Leaf l;
+    std::vector<std::string> strs { "a", std::string(5, '\xff'), std::string(4, '\xff') };
+    for (int i = 100; i < 300; i++)
+        strs.push_back("file" + std::to_string(i));
+    std::shuffle(strs.begin(), strs.end(), std::mt19937(std::random_device()()));
+    for (const auto& str: strs)
+        l.insert(str, "");
+
+    std::sort(strs.begin(), strs.end());
+    for (size_t i = 0; i < strs.size(); i++)
+    {
+        ASSERT_EQ(l.find(strs[i]), l.beginTable() + i);
+        ASSERT_EQ(l.lowerBound(strs[i]), l.beginTable() + i);
+    }
+    ASSERT_EQ(l.lowerBound("file"), l.beginTable() + 1);
+    ASSERT_EQ(l.lowerBound("file2"), l.beginTable() + 101);
+    ASSERT_EQ(l.lowerBound(std::string(6, '\xff')), l.endTable());
+}
@@ -16,7 +16,7 @@ TEST(ReadOnlyFile, UnmodifiedCacheManagerCanCommitReadOnly)
 {
     MemoryFile mf;
     mf.newInterval(1);
-    uint8_t page[4096];
+    uint8_t page[PageSize];
     writeSignedPage(&mf, 0, page);
     CacheManager cm(std::make_unique<ReadOnlyFile<MemoryFile>>(std::move(mf)));
     cm.loadPage(0);
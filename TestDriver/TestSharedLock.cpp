@@ -1,11 +1,80 @@
 
 #include <gtest/gtest.h>
 #include <thread>
+#include <vector>
 
 #include "CompoundFs/SharedLock.h"
 
 using namespace TxFs;
 
+TEST(SharedLock, readersShareWritersExclude)
+{
+    SharedLock sl;
+    sl.lock_shared();
+    ASSERT_TRUE(sl.try_lock_shared());
+    ASSERT_FALSE(sl.try_lock());
+    sl.unlock_shared();
+    sl.unlock_shared();
+
+    ASSERT_TRUE(sl.try_lock());
+    ASSERT_FALSE(sl.try_lock_shared());
+    ASSERT_FALSE(sl.try_lock());
+    sl.unlock();
+    ASSERT_TRUE(sl.try_lock_shared());
+    sl.unlock_shared();
+}
+
+TEST(SharedLock, waitingWriterKeepsNewReadersOut)
+{
+    SharedLock sl;
+    sl.lock_shared();
+    std::thread writer([&] {
+        sl.lock();
+        sl.unlock();
+    });
+
+    // a reader is admitted until the writer waits
+    while (sl.try_lock_shared())
+    {
+        sl.unlock_shared();
+        std::this_thread::yield();
+    }
+    sl.unlock_shared();
+    writer.join();
+    ASSERT_TRUE(sl.try_lock_shared());
+    sl.unlock_shared();
+}
+
+TEST(SharedLock, concurrentReadersAndWriters)
+{
+    SharedLock sl(10);
+    int64_t value = 0;
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 4; i++)
+        threads.emplace_back([&] {
+            for (int j = 0; j < 10000; j++)
+            {
+                sl.lock();
+                value++;
+                sl.unlock();
+            }
+        });
+    for (int i = 0; i < 4; i++)
+        threads.emplace_back([&] {
+            for (int j = 0; j < 1000; j++)
+            {
+                sl.lock_shared();
+                auto v = value;
+                std::this_thread::yield();
+                EXPECT_EQ(v, value); // no writer gets in
+                sl.unlock_shared();
+            }
+        });
+    for (auto& thread: threads)
+        thread.join();
+    ASSERT_EQ(value, 4 * 10000);
+}
+
 TEST(DebugSharedLock, nolock)
 {
     DebugSharedLock dsl;
@@ -113,7 +113,7 @@ void importFiles(std::string_view source, FileSystem& fs, std::string_view desti
             fs.createPath(Path(dest));
         else if (e.is_regular_file())
         {
-            buffer.resize(BufferPages * 4096ULL);
+            buffer.resize(BufferPages * PageSize);
             auto wh = fs.createFile(Path(dest));
             PosixFile rf(e, OpenMode::ReadOnly);
             auto fileSizeInPages = (PageIndex) rf.fileSizeInPages();
@@ -204,7 +204,7 @@ PYBIND11_MODULE(py_txfs, m)
                  for (auto cur = fs.begin(path); cur; cur = fs.next(cur))
                      py::print(cur.key().m_relativePath, cur.value());
              })
-        .def("commit", &FileSystem::commit)
+        .def("commit", [](FileSystem& fs) { fs.commit(); })
         .def("rollback", &FileSystem::rollback)
         .def("sub_folder", subFolder)
 